@@ -1,3 +1,4 @@
+--@pure
 local function count_classes(pilots)
    local class_count = {}
    for i, p in ipairs(pilots) do
@@ -608,6 +608,7 @@ static int ai_loadEquip (void)
 
    /* Create new state. */
    equip_env = nlua_newEnv(1);
+   nlua_setEnvName( equip_env, "%s", filename );
    nlua_loadStandard(equip_env);
 
    /* Load the file. */
@@ -654,6 +655,7 @@ static int ai_loadProfile( const char* filename )
 
    /* Create Lua. */
    env = nlua_newEnv(1);
+   nlua_setEnvName( env, "ai:%s", prof->name );
    nlua_loadStandard(env);
    prof->env = env;
 
@@ -757,6 +759,7 @@ void ai_think( Pilot* pilot, const double dt )
    pilot_acc         = 0;
    pilot_turn        = 0.;
    pilot_flags       = 0;
+   nlua_vectorScratchReset(); /* vec2.tmp() vectors only last a tick. */
    /* pilot_setTarget( cur_pilot, cur_pilot->id ); */
    pilot_weapSetAIClear( cur_pilot ); /* Hack so shit works. TODO fix. */
 
@@ -388,6 +388,7 @@ static nlua_env background_create( const char *name )
 
    /* Create the Lua env. */
    env = nlua_newEnv(1);
+   nlua_setEnvName( env, "%s", path );
    nlua_loadStandard(env);
    nlua_loadTex(env);
    nlua_loadCol(env);
@@ -0,0 +1,226 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file bench.c
+ *
+ * @brief Small harness shared by the micro-benchmarks.
+ *
+ * Each benchmark is run with a doubling number of iterations until it takes
+ * at least BENCH_MINTIME seconds, and then the time per iteration and the
+ * throughput are printed.
+ */
+
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+
+#include "log.h"
+
+
+static const char *bench_rootpath = "."; /**< Root of the source tree, holds dat/. */
+static volatile double bench_sinkval = 0.; /**< Keeps results from being optimized out. */
+
+
+/*
+ * Prototypes.
+ */
+static int bench_sortNames( const void *p1, const void *p2 );
+
+
+/**
+ * @brief Stands in for log.c, which depends on the console.
+ */
+int logprintf( FILE *stream, int newline, const char *fmt, ... )
+{
+   va_list ap;
+   int n;
+
+   va_start( ap, fmt );
+   n = vfprintf( stream, fmt, ap );
+   va_end( ap );
+   if (newline)
+      fputc( '\n', stream );
+   return n;
+}
+
+
+/**
+ * @brief Initializes a benchmark program.
+ *
+ *    @param argc Number of arguments.
+ *    @param argv Arguments, the first one being the root of the source tree.
+ *    @param name Name of the benchmark program.
+ */
+void bench_init( int argc, char **argv, const char *name )
+{
+   if (argc > 1)
+      bench_rootpath = argv[1];
+   printf( "== %s\n", name );
+}
+
+
+/**
+ * @brief Gets the root of the source tree.
+ */
+const char *bench_root (void)
+{
+   return bench_rootpath;
+}
+
+
+/**
+ * @brief Reads a whole file relative to the root of the source tree.
+ *
+ *    @param path Path of the file.
+ *    @param[out] size Size of the file (may be NULL).
+ *    @return Newly allocated buffer with a trailing NUL or NULL on error.
+ */
+char *bench_readFile( const char *path, size_t *size )
+{
+   char buf[1024];
+   FILE *f;
+   char *data;
+   long len;
+
+   snprintf( buf, sizeof(buf), "%s/%s", bench_rootpath, path );
+   f = fopen( buf, "rb" );
+   if (f == NULL)
+      return NULL;
+
+   fseek( f, 0, SEEK_END );
+   len = ftell( f );
+   fseek( f, 0, SEEK_SET );
+   data = malloc( len+1 );
+   if (fread( data, 1, len, f ) != (size_t)len) {
+      free( data );
+      fclose( f );
+      return NULL;
+   }
+   data[len] = '\0';
+   fclose( f );
+
+   if (size != NULL)
+      *size = len;
+   return data;
+}
+
+
+/**
+ * @brief Compares names for qsort.
+ */
+static int bench_sortNames( const void *p1, const void *p2 )
+{
+   return strcmp( *(char* const*) p1, *(char* const*) p2 );
+}
+
+
+/**
+ * @brief Lists the files of a directory relative to the root of the source tree.
+ *
+ *    @param path Directory to list.
+ *    @param suffix Only list files ending with this.
+ *    @param[out] n Number of files found.
+ *    @return Sorted list of paths relative to the root, free each and the list.
+ */
+char **bench_listDir( const char *path, const char *suffix, int *n )
+{
+   char buf[1024];
+   DIR *d;
+   struct dirent *ent;
+   char **files;
+   size_t len, slen;
+   int m;
+
+   *n    = 0;
+   m     = 0;
+   files = NULL;
+   snprintf( buf, sizeof(buf), "%s/%s", bench_rootpath, path );
+   d = opendir( buf );
+   if (d == NULL)
+      return NULL;
+
+   slen = strlen( suffix );
+   while ((ent = readdir( d )) != NULL) {
+      if (ent->d_name[0] == '.')
+         continue;
+      len = strlen( ent->d_name );
+      if ((len < slen) || (strcmp( &ent->d_name[len-slen], suffix ) != 0))
+         continue;
+      if (*n >= m) {
+         m     = (m==0) ? 64 : 2*m;
+         files = realloc( files, m * sizeof(char*) );
+      }
+      snprintf( buf, sizeof(buf), "%s/%s", path, ent->d_name );
+      files[ (*n)++ ] = strdup( buf );
+   }
+   closedir( d );
+
+   qsort( files, *n, sizeof(char*), bench_sortNames );
+   return files;
+}
+
+
+/**
+ * @brief Gets a monotonic time in seconds.
+ */
+double bench_time (void)
+{
+   struct timespec ts;
+   clock_gettime( CLOCK_MONOTONIC, &ts );
+   return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+
+/**
+ * @brief Runs a benchmark and prints the results.
+ *
+ *    @param name Name of the benchmark.
+ *    @param func Function running the algorithm.
+ *    @param data Data to pass to func.
+ *    @param units Units processed per iteration (0. to not print throughput).
+ *    @param unit Name of the unit.
+ */
+void bench_run( const char *name, bench_func func, void *data,
+      double units, const char *unit )
+{
+   unsigned long n;
+   double t0, dt;
+
+   /* Warm up caches. */
+   func( data, 1 );
+
+   n = 1;
+   for (;;) {
+      t0 = bench_time();
+      func( data, n );
+      dt = bench_time() - t0;
+      if (dt >= BENCH_MINTIME)
+         break;
+      n *= 2;
+   }
+
+   if (units > 0.)
+      printf( "%-40s %10lu iter %12.1f ns/iter %12.4g %s/s\n",
+            name, n, 1e9 * dt / (double)n, units * (double)n / dt, unit );
+   else
+      printf( "%-40s %10lu iter %12.1f ns/iter\n",
+            name, n, 1e9 * dt / (double)n );
+   fflush( stdout );
+}
+
+
+/**
+ * @brief Consumes a result so the compiler can't optimize the work away.
+ */
+void bench_sink( double x )
+{
+   bench_sinkval += x;
+}
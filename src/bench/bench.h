@@ -0,0 +1,35 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef BENCH_H
+#  define BENCH_H
+
+
+#include <stddef.h>
+
+
+#define BENCH_MINTIME   0.5 /**< Minimum time in seconds to run each benchmark for. */
+
+
+/**
+ * @brief Benchmarked function, must run the algorithm n times.
+ */
+typedef void (*bench_func)( void *data, unsigned long n );
+
+
+/* Setup. */
+void bench_init( int argc, char **argv, const char *name );
+const char *bench_root (void);
+char *bench_readFile( const char *path, size_t *size );
+char **bench_listDir( const char *path, const char *suffix, int *n );
+
+/* Running. */
+double bench_time (void);
+void bench_run( const char *name, bench_func func, void *data,
+      double units, const char *unit );
+void bench_sink( double x );
+
+
+#endif /* BENCH_H */
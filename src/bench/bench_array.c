@@ -0,0 +1,145 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file bench_array.c
+ *
+ * @brief Benchmarks the array.h helpers.
+ */
+
+
+#include "naev.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "array.h"
+
+
+#define ARRAY_ELEMENTS  4096 /**< Elements per array. */
+
+
+/**
+ * @brief Bigger element to see the effect of element size.
+ */
+typedef struct ArrayElem_ {
+   double x; /**< X. */
+   double y; /**< Y. */
+   int id; /**< ID. */
+   char pad[44]; /**< Filler up to 64 bytes. */
+} ArrayElem;
+
+
+/*
+ * Prototypes.
+ */
+static void array_benchPush( void *data, unsigned long n );
+static void array_benchGrow( void *data, unsigned long n );
+static void array_benchIterate( void *data, unsigned long n );
+static void array_benchErase( void *data, unsigned long n );
+
+
+/**
+ * @brief Creates an array and pushes ints into it.
+ */
+static void array_benchPush( void *data, unsigned long n )
+{
+   unsigned long i;
+   int j, *arr;
+   (void) data;
+
+   for (i=0; i<n; i++) {
+      arr = array_create( int );
+      for (j=0; j<ARRAY_ELEMENTS; j++)
+         array_push_back( &arr, j );
+      bench_sink( arr[ARRAY_ELEMENTS-1] );
+      array_free( arr );
+   }
+}
+
+
+/**
+ * @brief Creates an array and grows it with big elements.
+ */
+static void array_benchGrow( void *data, unsigned long n )
+{
+   unsigned long i;
+   int j;
+   ArrayElem *arr, *e;
+   (void) data;
+
+   for (i=0; i<n; i++) {
+      arr = array_create( ArrayElem );
+      for (j=0; j<ARRAY_ELEMENTS; j++) {
+         e     = &array_grow( &arr );
+         e->x  = j;
+         e->y  = -j;
+         e->id = j;
+      }
+      array_shrink( &arr );
+      bench_sink( arr[ARRAY_ELEMENTS-1].x );
+      array_free( arr );
+   }
+}
+
+
+/**
+ * @brief Iterates over an array using array_size.
+ */
+static void array_benchIterate( void *data, unsigned long n )
+{
+   unsigned long i;
+   int j;
+   double sum;
+   ArrayElem *arr = data;
+
+   sum = 0.;
+   for (i=0; i<n; i++)
+      for (j=0; j<array_size(arr); j++)
+         sum += arr[j].x;
+   bench_sink( sum );
+}
+
+
+/**
+ * @brief Fills an array and erases it one element at a time from the front.
+ */
+static void array_benchErase( void *data, unsigned long n )
+{
+   unsigned long i;
+   int j, *arr;
+   (void) data;
+
+   for (i=0; i<n; i++) {
+      arr = array_create( int );
+      for (j=0; j<ARRAY_ELEMENTS/4; j++)
+         array_push_back( &arr, j );
+      while (array_size(arr) > 0)
+         array_erase( &arr, &arr[0], &arr[1] );
+      array_free( arr );
+   }
+}
+
+
+int main( int argc, char **argv )
+{
+   ArrayElem *arr;
+   int j;
+
+   bench_init( argc, argv, "array" );
+
+   bench_run( "array_push_back int", array_benchPush, NULL, ARRAY_ELEMENTS, "elements" );
+   bench_run( "array_grow 64 byte elements", array_benchGrow, NULL, ARRAY_ELEMENTS, "elements" );
+
+   arr = array_create( ArrayElem );
+   for (j=0; j<ARRAY_ELEMENTS; j++)
+      array_grow( &arr ).x = j;
+   bench_run( "array_size iteration", array_benchIterate, arr, ARRAY_ELEMENTS, "elements" );
+   array_free( arr );
+
+   bench_run( "array_erase front", array_benchErase, NULL, ARRAY_ELEMENTS/4, "elements" );
+
+   return 0;
+}
@@ -0,0 +1,300 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file bench_collide.c
+ *
+ * @brief Benchmarks pixel perfect sprite collisions.
+ *
+ * Uses synthetic round sprites of increasing size and the real ship sprites
+ * from dat/gfx/ship. Only the transparency maps are built, no OpenGL context
+ * is needed.
+ */
+
+
+#include "naev.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "nstring.h"
+#include <string.h>
+
+#include "bench.h"
+#include "collision.h"
+#include "npng.h"
+
+
+#define COLLIDE_CASES      4096 /**< Number of precomputed collision checks. */
+#define COLLIDE_MAXSHIPS   32   /**< Maximum real ship sprites to load. */
+
+
+/**
+ * @brief A single collision check.
+ */
+typedef struct CollideCase_ {
+   const glTexture *a; /**< First sprite sheet. */
+   const glTexture *b; /**< Second sprite sheet. */
+   int asx; /**< Sprite of a on x axis. */
+   int asy; /**< Sprite of a on y axis. */
+   int bsx; /**< Sprite of b on x axis. */
+   int bsy; /**< Sprite of b on y axis. */
+   Vector2d ap; /**< Position of a. */
+   Vector2d bp; /**< Position of b. */
+   double ad; /**< Direction of the line from a. */
+   double al; /**< Length of the line from a. */
+} CollideCase;
+
+
+static CollideCase collide_cases[COLLIDE_CASES]; /**< Checks to run. */
+static unsigned int collide_seed = 1; /**< Deterministic random seed. */
+
+
+/*
+ * Prototypes.
+ */
+static double collide_rand (void);
+static glTexture *collide_genSprite( int size );
+static glTexture *collide_loadSprite( const char *path );
+static void collide_genCases( glTexture **tex, int ntex );
+static void collide_sprite( void *data, unsigned long n );
+static void collide_line( void *data, unsigned long n );
+
+
+/**
+ * @brief Same as the engine's, the sheets are built here without OpenGL.
+ */
+int gl_isTrans( const glTexture* t, const int x, const int y )
+{
+   int i;
+   i = y*(int)(t->w) + x;
+   return !(t->trans[ i/8 ] & (1 << (i%8)));
+}
+
+
+/**
+ * @brief Deterministic random number in [0,1).
+ */
+static double collide_rand (void)
+{
+   collide_seed = collide_seed * 1103515245 + 12345;
+   return (double)((collide_seed >> 8) & 0xFFFFFF) / (double)0x1000000;
+}
+
+
+/**
+ * @brief Generates a round sprite with a hole, the size of the sheet is size.
+ */
+static glTexture *collide_genSprite( int size )
+{
+   glTexture *t;
+   int x, y, i;
+   double dx, dy, r, c;
+
+   t        = calloc( 1, sizeof(glTexture) );
+   t->name  = strdup( "synthetic" );
+   t->w     = t->h = t->sw = t->sh = size;
+   t->sx    = t->sy = 1.;
+   t->trans = calloc( size*size/8 + 1, 1 );
+   c        = (size-1) / 2.;
+   for (y=0; y<size; y++) {
+      for (x=0; x<size; x++) {
+         dx = x - c;
+         dy = y - c;
+         r  = sqrt( dx*dx + dy*dy );
+         if ((r < size/2.) && (r > size/8.)) {
+            i = y*size + x;
+            t->trans[ i/8 ] |= 1 << (i%8);
+         }
+      }
+   }
+   return t;
+}
+
+
+/**
+ * @brief Loads the transparency map of a real 8x8 ship sprite sheet.
+ */
+static glTexture *collide_loadSprite( const char *path )
+{
+   char buf[PATH_MAX];
+   SDL_RWops *rw;
+   npng_t *npng;
+   SDL_Surface *s;
+   glTexture *t;
+   Uint8 r, g, b, a;
+   Uint32 pix;
+   int x, y, i, bpp;
+
+   nsnprintf( buf, sizeof(buf), "%s/%s", bench_root(), path );
+   rw = SDL_RWFromFile( buf, "rb" );
+   if (rw == NULL)
+      return NULL;
+   npng = npng_open( rw );
+   if (npng == NULL) {
+      SDL_RWclose( rw );
+      return NULL;
+   }
+   s = npng_readSurface( npng, 0, 1 );
+   npng_close( npng );
+   SDL_RWclose( rw );
+   if (s == NULL)
+      return NULL;
+
+   t        = calloc( 1, sizeof(glTexture) );
+   t->name  = strdup( path );
+   t->w     = s->w;
+   t->h     = s->h;
+   t->sx    = ((s->w % 8 == 0) && (s->h % 8 == 0)) ? 8. : 1.;
+   t->sy    = t->sx;
+   t->sw    = t->w / t->sx;
+   t->sh    = t->h / t->sy;
+   t->trans = calloc( s->w*s->h/8 + 1, 1 );
+   bpp      = s->format->BytesPerPixel;
+   SDL_LockSurface( s );
+   for (y=0; y<s->h; y++) {
+      for (x=0; x<s->w; x++) {
+         pix = 0;
+         memcpy( &pix, (Uint8*)s->pixels + y*s->pitch + x*bpp, bpp );
+         SDL_GetRGBA( pix, s->format, &r, &g, &b, &a );
+         if (a != SDL_ALPHA_TRANSPARENT) {
+            i = y*s->w + x;
+            t->trans[ i/8 ] |= 1 << (i%8);
+         }
+      }
+   }
+   SDL_UnlockSurface( s );
+   SDL_FreeSurface( s );
+   return t;
+}
+
+
+/**
+ * @brief Generates overlapping pairs of sprites and lines crossing them.
+ */
+static void collide_genCases( glTexture **tex, int ntex )
+{
+   int i;
+   CollideCase *c;
+   double r;
+
+   for (i=0; i<COLLIDE_CASES; i++) {
+      c       = &collide_cases[i];
+      c->a    = tex[ (int)(collide_rand() * ntex) ];
+      c->b    = tex[ (int)(collide_rand() * ntex) ];
+      c->asx  = (int)(collide_rand() * c->a->sx);
+      c->asy  = (int)(collide_rand() * c->a->sy);
+      c->bsx  = (int)(collide_rand() * c->b->sx);
+      c->bsy  = (int)(collide_rand() * c->b->sy);
+      /* Bounding boxes always overlap so the pixel test runs. */
+      r       = (c->a->sw + c->b->sw) / 2. - 1.;
+      vect_cset( &c->ap, 0., 0. );
+      vect_cset( &c->bp, (collide_rand()-0.5) * r, (collide_rand()-0.5) * r );
+      /* Lines start outside and point near b. */
+      c->ad   = atan2( c->bp.y - c->ap.y + (collide_rand()-0.5) * c->b->sh,
+            c->bp.x - c->ap.x + (collide_rand()-0.5) * c->b->sw );
+      c->al   = 2. * r + c->b->sw;
+   }
+}
+
+
+/**
+ * @brief Runs CollideSprite on the cases.
+ */
+static void collide_sprite( void *data, unsigned long n )
+{
+   unsigned long i;
+   int hits;
+   CollideCase *c;
+   Vector2d crash;
+   (void) data;
+
+   hits = 0;
+   for (i=0; i<n; i++) {
+      c = &collide_cases[ i % COLLIDE_CASES ];
+      hits += CollideSprite( c->a, c->asx, c->asy, &c->ap,
+            c->b, c->bsx, c->bsy, &c->bp, &crash );
+   }
+   bench_sink( hits );
+}
+
+
+/**
+ * @brief Runs CollideLineSprite on the cases.
+ */
+static void collide_line( void *data, unsigned long n )
+{
+   unsigned long i;
+   int hits;
+   CollideCase *c;
+   Vector2d crash[2];
+   (void) data;
+
+   hits = 0;
+   for (i=0; i<n; i++) {
+      c = &collide_cases[ i % COLLIDE_CASES ];
+      hits += CollideLineSprite( &c->ap, c->ad, c->al,
+            c->b, c->bsx, c->bsy, &c->bp, crash );
+   }
+   bench_sink( hits );
+}
+
+
+int main( int argc, char **argv )
+{
+   char name[PATH_MAX];
+   glTexture *tex[COLLIDE_MAXSHIPS];
+   char **dirs, **files;
+   int i, j, ndirs, nfiles, ntex, size;
+
+   bench_init( argc, argv, "collide" );
+
+   /* Synthetic sprites. */
+   for (size=32; size<=256; size*=2) {
+      tex[0] = collide_genSprite( size );
+      collide_genCases( tex, 1 );
+      nsnprintf( name, sizeof(name), "CollideSprite synthetic %dx%d", size, size );
+      bench_run( name, collide_sprite, NULL, 1., "checks" );
+      nsnprintf( name, sizeof(name), "CollideLineSprite synthetic %dx%d", size, size );
+      bench_run( name, collide_line, NULL, 1., "checks" );
+      free( tex[0]->trans );
+      free( tex[0]->name );
+      free( tex[0] );
+   }
+
+   /* Real ship sprites, skipping comm and engine graphics. */
+   ntex  = 0;
+   dirs  = bench_listDir( "dat/gfx/ship", "", &ndirs );
+   for (i=0; i<ndirs; i++) {
+      files = bench_listDir( dirs[i], ".png", &nfiles );
+      for (j=0; j<nfiles; j++) {
+         if ((ntex < COLLIDE_MAXSHIPS) && (strstr( files[j], "_comm" ) == NULL) &&
+               (strstr( files[j], "_engine" ) == NULL)) {
+            tex[ntex] = collide_loadSprite( files[j] );
+            if (tex[ntex] != NULL)
+               ntex++;
+         }
+         free( files[j] );
+      }
+      free( files );
+      free( dirs[i] );
+   }
+   free( dirs );
+
+   if (ntex == 0) {
+      printf( "No ship sprites found in %s/dat/gfx/ship, skipping.\n", bench_root() );
+      return 0;
+   }
+   collide_genCases( tex, ntex );
+   nsnprintf( name, sizeof(name), "CollideSprite %d ship sheets", ntex );
+   bench_run( name, collide_sprite, NULL, 1., "checks" );
+   nsnprintf( name, sizeof(name), "CollideLineSprite %d ship sheets", ntex );
+   bench_run( name, collide_line, NULL, 1., "checks" );
+
+   for (i=0; i<ntex; i++) {
+      free( tex[i]->trans );
+      free( tex[i]->name );
+      free( tex[i] );
+   }
+   return 0;
+}
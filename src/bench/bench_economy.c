@@ -0,0 +1,131 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file bench_economy.c
+ *
+ * @brief Benchmarks solving the economy on synthetic grids and the real universe.
+ *
+ * Commodities are loaded from dat/commodity.xml, everything economy.c needs
+ * from the rest of the engine is stubbed out below.
+ */
+
+
+#include "naev.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "nstring.h"
+
+#include "bench.h"
+#include "bench_universe.h"
+#include "economy.h"
+#include "faction.h"
+#include "ndata.h"
+#include "nxml.h"
+#include "pilot.h"
+#include "player.h"
+#include "spfx.h"
+
+
+/*
+ * Stubs.
+ */
+int areEnemies( int a, int b ) { (void) a; (void) b; return 0; }
+int areAllies( int a, int b ) { (void) a; (void) b; return 0; }
+glTexture* gl_texRequest( const char* path, int sx, int sy, const unsigned int flags )
+{ (void) path; (void) sx; (void) sy; (void) flags; return NULL; }
+glTexture* gl_newImage( const char* path, const unsigned int flags )
+{ (void) path; (void) flags; return NULL; }
+void gl_freeTexture( glTexture* texture ) { (void) texture; }
+void gl_texFlush (void) { }
+glTexture* gl_texCheck( glTexture *texture ) { return texture; }
+void gl_blitSprite( const glTexture* sprite, const double bx, const double by,
+      const int sx, const int sy, const glColour *c )
+{ (void) sprite; (void) bx; (void) by; (void) sx; (void) sy; (void) c; }
+Pilot* pilot_get( const unsigned int id ) { (void) id; return NULL; }
+int pilot_cargoFree( Pilot* p ) { (void) p; return 0; }
+int pilot_cargoAdd( Pilot* pilot, Commodity* cargo, int quantity, unsigned int id )
+{ (void) pilot; (void) cargo; (void) quantity; (void) id; return 0; }
+void player_message( const char *fmt, ... ) { (void) fmt; }
+int spfx_get( char* name ) { (void) name; return -1; }
+void spfx_add( const int effect, const double px, const double py,
+      const double vx, const double vy, const int layer )
+{ (void) effect; (void) px; (void) py; (void) vx; (void) vy; (void) layer; }
+
+
+/*
+ * Prototypes.
+ */
+static void economy_runUpdate( void *data, unsigned long n );
+static void economy_runRefresh( void *data, unsigned long n );
+static void economy_bench( const char *name );
+
+
+/**
+ * @brief Solves the economy.
+ */
+static void economy_runUpdate( void *data, unsigned long n )
+{
+   unsigned long i;
+   (void) data;
+   for (i=0; i<n; i++)
+      economy_update( 1 );
+   bench_sink( (systems_stack[0].prices != NULL) ? systems_stack[0].prices[0] : 0. );
+}
+
+
+/**
+ * @brief Rebuilds the admittance matrix and solves the economy.
+ */
+static void economy_runRefresh( void *data, unsigned long n )
+{
+   unsigned long i;
+   (void) data;
+   for (i=0; i<n; i++)
+      economy_refresh();
+}
+
+
+/**
+ * @brief Runs the benchmarks on the current universe.
+ */
+static void economy_bench( const char *name )
+{
+   char buf[PATH_MAX];
+
+   economy_init();
+   nsnprintf( buf, sizeof(buf), "economy_update %s (%d systems)", name, systems_nstack );
+   bench_run( buf, economy_runUpdate, NULL, systems_nstack, "systems" );
+   nsnprintf( buf, sizeof(buf), "economy_refresh %s (%d systems)", name, systems_nstack );
+   bench_run( buf, economy_runRefresh, NULL, systems_nstack, "systems" );
+   economy_destroy();
+}
+
+
+int main( int argc, char **argv )
+{
+   int size;
+
+   bench_init( argc, argv, "economy" );
+
+   if (commodity_load()) {
+      printf( "Unable to load %s/%s, skipping.\n", bench_root(), COMMODITY_DATA_PATH );
+      return 0;
+   }
+
+   for (size=8; size<=32; size*=2) {
+      bench_universeGrid( size, size );
+      economy_bench( "grid" );
+   }
+
+   if (bench_universeLoad() > 0)
+      economy_bench( "dat/ssys" );
+   else
+      printf( "No systems found in %s/dat/ssys, skipping.\n", bench_root() );
+
+   bench_universeFree();
+   commodity_free();
+   return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file bench_jumppath.c
+ *
+ * @brief Benchmarks map_getJumpPath on synthetic grids and the real universe.
+ */
+
+
+#include "naev.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "nstring.h"
+
+#include "bench.h"
+#include "bench_universe.h"
+#include "map.h"
+
+
+#define JUMPPATH_PAIRS  512 /**< Number of precomputed start and end systems. */
+
+
+static int jumppath_start[JUMPPATH_PAIRS]; /**< Start systems. */
+static int jumppath_end[JUMPPATH_PAIRS]; /**< End systems. */
+
+
+/*
+ * Prototypes.
+ */
+static void jumppath_genPairs (void);
+static void jumppath_run( void *data, unsigned long n );
+static void jumppath_bench( const char *name );
+
+
+/**
+ * @brief Picks pairs of systems to find paths between.
+ */
+static void jumppath_genPairs (void)
+{
+   unsigned int seed;
+   int i;
+
+   seed = 1;
+   for (i=0; i<JUMPPATH_PAIRS; i++) {
+      seed = seed * 1103515245 + 12345;
+      jumppath_start[i] = (seed >> 8) % systems_nstack;
+      seed = seed * 1103515245 + 12345;
+      jumppath_end[i]   = (seed >> 8) % systems_nstack;
+   }
+}
+
+
+/**
+ * @brief Finds paths between the pairs.
+ */
+static void jumppath_run( void *data, unsigned long n )
+{
+   unsigned long i;
+   int k, njumps, total;
+   StarSystem **path;
+   (void) data;
+
+   total = 0;
+   for (i=0; i<n; i++) {
+      k = i % JUMPPATH_PAIRS;
+      njumps = 0;
+      path = map_getJumpPath( &njumps, systems_stack[ jumppath_start[k] ].name,
+            systems_stack[ jumppath_end[k] ].name, 1, 1, NULL );
+      total += njumps;
+      free( path );
+   }
+   bench_sink( total );
+}
+
+
+/**
+ * @brief Runs the benchmark on the current universe.
+ */
+static void jumppath_bench( const char *name )
+{
+   char buf[PATH_MAX];
+   nsnprintf( buf, sizeof(buf), "map_getJumpPath %s (%d systems)", name, systems_nstack );
+   jumppath_genPairs();
+   bench_run( buf, jumppath_run, NULL, 1., "paths" );
+}
+
+
+int main( int argc, char **argv )
+{
+   int size;
+
+   bench_init( argc, argv, "jumppath" );
+
+   for (size=8; size<=32; size*=2) {
+      bench_universeGrid( size, size );
+      jumppath_bench( "grid" );
+   }
+
+   if (bench_universeLoad() > 0)
+      jumppath_bench( "dat/ssys" );
+   else
+      printf( "No systems found in %s/dat/ssys, skipping.\n", bench_root() );
+
+   bench_universeFree();
+   return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file bench_nebula.c
+ *
+ * @brief Benchmarks generating the nebula noise maps.
+ */
+
+
+#include "naev.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "nstring.h"
+
+#include "SDL.h"
+
+#include "bench.h"
+#include "perlin.h"
+#include "threadpool.h"
+#include "rng.h"
+
+
+#define NEBULA_Z        16 /**< Z plane, same as nebula.c. */
+#define NEBULA_RUGGED   5. /**< Ruggedness, same as nebula.c. */
+
+
+/**
+ * @brief Size of the map to generate.
+ */
+typedef struct NebulaSize_ {
+   int w; /**< Width. */
+   int h; /**< Height. */
+} NebulaSize;
+
+
+/*
+ * Prototypes.
+ */
+static void nebula_run( void *data, unsigned long n );
+
+
+/**
+ * @brief Generates the nebula maps.
+ */
+static void nebula_run( void *data, unsigned long n )
+{
+   unsigned long i;
+   NebulaSize *s = data;
+   float *nebu;
+
+   for (i=0; i<n; i++) {
+      nebu = noise_genNebulaMap( s->w, s->h, NEBULA_Z, NEBULA_RUGGED );
+      bench_sink( nebu[0] );
+      free( nebu );
+   }
+}
+
+
+int main( int argc, char **argv )
+{
+   char name[PATH_MAX];
+   NebulaSize s;
+
+   bench_init( argc, argv, "nebula" );
+
+   if (SDL_Init( 0 )) {
+      printf( "Unable to initialize SDL: %s\n", SDL_GetError() );
+      return 1;
+   }
+   rng_init();
+   threadpool_init();
+
+   for (s.w=128; s.w<=512; s.w*=2) {
+      s.h = s.w;
+      nsnprintf( name, sizeof(name), "noise_genNebulaMap %dx%dx%d", s.w, s.h, NEBULA_Z );
+      bench_run( name, nebula_run, &s, (double)s.w*s.h*NEBULA_Z, "voxels" );
+   }
+
+   SDL_Quit();
+   return 0;
+}
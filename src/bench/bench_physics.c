@@ -0,0 +1,88 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file bench_physics.c
+ *
+ * @brief Benchmarks updating solids with the different integrators.
+ */
+
+
+#include "naev.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "physics.h"
+
+
+#define PHYSICS_SOLIDS  1024 /**< Number of solids updated per iteration. */
+#define PHYSICS_DT      (1./60.) /**< Time step, one frame at 60 FPS. */
+
+
+static Solid physics_solids[PHYSICS_SOLIDS]; /**< Solids being updated. */
+
+
+/*
+ * Prototypes.
+ */
+static void physics_init( int update, double dir_vel, double thrust );
+static void physics_run( void *data, unsigned long n );
+
+
+/**
+ * @brief Sets up the solids.
+ *
+ *    @param update Integrator to use.
+ *    @param dir_vel Turn rate of the solids.
+ *    @param thrust Thrust of the solids.
+ */
+static void physics_init( int update, double dir_vel, double thrust )
+{
+   int i;
+   Vector2d pos, vel;
+
+   for (i=0; i<PHYSICS_SOLIDS; i++) {
+      vect_cset( &pos, 10.*i, -5.*i );
+      vect_pset( &vel, 50. + i%200, 2.*M_PI*i/PHYSICS_SOLIDS );
+      solid_init( &physics_solids[i], 100. + i%50, 2.*M_PI*i/PHYSICS_SOLIDS,
+            &pos, &vel, update );
+      physics_solids[i].dir_vel   = dir_vel * ((i%2) ? 1. : -1.);
+      physics_solids[i].thrust    = thrust;
+      physics_solids[i].speed_max = 300.;
+   }
+}
+
+
+/**
+ * @brief Updates all the solids n times.
+ */
+static void physics_run( void *data, unsigned long n )
+{
+   unsigned long i;
+   int j;
+   (void) data;
+
+   for (i=0; i<n; i++)
+      for (j=0; j<PHYSICS_SOLIDS; j++)
+         physics_solids[j].update( &physics_solids[j], PHYSICS_DT );
+   bench_sink( physics_solids[0].pos.x );
+}
+
+
+int main( int argc, char **argv )
+{
+   bench_init( argc, argv, "physics" );
+
+   /* Turning and thrusting is what uses the full RK4 path. */
+   physics_init( SOLID_UPDATE_RK4, 0., 0. );
+   bench_run( "solid_update_rk4 drifting", physics_run, NULL, PHYSICS_SOLIDS, "updates" );
+   physics_init( SOLID_UPDATE_RK4, 1., 5000. );
+   bench_run( "solid_update_rk4 turning and thrusting", physics_run, NULL, PHYSICS_SOLIDS, "updates" );
+   physics_init( SOLID_UPDATE_EULER, 1., 5000. );
+   bench_run( "solid_update_euler turning and thrusting", physics_run, NULL, PHYSICS_SOLIDS, "updates" );
+
+   return 0;
+}
@@ -0,0 +1,293 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file bench_universe.c
+ *
+ * @brief Minimal star system graph for the benchmarks.
+ *
+ * Stands in for space.c, providing the system stack and the lookups used by
+ * the path finding and economy code. The graph is either a synthetic grid or
+ * the names, nebulae and jumps of the real systems in dat/ssys.
+ */
+
+
+#include "bench_universe.h"
+
+#include "naev.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libxml/parser.h"
+
+#include "bench.h"
+#include "ndata.h"
+
+
+StarSystem *systems_stack  = NULL; /**< Star system stack. */
+int systems_nstack         = 0; /**< Number of star systems. */
+
+
+/*
+ * Prototypes.
+ */
+static StarSystem *universe_add( const char *name );
+static void universe_addJump( StarSystem *sys, int target, unsigned int flags );
+static void universe_parse( StarSystem *sys, xmlNodePtr root, char ***targets,
+      unsigned int **flags, int *ntargets );
+
+
+/**
+ * @brief Gets a system by name, same as space.c.
+ */
+StarSystem* system_get( const char* sysname )
+{
+   int i;
+   for (i=0; i<systems_nstack; i++)
+      if (strcmp( sysname, systems_stack[i].name ) == 0)
+         return &systems_stack[i];
+   return NULL;
+}
+
+
+/**
+ * @brief Checks to see if a system exists, same as space.c.
+ */
+int system_exists( const char* sysname )
+{
+   return (system_get( sysname ) != NULL);
+}
+
+
+/**
+ * @brief All systems are reachable in the benchmarks.
+ */
+int space_sysReachable( StarSystem *sys )
+{
+   (void) sys;
+   return 1;
+}
+
+
+/**
+ * @brief Reads data files straight from the source tree.
+ */
+void* ndata_read( const char* filename, size_t *filesize )
+{
+   return bench_readFile( filename, filesize );
+}
+
+
+/**
+ * @brief Adds a system to the stack.
+ */
+static StarSystem *universe_add( const char *name )
+{
+   StarSystem *sys;
+
+   systems_stack = realloc( systems_stack, sizeof(StarSystem) * (systems_nstack+1) );
+   sys = &systems_stack[ systems_nstack ];
+   memset( sys, 0, sizeof(StarSystem) );
+   sys->id      = systems_nstack;
+   sys->name    = strdup( name );
+   sys->faction = -1;
+   systems_nstack++;
+   return sys;
+}
+
+
+/**
+ * @brief Adds a jump to a system, the target is resolved later.
+ */
+static void universe_addJump( StarSystem *sys, int target, unsigned int flags )
+{
+   JumpPoint *jp;
+
+   sys->jumps = realloc( sys->jumps, sizeof(JumpPoint) * (sys->njumps+1) );
+   jp = &sys->jumps[ sys->njumps++ ];
+   memset( jp, 0, sizeof(JumpPoint) );
+   jp->targetid = target;
+   jp->flags    = flags | JP_KNOWN;
+}
+
+
+/**
+ * @brief Creates a grid of systems, each connected to its four neighbours.
+ *
+ *    @param w Width of the grid.
+ *    @param h Height of the grid.
+ *    @return Number of systems created.
+ */
+int bench_universeGrid( int w, int h )
+{
+   char buf[32];
+   StarSystem *sys;
+   int x, y, i, j;
+
+   bench_universeFree();
+   for (y=0; y<h; y++) {
+      for (x=0; x<w; x++) {
+         snprintf( buf, sizeof(buf), "Grid %d-%d", x, y );
+         sys = universe_add( buf );
+         vect_cset( &sys->pos, 100.*x, 100.*y );
+         if (x > 0)
+            universe_addJump( sys, y*w + x-1, 0 );
+         if (x < w-1)
+            universe_addJump( sys, y*w + x+1, 0 );
+         if (y > 0)
+            universe_addJump( sys, (y-1)*w + x, 0 );
+         if (y < h-1)
+            universe_addJump( sys, (y+1)*w + x, 0 );
+      }
+   }
+
+   /* The stack is stable now so targets can be set. */
+   for (i=0; i<systems_nstack; i++)
+      for (j=0; j<systems_stack[i].njumps; j++)
+         systems_stack[i].jumps[j].target =
+               &systems_stack[ systems_stack[i].jumps[j].targetid ];
+   return systems_nstack;
+}
+
+
+/**
+ * @brief Parses the parts of a system file the benchmarks need.
+ */
+static void universe_parse( StarSystem *sys, xmlNodePtr root, char ***targets,
+      unsigned int **flags, int *ntargets )
+{
+   xmlNodePtr node, cur, jump;
+   xmlChar *prop;
+   unsigned int f;
+
+   for (node=root->children; node!=NULL; node=node->next) {
+      if (node->type != XML_ELEMENT_NODE)
+         continue;
+
+      if (xmlStrcmp( node->name, (const xmlChar*)"general" ) == 0) {
+         for (cur=node->children; cur!=NULL; cur=cur->next) {
+            if (xmlStrcmp( cur->name, (const xmlChar*)"nebula" ) != 0)
+               continue;
+            prop = xmlNodeGetContent( cur );
+            sys->nebu_density = atof( (char*)prop );
+            xmlFree( prop );
+            prop = xmlGetProp( cur, (const xmlChar*)"volatility" );
+            if (prop != NULL) {
+               sys->nebu_volatility = atof( (char*)prop );
+               xmlFree( prop );
+            }
+         }
+      }
+      else if (xmlStrcmp( node->name, (const xmlChar*)"jumps" ) == 0) {
+         for (jump=node->children; jump!=NULL; jump=jump->next) {
+            if (xmlStrcmp( jump->name, (const xmlChar*)"jump" ) != 0)
+               continue;
+            prop = xmlGetProp( jump, (const xmlChar*)"target" );
+            if (prop == NULL)
+               continue;
+            f = 0;
+            for (cur=jump->children; cur!=NULL; cur=cur->next) {
+               if (xmlStrcmp( cur->name, (const xmlChar*)"hidden" ) == 0)
+                  f |= JP_HIDDEN;
+               else if (xmlStrcmp( cur->name, (const xmlChar*)"exitonly" ) == 0)
+                  f |= JP_EXITONLY;
+            }
+            *targets = realloc( *targets, sizeof(char*) * (*ntargets+1) );
+            *flags   = realloc( *flags, sizeof(unsigned int) * (*ntargets+1) );
+            (*targets)[ *ntargets ] = strdup( (char*)prop );
+            (*flags)[ *ntargets ]   = f;
+            (*ntargets)++;
+            xmlFree( prop );
+         }
+      }
+   }
+}
+
+
+/**
+ * @brief Loads the real universe graph from dat/ssys.
+ *
+ *    @return Number of systems loaded.
+ */
+int bench_universeLoad (void)
+{
+   char **files, ***targets;
+   unsigned int **flags;
+   int *ntargets;
+   char *buf;
+   size_t size;
+   xmlDocPtr doc;
+   xmlNodePtr root;
+   xmlChar *name;
+   StarSystem *sys, *target;
+   int i, j, nfiles;
+
+   bench_universeFree();
+   files = bench_listDir( "dat/ssys", ".xml", &nfiles );
+   if (files == NULL)
+      return 0;
+   targets  = calloc( nfiles, sizeof(char**) );
+   flags    = calloc( nfiles, sizeof(unsigned int*) );
+   ntargets = calloc( nfiles, sizeof(int) );
+
+   for (i=0; i<nfiles; i++) {
+      buf = bench_readFile( files[i], &size );
+      free( files[i] );
+      if (buf == NULL)
+         continue;
+      doc = xmlParseMemory( buf, size );
+      free( buf );
+      if (doc == NULL)
+         continue;
+      root = xmlDocGetRootElement( doc );
+      name = (root != NULL) ? xmlGetProp( root, (const xmlChar*)"name" ) : NULL;
+      if (name != NULL) {
+         sys = universe_add( (char*)name );
+         universe_parse( sys, root, &targets[ sys->id ], &flags[ sys->id ],
+               &ntargets[ sys->id ] );
+         xmlFree( name );
+      }
+      xmlFreeDoc( doc );
+   }
+   free( files );
+
+   /* Resolve the jumps now that all the systems exist. */
+   for (i=0; i<systems_nstack; i++) {
+      for (j=0; j<ntargets[i]; j++) {
+         target = system_get( targets[i][j] );
+         if (target != NULL)
+            universe_addJump( &systems_stack[i], target->id, flags[i][j] );
+         free( targets[i][j] );
+      }
+      free( targets[i] );
+      free( flags[i] );
+   }
+   for (i=0; i<systems_nstack; i++)
+      for (j=0; j<systems_stack[i].njumps; j++)
+         systems_stack[i].jumps[j].target =
+               &systems_stack[ systems_stack[i].jumps[j].targetid ];
+   free( targets );
+   free( flags );
+   free( ntargets );
+   return systems_nstack;
+}
+
+
+/**
+ * @brief Frees the universe.
+ */
+void bench_universeFree (void)
+{
+   int i;
+   for (i=0; i<systems_nstack; i++) {
+      free( systems_stack[i].name );
+      free( systems_stack[i].jumps );
+      free( systems_stack[i].prices );
+   }
+   free( systems_stack );
+   systems_stack  = NULL;
+   systems_nstack = 0;
+}
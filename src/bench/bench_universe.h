@@ -0,0 +1,23 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef BENCH_UNIVERSE_H
+#  define BENCH_UNIVERSE_H
+
+
+#include "space.h"
+
+
+extern StarSystem *systems_stack;
+extern int systems_nstack;
+
+
+/* Universe creation. */
+int bench_universeGrid( int w, int h );
+int bench_universeLoad (void);
+void bench_universeFree (void);
+
+
+#endif /* BENCH_UNIVERSE_H */
@@ -0,0 +1,149 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file bench_vec2.c
+ *
+ * @brief Benchmarks the vector computations done by the AI every tick.
+ *
+ * The AI code is modelled on follow_accurate() and mine() from
+ * dat/ai/include/basic.lua, once written with the allocating operators and
+ * once with the in-place methods and scratch vectors.
+ */
+
+
+#include "naev.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+
+#include "bench.h"
+#include "nlua_vec2.h"
+
+
+#define VEC2_PILOTS     64 /**< Number of pilots thinking per tick. */
+
+
+static lua_State *vec2_L = NULL; /**< Lua state running the AI code. */
+
+
+/**
+ * @brief AI code run by the benchmark.
+ *
+ * Pilots are tables here, pos() and vel() copy or reuse vectors like the
+ * pilot methods do.
+ */
+static const char vec2_code[] =
+"local pilots = {}\n"
+"for i=1,npilots do\n"
+"   local pos, vel = vec2.new( 10*i, -5*i ), vec2.new( i, 2*i )\n"
+"   pilots[i] = {\n"
+"      pos = function (self, out)\n"
+"         if out then out:set( pos:get() ) return out end\n"
+"         return vec2.new( pos:get() )\n"
+"      end,\n"
+"      vel = function (self, out)\n"
+"         if out then out:set( vel:get() ) return out end\n"
+"         return vec2.new( vel:get() )\n"
+"      end,\n"
+"   }\n"
+"end\n"
+"local goal, target = vec2.new( 300, 200 ), vec2.new( -50, 75 )\n"
+"function think_alloc ()\n"
+"   local s = 0\n"
+"   for i=1,#pilots do\n"
+"      local p = pilots[i]\n"
+"      local mod = vec2.mod(goal - p:pos())\n"
+"      local target2 = target + vec2.new( 200, 0 )\n"
+"      local relpos = (p:pos() - target2):mod()\n"
+"      local relvel = (p:vel() - goal*0.01):mod()\n"
+"      s = s + mod + relpos + relvel\n"
+"   end\n"
+"   return s\n"
+"end\n"
+"function think_pool ()\n"
+"   local s = 0\n"
+"   for i=1,#pilots do\n"
+"      local p = pilots[i]\n"
+"      local pos = p:pos( vec2.tmp() )\n"
+"      local mod = goal:dist( pos )\n"
+"      local target2 = vec2.tmp( target:get() ):add( 200, 0 )\n"
+"      local relpos = pos:dist( target2 )\n"
+"      local relvel = vec2.tmp( goal:get() ):mul( 0.01 ):dist( p:vel( vec2.tmp() ) )\n"
+"      s = s + mod + relpos + relvel\n"
+"   end\n"
+"   return s\n"
+"end\n";
+
+
+/*
+ * Prototypes.
+ */
+static void vec2_run( void *data, unsigned long n );
+
+
+/**
+ * @brief Stands in for nlua.c, registers the library as a global.
+ */
+void nlua_register( nlua_env env, const char *libname,
+      const luaL_Reg *l, int metatable )
+{
+   (void) env;
+   if (luaL_newmetatable( vec2_L, libname )) {
+      if (metatable) {
+         lua_pushvalue( vec2_L, -1 );
+         lua_setfield( vec2_L, -2, "__index" );
+      }
+      luaL_register( vec2_L, NULL, l );
+   }
+   lua_setglobal( vec2_L, libname );
+}
+
+
+/**
+ * @brief Runs n ticks of the AI function in data.
+ */
+static void vec2_run( void *data, unsigned long n )
+{
+   unsigned long i;
+   double s;
+
+   s = 0.;
+   for (i=0; i<n; i++) {
+      nlua_vectorScratchReset();
+      lua_getglobal( vec2_L, (const char*) data );
+      lua_call( vec2_L, 0, 1 );
+      s += lua_tonumber( vec2_L, -1 );
+      lua_pop( vec2_L, 1 );
+   }
+   bench_sink( s );
+}
+
+
+int main( int argc, char **argv )
+{
+   bench_init( argc, argv, "vec2" );
+
+   vec2_L = luaL_newstate();
+   luaL_openlibs( vec2_L );
+   nlua_loadVector( 0 );
+   lua_pushnumber( vec2_L, VEC2_PILOTS );
+   lua_setglobal( vec2_L, "npilots" );
+   if (luaL_dostring( vec2_L, vec2_code ) != 0) {
+      fprintf( stderr, "%s\n", lua_tostring( vec2_L, -1 ) );
+      return EXIT_FAILURE;
+   }
+
+   bench_run( "ai tick with allocating operators", vec2_run, "think_alloc",
+         VEC2_PILOTS, "pilots" );
+   bench_run( "ai tick with in-place methods", vec2_run, "think_pool",
+         VEC2_PILOTS, "pilots" );
+
+   lua_close( vec2_L );
+   return 0;
+}
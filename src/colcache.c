@@ -0,0 +1,484 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file colcache.c
+ *
+ * @brief Cache of the transparency maps used for collisions.
+ *
+ * All the maps live in a single pack in the cache path, keyed by a fast hash
+ * and the size of the image file they were generated from. The pack gets
+ * mapped into memory when starting and is only read from afterwards, maps
+ * generated during the session are kept in memory until colcache_save()
+ * rewrites the pack with them.
+ *
+ * The file is laid out as:
+ *
+ *  - ColCacheHeader.
+ *  - nentries ColCacheEntry sorted by key and size.
+ *  - Map data.
+ *
+ * Lookups and additions are safe from any thread.
+ */
+
+
+#include "colcache.h"
+
+#include "naev.h"
+
+#include <stdlib.h>
+#include "nstring.h"
+
+#if HAS_POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif /* HAS_POSIX */
+
+#include "SDL.h"
+
+#include "log.h"
+#include "nfile.h"
+#include "array.h"
+
+
+#define ROTL64(x,r)  (((x) << (r)) | ((x) >> (64 - (r)))) /**< Rotates left. */
+
+
+static const char colcache_magic[4] = { 'N', 'C', 'O', 'L' }; /**< Identifies the file. */
+
+
+/**
+ * @brief Header of the pack.
+ */
+typedef struct ColCacheHeader_ {
+   char magic[4]; /**< Must match colcache_magic. */
+   uint32_t version; /**< Must match COLCACHE_VERSION. */
+   uint32_t nentries; /**< Number of maps. */
+   uint32_t pad; /**< Keeps the index aligned. */
+} ColCacheHeader;
+
+
+/**
+ * @brief Index entry of a map in the pack.
+ */
+typedef struct ColCacheEntry_ {
+   uint64_t key; /**< Hash of the image file. */
+   uint64_t offset; /**< Offset of the map from the start of the pack. */
+   uint32_t size; /**< Size of the image file. */
+   uint32_t len; /**< Length of the map. */
+} ColCacheEntry;
+
+
+/**
+ * @brief Map generated during this session.
+ */
+typedef struct ColCacheNew_ {
+   uint64_t key; /**< Hash of the image file. */
+   uint32_t size; /**< Size of the image file. */
+   uint32_t len; /**< Length of the map. */
+   uint8_t *data; /**< The map. */
+} ColCacheNew;
+
+
+/**
+ * @brief Map being written, either from the pack or new.
+ */
+typedef struct ColCacheWrite_ {
+   uint64_t key; /**< Hash of the image file. */
+   uint32_t size; /**< Size of the image file. */
+   uint32_t len; /**< Length of the map. */
+   const uint8_t *data; /**< The map. */
+   int isnew; /**< Generated during this session, wins over the pack. */
+} ColCacheWrite;
+
+
+static char *colcache_data = NULL; /**< Contents of the pack. */
+static size_t colcache_datalen = 0; /**< Length of the pack. */
+static int colcache_mapped = 0; /**< The pack is mapped instead of read. */
+static const ColCacheEntry *colcache_index = NULL; /**< Index of the pack. */
+static uint32_t colcache_nindex = 0; /**< Number of maps in the pack. */
+static ColCacheNew *colcache_new = NULL; /**< Maps generated this session (array.h). */
+static int colcache_dirty = 0; /**< There are maps not written yet. */
+static SDL_mutex *colcache_lock = NULL; /**< Protects the new maps. */
+
+
+/*
+ * Prototypes.
+ */
+static char* colcache_path( char *buf, size_t len, const char *suffix );
+static int colcache_open( const char *path );
+static void colcache_close (void);
+static int colcache_cmpEntry( const void *p1, const void *p2 );
+static int colcache_cmpWrite( const void *p1, const void *p2 );
+
+
+/**
+ * @brief Gets the path of the pack.
+ */
+static char* colcache_path( char *buf, size_t len, const char *suffix )
+{
+   nsnprintf( buf, len, "%s%s%s", nfile_cachePath(), COLCACHE_FILE, suffix );
+   return buf;
+}
+
+
+/**
+ * @brief Opens the pack and checks the index.
+ *
+ *    @param path Path of the pack.
+ *    @return 0 on success.
+ */
+static int colcache_open( const char *path )
+{
+   const ColCacheHeader *header;
+   const ColCacheEntry *e;
+   uint32_t i;
+#if HAS_POSIX
+   struct stat st;
+   void *map;
+   int fd;
+
+   fd = open( path, O_RDONLY );
+   if (fd < 0)
+      return -1;
+   if ((fstat( fd, &st ) != 0) || (st.st_size < (off_t)sizeof(ColCacheHeader))) {
+      close( fd );
+      return -1;
+   }
+   map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+   close( fd );
+   if (map == MAP_FAILED)
+      return -1;
+   colcache_data    = map;
+   colcache_datalen = st.st_size;
+   colcache_mapped  = 1;
+#else /* HAS_POSIX */
+   if (!nfile_fileExists( path ))
+      return -1;
+   colcache_data = nfile_readFile( &colcache_datalen, path );
+   if (colcache_data == NULL)
+      return -1;
+#endif /* HAS_POSIX */
+
+   /* Check the header. */
+   header = (const ColCacheHeader*) colcache_data;
+   if ((colcache_datalen < sizeof(ColCacheHeader)) ||
+         (memcmp( header->magic, colcache_magic, sizeof(colcache_magic) ) != 0) ||
+         (header->version != COLCACHE_VERSION) ||
+         (header->nentries > (colcache_datalen - sizeof(ColCacheHeader)) / sizeof(ColCacheEntry))) {
+      colcache_close();
+      return -1;
+   }
+
+   /* Check the index. */
+   colcache_index  = (const ColCacheEntry*) &colcache_data[ sizeof(ColCacheHeader) ];
+   colcache_nindex = header->nentries;
+   for (i=0; i<colcache_nindex; i++) {
+      e = &colcache_index[i];
+      if ((e->offset > colcache_datalen) || (e->len > colcache_datalen - e->offset) ||
+            ((i > 0) && (colcache_cmpEntry( &colcache_index[i-1], e ) >= 0))) {
+         WARN(_("Collision cache '%s' is corrupt, ignoring it."), path);
+         colcache_close();
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+
+/**
+ * @brief Closes the pack.
+ */
+static void colcache_close (void)
+{
+#if HAS_POSIX
+   if (colcache_mapped)
+      munmap( colcache_data, colcache_datalen );
+   else
+#endif /* HAS_POSIX */
+      free( colcache_data );
+   colcache_data    = NULL;
+   colcache_datalen = 0;
+   colcache_mapped  = 0;
+   colcache_index   = NULL;
+   colcache_nindex  = 0;
+}
+
+
+/**
+ * @brief Compares index entries by key and size.
+ */
+static int colcache_cmpEntry( const void *p1, const void *p2 )
+{
+   const ColCacheEntry *e1, *e2;
+   e1 = (const ColCacheEntry*) p1;
+   e2 = (const ColCacheEntry*) p2;
+   if (e1->key != e2->key)
+      return (e1->key < e2->key) ? -1 : 1;
+   if (e1->size != e2->size)
+      return (e1->size < e2->size) ? -1 : 1;
+   return 0;
+}
+
+
+/**
+ * @brief Compares maps to write by key and size, new ones first.
+ */
+static int colcache_cmpWrite( const void *p1, const void *p2 )
+{
+   const ColCacheWrite *w1, *w2;
+   w1 = (const ColCacheWrite*) p1;
+   w2 = (const ColCacheWrite*) p2;
+   if (w1->key != w2->key)
+      return (w1->key < w2->key) ? -1 : 1;
+   if (w1->size != w2->size)
+      return (w1->size < w2->size) ? -1 : 1;
+   return w2->isnew - w1->isnew;
+}
+
+
+/**
+ * @brief Opens the collision cache.
+ */
+void colcache_init (void)
+{
+   char path[PATH_MAX];
+
+   colcache_lock = SDL_CreateMutex();
+   colcache_new  = array_create( ColCacheNew );
+   colcache_open( colcache_path( path, sizeof(path), "" ) );
+}
+
+
+/**
+ * @brief Writes the new maps and closes the collision cache.
+ */
+void colcache_exit (void)
+{
+   int i;
+
+   colcache_save();
+   colcache_close();
+
+   for (i=0; i<array_size(colcache_new); i++)
+      free( colcache_new[i].data );
+   array_free( colcache_new );
+   colcache_new = NULL;
+   SDL_DestroyMutex( colcache_lock );
+   colcache_lock = NULL;
+}
+
+
+/**
+ * @brief Hashes an image file, much faster than a cryptographic hash.
+ *
+ *    @param data Data to hash.
+ *    @param len Length of the data.
+ *    @return The hash.
+ */
+uint64_t colcache_hash( const void *data, size_t len )
+{
+   const uint8_t *p;
+   uint64_t h, k;
+   size_t i;
+
+   p = data;
+   h = 0x9E3779B97F4A7C15ULL ^ ((uint64_t)len * 0xC2B2AE3D27D4EB4FULL);
+
+   /* Eight bytes at a time. */
+   for (i=0; i+8<=len; i+=8) {
+      memcpy( &k, &p[i], 8 );
+      k *= 0x87C37B91114253D5ULL;
+      k  = ROTL64( k, 31 );
+      k *= 0x4CF5AD432745937FULL;
+      h ^= k;
+      h  = ROTL64( h, 27 ) * 5 + 0x52DCE729;
+   }
+
+   /* Remainder. */
+   if (i < len) {
+      k = 0;
+      memcpy( &k, &p[i], len-i );
+      k *= 0x87C37B91114253D5ULL;
+      h ^= ROTL64( k, 31 );
+   }
+
+   /* Final mix. */
+   h ^= h >> 33;
+   h *= 0xFF51AFD7ED558CCDULL;
+   h ^= h >> 33;
+   h *= 0xC4CEB9FE1A85EC53ULL;
+   h ^= h >> 33;
+   return h;
+}
+
+
+/**
+ * @brief Gets a transparency map from the cache.
+ *
+ *    @param key Hash of the image file.
+ *    @param size Size of the image file.
+ *    @param len Length the map must have.
+ *    @return A copy of the map to free, or NULL if it isn't cached.
+ */
+uint8_t* colcache_get( uint64_t key, uint32_t size, size_t len )
+{
+   ColCacheEntry k;
+   const ColCacheEntry *e;
+   const uint8_t *src;
+   uint8_t *trans;
+   int i;
+
+   src = NULL;
+
+   /* Look in the pack. */
+   k.key  = key;
+   k.size = size;
+   e = NULL;
+   if (colcache_nindex > 0)
+      e = bsearch( &k, colcache_index, colcache_nindex, sizeof(ColCacheEntry), colcache_cmpEntry );
+   if ((e != NULL) && (e->len == len))
+      src = (const uint8_t*) &colcache_data[ e->offset ];
+
+   /* Look in the maps generated this session. */
+   SDL_mutexP( colcache_lock );
+   if (src == NULL) {
+      for (i=0; i<array_size(colcache_new); i++) {
+         if ((colcache_new[i].key == key) && (colcache_new[i].size == size) &&
+               (colcache_new[i].len == len)) {
+            src = colcache_new[i].data;
+            break;
+         }
+      }
+   }
+   trans = NULL;
+   if (src != NULL) {
+      trans = malloc( len );
+      memcpy( trans, src, len );
+   }
+   SDL_mutexV( colcache_lock );
+
+   return trans;
+}
+
+
+/**
+ * @brief Adds a transparency map to the cache.
+ *
+ *    @param key Hash of the image file.
+ *    @param size Size of the image file.
+ *    @param data Map to add, it gets copied.
+ *    @param len Length of the map.
+ */
+void colcache_put( uint64_t key, uint32_t size, const uint8_t *data, size_t len )
+{
+   ColCacheNew *n;
+
+   if (data == NULL)
+      return;
+
+   SDL_mutexP( colcache_lock );
+   n = &array_grow( &colcache_new );
+   n->key  = key;
+   n->size = size;
+   n->len  = len;
+   n->data = malloc( len );
+   memcpy( n->data, data, len );
+   colcache_dirty = 1;
+   SDL_mutexV( colcache_lock );
+}
+
+
+/**
+ * @brief Rewrites the pack if maps were generated since it was last written.
+ *
+ *    @return 0 on success.
+ */
+int colcache_save (void)
+{
+   char path[PATH_MAX], tmp[PATH_MAX];
+   ColCacheHeader header;
+   ColCacheEntry *index;
+   ColCacheWrite *w;
+   char *buf;
+   size_t len, offset;
+   int i, n, nw, ret;
+
+   if (colcache_lock == NULL)
+      return 0;
+
+   SDL_mutexP( colcache_lock );
+   if (!colcache_dirty) {
+      SDL_mutexV( colcache_lock );
+      return 0;
+   }
+
+   /* Gather the maps, new ones replace the ones in the pack. */
+   n = colcache_nindex + array_size(colcache_new);
+   w = malloc( n * sizeof(ColCacheWrite) );
+   for (i=0; i<(int)colcache_nindex; i++) {
+      w[i].key   = colcache_index[i].key;
+      w[i].size  = colcache_index[i].size;
+      w[i].len   = colcache_index[i].len;
+      w[i].data  = (const uint8_t*) &colcache_data[ colcache_index[i].offset ];
+      w[i].isnew = 0;
+   }
+   for (i=0; i<array_size(colcache_new); i++) {
+      w[colcache_nindex+i].key   = colcache_new[i].key;
+      w[colcache_nindex+i].size  = colcache_new[i].size;
+      w[colcache_nindex+i].len   = colcache_new[i].len;
+      w[colcache_nindex+i].data  = colcache_new[i].data;
+      w[colcache_nindex+i].isnew = 1;
+   }
+   qsort( w, n, sizeof(ColCacheWrite), colcache_cmpWrite );
+   nw = 0;
+   for (i=0; i<n; i++)
+      if ((nw == 0) || (w[nw-1].key != w[i].key) || (w[nw-1].size != w[i].size))
+         w[nw++] = w[i];
+
+   /* Lay out the pack. */
+   len = sizeof(ColCacheHeader) + nw * sizeof(ColCacheEntry);
+   for (i=0; i<nw; i++)
+      len += w[i].len;
+   buf = malloc( len );
+   memset( &header, 0, sizeof(header) );
+   memcpy( header.magic, colcache_magic, sizeof(colcache_magic) );
+   header.version  = COLCACHE_VERSION;
+   header.nentries = nw;
+   memcpy( buf, &header, sizeof(header) );
+   index  = (ColCacheEntry*) &buf[ sizeof(ColCacheHeader) ];
+   offset = sizeof(ColCacheHeader) + nw * sizeof(ColCacheEntry);
+   for (i=0; i<nw; i++) {
+      memset( &index[i], 0, sizeof(ColCacheEntry) );
+      index[i].key    = w[i].key;
+      index[i].offset = offset;
+      index[i].size   = w[i].size;
+      index[i].len    = w[i].len;
+      memcpy( &buf[offset], w[i].data, w[i].len );
+      offset += w[i].len;
+   }
+   free( w );
+   colcache_dirty = 0;
+   SDL_mutexV( colcache_lock );
+
+   /* Write it next to the old one and swap them. */
+   colcache_path( path, sizeof(path), "" );
+   colcache_path( tmp, sizeof(tmp), ".tmp" );
+   nfile_dirMakeExist( "%s", nfile_cachePath() );
+   ret = nfile_writeFile( buf, len, tmp );
+   free( buf );
+   if (ret != 0) {
+      WARN(_("Unable to write collision cache '%s'."), tmp);
+      return -1;
+   }
+   if (nfile_fileExists( path ))
+      nfile_delete( path );
+   nfile_rename( tmp, path );
+
+   DEBUG( ngettext( "Wrote %d collision map to the cache", "Wrote %d collision maps to the cache", nw ), nw );
+   return 0;
+}
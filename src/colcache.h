@@ -0,0 +1,29 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef COLCACHE_H
+#  define COLCACHE_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define COLCACHE_FILE      "collisions.pack" /**< Name of the pack in the cache path. */
+#define COLCACHE_VERSION   1 /**< Bump whenever the format changes. */
+
+
+/* Init/exit. */
+void colcache_init (void);
+void colcache_exit (void);
+
+/* Maps. */
+uint64_t colcache_hash( const void *data, size_t len );
+uint8_t* colcache_get( uint64_t key, uint32_t size, size_t len );
+void colcache_put( uint64_t key, uint32_t size, const uint8_t *data, size_t len );
+int colcache_save (void);
+
+
+#endif /* COLCACHE_H */
@@ -13,12 +13,17 @@
 
 #include "naev.h"
 
+#include "SDL.h"
+
 #include "log.h"
 #include "nlua.h"
 #include "nluadef.h"
+#include "nstring.h"
 
 
 static nlua_env cond_env = LUA_NOREF; /** Conditional Lua env. */
+static int cond_cache = LUA_NOREF; /**< Compiled conditions indexed by their source, false if they don't compile. */
+static CondStats cond_stats; /**< Statistics of the checks. */
 
 
 /**
@@ -30,11 +35,16 @@ int cond_init (void)
       return 0;
 
    cond_env = nlua_newEnv(0);
+   nlua_setEnvName( cond_env, "cond" );
    if (nlua_loadStandard(cond_env)) {
       WARN(_("Failed to load standard Lua libraries."));
       return -1;
    }
 
+   lua_newtable(naevL);
+   cond_cache = luaL_ref(naevL, LUA_REGISTRYINDEX);
+   memset( &cond_stats, 0, sizeof(CondStats) );
+
    return 0;
 }
 
@@ -47,11 +57,65 @@ void cond_exit (void)
    if (cond_env == LUA_NOREF)
       return;
 
+   luaL_unref(naevL, LUA_REGISTRYINDEX, cond_cache);
+   cond_cache = LUA_NOREF;
    nlua_freeEnv(cond_env);
    cond_env = LUA_NOREF;
 }
 
 
+/**
+ * @brief Pushes the compiled function of a condition.
+ *
+ * Conditions are compiled the first time they are seen and kept in the
+ *  cache, as are the ones that fail to compile so they only warn once.
+ *
+ *    @param cond Condition to get.
+ *    @return 0 with the function on the stack, -1 if it doesn't compile.
+ */
+static int cond_get( const char *cond )
+{
+   lua_rawgeti(naevL, LUA_REGISTRYINDEX, cond_cache);
+   lua_getfield(naevL, -1, cond);
+   if (lua_isfunction(naevL, -1)) {
+      cond_stats.hits++;
+      lua_remove(naevL, -2);
+      return 0;
+   }
+   if (!lua_isnil(naevL, -1)) {
+      cond_stats.hits++;
+      lua_pop(naevL, 2);
+      return -1;
+   }
+   lua_pop(naevL, 1);
+   cond_stats.misses++;
+
+   /* Compile it. */
+   lua_pushstring(naevL, "return ");
+   lua_pushstring(naevL, cond);
+   lua_concat(naevL, 2);
+   if (luaL_loadbuffer(naevL, lua_tostring(naevL,-1),
+            lua_strlen(naevL,-1), "Lua Conditional") != 0) {
+      WARN(_("Lua conditional syntax error: %s"), lua_tostring(naevL, -1));
+      lua_pop(naevL, 2);
+      lua_pushboolean(naevL, 0);
+      lua_setfield(naevL, -2, cond);
+      lua_pop(naevL, 1);
+      return -1;
+   }
+   lua_remove(naevL, -2);
+   nlua_pushenv(cond_env);
+   lua_setfenv(naevL, -2);
+
+   /* Cache it. */
+   lua_pushvalue(naevL, -1);
+   lua_setfield(naevL, -3, cond);
+   lua_remove(naevL, -2);
+   cond_stats.compiled++;
+   return 0;
+}
+
+
 /**
  * @brief Checks to see if a condition is true.
  *
@@ -62,17 +126,16 @@ int cond_check( const char* cond )
 {
    int b;
    int ret;
+   Uint64 t;
 
-   /* Load the string. */
-   lua_pushstring(naevL, "return ");
-   lua_pushstring(naevL, cond);
-   lua_concat(naevL, 2);
-   ret = nlua_dobufenv(cond_env, lua_tostring(naevL,-1),
-                       lua_strlen(naevL,-1), "Lua Conditional");
+   t = SDL_GetPerformanceCounter();
+
+   /* Get the compiled condition. */
+   if (cond_get( cond ) != 0)
+      goto cond_err;
+
+   ret = nlua_pcall(cond_env, 0, 1);
    switch (ret) {
-      case  LUA_ERRSYNTAX:
-         WARN(_("Lua conditional syntax error: %s"), lua_tostring(naevL, -1));
-         goto cond_err;
       case LUA_ERRRUN:
          WARN(_("Lua Conditional had a runtime error: %s"), lua_tostring(naevL, -1));
          goto cond_err;
@@ -98,6 +161,8 @@ int cond_check( const char* cond )
       /* Clear the stack. */
       lua_settop(naevL, 0);
 
+      cond_stats.time += (double)(SDL_GetPerformanceCounter() - t) /
+            (double)SDL_GetPerformanceFrequency();
       return ret;
    }
    WARN(_("Lua Conditional didn't return a boolean"));
@@ -105,5 +170,39 @@ int cond_check( const char* cond )
 cond_err:
    /* Clear the stack. */
    lua_settop(naevL, 0);
+   cond_stats.errors++;
+   cond_stats.time += (double)(SDL_GetPerformanceCounter() - t) /
+         (double)SDL_GetPerformanceFrequency();
    return -1;
 }
+
+
+/**
+ * @brief Gets the statistics of the condition checks.
+ *
+ *    @param[out] stats Where to store them.
+ */
+void cond_getStats( CondStats *stats )
+{
+   *stats = cond_stats;
+}
+
+
+/**
+ * @brief Prints the statistics of the condition checks.
+ *
+ *    @param print Function to print each line with.
+ */
+void cond_printStats( void (*print)( const char *msg ) )
+{
+   char buf[256];
+   unsigned long n;
+
+   n = cond_stats.hits + cond_stats.misses;
+   nsnprintf( buf, sizeof(buf), _("Conditions: %d compiled, %lu checks (%lu hits, %lu misses, %lu errors)"),
+         cond_stats.compiled, n, cond_stats.hits, cond_stats.misses, cond_stats.errors );
+   print( buf );
+   nsnprintf( buf, sizeof(buf), _("Condition time: %.3f ms total, %.3f ms average"),
+         cond_stats.time * 1000., (n > 0) ? cond_stats.time * 1000. / (double)n : 0. );
+   print( buf );
+}
@@ -7,9 +7,23 @@
 #  define COND_H
 
 
+/**
+ * @brief Statistics of the condition checks.
+ */
+typedef struct CondStats_ {
+   int compiled; /**< Distinct conditions compiled. */
+   unsigned long hits; /**< Checks that found the condition compiled. */
+   unsigned long misses; /**< Checks that had to compile it. */
+   unsigned long errors; /**< Checks that failed. */
+   double time; /**< Seconds spent checking. */
+} CondStats;
+
+
 int cond_init (void);
 void cond_exit (void);
 int cond_check( const char *cond );
+void cond_getStats( CondStats *stats );
+void cond_printStats( void (*print)( const char *msg ) );
 
 
 #endif /* COND_H */
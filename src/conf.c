@@ -101,6 +101,9 @@ static void print_usage( char **argv )
    LOG(_("   -N, --nondata         do not use ndata and try to use laid out files"));
    LOG(_("   -d, --datapath        specifies a custom path for all user data (saves, screenshots, etc.)"));
    LOG(_("   -X, --scale           defines the scale factor"));
+   LOG(_("   --memreport file      writes a memory usage report to file when exiting"));
+   LOG(_("   --luaprofile file     profiles Lua and writes the report to file when exiting"));
+   LOG(_("   --stats target        exports statistics every second to a file or unix:socket"));
 #ifdef DEBUGGING
    LOG(_("   --devmode             enables dev mode perks like the editors"));
    LOG(_("   --devcsv              generates csv output from the ndata for development purposes"));
@@ -268,12 +271,14 @@ void conf_setVideoDefaults (void)
    /* FPS. */
    conf.fps_show     = SHOW_FPS_DEFAULT;
    conf.fps_max      = FPS_MAX_DEFAULT;
+   conf.lua_gcpause  = LUA_GCPAUSE_DEFAULT;
 
    /* Pause. */
    conf.pause_show   = SHOW_PAUSE_DEFAULT;
 
    /* Memory. */
    conf.engineglow   = ENGINE_GLOWS_DEFAULT;
+   conf.texture_budget = TEXTURE_BUDGET_DEFAULT;
 }
 
 
@@ -296,6 +301,13 @@ void conf_cleanup (void)
    if (conf.dev_save_asset != NULL)
       free(conf.dev_save_asset);
 
+   if (conf.mem_report != NULL)
+      free(conf.mem_report);
+   if (conf.lua_profile != NULL)
+      free(conf.lua_profile);
+   if (conf.stats != NULL)
+      free(conf.stats);
+
    /* Clear memory. */
    memset( &conf, 0, sizeof(conf) );
 }
@@ -352,6 +364,7 @@ int conf_loadConfig ( const char* file )
 
       /* Memory. */
       conf_loadBool("engineglow",conf.engineglow);
+      conf_loadInt("texture_budget",conf.texture_budget);
 
       /* Window. */
       w = h = 0;
@@ -373,6 +386,7 @@ int conf_loadConfig ( const char* file )
       /* FPS */
       conf_loadBool("showfps",conf.fps_show);
       conf_loadInt("maxfps",conf.fps_max);
+      conf_loadFloat("luagcpause",conf.lua_gcpause);
 
       /*  Pause */
       conf_loadBool("showpause",conf.pause_show);
@@ -612,6 +626,9 @@ void conf_parseCLI( int argc, char** argv )
       { "generate", no_argument, 0, 'G' },
       { "nondata", no_argument, 0, 'N' },
       { "scale", required_argument, 0, 'X' },
+      { "memreport", required_argument, 0, 'R' },
+      { "luaprofile", required_argument, 0, 'P' },
+      { "stats", required_argument, 0, 'T' },
 #ifdef DEBUGGING
       { "devmode", no_argument, 0, 'D' },
       { "devcsv", no_argument, 0, 'C' },
@@ -680,6 +697,21 @@ void conf_parseCLI( int argc, char** argv )
          case 'X':
             conf.scalefactor = atof(optarg);
             break;
+         case 'R':
+            if (conf.mem_report != NULL)
+               free(conf.mem_report);
+            conf.mem_report = strdup(optarg);
+            break;
+         case 'P':
+            if (conf.lua_profile != NULL)
+               free(conf.lua_profile);
+            conf.lua_profile = strdup(optarg);
+            break;
+         case 'T':
+            if (conf.stats != NULL)
+               free(conf.stats);
+            conf.stats = strdup(optarg);
+            break;
 #ifdef DEBUGGING
          case 'D':
             conf.devmode = 1;
@@ -919,6 +951,10 @@ int conf_saveConfig ( const char* file )
    conf_saveBool("engineglow",conf.engineglow);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("Megabytes of texture memory to keep unused textures loaded in, 0 unloads them right away"));
+   conf_saveInt("texture_budget",conf.texture_budget);
+   conf_saveEmptyLine();
+
    /* Window. */
    conf_saveComment(_("The window size or screen resolution"));
    conf_saveComment(_("Set both of these to 0 to make Naev try the desktop resolution"));
@@ -957,6 +993,10 @@ int conf_saveConfig ( const char* file )
    conf_saveInt("maxfps",conf.fps_max);
    conf_saveEmptyLine();
 
+   conf_saveComment(_("Maximum time in milliseconds to spend collecting Lua garbage each frame"));
+   conf_saveFloat("luagcpause",conf.lua_gcpause);
+   conf_saveEmptyLine();
+
    /* Pause */
    conf_saveComment(_("Show 'PAUSED' on screen while paused"));
    conf_saveBool("showpause",conf.pause_show);
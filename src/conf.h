@@ -37,7 +37,9 @@
 #define FPS_MAX_DEFAULT                      60    /**< Maximum FPS. */
 #define SHOW_PAUSE_DEFAULT                   1     /**< Whether to display pause status. */
 #define ENGINE_GLOWS_DEFAULT                 1     /**< Whether to display engine glows. */
+#define TEXTURE_BUDGET_DEFAULT               256   /**< Texture memory in megabytes to keep unused textures cached within. */
 #define MINIMIZE_DEFAULT                     1     /**< Whether to minimize on focus loss. */
+#define LUA_GCPAUSE_DEFAULT                  1.    /**< Maximum time in milliseconds to spend collecting Lua garbage per frame. */
 /* Audio options */
 #define VOICES_DEFAULT                       128   /**< Amount of voices to use. */
 #define PILOT_RELATIVE_DEFAULT               1     /**< Whether the sound is relative to the pilot (as opposed to the camera). */
@@ -78,6 +80,7 @@ typedef struct PlayerConf_s {
 
    /* Memory usage. */
    int engineglow; /**< Sets engine glow. */
+   int texture_budget; /**< Texture memory in megabytes unused textures are cached within. */
 
    /* Window dimensions. */
    int width; /**< Width of the window to use. */
@@ -101,6 +104,7 @@ typedef struct PlayerConf_s {
    /* FPS. */
    int fps_show; /**< Whether or not FPS should be shown */
    int fps_max; /**< Maximum FPS to limit to. */
+   double lua_gcpause; /**< Maximum Lua garbage collection time per frame in milliseconds. */
 
    /* Pause. */
    int pause_show; /**< Whether pause status should be shown. */
@@ -147,6 +151,9 @@ typedef struct PlayerConf_s {
 
    /* Debugging. */
    int fpu_except; /**< Enable FPU exceptions? */
+   char *mem_report; /**< File to write a memory report to when exiting. */
+   char *lua_profile; /**< File to write a Lua profile to when exiting. */
+   char *stats; /**< File or socket to export statistics to. */
 
    /* Editor. */
    char *dev_save_sys; /**< Path to save systems to. */
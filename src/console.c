@@ -415,6 +415,7 @@ int cli_init (void)
 
    /* Create the state. */
    cli_env = nlua_newEnv(1);
+   nlua_setEnvName( cli_env, "console" );
    nlua_loadStandard( cli_env );
    nlua_loadTex( cli_env );
    nlua_loadCol( cli_env );
@@ -16,6 +16,7 @@
 #include <stdlib.h> /* qsort */
 
 #include "conf.h"
+#include "ndata.h"
 #include "nxml.h"
 #include "space.h"
 #include "physics.h"
@@ -326,6 +327,9 @@ int dsys_saveMap (StarSystem **uniedit_sys, int uniedit_nsys, char *fileName, ch
    xmlSaveFileEnc( file, doc, "UTF-8" );
    free( file );
 
+   /* Make it show up in the map listings. */
+   ndata_rescan();
+
    /* Clean up. */
    xmlFreeDoc(doc);
    free(cleanName);
@@ -83,7 +83,7 @@ static cs *econ_G             = NULL; /**< Admittance matrix. */
  */
 /* Commodity. */
 static void commodity_freeOne( Commodity* com );
-static int commodity_parse( Commodity *temp, xmlNodePtr parent );
+static int commodity_parse( Commodity *temp, xmlTextReaderPtr reader );
 /* Economy. */
 static double econ_calcJumpR( StarSystem *A, StarSystem *B );
 static int econ_createGMatrix (void);
@@ -224,28 +224,29 @@ int commodity_compareTech( const void *commodity1, const void *commodity2 )
  * @brief Loads a commodity.
  *
  *    @param temp Commodity to load data into.
- *    @param parent XML node to load from.
- *    @return Commodity loaded from parent.
+ *    @param reader XML stream positioned on the commodity element.
+ *    @return Commodity loaded from the element.
  */
-static int commodity_parse( Commodity *temp, xmlNodePtr parent )
+static int commodity_parse( Commodity *temp, xmlTextReaderPtr reader )
 {
-   xmlNodePtr node;
+   int depth;
 
    /* Clear memory. */
    memset( temp, 0, sizeof(Commodity) );
 
    /* Parse body. */
-   node = parent->xmlChildrenNode;
-   do {
-      xml_onlyNodes(node);
-      xmlr_strd(node, "name", temp->name);
-      xmlr_strd(node, "description", temp->description);
-      xmlr_int(node, "price", temp->price);
-      if (xml_isNode(node,"gfx_space"))
-         temp->gfx_space = xml_parseTexture( node,
+   depth = xmls_depth( reader );
+   while (xmls_nextChild( reader, depth )) {
+      xmls_strd(reader, "name", temp->name);
+      xmls_strd(reader, "description", temp->description);
+      xmls_int(reader, "price", temp->price);
+      if (xmls_isNode(reader,"gfx_space")) {
+         temp->gfx_space = xmls_parseTexture( reader,
                COMMODITY_GFX_PATH"space/%s.png", 1, 1, OPENGL_TEX_MIPMAPS );
-      if (xml_isNode(node,"gfx_store")) {
-         temp->gfx_store = xml_parseTexture( node,
+         continue;
+      }
+      if (xmls_isNode(reader,"gfx_store")) {
+         temp->gfx_store = xmls_parseTexture( reader,
                COMMODITY_GFX_PATH"%s.png", 1, 1, OPENGL_TEX_MIPMAPS );
          if (temp->gfx_store != NULL) {
          } else {
@@ -253,7 +254,7 @@ static int commodity_parse( Commodity *temp, xmlNodePtr parent )
          }
          continue;
       }
-   } while (xml_nextNode(node));
+   }
    if (temp->name == NULL)
       WARN( _("Commodity from %s has invalid or no name"), COMMODITY_DATA_PATH);
    if ((temp->price>0)) {
@@ -501,8 +502,9 @@ int commodity_load (void)
 {
    size_t bufsize;
    char *buf;
-   xmlNodePtr node;
-   xmlDocPtr doc;
+   xmlTextReaderPtr reader;
+   int i, depth, n;
+   Commodity *c;
 
    /* Load the file. */
    buf = ndata_read( COMMODITY_DATA_PATH, &bufsize);
@@ -510,34 +512,34 @@ int commodity_load (void)
       return -1;
 
    /* Handle the XML. */
-   doc = xmlParseMemory( buf, bufsize );
-   if (doc == NULL) {
+   reader = xmls_open( buf, bufsize, COMMODITY_DATA_PATH );
+   if (reader == NULL) {
       WARN(_("'%s' is not valid XML."), COMMODITY_DATA_PATH);
+      free(buf);
       return -1;
    }
 
-   node = doc->xmlChildrenNode; /* Commodities node */
-   if (strcmp((char*)node->name,XML_COMMODITY_ID)) {
-      ERR(_("Malformed %s file: missing root element '%s'"), COMMODITY_DATA_PATH, XML_COMMODITY_ID);
-      return -1;
-   }
-
-   node = node->xmlChildrenNode; /* first faction node */
-   if (node == NULL) {
-      ERR(_("Malformed %s file: does not contain elements"), COMMODITY_DATA_PATH);
+   /* Commodities node */
+   if (!xmls_nextChild( reader, -1 ) || !xmls_isNode(reader, XML_COMMODITY_ID)) {
+      if (!xmls_failed( reader ))
+         ERR(_("Malformed %s file: missing root element '%s'"), COMMODITY_DATA_PATH, XML_COMMODITY_ID);
+      xmls_close(reader);
+      free(buf);
       return -1;
    }
 
-   do {
-      xml_onlyNodes(node);
-      if (xml_isNode(node, XML_COMMODITY_TAG)) {
+   depth = xmls_depth( reader );
+   n     = 0;
+   while (xmls_nextChild( reader, depth )) {
+      n++;
+      if (xmls_isNode(reader, XML_COMMODITY_TAG)) {
 
          /* Make room for commodity. */
          commodity_stack = realloc(commodity_stack,
                sizeof(Commodity)*(++commodity_nstack));
 
          /* Load commodity. */
-         commodity_parse(&commodity_stack[commodity_nstack-1], node);
+         commodity_parse(&commodity_stack[commodity_nstack-1], reader);
 
          /* See if should get added to commodity list. */
          if (commodity_stack[commodity_nstack-1].price > 0.) {
@@ -547,12 +549,33 @@ int commodity_load (void)
          }
       }
       else
-         WARN(_("'%s' has unknown node '%s'."), COMMODITY_DATA_PATH, node->name);
-   } while (xml_nextNode(node));
+         WARN(_("'%s' has unknown node '%s'."), COMMODITY_DATA_PATH, xmls_name(reader));
+   }
 
-   xmlFreeDoc(doc);
+   /* Don't run with part of the commodities. */
+   if (xmls_failed( reader )) {
+      xmls_close(reader);
+      free(buf);
+      commodity_free();
+      return -1;
+   }
+   if (n == 0)
+      ERR(_("Malformed %s file: does not contain elements"), COMMODITY_DATA_PATH);
+
+   xmls_close(reader);
    free(buf);
 
+   /* Upload the graphics, falling back to the defaults if they don't decode. */
+   gl_texFlush();
+   for (i=0; i<commodity_nstack; i++) {
+      c = &commodity_stack[i];
+      if ((c->gfx_store != NULL) && (gl_texCheck( c->gfx_store ) == NULL))
+         c->gfx_store = gl_newImage( COMMODITY_GFX_PATH"_default.png", 0 );
+      if ((c->gfx_space != NULL) && (gl_texCheck( c->gfx_space ) == NULL))
+         c->gfx_space = (c->price > 0) ?
+               gl_newImage( COMMODITY_GFX_PATH"space/_default.png", 0 ) : NULL;
+   }
+
    DEBUG( ngettext( "Loaded %d Commodity", "Loaded %d Commodities", commodity_nstack ), commodity_nstack );
 
    return 0;
@@ -575,6 +598,8 @@ void commodity_free (void)
 
    /* More clean up. */
    free( econ_comm );
+   econ_comm    = NULL;
+   econ_nprices = 0;
 }
 
 
@@ -419,7 +419,7 @@ static void equipment_renderColumn( double x, double y, double w, double h,
 
       if (lst[i].outfit != NULL) {
          /* Draw bugger. */
-         gl_blitScale( lst[i].outfit->gfx_store,
+         gl_blitScale( outfit_gfxStore( lst[i].outfit ),
                x, y, w, h, NULL );
       }
       else if ((o != NULL) &&
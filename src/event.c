@@ -40,6 +40,7 @@
 #include "hook.h"
 #include "player.h"
 #include "npc.h"
+#include "array.h"
 
 
 #define XML_EVENT_ID          "Events" /**< XML document identifier */
@@ -57,6 +58,7 @@
 typedef struct EventData_s {
    char *name; /**< Name of the event. */
    char *lua; /**< Name of Lua file to use. */
+   int chunk; /**< Compiled Lua file, LUA_NOREF until first used. */
    unsigned int flags; /**< Bit flags. */
 
    EventTrigger_t trigger; /**< What triggers the event. */
@@ -70,6 +72,8 @@ typedef struct EventData_s {
  */
 static EventData_t *event_data   = NULL; /**< Allocated event data. */
 static int event_ndata           = 0; /**< Number of actual event data. */
+static int *event_triggers[EVENT_TRIGGER_LOAD+1]; /**< Event data IDs by trigger (array.h). */
+static int *event_running        = NULL; /**< Active events by event data ID. */
 
 
 /*
@@ -244,8 +248,6 @@ static unsigned int event_genID (void)
  */
 static int event_create( int dataid, unsigned int *id )
 {
-   size_t bufsize;
-   char *buf;
    Event_t *ev;
    EventData_t *data;
 
@@ -265,9 +267,11 @@ static int event_create( int dataid, unsigned int *id )
    /* Add the data. */
    ev->data = dataid;
    data = &event_data[dataid];
+   event_running[dataid]++;
 
    /* Open the new state. */
    ev->env = nlua_newEnv(1);
+   nlua_setEnvName( ev->env, "event:%s", data->name );
    nlua_loadStandard(ev->env);
    nlua_loadEvt(ev->env);
    nlua_loadHook(ev->env);
@@ -279,21 +283,14 @@ static int event_create( int dataid, unsigned int *id )
    if (player_isTut())
       nlua_loadTut(ev->env);
 
-   /* Load file. */
-   buf = ndata_read( data->lua, &bufsize );
-   if (buf == NULL) {
-      WARN(_("Event '%s' Lua script not found."), data->lua );
-      return -1;
-   }
-   if (nlua_dobufenv(ev->env, buf, bufsize, data->lua) != 0) {
+   /* Load file, it's only compiled the first time. */
+   if (nlua_dochunkenv(ev->env, &data->chunk, data->lua) != 0) {
       WARN(_("Error loading event file: %s\n"
             "%s\n"
             "Most likely Lua file has improper syntax, please check"),
             data->lua, lua_tostring(naevL,-1));
-      free(buf);
       return -1;
    }
-   free(buf);
 
    /* Run Lua. */
    if ((id==NULL) || (*id==0))
@@ -312,6 +309,9 @@ static int event_create( int dataid, unsigned int *id )
  */
 static void event_cleanup( Event_t *ev )
 {
+   /* No longer running. */
+   event_running[ ev->data ]--;
+
    /* Free lua env. */
    nlua_freeEnv(ev->env);
 
@@ -376,17 +376,9 @@ int event_save( unsigned int eventid )
  */
 int event_alreadyRunning( int data )
 {
-   int i;
-   Event_t *ev;
-
-   /* Find events. */
-   for (i=0; i<event_nactive; i++) {
-      ev = &event_active[i];
-      if (ev->data == data)
-         return 1;
-   }
-
-   return 0;
+   if ((data < 0) || (data >= event_ndata))
+      return 0;
+   return (event_running[data] > 0);
 }
 
 
@@ -397,18 +389,21 @@ int event_alreadyRunning( int data )
  */
 void events_trigger( EventTrigger_t trigger )
 {
-   int i, c;
+   int i, j, c;
    int created;
 
    /* Events can't be triggered by tutorial. */
    if (player_isTut())
       return;
 
+   /* Only look at the events with the trigger. */
+   if ((trigger < 0) || (trigger > EVENT_TRIGGER_LOAD) ||
+         (event_triggers[trigger] == NULL))
+      return;
+
    created = 0;
-   for (i=0; i<event_ndata; i++) {
-      /* Make sure trigger matches. */
-      if (event_data[i].trigger != trigger)
-         continue;
+   for (j=0; j<array_size(event_triggers[trigger]); j++) {
+      i = event_triggers[trigger][j];
 
       /* Make sure chance is succeeded. */
       if (RNGF() > event_data[i].chance)
@@ -461,6 +456,7 @@ static int event_parse( EventData_t *temp, const xmlNodePtr parent )
 #endif /* DEBUGGING */
 
    memset( temp, 0, sizeof(EventData_t) );
+   temp->chunk = LUA_NOREF;
 
    /* get the name */
    temp->name = xml_nodeProp(parent, "name");
@@ -559,6 +555,7 @@ static int event_parse( EventData_t *temp, const xmlNodePtr parent )
 int events_load (void)
 {
    int m;
+   EventTrigger_t t;
    size_t bufsize;
    char *buf;
    xmlNodePtr node;
@@ -611,6 +608,17 @@ int events_load (void)
    /* Shrink to minimum. */
    event_data = realloc(event_data, sizeof(EventData_t)*event_ndata);
 
+   /* Bucket by trigger so triggering doesn't look at all of them. */
+   for (m=0; m<event_ndata; m++) {
+      t = event_data[m].trigger;
+      if ((t < 0) || (t > EVENT_TRIGGER_LOAD))
+         continue;
+      if (event_triggers[t] == NULL)
+         event_triggers[t] = array_create( int );
+      array_push_back( &event_triggers[t], m );
+   }
+   event_running = calloc( event_ndata, sizeof(int) );
+
    /* Clean up. */
    xmlFreeDoc(doc);
    free(buf);
@@ -630,6 +638,7 @@ static void event_freeData( EventData_t *event )
 {
    free( event->name );
    free( event->lua );
+   nlua_freeChunk( &event->chunk );
    free( event->cond );
 #if DEBUGGING
    memset( event, 0, sizeof(EventData_t) );
@@ -673,6 +682,15 @@ void events_exit (void)
    }
    event_data  = NULL;
    event_ndata = 0;
+
+   /* Free lookups. */
+   for (i=0; i<=EVENT_TRIGGER_LOAD; i++) {
+      if (event_triggers[i] != NULL)
+         array_free( event_triggers[i] );
+      event_triggers[i] = NULL;
+   }
+   free( event_running );
+   event_running = NULL;
 }
 
 
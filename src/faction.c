@@ -1256,6 +1256,7 @@ static int faction_parse( Faction* temp, xmlNodePtr parent )
             WARN(_("Faction '%s' has duplicate 'spawn' tag."), temp->name);
          nsnprintf( buf, sizeof(buf), "dat/factions/spawn/%s.lua", xml_raw(node) );
          temp->sched_env = nlua_newEnv(1);
+         nlua_setEnvName( temp->sched_env, "%s", buf );
          nlua_loadStandard( temp->sched_env);
          dat = ndata_read( buf, &ndat );
          if (nlua_dobufenv(temp->sched_env, dat, ndat, buf) != 0) {
@@ -1275,6 +1276,7 @@ static int faction_parse( Faction* temp, xmlNodePtr parent )
             WARN(_("Faction '%s' has duplicate 'standing' tag."), temp->name);
          nsnprintf( buf, sizeof(buf), "dat/factions/standing/%s.lua", xml_raw(node) );
          temp->env = nlua_newEnv(1);
+         nlua_setEnvName( temp->env, "%s", buf );
          nlua_loadStandard( temp->env );
          dat = ndata_read( buf, &ndat );
          if (nlua_dobufenv(temp->env, dat, ndat, buf) != 0) {
@@ -1299,6 +1301,7 @@ static int faction_parse( Faction* temp, xmlNodePtr parent )
             WARN(_("Faction '%s' has duplicate 'equip' tag."), temp->name);
          nsnprintf( buf, sizeof(buf), "dat/factions/equip/%s.lua", xml_raw(node) );
          temp->equip_env = nlua_newEnv(1);
+         nlua_setEnvName( temp->equip_env, "%s", buf );
          nlua_loadStandard( temp->equip_env );
          dat = ndata_read( buf, &ndat );
          if (nlua_dobufenv(temp->equip_env, dat, ndat, buf) != 0) {
@@ -114,7 +114,7 @@ static int fleet_parse( Fleet *temp, const xmlNodePtr parent )
    memset( temp, 0, sizeof(Fleet) );
    temp->faction = -1;
 
-   temp->name = (char*)xmlGetProp(parent,(xmlChar*)"name"); /* already mallocs */
+   temp->name = xml_nodeProp(parent,"name"); /* already mallocs */
    if (temp->name == NULL)
       WARN( _("Fleet in %s has invalid or no name"), FLEET_DATA_PATH );
 
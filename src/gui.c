@@ -2153,6 +2153,7 @@ int gui_load( const char* name )
 
    /* Create Lua state. */
    gui_env = nlua_newEnv(1);
+   nlua_setEnvName( gui_env, "gui:%s", name );
    if (nlua_dobufenv( gui_env, buf, bufsize, path ) != 0) {
       WARN(_("Failed to load GUI Lua: %s\n"
             "%s\n"
@@ -2175,6 +2176,9 @@ int gui_load( const char* name )
       gui_env = LUA_NOREF;
    }
 
+   /* Upload whatever textures the GUI opened and didn't use yet. */
+   gl_texFlush();
+
    /* Recreate land window if landed. */
    if (landed) {
       land_genWindows( 0, 1 );
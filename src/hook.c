@@ -39,9 +39,12 @@
 #include "mission.h"
 #include "space.h"
 #include "menu.h"
+#include "array.h"
 
 
 #define HOOK_CHUNK   32 /**< Size to grow by when out of space */
+#define HOOK_STACK_BUCKETS 64 /**< Buckets for the stack names, must be a power of two. */
+#define HOOK_HASH_MIN   256 /**< Minimum buckets for the hook IDs, must be a power of two. */
 
 
 /**
@@ -76,22 +79,27 @@ typedef enum HookType_e {
  */
 typedef struct Hook_ {
    struct Hook_ *next; /**< Linked list. */
+   struct Hook_ *hnext; /**< Next in the ID hash bucket. */
 
    unsigned int id; /**< unique id */
-   char *stack; /**< stack it's a part of */
+   const char *stack; /**< stack it's a part of, interned */
+   int stackid; /**< ID of the stack it's a part of. */
    int created; /**< Hook has just been created. */
    int delete; /**< indicates it should be deleted when possible */
    int ran_once; /**< Indicates if the hook already ran, useful when iterating. */
    int once; /**< Only run the hook once. */
 
+   /* Scheduling. */
+   int heapidx; /**< Position in the timer or date heap, -1 if not in one. */
+
    /* Timer information. */
    int is_timer; /**< Whether or not is actually a timer. */
-   double ms; /**< Milliseconds left. */
+   double due; /**< Timer clock time it's due at, in seconds. */
 
    /* Date information. */
    int is_date; /**< Whether or not it is a date hook. */
    ntime_t res; /**< Resolution to display. */
-   ntime_t acc; /**< Accumulated resolution. */
+   ntime_t fire; /**< Date clock time a full resolution is accumulated at. */
 
    HookType_t type; /**< Type of hook. */
    union {
@@ -107,11 +115,37 @@ typedef struct Hook_ {
 } Hook;
 
 
+/**
+ * @brief Interned hook stack with the hooks that belong to it.
+ */
+typedef struct HookStack_ {
+   char *name; /**< Name of the stack. */
+   int next; /**< Next stack in the name bucket, -1 if none. */
+   Hook **hooks; /**< Hooks in the stack, oldest first (array.h). */
+} HookStack;
+
+
 /*
  * the stack
  */
 static unsigned int hook_id   = 0; /**< Unique hook id generator. */
 static Hook* hook_list        = NULL; /**< Stack of hooks. */
+static HookStack *hook_stacks = NULL; /**< Interned stacks (array.h). */
+static int hook_stackBuckets[ HOOK_STACK_BUCKETS ]; /**< First stack by name hash, -1 if none. */
+static Hook **hook_hash       = NULL; /**< Hooks by ID. */
+static int hook_nhash         = 0; /**< Number of buckets in hook_hash. */
+static int hook_nhooks        = 0; /**< Number of hooks in hook_hash. */
+
+
+/*
+ * Scheduled hooks.
+ */
+static Hook **hook_timers     = NULL; /**< Min-heap of timer hooks by due time (array.h). */
+static Hook **hook_dates      = NULL; /**< Min-heap of date hooks by next time (array.h). */
+static Hook **hook_pending    = NULL; /**< Scheduled while the heaps are being run (array.h). */
+static double hook_timerNow   = 0.; /**< Timer clock, advances with the hook updates. */
+static ntime_t hook_dateNow   = 0; /**< Date clock, advances with the date changes. */
+static int hook_heapRunning   = 0; /**< Whether or not the heaps are being run. */
 static int hook_runningstack  = 0; /**< Check if stack is running. */
 static int hook_loadingstack  = 0; /**< Check if the hooks are being loaded. */
 
@@ -126,6 +160,21 @@ static void hooks_updateDateExecute( ntime_t change );
 static void hook_rmRaw( Hook *h );
 static void hooks_purgeList (void);
 static Hook* hook_get( unsigned int id );
+static uint32_t hook_hashStr( const char *str );
+static int hook_stackID( const char *stack, int create );
+static void hook_hashAdd( Hook *h );
+static void hook_hashRm( Hook *h );
+/* Scheduling. */
+static int hook_heapLess( const Hook *a, const Hook *b );
+static void hook_heapSwap( Hook **heap, int i, int j );
+static void hook_heapUp( Hook **heap, int i );
+static void hook_heapDown( Hook **heap, int i );
+static void hook_heapPush( Hook ***heap, Hook *h );
+static Hook* hook_heapPop( Hook ***heap );
+static void hook_heapRm( Hook ***heap, Hook *h );
+static void hook_schedule( Hook *h );
+static void hook_scheduleFlush (void);
+static int hook_cmpScheduled( const void *p1, const void *p2 );
 static unsigned int hook_genID (void);
 static Hook* hook_new( HookType_t type, const char *stack );
 static int hook_parseParam( lua_State *L, HookParam *param );
@@ -441,7 +490,6 @@ static int hook_run( Hook *hook, HookParam *param, int claims )
 static unsigned int hook_genID (void)
 {
    unsigned int id;
-   Hook *h;
    id = ++hook_id; /* default id, not safe if loading */
 
    /* If not loading we can just return. */
@@ -449,14 +497,116 @@ static unsigned int hook_genID (void)
       return id;
 
    /* Must check ids for collisions. */
-   for (h=hook_list; h!=NULL; h=h->next)
-      if (id == h->id) /* Check for collision. */
-         return hook_genID(); /* recursively try again */
+   if (hook_get( id ) != NULL)
+      return hook_genID(); /* recursively try again */
 
    return id;
 }
 
 
+/**
+ * @brief Hashes a stack name.
+ */
+static uint32_t hook_hashStr( const char *str )
+{
+   uint32_t hash;
+   const unsigned char *c;
+
+   hash = 2166136261U;
+   for (c=(const unsigned char*)str; *c != '\0'; c++) {
+      hash ^= *c;
+      hash *= 16777619U;
+   }
+   return hash;
+}
+
+
+/**
+ * @brief Gets the ID of a stack, interning it if needed.
+ *
+ *    @param stack Name of the stack.
+ *    @param create Whether or not to intern the stack if it doesn't exist.
+ *    @return ID of the stack or -1 if it doesn't exist and create is 0.
+ */
+static int hook_stackID( const char *stack, int create )
+{
+   int i, b;
+   HookStack *hs;
+
+   if (hook_stacks == NULL) {
+      hook_stacks = array_create( HookStack );
+      for (i=0; i<HOOK_STACK_BUCKETS; i++)
+         hook_stackBuckets[i] = -1;
+   }
+
+   b = hook_hashStr( stack ) & (HOOK_STACK_BUCKETS-1);
+   for (i=hook_stackBuckets[b]; i>=0; i=hook_stacks[i].next)
+      if (strcmp( hook_stacks[i].name, stack )==0)
+         return i;
+
+   if (!create)
+      return -1;
+
+   hs          = &array_grow( &hook_stacks );
+   hs->name    = strdup( stack );
+   hs->hooks   = array_create( Hook* );
+   hs->next    = hook_stackBuckets[b];
+   hook_stackBuckets[b] = array_size(hook_stacks)-1;
+   return array_size(hook_stacks)-1;
+}
+
+
+/**
+ * @brief Adds a hook to the ID hash, growing it as needed.
+ */
+static void hook_hashAdd( Hook *h )
+{
+   int i, n;
+   Hook **buckets, *c, *cn;
+
+   /* Grow and rehash. */
+   if (hook_nhooks >= hook_nhash) {
+      n = MAX( HOOK_HASH_MIN, 2*hook_nhash );
+      buckets = calloc( n, sizeof(Hook*) );
+      for (i=0; i<hook_nhash; i++) {
+         for (c=hook_hash[i]; c!=NULL; c=cn) {
+            cn = c->hnext;
+            c->hnext = buckets[ c->id & (n-1) ];
+            buckets[ c->id & (n-1) ] = c;
+         }
+      }
+      free( hook_hash );
+      hook_hash   = buckets;
+      hook_nhash  = n;
+   }
+
+   h->hnext = hook_hash[ h->id & (hook_nhash-1) ];
+   hook_hash[ h->id & (hook_nhash-1) ] = h;
+   hook_nhooks++;
+}
+
+
+/**
+ * @brief Removes a hook from the ID hash.
+ */
+static void hook_hashRm( Hook *h )
+{
+   Hook **c;
+
+   if (hook_nhash <= 0)
+      return;
+
+   for (c=&hook_hash[ h->id & (hook_nhash-1) ]; *c!=NULL; c=&(*c)->hnext) {
+      if (*c == h) {
+         *c = h->hnext;
+         h->hnext = NULL;
+         hook_nhooks--;
+         return;
+      }
+   }
+}
+
+
 /**
  * @brief Generates and allocates a new hook.
  *
@@ -480,8 +630,14 @@ static Hook* hook_new( HookType_t type, const char *stack )
    /* Fill out generic details. */
    new_hook->type    = type;
    new_hook->id      = hook_genID();
-   new_hook->stack   = strdup(stack);
+   new_hook->stackid = hook_stackID( stack, 1 );
+   new_hook->stack   = hook_stacks[ new_hook->stackid ].name;
    new_hook->created = 1;
+   new_hook->heapidx = -1;
+
+   /* Index it. */
+   hook_hashAdd( new_hook );
+   array_push_back( &hook_stacks[ new_hook->stackid ].hooks, new_hook );
 
    /** @TODO fix this hack. */
    if (strcmp(stack,"safe")==0)
@@ -558,7 +714,8 @@ unsigned int hook_addTimerMisn( unsigned int parent, const char *func, double ms
 
    /* Timer information. */
    new_hook->is_timer      = 1;
-   new_hook->ms            = ms;
+   new_hook->due           = hook_timerNow + ms;
+   hook_schedule( new_hook );
 
    return new_hook->id;
 }
@@ -585,7 +742,8 @@ unsigned int hook_addTimerEvt( unsigned int parent, const char *func, double ms
 
    /* Timer information. */
    new_hook->is_timer      = 1;
-   new_hook->ms            = ms;
+   new_hook->due           = hook_timerNow + ms;
+   hook_schedule( new_hook );
 
    return new_hook->id;
 }
@@ -596,12 +754,24 @@ unsigned int hook_addTimerEvt( unsigned int parent, const char *func, double ms
  */
 static void hooks_purgeList (void)
 {
-   Hook *h, *hl;
+   int i, j, n;
+   Hook *h, *hl, **hooks;
 
    /* Do not run while stack is being run. */
    if (hook_runningstack)
       return;
 
+   /* Drop from the stacks keeping the order. */
+   for (i=0; i<array_size(hook_stacks); i++) {
+      hooks = hook_stacks[i].hooks;
+      n = 0;
+      for (j=0; j<array_size(hooks); j++)
+         if (!hooks[j]->delete)
+            hooks[n++] = hooks[j];
+      if (n != array_size(hooks))
+         array_resize( &hook_stacks[i].hooks, n );
+   }
+
    /* Second pass to delete. */
    hl = NULL;
    h  = hook_list;
@@ -631,6 +801,158 @@ static void hooks_purgeList (void)
 }
 
 
+/**
+ * @brief Checks to see if a hook should fire before another.
+ */
+static int hook_heapLess( const Hook *a, const Hook *b )
+{
+   if (a->is_date) {
+      if (a->fire != b->fire)
+         return (a->fire < b->fire);
+   }
+   else if (a->due != b->due)
+      return (a->due < b->due);
+   /* Newest first like the stacks. */
+   return (a->id > b->id);
+}
+
+
+/**
+ * @brief Swaps two hooks in a heap.
+ */
+static void hook_heapSwap( Hook **heap, int i, int j )
+{
+   Hook *h;
+   h        = heap[i];
+   heap[i]  = heap[j];
+   heap[j]  = h;
+   heap[i]->heapidx = i;
+   heap[j]->heapidx = j;
+}
+
+
+/**
+ * @brief Moves a hook up the heap until it's in place.
+ */
+static void hook_heapUp( Hook **heap, int i )
+{
+   int p;
+   while (i > 0) {
+      p = (i-1) / 2;
+      if (!hook_heapLess( heap[i], heap[p] ))
+         break;
+      hook_heapSwap( heap, i, p );
+      i = p;
+   }
+}
+
+
+/**
+ * @brief Moves a hook down the heap until it's in place.
+ */
+static void hook_heapDown( Hook **heap, int i )
+{
+   int n, c;
+   n = array_size(heap);
+   while (1) {
+      c = 2*i+1;
+      if (c >= n)
+         break;
+      if ((c+1 < n) && hook_heapLess( heap[c+1], heap[c] ))
+         c++;
+      if (!hook_heapLess( heap[c], heap[i] ))
+         break;
+      hook_heapSwap( heap, i, c );
+      i = c;
+   }
+}
+
+
+/**
+ * @brief Adds a hook to a heap.
+ */
+static void hook_heapPush( Hook ***heap, Hook *h )
+{
+   if (*heap == NULL)
+      *heap = array_create( Hook* );
+   array_push_back( heap, h );
+   h->heapidx = array_size(*heap)-1;
+   hook_heapUp( *heap, h->heapidx );
+}
+
+
+/**
+ * @brief Removes the hook that fires first from a heap.
+ */
+static Hook* hook_heapPop( Hook ***heap )
+{
+   Hook *h;
+   h = (*heap)[0];
+   hook_heapRm( heap, h );
+   return h;
+}
+
+
+/**
+ * @brief Removes a hook from a heap.
+ */
+static void hook_heapRm( Hook ***heap, Hook *h )
+{
+   int i, n;
+   Hook *moved;
+
+   i = h->heapidx;
+   n = array_size(*heap)-1;
+   if (i != n) {
+      hook_heapSwap( *heap, i, n );
+      array_resize( heap, n );
+      moved = (*heap)[i];
+      hook_heapDown( *heap, i );
+      hook_heapUp( *heap, moved->heapidx );
+   }
+   else
+      array_resize( heap, n );
+   h->heapidx = -1;
+}
+
+
+/**
+ * @brief Schedules a timer or date hook.
+ *
+ * While the heaps are being run they're left pending so they don't fire
+ *  until the next update.
+ */
+static void hook_schedule( Hook *h )
+{
+   if (hook_heapRunning) {
+      if (hook_pending == NULL)
+         hook_pending = array_create( Hook* );
+      array_push_back( &hook_pending, h );
+   }
+   else if (h->is_date)
+      hook_heapPush( &hook_dates, h );
+   else if (h->is_timer)
+      hook_heapPush( &hook_timers, h );
+}
+
+
+/**
+ * @brief Schedules the hooks left pending while the heaps were run.
+ */
+static void hook_scheduleFlush (void)
+{
+   int i;
+
+   if (hook_heapRunning || (hook_pending == NULL))
+      return;
+
+   for (i=0; i<array_size(hook_pending); i++)
+      if (!hook_pending[i]->delete)
+         hook_schedule( hook_pending[i] );
+   array_resize( &hook_pending, 0 );
+}
+
+
 /**
  * @brief Updates the time to see if it should be updated.
  */
@@ -646,44 +968,51 @@ void hooks_updateDate( ntime_t change )
  */
 static void hooks_updateDateExecute( ntime_t change )
 {
-   int j;
+   ntime_t acc, prev;
    Hook *h;
 
    /* Don't update without player. */
    if ((player.p == NULL) || player_isFlag(PLAYER_CREATING))
       return;
 
-   /* Clear creation flags. */
-   for (h=hook_list; h!=NULL; h=h->next)
-      h->created = 0;
+   /* The date is advanced first so hooks created by the ones run below
+    * start counting from the new date. */
+   prev = hook_dateNow;
+   hook_dateNow += change;
 
-   /* On j=0 we increment all timers and try to run, then on j=1 we update the timers. */
    hook_runningstack++; /* running hooks */
-   for (j=1; j>=0; j--) {
-      for (h=hook_list; h!=NULL; h=h->next) {
-         /* Find valid date hooks. */
-         if (h->is_date == 0)
-            continue;
-         /* Don't update newly created hooks. */
-         if (h->created != 0)
-            continue;
-
-         /* Decrement timer and check to see if should run. */
-         if (j==0)
-            h->acc += change;
-         if (h->acc < h->res)
-            continue;
-
-         /* Run the timer hook. */
-         hook_run( h, NULL, j );
-         /* Date hooks are not deleted. */
-
-         /* Time is modified at the end. */
-         if (j==1)
-            h->acc %= h->res; /* We'll skip all buggers. */
+   hook_heapRunning++;
+
+   /* First run the ones left due by the last change for the claims, and
+    * restart their accumulation. */
+   while ((array_size(hook_dates) > 0) && (hook_dates[0]->fire <= prev)) {
+      h = hook_heapPop( &hook_dates );
+      if (h->delete)
+         continue;
+      hook_run( h, NULL, 1 );
+      if (h->res > 0) {
+         acc = (h->res - (h->fire - prev)) % h->res; /* We'll skip all buggers. */
+         h->fire = prev + h->res - acc;
       }
+      else
+         h->fire = prev + 1;
+      hook_heapPush( &hook_dates, h );
+   }
+
+   /* Then run the ones that became due with the change. They stay due until
+    * the next change. */
+   while ((array_size(hook_dates) > 0) && (hook_dates[0]->fire <= hook_dateNow)) {
+      h = hook_heapPop( &hook_dates );
+      if (h->delete)
+         continue;
+      hook_run( h, NULL, 0 );
+      /* Date hooks are not deleted. */
+      hook_schedule( h );
    }
+
+   hook_heapRunning--;
    hook_runningstack--; /* not running hooks anymore */
+   hook_scheduleFlush();
 
    /* Second pass to delete. */
    hooks_purgeList();
@@ -704,7 +1033,8 @@ unsigned int hook_addDateMisn( unsigned int parent, const char *func, ntime_t re
    /* Timer information. */
    new_hook->is_date       = 1;
    new_hook->res           = resolution;
-   new_hook->acc           = 0;
+   new_hook->fire          = hook_dateNow + resolution;
+   hook_schedule( new_hook );
 
    return new_hook->id;
 }
@@ -724,7 +1054,8 @@ unsigned int hook_addDateEvt( unsigned int parent, const char *func, ntime_t res
    /* Timer information. */
    new_hook->is_date       = 1;
    new_hook->res           = resolution;
-   new_hook->acc           = 0;
+   new_hook->fire          = hook_dateNow + resolution;
+   hook_schedule( new_hook );
 
    return new_hook->id;
 }
@@ -736,41 +1067,38 @@ unsigned int hook_addDateEvt( unsigned int parent, const char *func, ntime_t res
 void hooks_update( double dt )
 {
    int j;
+   double prev, now;
    Hook *h;
 
    /* Don't update without player. */
    if ((player.p == NULL) || player_isFlag(PLAYER_CREATING))
       return;
 
-   /* Clear creation flags. */
-   for (h=hook_list; h!=NULL; h=h->next)
-      h->created = 0;
+   /* The clock is advanced first so timers created by the ones run below
+    * count from the new time. */
+   prev = hook_timerNow;
+   hook_timerNow += dt;
 
+   /* On j=1 the ones already due run for the claims, on j=0 the rest that
+    * became due run. */
    hook_runningstack++; /* running hooks */
+   hook_heapRunning++;
    for (j=1; j>=0; j--) {
-      for (h=hook_list; h!=NULL; h=h->next) {
+      now = (j==1) ? prev : hook_timerNow;
+      while ((array_size(hook_timers) > 0) && (hook_timers[0]->due <= now)) {
+         h = hook_heapPop( &hook_timers );
          /* Not be deleting. */
          if (h->delete)
             continue;
-         /* Find valid timer hooks. */
-         if (h->is_timer == 0)
-            continue;
-         /* Don't update newly created hooks. */
-         if (h->created != 0)
-            continue;
-
-         /* Decrement timer and check to see if should run. */
-         if (j==0)
-            h->ms -= dt;
-         if (h->ms > 0.)
-            continue;
 
          /* Run the timer hook. */
          hook_run( h, NULL, j );
          hook_rmRaw( h );
       }
    }
+   hook_heapRunning--;
    hook_runningstack--; /* not running hooks anymore */
+   hook_scheduleFlush();
 
    /* Second pass to delete. */
    hooks_purgeList();
@@ -888,10 +1216,100 @@ int hook_hasEventParent( unsigned int parent )
 }
 
 
+/**
+ * @brief Counts the live hooks of each stack.
+ *
+ *    @param stat Called once per stack with the stack name and hook count.
+ *    @param data Passed to stat.
+ */
+void hooks_stats( void (*stat)( const char *stack, int n, void *data ), void *data )
+{
+   int i, j, n;
+   Hook **hooks;
+
+   for (i=0; i<array_size(hook_stacks); i++) {
+      hooks = hook_stacks[i].hooks;
+      n = 0;
+      for (j=0; j<array_size(hooks); j++)
+         if (!hooks[j]->delete)
+            n++;
+      if (n > 0)
+         stat( hook_stacks[i].name, n, data );
+   }
+}
 
+
+
+/**
+ * @brief Compares two scheduled hooks by when they fire.
+ */
+static int hook_cmpScheduled( const void *p1, const void *p2 )
+{
+   const Hook *h1, *h2;
+   h1 = *(const Hook**) p1;
+   h2 = *(const Hook**) p2;
+   if (hook_heapLess( h1, h2 ))
+      return -1;
+   if (hook_heapLess( h2, h1 ))
+      return +1;
+   return 0;
+}
+
+
+/**
+ * @brief Prints the upcoming timer and date hooks.
+ *
+ *    @param print Function to print each line with.
+ *    @param max Maximum number of hooks of each kind to print.
+ */
+void hooks_printScheduled( void (*print)( const char *msg ), int max )
+{
+   int i, k;
+   Hook **hooks, **heap, *h;
+   const char *func;
+   char buf[256], date[64];
+
+   for (k=0; k<2; k++) {
+      heap = (k==0) ? hook_timers : hook_dates;
+      if ((heap == NULL) || (array_size(heap) == 0)) {
+         print( (k==0) ? _("No timer hooks.") : _("No date hooks.") );
+         continue;
+      }
+      nsnprintf( buf, sizeof(buf), (k==0) ? _("Timer hooks: %d") : _("Date hooks: %d"),
+            array_size(heap) );
+      print( buf );
+
+      /* Only sort a copy, the heap must stay as is. */
+      hooks = malloc( sizeof(Hook*) * array_size(heap) );
+      memcpy( hooks, heap, sizeof(Hook*) * array_size(heap) );
+      qsort( hooks, array_size(heap), sizeof(Hook*), hook_cmpScheduled );
+      for (i=0; (i<array_size(heap)) && (i<max); i++) {
+         h = hooks[i];
+         func = (h->type == HOOK_TYPE_MISN) ? h->u.misn.func :
+               (h->type == HOOK_TYPE_EVENT) ? h->u.event.func : "?";
+         if (k==0)
+            nsnprintf( buf, sizeof(buf), _("   %8.2f s  %u -> %s"),
+                  h->due - hook_timerNow, h->id, func );
+         else {
+            ntime_prettyBuf( date, sizeof(date), h->fire - hook_dateNow, 4 );
+            nsnprintf( buf, sizeof(buf), _("   %s  %u -> %s"), date, h->id, func );
+         }
+         print( buf );
+      }
+      free( hooks );
+   }
+}
+
+
+/**
+ * @brief Runs all the hooks of a stack.
+ *
+ * Hooks are run newest first, once for the ones that claimed the system and
+ *  then for the rest. Hooks created while running are left for the next time.
+ */
 static int hooks_executeParam( const char* stack, HookParam *param )
 {
-   int j;
+   int i, j, sid;
    int run;
    Hook *h;
 
@@ -899,17 +1317,26 @@ static int hooks_executeParam( const char* stack, HookParam *param )
    if ((player.p == NULL) || player_isFlag(PLAYER_DESTROYED))
       return 0;
 
+   /* Nothing has ever hooked the stack. */
+   sid = hook_stackID( stack, 0 );
+   if (sid < 0)
+      return 0;
+
    /* Reset the current stack's ran and creation flags. */
-   for (h=hook_list; h!=NULL; h=h->next)
-      if (strcmp(stack, h->stack)==0) {
-         h->ran_once = 0;
-         h->created = 0;
-      }
+   for (i=0; i<array_size(hook_stacks[sid].hooks); i++) {
+      h = hook_stacks[sid].hooks[i];
+      h->ran_once = 0;
+      h->created = 0;
+   }
 
    run = 0;
    hook_runningstack++; /* running hooks */
    for (j=1; j>=0; j--) {
-      for (h=hook_list; h!=NULL; h=h->next) {
+      /* Hooks can be added while running, they go to the end and are skipped. */
+      for (i=array_size(hook_stacks[sid].hooks)-1; i>=0; i--) {
+         if (i >= array_size(hook_stacks[sid].hooks))
+            continue;
+         h = hook_stacks[sid].hooks[i];
          /* Should be deleted. */
          if (h->delete)
             continue;
@@ -919,9 +1346,6 @@ static int hooks_executeParam( const char* stack, HookParam *param )
          /* Don't update newly created hooks. */
          if (h->created != 0)
             continue;
-         /* Doesn't match stack. */
-         if (strcmp(stack, h->stack) != 0)
-            continue;
 
          /* Run hook. */
          hook_run( h, param, j );
@@ -991,7 +1415,11 @@ int hooks_run( const char* stack )
 static Hook* hook_get( unsigned int id )
 {
    Hook *h;
-   for (h=hook_list; h!=NULL; h=h->next)
+
+   if (hook_nhash <= 0)
+      return NULL;
+
+   for (h=hook_hash[ id & (hook_nhash-1) ]; h!=NULL; h=h->hnext)
       if (h->id == id)
          return h;
 
@@ -1078,9 +1506,10 @@ static void hook_free( Hook *h )
    /* Remove from all the pilots. */
    pilots_rmHook( h->id );
 
-   /* Generic freeing. */
-   if (h->stack != NULL)
-      free(h->stack);
+   /* No longer findable. */
+   hook_hashRm( h );
+   if (h->heapidx >= 0)
+      hook_heapRm( h->is_date ? &hook_dates : &hook_timers, h );
 
    /* Free type specific. */
    switch (h->type) {
@@ -1107,6 +1536,7 @@ static void hook_free( Hook *h )
  */
 void hook_cleanup (void)
 {
+   int i;
    Hook *h, *hn;
 
    if (hook_runningstack)
@@ -1123,6 +1553,12 @@ void hook_cleanup (void)
    }
    /* sane defaults just in case */
    hook_list  = NULL;
+
+   /* Stacks stay interned, only the hooks go. */
+   for (i=0; i<array_size(hook_stacks); i++)
+      array_resize( &hook_stacks[i].hooks, 0 );
+   if (hook_pending != NULL)
+      array_resize( &hook_pending, 0 );
 }
 
 
@@ -1334,15 +1770,19 @@ static int hook_parse( xmlNodePtr base )
             new_id = hook_addEvent( parent, func, stack );
 
          /* Set the id. */
+         h = hook_get( new_id );
          if (id != 0) {
-            h = hook_get( new_id );
+            hook_hashRm( h );
             h->id = id;
+            hook_hashAdd( h );
          }
 
          /* Additional info. */
          if (is_date) {
             h->is_date = 1;
             h->res = res;
+            h->fire = hook_dateNow + res;
+            hook_schedule( h );
          }
       }
    } while (xml_nextNode(node));
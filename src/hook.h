@@ -64,6 +64,8 @@ void hook_rmMisnParent( unsigned int parent );
 void hook_rmEventParent( unsigned int parent );
 int hook_hasMisnParent( unsigned int parent );
 int hook_hasEventParent( unsigned int parent );
+void hooks_stats( void (*stat)( const char *stack, int n, void *data ), void *data );
+void hooks_printScheduled( void (*print)( const char *msg ), int max );
 
 /* pilot hook. */
 int pilot_runHookParam( Pilot* p, int hook_type, HookParam *param, int nparam );
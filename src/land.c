@@ -1088,10 +1088,17 @@ void land( Planet* p, int load )
    /* Stop player sounds. */
    player_soundStop();
 
+   /* Generating the windows runs a lot of Lua outside of the frame loop. */
+   nlua_gcAuto();
+
    /* Load stuff */
    land_planet = p;
    gfx_exterior = gl_newImage( p->gfx_exterior, 0 );
 
+   /* Read the shipyard graphics while the other windows are created. */
+   if (planet_hasService(land_planet, PLANET_SERVICE_SHIPYARD))
+      shipyard_prefetch();
+
    /* Generate the news. */
    if (planet_hasService(land_planet, PLANET_SERVICE_BAR))
       news_load();
@@ -1377,6 +1384,7 @@ static void land_stranded (void)
 
    if (rescue_env == LUA_NOREF) {
       rescue_env = nlua_newEnv(1);
+      nlua_setEnvName( rescue_env, "%s", file );
       nlua_loadStandard( rescue_env );
       nlua_loadTk( rescue_env );
 
@@ -407,7 +407,7 @@ void outfits_update( unsigned int wid, char* str )
    outfit = outfit_get( outfitname );
 
    /* new image */
-   window_modifyImage( wid, "imgOutfit", outfit->gfx_store, 0, 0 );
+   window_modifyImage( wid, "imgOutfit", outfit_gfxStore( outfit ), 0, 0 );
 
    if (outfit_canBuy(outfitname, land_planet) > 0)
       window_enableButton( wid, "btnBuyOutfit" );
@@ -550,7 +550,7 @@ int outfits_filter( Outfit **outfits, glTexture **toutfits, int n,
       /* Shift matches downward. */
       outfits[j] = outfits[i];
       if (toutfits != NULL)
-         toutfits[j] = outfits[i]->gfx_store;
+         toutfits[j] = outfit_gfxStore( outfits[i] );
 
       j++;
    }
@@ -44,6 +44,21 @@ static void shipyard_renderSlotsRow( double bx, double by, double bw, char *str,
 static void shipyard_find( unsigned int wid, char* str );
 
 
+/**
+ * @brief Starts reading the graphics of the ships for sale in the background.
+ */
+void shipyard_prefetch (void)
+{
+   int i, nships;
+   Ship **ships;
+
+   ships = tech_getShip( land_planet->tech, &nships );
+   for (i=0; i<nships; i++)
+      ship_gfxPrefetch( ships[i] );
+   free(ships);
+}
+
+
 /**
  * @brief Opens the shipyard window.
  */
@@ -157,7 +172,7 @@ void shipyard_open( unsigned int wid )
       tships = malloc(sizeof(glTexture*)*nships);
       for (i=0; i<nships; i++) {
          sships[i] = strdup(ships[i]->name);
-         tships[i] = ships[i]->gfx_store;
+         tships[i] = ship_gfxStore( ships[i] );
       }
       free(ships);
    }
@@ -224,7 +239,7 @@ void shipyard_update( unsigned int wid, char* str )
    shipyard_selected = ship;
 
    /* update image */
-   window_modifyImage( wid, "imgTarget", ship->gfx_store, 0, 0 );
+   window_modifyImage( wid, "imgTarget", ship_gfxStore( ship ), 0, 0 );
 
    /* update text */
    window_modifyText( wid, "txtStats", ship->desc_stats );
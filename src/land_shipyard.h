@@ -14,6 +14,7 @@
 /*
  * Window stuff.
  */
+void shipyard_prefetch (void);
 void shipyard_open( unsigned int wid );
 void shipyard_update( unsigned int wid, char* str );
 
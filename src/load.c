@@ -28,6 +28,7 @@
 #include "faction.h"
 #include "gui.h"
 #include "unidiff.h"
+#include "nlua.h"
 #include "nlua_var.h"
 #include "land.h"
 #include "hook.h"
@@ -548,6 +549,9 @@ int load_game( const char* file, int version_diff )
       return -1;
    }
 
+   /* Loading runs a lot of Lua outside of the frame loop. */
+   nlua_gcAuto();
+
    /* Load the XML. */
    doc   = xmlParseFile(file);
    if (doc == NULL)
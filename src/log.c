@@ -24,6 +24,8 @@
 #include <unistd.h> /* isatty */
 #endif
 
+#include "SDL_atomic.h"
+
 #include "console.h"
 
 
@@ -46,6 +48,8 @@ static char *errfiledouble = NULL;
 /* Whether to copy stdout and stderr to temporary buffers. */
 int copying = 0;
 
+static SDL_SpinLock log_lock = 0; /**< Serializes output from the loading threads. */
+
 
 /*
  * Prototypes
@@ -60,6 +64,7 @@ int logprintf( FILE *stream, int newline, const char *fmt, ... )
    va_list ap;
    char buf[2048];
    size_t n;
+   int ret;
 
    if (fmt == NULL)
       return 0;
@@ -72,6 +77,8 @@ int logprintf( FILE *stream, int newline, const char *fmt, ... )
 
    }
 
+   SDL_AtomicLock( &log_lock );
+
 #ifndef NOLOGPRINTFCONSOLE
    /* Add to console. */
    if (stream == stderr) {
@@ -96,7 +103,10 @@ int logprintf( FILE *stream, int newline, const char *fmt, ... )
       log_append(stream, &buf[2]);
 
    /* Also print to the stream. */
-   return fprintf( stream, "%s", &buf[2] );
+   ret = fprintf( stream, "%s", &buf[2] );
+
+   SDL_AtomicUnlock( &log_lock );
+   return ret;
 }
 
 
@@ -36,9 +36,6 @@
 #define BUTTON_HEIGHT   30 /**< Map button height. */
 
 
-#define MAP_LOOP_PROT   1000 /**< Number of iterations max in pathfinding before
-                                 aborting. */
-
 /* map decorator stack */
 static MapDecorator* decorator_stack = NULL; /**< Contains all the map decorators. */
 static int decorator_nstack       = 0; /**< Number of map decorators in the stack. */
@@ -84,6 +81,7 @@ static glTexture *gl_genFactionDisk( int radius );
 static int map_keyHandler( unsigned int wid, SDL_Keycode key, SDL_Keymod mod );
 static void map_buttonZoom( unsigned int wid, char* str );
 static void map_selectCur (void);
+static int map_decorator_parse( MapDecorator *temp, xmlNodePtr parent );
 
 
 /**
@@ -1499,298 +1497,12 @@ void map_select( StarSystem *sys, char shifted )
    gui_setNav();
 }
 
-/*
- * A* algorithm for shortest path finding
- *
- * Note since that we can't actually get an admissible heurestic for A* this is
- * in reality just Djikstras. I've removed the heurestic bit to make sure I
- * don't try to implement an admissible heuristic when I'm pretty sure there is
- * none.
- */
-/**
- * @brief Node structure for A* pathfinding.
- */
-typedef struct SysNode_ {
-   struct SysNode_ *next; /**< Next node */
-   struct SysNode_ *gnext; /**< Next node in the garbage collector. */
-
-   struct SysNode_ *parent; /**< Parent node. */
-   StarSystem* sys; /**< System in node. */
-   int g; /**< step */
-} SysNode; /**< System Node for use in A* pathfinding. */
-static SysNode *A_gc;
-/* prototypes */
-static SysNode* A_newNode( StarSystem* sys );
-static int A_g( SysNode* n );
-static SysNode* A_add( SysNode *first, SysNode *cur );
-static SysNode* A_rm( SysNode *first, StarSystem *cur );
-static SysNode* A_in( SysNode *first, StarSystem *cur );
-static SysNode* A_lowest( SysNode *first );
-static void A_freeList( SysNode *first );
-static int map_decorator_parse( MapDecorator *temp, xmlNodePtr parent );
-/** @brief Creates a new node link to star system. */
-static SysNode* A_newNode( StarSystem* sys )
-{
-   SysNode* n;
-
-   n        = malloc(sizeof(SysNode));
-
-   n->next  = NULL;
-   n->sys   = sys;
-
-   n->gnext = A_gc;
-   A_gc     = n;
-
-   return n;
-}
-/** @brief Gets the g from a node. */
-static int A_g( SysNode* n )
-{
-   return n->g;
-}
-/** @brief Adds a node to the linked list. */
-static SysNode* A_add( SysNode *first, SysNode *cur )
-{
-   SysNode *n;
-
-   if (first == NULL)
-      return cur;
-
-   n = first;
-   while (n->next != NULL)
-      n = n->next;
-   n->next = cur;
-
-   return first;
-}
-/* @brief Removes a node from a linked list. */
-static SysNode* A_rm( SysNode *first, StarSystem *cur )
-{
-   SysNode *n, *p;
-
-   if (first->sys == cur) {
-      n = first->next;
-      first->next = NULL;
-      return n;
-   }
-
-   p = first;
-   n = p->next;
-   do {
-      if (n->sys == cur) {
-         n->next = NULL;
-         p->next = n->next;
-         break;
-      }
-      p = n;
-   } while ((n=n->next) != NULL);
-
-   return first;
-}
-/** @brief Checks to see if node is in linked list. */
-static SysNode* A_in( SysNode *first, StarSystem *cur )
-{
-   SysNode *n;
-
-   if (first == NULL)
-      return NULL;
-
-   n = first;
-   do {
-      if (n->sys == cur)
-         return n;
-   } while ((n=n->next) != NULL);
-   return NULL;
-}
-/** @brief Returns the lowest ranking node from a linked list of nodes. */
-static SysNode* A_lowest( SysNode *first )
-{
-   SysNode *lowest, *n;
-
-   if (first == NULL)
-      return NULL;
-
-   n = first;
-   lowest = n;
-   do {
-      if (n->g < lowest->g)
-         lowest = n;
-   } while ((n=n->next) != NULL);
-   return lowest;
-}
-/** @brief Frees a linked list. */
-static void A_freeList( SysNode *first )
-{
-   SysNode *p, *n;
-
-   if (first == NULL)
-      return;
-
-   p = NULL;
-   n = first;
-   do {
-      if (p != NULL)
-         free(p);
-      p = n;
-   } while ((n=n->gnext) != NULL);
-   free(p);
-}
-
 /** @brief Sets map_zoom to zoom and recreates the faction disk texture. */
 void map_setZoom(double zoom)
 {
    map_zoom = zoom;
 }
 
-/**
- * @brief Gets the jump path between two systems.
- *
- *    @param[out] njumps Number of jumps in the path.
- *    @param sysstart Name of the system to start from.
- *    @param sysend Name of the system to end at.
- *    @param ignore_known Whether or not to ignore if systems are known.
- *    @param the old star system (if we're merely extending the list)
- *    @return NULL on failure, the list of njumps elements systems in the path.
- */
-StarSystem** map_getJumpPath( int* njumps, const char* sysstart,
-    const char* sysend, int ignore_known, int show_hidden,
-    StarSystem** old_data )
-{
-   int i, j, cost, ojumps;
-
-   StarSystem *sys, *ssys, *esys, **res;
-   JumpPoint *jp;
-
-   SysNode *cur,   *neighbour;
-   SysNode *open,  *closed;
-   SysNode *ocost, *ccost;
-
-   A_gc = NULL;
-
-   /* initial and target systems */
-   ssys = system_get(sysstart); /* start */
-   esys = system_get(sysend); /* goal */
-
-   /* Set up. */
-   ojumps = 0;
-   if ((old_data != NULL) && (*njumps>0)) {
-      ssys   = system_get( old_data[ (*njumps)-1 ]->name );
-      ojumps = *njumps;
-   }
-
-   /* Check self. */
-   if ((ssys == esys) || (ssys->njumps==0)) {
-      (*njumps) = 0;
-      if (old_data != NULL)
-         free( old_data );
-      return NULL;
-   }
-
-   /* system target must be known and reachable */
-   if (!ignore_known && !sys_isKnown(esys) && !space_sysReachable(esys)) {
-      /* can't reach - don't make path */
-      (*njumps) = 0;
-      if (old_data != NULL)
-         free( old_data );
-      return NULL;
-   }
-
-   /* start the linked lists */
-   open     = closed = NULL;
-   cur      = A_newNode( ssys );
-   cur->parent = NULL;
-   cur->g   = 0;
-   open     = A_add( open, cur ); /* Initial open node is the start system */
-
-   j = 0;
-   while ((cur = A_lowest(open))) {
-      /* End condition. */
-      if (cur->sys == esys)
-         break;
-
-      /* Break if infinite loop. */
-      j++;
-      if (j > MAP_LOOP_PROT)
-         break;
-
-      /* Get best from open and toss to closed */
-      open   = A_rm( open, cur->sys );
-      closed = A_add( closed, cur );
-      cost   = A_g(cur) + 1; /* Base unit is jump and always increases by 1. */
-
-      for (i=0; i<cur->sys->njumps; i++) {
-         jp  = &cur->sys->jumps[i];
-         sys = jp->target;
-
-         /* Make sure it's reachable */
-         if (!ignore_known) {
-            if (!jp_isKnown(jp))
-               continue;
-            if (!sys_isKnown(sys) && !space_sysReachable(sys))
-               continue;
-         }
-         if (jp_isFlag( jp, JP_EXITONLY ))
-            continue;
-
-         /* Skip hidden jumps if they're unknown and not specifically requested */
-         if (!show_hidden && jp_isFlag( jp, JP_HIDDEN ) && !jp_isKnown(jp))
-            continue;
-
-         /* Check to see if it's already in the closed set. */
-         ccost = A_in(closed, sys);
-         if ((ccost != NULL) && (cost >= A_g(ccost)))
-            continue;
-            //closed = A_rm( closed, sys );
-
-         /* Remove if it exists and current is better. */
-         ocost = A_in(open, sys);
-         if (ocost != NULL) {
-            if (cost < A_g(ocost))
-               open = A_rm( open, sys ); /* New path is better */
-            else
-               continue; /* This node is worse, so ignore it. */
-         }
-
-         /* Create the node. */
-         neighbour         = A_newNode( sys );
-         neighbour->parent = cur;
-         neighbour->g      = cost;
-         open              = A_add( open, neighbour );
-      }
-
-      /* Sanity check in case not linked. */
-      if (open == NULL)
-         break;
-   }
-
-   /* Build path backwards if not broken from loop. */
-   if (esys == cur->sys) {
-      (*njumps) = A_g(cur);
-      if (old_data == NULL)
-         res      = malloc( sizeof(StarSystem*) * (*njumps) );
-      else {
-         *njumps  = *njumps + ojumps;
-         res      = realloc( old_data, sizeof(StarSystem*) * (*njumps) );
-      }
-      /* Build path. */
-      for (i=0; i<((*njumps)-ojumps); i++) {
-         res[(*njumps)-i-1] = cur->sys;
-         cur                = cur->parent;
-      }
-   }
-   else {
-      (*njumps) = 0;
-      res = NULL;
-      if (old_data != NULL)
-         free( old_data );
-   }
-
-   /* free the linked lists */
-   A_freeList(A_gc);
-   return res;
-}
-
-
 /**
  * @brief Marks maps around a radius of currently system as known.
  *
@@ -1976,6 +1688,8 @@ int map_center( const char *sys )
  */
 int map_load (void)
 {
+   int i;
+   glTexture *pict;
    size_t bufsize;
    char *buf;
    xmlNodePtr node;
@@ -2024,6 +1738,17 @@ int map_load (void)
    xmlFreeDoc(doc);
    free(buf);
 
+   /* Upload the graphics. */
+   gl_texFlush();
+   for (i=0; i<decorator_nstack; i++) {
+      pict = decorator_stack[i].picture;
+      if ((pict == NULL) || (gl_texFinish( pict ) == 0))
+         continue; /* Loaded or already warned about. */
+      WARN("Could not load map decorator texture '%s'.", pict->name);
+      gl_freeTexture( pict );
+      decorator_stack[i].picture = NULL;
+   }
+
    DEBUG("Loaded %d map decorators.", decorator_nstack);
 
    return 0;
@@ -713,7 +713,7 @@ static void map_showOutfitDetail(unsigned int wid, char* wgtname, int x, int y,
 
    outfit = outfit_get( toolkit_getList(wid, wgtname) );
    window_modifyText( wid, "txtOutfitName", outfit->name );
-   window_modifyImage( wid, "imgOutfit", outfit->gfx_store, 0, 0 );
+   window_modifyImage( wid, "imgOutfit", outfit_gfxStore( outfit ), 0, 0 );
 
    mass = outfit->mass;
    if ((outfit_isLauncher(outfit) || outfit_isFighterBay(outfit)) &&
@@ -58,6 +58,31 @@ static MissionData *mission_stack = NULL; /**< Unmutable after creation */
 static int mission_nstack = 0; /**< Missions in stack. */
 
 
+/**
+ * @brief Missions restricted to a planet or system name.
+ */
+typedef struct MissionIndexKey_ {
+   const char *name; /**< Planet or system name. */
+   int *misn; /**< Missions restricted to it (array.h). */
+} MissionIndexKey;
+
+
+/**
+ * @brief Missions available at a location, by their most selective restriction.
+ *
+ * Every mission is only in one of the lists, the rest of the requirements
+ *  are still checked by mission_meetReq().
+ */
+typedef struct MissionIndex_ {
+   MissionIndexKey *planets; /**< By planet, sorted by name (array.h). */
+   MissionIndexKey *systems; /**< By system, sorted by name (array.h). */
+   int **factions; /**< By faction ID, NULL if none (array.h of array.h). */
+   int *anyfaction; /**< All the ones in factions (array.h). */
+   int *generic; /**< Ones without restrictions (array.h). */
+} MissionIndex;
+static MissionIndex mission_index[MIS_AVAIL_SPACE+1]; /**< Indexes by location. */
+
+
 /*
  * prototypes
  */
@@ -71,6 +96,15 @@ static int mission_compare( const void* arg1, const void* arg2 );
 static int mission_meetReq( int mission, int faction,
       const char* planet, const char* sysname );
 static int mission_matchFaction( MissionData* misn, int faction );
+/* Index. */
+static int mission_indexCmp( const void *p1, const void *p2 );
+static void mission_indexAddKey( MissionIndexKey **keys, const char *name, int mission );
+static void mission_indexBuild (void);
+static void mission_indexFree (void);
+static void mission_indexAppend( int **out, int *misn );
+static int mission_intCmp( const void *p1, const void *p2 );
+static int* mission_candidates( int loc, int faction,
+      const char* planet, const char* sysname );
 static int mission_location( const char* loc );
 /* Loading. */
 static int mission_parse( MissionData* temp, const xmlNodePtr parent );
@@ -157,8 +191,6 @@ MissionData* mission_getFromName( const char* name )
  */
 static int mission_init( Mission* mission, MissionData* misn, int genid, int create, unsigned int *id )
 {
-   char *buf;
-   size_t bufsize;
    int ret;
 
    /* clear the mission */
@@ -176,24 +208,18 @@ static int mission_init( Mission* mission, MissionData* misn, int genid, int cre
 
    /* init Lua */
    mission->env = nlua_newEnv(1);
+   nlua_setEnvName( mission->env, "misn:%s", misn->name );
 
    misn_loadLibs( mission->env ); /* load our custom libraries */
 
-   /* load the file */
-   buf = ndata_read( misn->lua, &bufsize );
-   if (buf == NULL) {
-      WARN(_("Mission '%s' Lua script not found."), misn->lua );
-      return -1;
-   }
-   if (nlua_dobufenv(mission->env, buf, bufsize, misn->lua) != 0) {
+   /* load the file, it's only compiled the first time */
+   if (nlua_dochunkenv(mission->env, &misn->chunk, misn->lua) != 0) {
       WARN(_("Error loading mission file: %s\n"
           "%s\n"
           "Most likely Lua file has improper syntax, please check"),
             misn->lua, lua_tostring(naevL, -1));
-      free(buf);
       return -1;
    }
-   free(buf);
 
    /* run create function */
    if (create) {
@@ -277,7 +303,12 @@ static int mission_meetReq( int mission, int faction,
           mission_alreadyRunning(misn)))
       return 0;
 
-   /* Must meet Lua condition. */
+   /* Must meet previous mission requirements. */
+   if ((misn->avail.done != NULL) &&
+         (player_missionAlreadyDone( misn->avail.doneid ) == 0))
+      return 0;
+
+   /* Must meet Lua condition, last as it's the expensive one. */
    if (misn->avail.cond != NULL) {
       c = cond_check(misn->avail.cond);
       if (c < 0) {
@@ -288,15 +319,217 @@ static int mission_meetReq( int mission, int faction,
          return 0;
    }
 
-   /* Must meet previous mission requirements. */
-   if ((misn->avail.done != NULL) &&
-         (player_missionAlreadyDone( mission_getID(misn->avail.done) ) == 0))
-      return 0;
-
   return 1;
 }
 
 
+/**
+ * @brief Compares two index keys by name.
+ */
+static int mission_indexCmp( const void *p1, const void *p2 )
+{
+   const MissionIndexKey *k1, *k2;
+   k1 = (const MissionIndexKey*) p1;
+   k2 = (const MissionIndexKey*) p2;
+   return strcmp( k1->name, k2->name );
+}
+
+
+/**
+ * @brief Adds a mission to the key with a name, creating it if needed.
+ *
+ * Keys are sorted once all the missions are added.
+ */
+static void mission_indexAddKey( MissionIndexKey **keys, const char *name, int mission )
+{
+   int i;
+   MissionIndexKey *k;
+
+   if (*keys == NULL)
+      *keys = array_create( MissionIndexKey );
+
+   k = NULL;
+   for (i=0; i<array_size(*keys); i++) {
+      if (strcmp( (*keys)[i].name, name )==0) {
+         k = &(*keys)[i];
+         break;
+      }
+   }
+   if (k == NULL) {
+      k = &array_grow( keys );
+      k->name  = name;
+      k->misn  = array_create( int );
+   }
+   array_push_back( &k->misn, mission );
+}
+
+
+/**
+ * @brief Builds the availability indexes once all the missions are loaded.
+ */
+static void mission_indexBuild (void)
+{
+   int i, j, f;
+   MissionData *misn;
+   MissionIndex *idx;
+
+   mission_indexFree();
+
+   for (i=0; i<mission_nstack; i++) {
+      misn = &mission_stack[i];
+
+      /* Resolve the required mission. */
+      misn->avail.doneid = (misn->avail.done != NULL) ?
+            mission_getID( misn->avail.done ) : -1;
+
+      if ((misn->avail.loc < 0) || (misn->avail.loc > MIS_AVAIL_SPACE))
+         continue;
+      idx = &mission_index[ misn->avail.loc ];
+
+      if (misn->avail.planet != NULL)
+         mission_indexAddKey( &idx->planets, misn->avail.planet, i );
+      else if (misn->avail.system != NULL)
+         mission_indexAddKey( &idx->systems, misn->avail.system, i );
+      else if (misn->avail.nfactions > 0) {
+         if (idx->factions == NULL)
+            idx->factions = array_create( int* );
+         for (j=0; j<misn->avail.nfactions; j++) {
+            f = misn->avail.factions[j];
+            if (f < 0)
+               continue;
+            while (array_size(idx->factions) <= f)
+               array_push_back( &idx->factions, NULL );
+            if (idx->factions[f] == NULL)
+               idx->factions[f] = array_create( int );
+            array_push_back( &idx->factions[f], i );
+         }
+         if (idx->anyfaction == NULL)
+            idx->anyfaction = array_create( int );
+         array_push_back( &idx->anyfaction, i );
+      }
+      else {
+         if (idx->generic == NULL)
+            idx->generic = array_create( int );
+         array_push_back( &idx->generic, i );
+      }
+   }
+
+   /* Sort the names for lookup. */
+   for (i=0; i<=MIS_AVAIL_SPACE; i++) {
+      idx = &mission_index[i];
+      if (idx->planets != NULL)
+         qsort( idx->planets, array_size(idx->planets), sizeof(MissionIndexKey), mission_indexCmp );
+      if (idx->systems != NULL)
+         qsort( idx->systems, array_size(idx->systems), sizeof(MissionIndexKey), mission_indexCmp );
+   }
+}
+
+
+/**
+ * @brief Frees the availability indexes.
+ */
+static void mission_indexFree (void)
+{
+   int i, j;
+   MissionIndex *idx;
+
+   for (i=0; i<=MIS_AVAIL_SPACE; i++) {
+      idx = &mission_index[i];
+      if (idx->planets != NULL) {
+         for (j=0; j<array_size(idx->planets); j++)
+            array_free( idx->planets[j].misn );
+         array_free( idx->planets );
+      }
+      if (idx->systems != NULL) {
+         for (j=0; j<array_size(idx->systems); j++)
+            array_free( idx->systems[j].misn );
+         array_free( idx->systems );
+      }
+      if (idx->factions != NULL) {
+         for (j=0; j<array_size(idx->factions); j++)
+            if (idx->factions[j] != NULL)
+               array_free( idx->factions[j] );
+         array_free( idx->factions );
+      }
+      if (idx->anyfaction != NULL)
+         array_free( idx->anyfaction );
+      if (idx->generic != NULL)
+         array_free( idx->generic );
+   }
+   memset( mission_index, 0, sizeof(mission_index) );
+}
+
+
+/**
+ * @brief Appends a list of missions to another.
+ */
+static void mission_indexAppend( int **out, int *misn )
+{
+   int i;
+   if (misn == NULL)
+      return;
+   for (i=0; i<array_size(misn); i++)
+      array_push_back( out, misn[i] );
+}
+
+
+/**
+ * @brief Compares two mission IDs.
+ */
+static int mission_intCmp( const void *p1, const void *p2 )
+{
+   return *(const int*)p1 - *(const int*)p2;
+}
+
+
+/**
+ * @brief Gets the missions that can be available somewhere.
+ *
+ *    @param loc Location to match.
+ *    @param faction Faction of the planet, -1 to not filter by faction.
+ *    @param planet Name of the current planet.
+ *    @param sysname Name of the current system.
+ *    @return The candidates in mission stack order (array.h), to be checked
+ *            with mission_meetReq().
+ */
+static int* mission_candidates( int loc, int faction,
+      const char* planet, const char* sysname )
+{
+   int *out;
+   MissionIndex *idx;
+   MissionIndexKey key, *k;
+
+   out = array_create( int );
+   if ((loc < 0) || (loc > MIS_AVAIL_SPACE))
+      return out;
+   idx = &mission_index[loc];
+
+   if ((planet != NULL) && (idx->planets != NULL)) {
+      key.name = planet;
+      k = bsearch( &key, idx->planets, array_size(idx->planets),
+            sizeof(MissionIndexKey), mission_indexCmp );
+      if (k != NULL)
+         mission_indexAppend( &out, k->misn );
+   }
+   if ((sysname != NULL) && (idx->systems != NULL)) {
+      key.name = sysname;
+      k = bsearch( &key, idx->systems, array_size(idx->systems),
+            sizeof(MissionIndexKey), mission_indexCmp );
+      if (k != NULL)
+         mission_indexAppend( &out, k->misn );
+   }
+   if (faction < 0)
+      mission_indexAppend( &out, idx->anyfaction );
+   else if ((idx->factions != NULL) && (faction < array_size(idx->factions)))
+      mission_indexAppend( &out, idx->factions[faction] );
+   mission_indexAppend( &out, idx->generic );
+
+   /* Keep the order they were defined in. */
+   qsort( out, array_size(out), sizeof(int), mission_intCmp );
+   return out;
+}
+
+
 /**
  * @brief Runs missions matching location, all Lua side and one-shot.
  *
@@ -309,15 +542,14 @@ void missions_run( int loc, int faction, const char* planet, const char* sysname
 {
    MissionData* misn;
    Mission mission;
-   int i;
+   int i, *cand;
    double chance;
 
-   for (i=0; i<mission_nstack; i++) {
-      misn = &mission_stack[i];
-      if (misn->avail.loc != loc)
-         continue;
+   cand = mission_candidates( loc, faction, planet, sysname );
+   for (i=0; i<array_size(cand); i++) {
+      misn = &mission_stack[ cand[i] ];
 
-      if (!mission_meetReq(i, faction, planet, sysname))
+      if (!mission_meetReq(cand[i], faction, planet, sysname))
          continue;
 
       chance = (double)(misn->avail.chance % 100)/100.;
@@ -329,6 +561,7 @@ void missions_run( int loc, int faction, const char* planet, const char* sysname
          mission_cleanup(&mission); /* it better clean up for itself or we do it */
       }
    }
+   array_free( cand );
 }
 
 
@@ -595,6 +828,7 @@ static void mission_freeData( MissionData* mission )
       free(mission->name);
    if (mission->lua)
       free(mission->lua);
+   nlua_freeChunk( &mission->chunk );
    if (mission->avail.planet)
       free(mission->avail.planet);
    if (mission->avail.system)
@@ -694,7 +928,7 @@ static int mission_compare( const void* arg1, const void* arg2 )
 Mission* missions_genList( int *n, int faction,
       const char* planet, const char* sysname, int loc )
 {
-   int i,j, m, alloced;
+   int i,j, m, alloced, *cand;
    double chance;
    int rep;
    Mission* tmp;
@@ -710,37 +944,37 @@ Mission* missions_genList( int *n, int faction,
    tmp      = NULL;
    m        = 0;
    alloced  = 0;
-   for (i=0; i<mission_nstack; i++) {
-      misn = &mission_stack[i];
-      if (misn->avail.loc == loc) {
+   cand     = mission_candidates( loc, faction, planet, sysname );
+   for (i=0; i<array_size(cand); i++) {
+      misn = &mission_stack[ cand[i] ];
 
-         /* Must meet requirements. */
-         if (!mission_meetReq(i, faction, planet, sysname))
-            continue;
+      /* Must meet requirements. */
+      if (!mission_meetReq(cand[i], faction, planet, sysname))
+         continue;
 
-         /* Must hit chance. */
-         chance = (double)(misn->avail.chance % 100)/100.;
-         if (chance == 0.) /* We want to consider 100 -> 100% not 0% */
-            chance = 1.;
-         rep = MAX(1, misn->avail.chance / 100);
-
-         for (j=0; j<rep; j++) /* random chance of rep appearances */
-            if (RNGF() < chance) {
-               m++;
-               /* Extra allocation. */
-               if (m > alloced) {
-                  if (alloced == 0)
-                     alloced = 32;
-                  else
-                     alloced *= 2;
-                  tmp      = realloc( tmp, sizeof(Mission) * alloced );
-               }
-               /* Initialize the mission. */
-               if (mission_init( &tmp[m-1], misn, 1, 1, NULL ))
-                  m--;
+      /* Must hit chance. */
+      chance = (double)(misn->avail.chance % 100)/100.;
+      if (chance == 0.) /* We want to consider 100 -> 100% not 0% */
+         chance = 1.;
+      rep = MAX(1, misn->avail.chance / 100);
+
+      for (j=0; j<rep; j++) /* random chance of rep appearances */
+         if (RNGF() < chance) {
+            m++;
+            /* Extra allocation. */
+            if (m > alloced) {
+               if (alloced == 0)
+                  alloced = 32;
+               else
+                  alloced *= 2;
+               tmp      = realloc( tmp, sizeof(Mission) * alloced );
             }
-      }
+            /* Initialize the mission. */
+            if (mission_init( &tmp[m-1], misn, 1, 1, NULL ))
+               m--;
+         }
    }
+   array_free( cand );
 
    /* Sort. */
    if (tmp != NULL) {
@@ -794,6 +1028,7 @@ static int mission_parse( MissionData* temp, const xmlNodePtr parent )
 
    /* Clear memory. */
    memset( temp, 0, sizeof(MissionData) );
+   temp->chunk = LUA_NOREF;
 
    /* Defaults. */
    temp->avail.priority = 5;
@@ -934,6 +1169,9 @@ int missions_load (void)
    /* Shrink to minimum. */
    mission_stack = realloc(mission_stack, sizeof(MissionData)*mission_nstack);
 
+   /* Index them by where they can be available. */
+   mission_indexBuild();
+
    /* Clean up. */
    xmlFreeDoc(doc);
    free(buf);
@@ -955,6 +1193,7 @@ void missions_free (void)
    missions_cleanup();
 
    /* Free the mission data. */
+   mission_indexFree();
    for (i=0; i<mission_nstack; i++)
       mission_freeData( &mission_stack[i] );
    free( mission_stack );
@@ -61,6 +61,7 @@ typedef struct MissionAvail_s {
 
    char* cond; /**< Condition that must be met (Lua). */
    char* done; /**< Previous mission that must have been done. */
+   int doneid; /**< ID of done, resolved once all missions are loaded. */
 
    int priority; /**< Mission priority: 0 = main plot, 5 = default, 10 = insignificant. */
 } MissionAvail_t;
@@ -78,6 +79,7 @@ typedef struct MissionData_ {
 
    unsigned int flags; /**< Flags to store binary properties */
    char* lua; /**< Lua file to use. */
+   int chunk; /**< Compiled Lua file, LUA_NOREF until first used. */
 } MissionData;
 
 
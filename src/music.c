@@ -532,6 +532,7 @@ static int music_luaInit (void)
       music_luaQuit();
 
    music_env = nlua_newEnv(1);
+   nlua_setEnvName( music_env, "%s", MUSIC_LUA_PATH );
    nlua_loadStandard(music_env);
    nlua_loadMusic(music_env); /* write it */
 
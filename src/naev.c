@@ -100,6 +100,11 @@
 #include "options.h"
 #include "dialogue.h"
 #include "slots.h"
+#include "nmem.h"
+#include "nlua.h"
+#include "nlua_prof.h"
+#include "colcache.h"
+#include "nstats.h"
 
 
 #define CONF_FILE       "conf.lua" /**< Configuration file by default. */
@@ -140,6 +145,7 @@ static asymbol **syms = NULL;
 static void print_SDLversion (void);
 static void loadscreen_load (void);
 static void loadscreen_unload (void);
+static int load_thread( void *data );
 static void load_all (void);
 static void unload_all (void);
 static void display_fps( const double dt );
@@ -230,6 +236,9 @@ int main( int argc, char** argv )
    gl_screen.desktop_w = current.w;
    gl_screen.desktop_h = current.h;
 
+   /* Memory accounting must be set up before libxml2 and Lua allocate. */
+   nmem_init();
+
    /* We'll be parsing XML. */
    LIBXML_TEST_VERSION
    xmlInitParser();
@@ -281,6 +290,14 @@ int main( int argc, char** argv )
    else
       log_purge();
 
+   /* Profile all the Lua from the start. */
+   if (conf.lua_profile != NULL)
+      nlua_profStart( NLUA_PROF_INTERVAL );
+
+   /* Export statistics for soak runs. */
+   if (conf.stats != NULL)
+      nstats_init( conf.stats );
+
    /* Enable FPU exceptions. */
 #if defined(HAVE_FEENABLEEXCEPT) && defined(DEBUGGING)
    if (conf.fpu_except)
@@ -491,6 +508,15 @@ int main( int argc, char** argv )
    /* Save configuration. */
    conf_saveConfig(buf);
 
+   /* Report memory usage while everything is still loaded. */
+   if (conf.mem_report != NULL)
+      nmem_report( conf.mem_report );
+   if (conf.lua_profile != NULL) {
+      nlua_profStop();
+      nlua_profReport( conf.lua_profile );
+   }
+   nstats_exit();
+
    /* data unloading */
    unload_all();
 
@@ -529,6 +555,9 @@ int main( int argc, char** argv )
    /* Clean up parser. */
    xmlCleanupParser();
 
+   /* Clean up memory accounting. */
+   nmem_exit();
+
    /* Clean up signal handler. */
    debug_sigClose();
 
@@ -663,45 +692,173 @@ static void loadscreen_unload (void)
 }
 
 
+/*
+ * Data loading stages, run as a dependency graph.
+ */
+enum {
+   LOAD_COMMODITY,
+   LOAD_FACTION,
+   LOAD_AI,
+   LOAD_MISSION,
+   LOAD_EVENT,
+   LOAD_SPFX,
+   LOAD_DTYPE,
+   LOAD_OUTFIT,
+   LOAD_SHIP,
+   LOAD_FLEET,
+   LOAD_TECH,
+   LOAD_SPACE,
+   LOAD_NSTAGES
+};
+#define LOAD_DEP(s)     (1U<<(s)) /**< Dependency bit of a stage. */
+#define LOAD_ALL        ((1U<<LOAD_NSTAGES)-1) /**< All stages done. */
+#ifdef DEBUGGING
+#define LOAD_LUACHECK   1 /**< Missions and events check Lua syntax on naevL while parsing. */
+#else /* DEBUGGING */
+#define LOAD_LUACHECK   0 /**< Missions and events only parse XML. */
+#endif /* DEBUGGING */
+/**
+ * @brief A data loading stage.
+ */
+typedef struct LoadStage_ {
+   int (*load)(void); /**< Loading function. */
+   const char *msg; /**< Loading screen message, untranslated. */
+   unsigned int deps; /**< Stages that must be done first. */
+   int main; /**< Uses OpenGL or naevL so must run on the main thread. */
+} LoadStage;
+static const LoadStage load_stages[LOAD_NSTAGES] = {
+   [LOAD_COMMODITY] = { commodity_load, gettext_noop("Loading Commodities..."), 0, 1 },
+   [LOAD_FACTION] = { factions_load, gettext_noop("Loading Factions..."), 0, 1 },
+   [LOAD_AI] = { ai_load, gettext_noop("Loading AI..."), LOAD_DEP(LOAD_FACTION), 1 },
+   [LOAD_MISSION] = { missions_load, gettext_noop("Loading Missions..."),
+         LOAD_DEP(LOAD_FACTION), LOAD_LUACHECK },
+   [LOAD_EVENT] = { events_load, gettext_noop("Loading Events..."), 0, LOAD_LUACHECK },
+   [LOAD_SPFX] = { spfx_load, gettext_noop("Loading Special Effects..."), 0, 1 },
+   [LOAD_DTYPE] = { dtype_load, gettext_noop("Loading Damage Types..."), 0, 0 },
+   [LOAD_OUTFIT] = { outfit_load, gettext_noop("Loading Outfits..."),
+         LOAD_DEP(LOAD_SPFX) | LOAD_DEP(LOAD_DTYPE), 1 },
+   [LOAD_SHIP] = { ships_load, gettext_noop("Loading Ships..."), LOAD_DEP(LOAD_OUTFIT), 1 },
+   [LOAD_FLEET] = { fleet_load, gettext_noop("Loading Fleets..."),
+         LOAD_DEP(LOAD_FACTION) | LOAD_DEP(LOAD_AI) | LOAD_DEP(LOAD_SHIP), 0 },
+   [LOAD_TECH] = { tech_load, gettext_noop("Loading Techs..."),
+         LOAD_DEP(LOAD_COMMODITY) | LOAD_DEP(LOAD_OUTFIT) | LOAD_DEP(LOAD_SHIP), 0 },
+   [LOAD_SPACE] = { space_load, gettext_noop("Loading the Universe..."),
+         LOAD_DEP(LOAD_COMMODITY) | LOAD_DEP(LOAD_FACTION) |
+         LOAD_DEP(LOAD_FLEET) | LOAD_DEP(LOAD_TECH), 1 },
+};
+static SDL_mutex *load_lock      = NULL; /**< Protects load_done. */
+static SDL_cond *load_cond       = NULL; /**< Signalled when a threaded stage finishes. */
+static unsigned int load_done    = 0; /**< Stages that are done. */
+
+
+/**
+ * @brief Runs a loading stage on the threadpool.
+ *
+ *    @param data Stage to run.
+ *    @return 0 on success.
+ */
+static int load_thread( void *data )
+{
+   const LoadStage *stage = data;
+
+   stage->load();
+
+   SDL_mutexP( load_lock );
+   load_done |= LOAD_DEP( stage - load_stages );
+   SDL_CondSignal( load_cond );
+   SDL_mutexV( load_lock );
+   return 0;
+}
+
+
 /**
  * @brief Loads all the data, makes main() simpler.
+ *
+ * Stages that only read files and parse XML are handed to the threadpool as
+ * soon as their dependencies are done, while the main thread runs the ones
+ * that upload textures or touch naevL.
  */
-#define LOADING_STAGES     12. /**< Amount of loading stages. */
+#define LOADING_STAGES     (LOAD_NSTAGES+1.) /**< Amount of loading stages. */
 void load_all (void)
 {
+   int i, run, ndone;
+   unsigned int started, done;
+   const char *msg;
+
+   /* Lua collects on its own until the frame loop takes over. */
+   nlua_gcAuto();
+
    /* We can do fast stuff here. */
    sp_load();
 
-   /* order is very important as they're interdependent */
-   loadscreen_render( 1./LOADING_STAGES, _("Loading Commodities...") );
-   commodity_load(); /* dep for space */
-   loadscreen_render( 2./LOADING_STAGES, _("Loading Factions...") );
-   factions_load(); /* dep for fleet, space, missions, AI */
-   loadscreen_render( 3./LOADING_STAGES, _("Loading AI...") );
-   ai_load(); /* dep for fleets */
-   loadscreen_render( 4./LOADING_STAGES, _("Loading Missions...") );
-   missions_load(); /* no dep */
-   loadscreen_render( 5./LOADING_STAGES, _("Loading Events...") );
-   events_load(); /* no dep */
-   loadscreen_render( 6./LOADING_STAGES, _("Loading Special Effects...") );
-   spfx_load(); /* no dep */
-   loadscreen_render( 6./LOADING_STAGES, _("Loading Damage Types...") );
-   dtype_load(); /* no dep */
-   loadscreen_render( 7./LOADING_STAGES, _("Loading Outfits...") );
-   outfit_load(); /* dep for ships */
-   loadscreen_render( 8./LOADING_STAGES, _("Loading Ships...") );
-   ships_load(); /* dep for fleet */
-   loadscreen_render( 9./LOADING_STAGES, _("Loading Fleets...") );
-   fleet_load(); /* dep for space */
-   loadscreen_render( 10./LOADING_STAGES, _("Loading Techs...") );
-   tech_load(); /* dep for space */
-   loadscreen_render( 11./LOADING_STAGES, _("Loading the Universe...") );
-   space_load();
-   loadscreen_render( 12./LOADING_STAGES, _("Populating Maps...") );
+   /* Read ahead what the universe and Lua includes will need, in order. */
+   ndata_prefetch( PLANET_DATA_PATH );
+   ndata_prefetch( SYSTEM_DATA_PATH );
+   ndata_prefetch( LUA_INCLUDE_PATH );
+
+   load_lock   = SDL_CreateMutex();
+   load_cond   = SDL_CreateCond();
+   load_done   = 0;
+   started     = 0;
+   done        = 0;
+   msg         = load_stages[0].msg;
+   while (done != LOAD_ALL) {
+      /* Start everything that is ready, keeping one main thread stage. */
+      run = -1;
+      for (i=0; i<LOAD_NSTAGES; i++) {
+         if ((started & LOAD_DEP(i)) || ((load_stages[i].deps & done) != load_stages[i].deps))
+            continue;
+         if (load_stages[i].main) {
+            if (run < 0)
+               run = i;
+            continue;
+         }
+         started |= LOAD_DEP(i);
+         threadpool_newJob( load_thread, (void*)&load_stages[i] );
+      }
+
+      /* Update progress. */
+      ndone = 0;
+      for (i=0; i<LOAD_NSTAGES; i++)
+         if (done & LOAD_DEP(i))
+            ndone++;
+      for (i=0; i<LOAD_NSTAGES; i++) {
+         if ((started & LOAD_DEP(i)) && !(done & LOAD_DEP(i))) {
+            msg = load_stages[i].msg;
+            break;
+         }
+      }
+      if (run >= 0)
+         msg = load_stages[run].msg;
+      loadscreen_render( (ndone+1.)/LOADING_STAGES, _(msg) );
+
+      if (run >= 0) {
+         /* Run a main thread stage while the threadpool works. */
+         started |= LOAD_DEP(run);
+         load_stages[run].load();
+         SDL_mutexP( load_lock );
+         load_done |= LOAD_DEP(run);
+      }
+      else {
+         /* Nothing to do but wait for the threadpool. */
+         SDL_mutexP( load_lock );
+         while (load_done == done)
+            SDL_CondWait( load_cond, load_lock );
+      }
+      done = load_done;
+      SDL_mutexV( load_lock );
+   }
+   SDL_DestroyCond( load_cond );
+   SDL_DestroyMutex( load_lock );
+   load_cond   = NULL;
+   load_lock   = NULL;
+
+   loadscreen_render( LOAD_NSTAGES/LOADING_STAGES, _("Populating Maps...") );
    outfit_mapParse();
    background_init();
    map_load();
    player_init(); /* Initialize player stuff. */
+   colcache_save(); /* Write the collision maps generated while loading. */
    loadscreen_render( 1., _("Loading Completed!") );
 }
 /**
@@ -741,10 +898,13 @@ void unload_all (void)
  */
 void main_loop( int update )
 {
+   Uint64 t0;
+
    /*
     * Control FPS.
     */
    fps_control(); /* everyone loves fps control */
+   t0 = SDL_GetPerformanceCounter();
 
    /*
     * Handle update.
@@ -771,6 +931,15 @@ void main_loop( int update )
    gl_checkErr(); /* check error every loop */
    /* Draw buffer. */
    SDL_GL_SwapWindow( gl_screen.window );
+
+   /*
+    * Collect Lua garbage while the frame is presented.
+    */
+   nlua_gcStep( real_dt );
+
+   /* Statistics. */
+   nstats_frame( 1000. * (double)(SDL_GetPerformanceCounter() - t0) /
+         (double)SDL_GetPerformanceFrequency(), real_dt );
 }
 
 
@@ -1080,6 +1249,7 @@ static double fps_cur = 0.; /**< FPS accumulator to trigger change. */
 static void display_fps( const double dt )
 {
    double x,y;
+   double gc_ms, gc_max;
    double dt_mod_base = 1.;
 
    fps_dt  += dt;
@@ -1094,6 +1264,9 @@ static void display_fps( const double dt )
    if (conf.fps_show) {
       gl_print( NULL, x, y, NULL, "%3.2f", fps );
       y -= gl_defFont.h + 5.;
+      gc_ms = nlua_gcTime( &gc_max );
+      gl_print( NULL, x, y, NULL, _("GC %.2f ms (%.2f max)"), gc_ms, gc_max );
+      y -= gl_defFont.h + 5.;
    }
 
    if ((player.p != NULL) && !player_isFlag(PLAYER_DESTROYED) &&
@@ -15,12 +15,18 @@
  * -- DONE AT INIT --
  *  1) CLI option
  *  2) conf.lua option
- * -- DONE AS NEEDED --
- *  3) Current dir laid out (does not work well when iterating through directories)
- *  4) ndata-$VERSION
- *  5) Makefile version
- *  6) ./ndata*
- *  7) dirname(argv[0])/ndata* (binary path)
+ *  3) Current dir laid out
+ *  4) Laid out in the CLI or conf.lua directory
+ *  5) Laid out next to NDATA_DEF
+ *  6) Laid out next to the binary
+ *  7) ndata-$VERSION
+ *  8) Makefile version
+ *  9) ./ndata*
+ * 10) dirname(argv[0])/ndata* (binary path)
+ *
+ * Once the source is found, every file it provides is put in an index that
+ *  maps the logical path to the file, so looking up, reading and listing
+ *  files never has to probe the file system or the archive again.
  */
 
 #include "ndata.h"
@@ -29,6 +35,10 @@
 
 #if HAS_POSIX
 #include <libgen.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif /* HAS_POSIX */
 #if HAS_WIN32
 #include <windows.h>
@@ -42,6 +52,7 @@
 #include "SDL_mutex.h"
 
 #include "log.h"
+#include "array.h"
 #include "nxml.h"
 #include "nzip.h"
 #include "nfile.h"
@@ -49,6 +60,7 @@
 #include "npng.h"
 #include "nstring.h"
 #include "start.h"
+#include "threadpool.h"
 
 
 #define NDATA_FILENAME  "ndata" /**< Generic ndata file name. */
@@ -57,10 +69,18 @@
 #endif /* NDATA_DEF */
 
 
-#define NDATA_SRC_LAIDOUT        0
-#define NDATA_SRC_DIRNAME        1
-#define NDATA_SRC_NDATADEF       2
-#define NDATA_SRC_BINARY         3
+#define NDATA_INDEX_MIN          1024 /**< Minimum amount of buckets in the index. */
+#define NDATA_MMAP_MIN           (256*1024) /**< Loose files at least this big are mapped instead of read. */
+
+
+/**
+ * @brief A file in the index.
+ */
+typedef struct NdataEntry_ {
+   char *path;       /**< Logical path of the file. */
+   uint32_t hash;    /**< Hash of the path. */
+   int next;         /**< Next entry in the same bucket, -1 if last. */
+} NdataEntry;
 
 
 /*
@@ -70,15 +90,32 @@ static char* ndata_filename         = NULL; /**< ndata archive name. */
 static char* ndata_dirname          = NULL; /**< Directory name. */
 static struct zip* ndata_archive    = NULL; /**< ndata file on disk */
 static char* ndata_arcName          = NULL; /**< Name of the ndata module. */
-static SDL_mutex *ndata_lock        = NULL; /**< Lock for ndata creation. */
+static SDL_mutex *ndata_lock        = NULL; /**< Lock for ndata creation and archive access. */
 static int ndata_loadedfile         = 0; /**< Already loaded a file? */
-static int ndata_source             = 0;
 
 /*
- * File list.
+ * File index.
  */
-static char **ndata_fileList  = NULL; /**< List of files in the archive. */
-static size_t ndata_fileNList     = 0; /**< Number of files in ndata_fileList. */
+static char *ndata_root             = NULL; /**< Directory the index points to, NULL when using the archive. */
+static NdataEntry *ndata_index      = NULL; /**< Indexed files sorted by path (array.h). */
+static int *ndata_buckets           = NULL; /**< Hash buckets of the index. */
+static int ndata_nbuckets           = 0; /**< Number of buckets, always a power of two. */
+
+/*
+ * Readahead.
+ */
+static SDL_cond *ndata_prefetchCond = NULL; /**< Signalled when a readahead job finishes. */
+static int ndata_prefetchJobs       = 0; /**< Readahead jobs still running. */
+static int ndata_prefetchStop       = 0; /**< Tells readahead jobs to give up. */
+
+
+/**
+ * @brief Files to read ahead.
+ */
+typedef struct NdataPrefetch_ {
+   char **files;     /**< Files to decompress. */
+   size_t nfiles;    /**< Number of files. */
+} NdataPrefetch;
 
 
 /*
@@ -90,10 +127,23 @@ static int ndata_openFile (void);
 static int ndata_isndata( const char *path, ... );
 static int ndata_prompt( void *data );
 static int ndata_notfound (void);
-static char** ndata_listBackend( const char* path, size_t* nfiles, int dirs );
-static char **stripPath( const char **list, int nlist, const char *path );
-static char** filterList( const char** list, int nlist,
-      const char* path, size_t* nfiles, int recursive );
+static char** ndata_listBackend( const char* path, size_t* nfiles, int recursive );
+/* Index. */
+static uint32_t ndata_hash( const char *path );
+static int ndata_normalize( char *out, size_t len, const char *path );
+static int ndata_indexCmp( const void *p1, const void *p2 );
+static void ndata_indexAdd( const char *path );
+static void ndata_indexFinish (void);
+static void ndata_indexFree (void);
+static int ndata_indexDir( const char *root );
+static void ndata_indexArchive (void);
+static int ndata_indexOpen (void);
+static int ndata_indexFind( const char *filename, char *path, size_t len );
+static int ndata_prefetchThread( void *data );
+#if HAS_POSIX
+static int ndata_rwopsUnmap( SDL_RWops *rw );
+static SDL_RWops *ndata_rwopsMap( const char *path );
+#endif /* HAS_POSIX */
 
 
 /**
@@ -447,12 +497,16 @@ static int ndata_openFile (void)
          if (!ndata_notfound())
             exit(1);
       }
-      else
+      else {
+         SDL_mutexV(ndata_lock);
          return -1;
+      }
    }
    ndata_archive = nzip_open( ndata_filename );
    if (ndata_archive == NULL)
       WARN(_("Unable to open ndata from '%s'."), ndata_filename );
+   else
+      ndata_indexArchive();
 
    /* Close lock. */
    SDL_mutexV(ndata_lock);
@@ -499,6 +553,299 @@ static void ndata_testVersion (void)
 }
 
 
+/**
+ * @brief Hashes a logical path (FNV-1a).
+ */
+static uint32_t ndata_hash( const char *path )
+{
+   uint32_t hash;
+   const unsigned char *c;
+
+   hash = 2166136261U;
+   for (c=(const unsigned char*)path; *c != '\0'; c++) {
+      hash ^= *c;
+      hash *= 16777619U;
+   }
+   return hash;
+}
+
+
+/**
+ * @brief Normalizes a path so it can be looked up in the index.
+ *
+ * Leading "./" are dropped and runs of separators are collapsed into a
+ *  single '/'.
+ *
+ *    @param[out] out Buffer to write the normalized path to.
+ *    @param len Size of the buffer.
+ *    @param path Path to normalize.
+ *    @return 0 on success, -1 if it doesn't fit.
+ */
+static int ndata_normalize( char *out, size_t len, const char *path )
+{
+   size_t i;
+
+   while ((path[0] == '.') && nfile_isSeparator(path[1]))
+      path += 2;
+
+   i = 0;
+   for (; *path != '\0'; path++) {
+      if (i+1 >= len)
+         return -1;
+      if (nfile_isSeparator(*path)) {
+         if ((i > 0) && (out[i-1] == '/'))
+            continue;
+         out[i++] = '/';
+      }
+      else
+         out[i++] = *path;
+   }
+   out[i] = '\0';
+   return 0;
+}
+
+
+/**
+ * @brief Compares two index entries by path.
+ */
+static int ndata_indexCmp( const void *p1, const void *p2 )
+{
+   const NdataEntry *e1, *e2;
+   e1 = (const NdataEntry*) p1;
+   e2 = (const NdataEntry*) p2;
+   return strcmp( e1->path, e2->path );
+}
+
+
+/**
+ * @brief Adds a file to the index, ndata_indexFinish must be called afterwards.
+ *
+ *    @param path Logical path of the file.
+ */
+static void ndata_indexAdd( const char *path )
+{
+   char buf[PATH_MAX];
+   NdataEntry *e;
+
+   if (ndata_normalize( buf, sizeof(buf), path ))
+      return;
+
+   if (ndata_index == NULL)
+      ndata_index = array_create( NdataEntry );
+   e        = &array_grow( &ndata_index );
+   e->path  = strdup( buf );
+   e->hash  = ndata_hash( buf );
+   e->next  = -1;
+}
+
+
+/**
+ * @brief Sorts the index and builds the hash buckets.
+ */
+static void ndata_indexFinish (void)
+{
+   int i, n, b;
+
+   if (ndata_index == NULL)
+      ndata_index = array_create( NdataEntry );
+   n = array_size( ndata_index );
+   qsort( ndata_index, n, sizeof(NdataEntry), ndata_indexCmp );
+
+   /* Keep the load factor under one. */
+   ndata_nbuckets = NDATA_INDEX_MIN;
+   while (ndata_nbuckets < n)
+      ndata_nbuckets *= 2;
+   free( ndata_buckets );
+   ndata_buckets = malloc( sizeof(int) * ndata_nbuckets );
+   for (i=0; i<ndata_nbuckets; i++)
+      ndata_buckets[i] = -1;
+
+   for (i=0; i<n; i++) {
+      b = ndata_index[i].hash & (ndata_nbuckets-1);
+      ndata_index[i].next = ndata_buckets[b];
+      ndata_buckets[b] = i;
+   }
+}
+
+
+/**
+ * @brief Frees the index.
+ */
+static void ndata_indexFree (void)
+{
+   int i;
+
+   if (ndata_index != NULL) {
+      for (i=0; i<array_size(ndata_index); i++)
+         free( ndata_index[i].path );
+      array_free( ndata_index );
+      ndata_index = NULL;
+   }
+   free( ndata_buckets );
+   ndata_buckets  = NULL;
+   ndata_nbuckets = 0;
+   free( ndata_root );
+   ndata_root     = NULL;
+}
+
+
+/**
+ * @brief Indexes a laid out data directory.
+ *
+ * Only the top level files and everything below "dat/" are indexed, the
+ *  directory may very well be the current directory or the binary directory.
+ *
+ *    @param root Directory to index.
+ *    @return 0 on success, -1 if it doesn't hold the data.
+ */
+static int ndata_indexDir( const char *root )
+{
+   char buf[PATH_MAX], **files;
+   size_t i, n, len;
+
+   /* Arbitrary, but the data can't be used without it. */
+   nsnprintf( buf, sizeof(buf), "%s/%s", root, START_DATA_PATH );
+   if (!nfile_fileExists( buf ))
+      return -1;
+
+   ndata_indexFree();
+   ndata_root = strdup( root );
+
+   /* Top level files. */
+   files = nfile_readDir( &n, root );
+   for (i=0; i<n; i++) {
+      nsnprintf( buf, sizeof(buf), "%s/%s", root, files[i] );
+      if (!nfile_dirExists( buf ))
+         ndata_indexAdd( files[i] );
+      free( files[i] );
+   }
+   free( files );
+
+   /* Data files, which come back prefixed by the root. */
+   nsnprintf( buf, sizeof(buf), "%s/dat/", root );
+   len   = strlen( root ) + 1;
+   files = nfile_readDirRecursive( &n, buf );
+   for (i=0; i<n; i++) {
+      ndata_indexAdd( &files[i][len] );
+      free( files[i] );
+   }
+   free( files );
+
+   ndata_indexFinish();
+   return 0;
+}
+
+
+/**
+ * @brief Indexes the files of the opened archive.
+ *
+ * Must be called with ndata_lock held.
+ */
+static void ndata_indexArchive (void)
+{
+   char **files;
+   size_t i, n, len;
+
+   ndata_indexFree();
+
+   files = nzip_listFiles( ndata_archive, &n );
+   for (i=0; i<n; i++) {
+      /* Directories are listed with a trailing separator. */
+      len = strlen( files[i] );
+      if ((len > 0) && !nfile_isSeparator( files[i][len-1] ))
+         ndata_indexAdd( files[i] );
+      free( files[i] );
+   }
+   free( files );
+
+   ndata_indexFinish();
+}
+
+
+/**
+ * @brief Finds the data and indexes it.
+ *
+ * Laid out directories take precedence over archives.
+ *
+ *    @return 0 on success.
+ */
+static int ndata_indexOpen (void)
+{
+   char path[PATH_MAX], *buf;
+
+   /* Current directory. */
+   if (ndata_indexDir( "." ) == 0)
+      return 0;
+
+   /* Directory set by the user. */
+   if ((ndata_dirname != NULL) && (ndata_indexDir( ndata_dirname ) == 0))
+      return 0;
+
+   /* Default location. */
+   buf = strdup( NDATA_DEF );
+   nsnprintf( path, sizeof(path), "%s", nfile_dirname(buf) );
+   free(buf);
+   if (ndata_indexDir( path ) == 0)
+      return 0;
+
+   /* Binary location. */
+   buf = strdup( naev_binary() );
+   nsnprintf( path, sizeof(path), "%s", nfile_dirname(buf) );
+   free(buf);
+   if (ndata_indexDir( path ) == 0)
+      return 0;
+
+   /* Fall back to an archive, which indexes itself. */
+   return ndata_openFile();
+}
+
+
+/**
+ * @brief Looks up a file in the index.
+ *
+ * ndata_rescan may rebuild the index while other threads read files, so the
+ *  path is copied out while holding the lock.
+ *
+ *    @param filename Logical path of the file.
+ *    @param[out] path Path of the file on disk if laid out or in the archive
+ *       otherwise, may be NULL.
+ *    @param len Size of path.
+ *    @return 1 if the file is laid out, 0 if it's in the archive or -1 if
+ *       it wasn't found.
+ */
+static int ndata_indexFind( const char *filename, char *path, size_t len )
+{
+   char buf[PATH_MAX];
+   uint32_t hash;
+   int i, ret;
+
+   if (filename == NULL)
+      return -1;
+   if (ndata_normalize( buf, sizeof(buf), filename ))
+      return -1;
+   hash = ndata_hash( buf );
+
+   ret = -1;
+   SDL_mutexP(ndata_lock);
+   if (ndata_buckets != NULL) {
+      for (i=ndata_buckets[ hash & (ndata_nbuckets-1) ]; i>=0; i=ndata_index[i].next) {
+         if ((ndata_index[i].hash != hash) || (strcmp( ndata_index[i].path, buf )!=0))
+            continue;
+         ret = (ndata_root != NULL);
+         if (path == NULL)
+            break;
+         if (ret)
+            nsnprintf( path, len, "%s/%s", ndata_root, ndata_index[i].path );
+         else
+            nsnprintf( path, len, "%s", ndata_index[i].path );
+         break;
+      }
+   }
+   SDL_mutexV(ndata_lock);
+   return ret;
+}
+
+
 /**
  * @brief Opens the ndata file.
  *
@@ -508,6 +855,8 @@ int ndata_open (void)
 {
    /* Create the lock. */
    ndata_lock = SDL_CreateMutex();
+   ndata_prefetchCond = SDL_CreateCond();
+   ndata_prefetchStop = 0;
 
    /* Set path to configuration. */
    ndata_setPath(conf.ndata);
@@ -519,7 +868,7 @@ int ndata_open (void)
    free(ndata_filename);
    ndata_filename = NULL;
 
-   return 0;
+   return ndata_indexOpen();
 }
 
 
@@ -528,7 +877,14 @@ int ndata_open (void)
  */
 void ndata_close (void)
 {
-   unsigned int i;
+   /* Wait for the readahead to give up. */
+   if (ndata_lock != NULL) {
+      SDL_mutexP(ndata_lock);
+      ndata_prefetchStop = 1;
+      while (ndata_prefetchJobs > 0)
+         SDL_CondWait( ndata_prefetchCond, ndata_lock );
+      SDL_mutexV(ndata_lock);
+   }
 
    /* Destroy the name. */
    if (ndata_arcName != NULL) {
@@ -536,15 +892,8 @@ void ndata_close (void)
       ndata_arcName = NULL;
    }
 
-   /* Destroy the list. */
-   if (ndata_fileList != NULL) {
-      for (i=0; i<ndata_fileNList; i++)
-         free(ndata_fileList[i]);
-
-      free(ndata_fileList);
-      ndata_fileList  = NULL;
-      ndata_fileNList = 0;
-   }
+   /* Destroy the index. */
+   ndata_indexFree();
 
    /* Close the archive. */
    if (ndata_archive) {
@@ -557,6 +906,96 @@ void ndata_close (void)
       SDL_DestroyMutex(ndata_lock);
       ndata_lock = NULL;
    }
+   if (ndata_prefetchCond != NULL) {
+      SDL_DestroyCond(ndata_prefetchCond);
+      ndata_prefetchCond = NULL;
+   }
+}
+
+
+/**
+ * @brief Rescans the data directory, picking up files written since it was opened.
+ *
+ * Meant for the development editors, does nothing when using an archive.
+ *  Lookups wait on the lock, so files being read by other threads stay valid.
+ *
+ *    @return 0 on success.
+ */
+int ndata_rescan (void)
+{
+   char *root;
+   int ret;
+
+   if (ndata_root == NULL)
+      return 0;
+
+   SDL_mutexP(ndata_lock);
+   root = strdup( ndata_root );
+   ret  = ndata_indexDir( root );
+   free( root );
+   SDL_mutexV(ndata_lock);
+   return ret;
+}
+
+
+/**
+ * @brief Decompresses the files of a readahead job into the archive cache.
+ *
+ *    @param data Files to read ahead, freed when done.
+ *    @return 0 on success.
+ */
+static int ndata_prefetchThread( void *data )
+{
+   NdataPrefetch *p;
+   size_t i;
+
+   p = (NdataPrefetch*) data;
+   for (i=0; i<p->nfiles; i++) {
+      /* Lock per file so readers aren't held up for long. */
+      SDL_mutexP(ndata_lock);
+      if (!ndata_prefetchStop && (ndata_archive != NULL))
+         nzip_prefetch( ndata_archive, p->files[i] );
+      SDL_mutexV(ndata_lock);
+      free( p->files[i] );
+   }
+   free( p->files );
+   free( p );
+
+   SDL_mutexP(ndata_lock);
+   ndata_prefetchJobs--;
+   SDL_CondBroadcast( ndata_prefetchCond );
+   SDL_mutexV(ndata_lock);
+   return 0;
+}
+
+
+/**
+ * @brief Reads ahead all the files below a path in the background.
+ *
+ * Only does something for archives, where it decompresses the files so
+ *  reading them later is just a copy. Loose files are left to the OS.
+ *
+ *    @param path Path of the files to read ahead.
+ */
+void ndata_prefetch( const char *path )
+{
+   NdataPrefetch *p;
+
+   if (ndata_archive == NULL)
+      return;
+
+   p = malloc( sizeof(NdataPrefetch) );
+   p->files = ndata_listRecursive( path, &p->nfiles );
+   if (p->nfiles == 0) {
+      free( p->files );
+      free( p );
+      return;
+   }
+
+   SDL_mutexP(ndata_lock);
+   ndata_prefetchJobs++;
+   SDL_mutexV(ndata_lock);
+   threadpool_newJob( ndata_prefetchThread, p );
 }
 
 
@@ -584,18 +1023,7 @@ const char* ndata_getDirname(void)
    if (path != NULL)
       return nfile_dirname( path );
 
-   switch (ndata_source) {
-      case NDATA_SRC_LAIDOUT:
-         return ".";
-      case NDATA_SRC_DIRNAME:
-         return ndata_dirname;
-      case NDATA_SRC_NDATADEF:
-         return nfile_dirname( strdup( NDATA_DEF ) );
-      case NDATA_SRC_BINARY:
-         return nfile_dirname( strdup( naev_binary() ) );
-   }
-
-   return NULL;
+   return ndata_root;
 }
 
 
@@ -606,46 +1034,7 @@ const char* ndata_getDirname(void)
  */
 int ndata_exists( const char* filename )
 {
-   char *buf, path[PATH_MAX];
-
-   /* See if needs to load ndata archive. */
-   if (ndata_archive == NULL) {
-
-      /* Try to read the file as locally. */
-      if (nfile_fileExists( filename ) && (ndata_source <= NDATA_SRC_LAIDOUT))
-         return 1;
-
-      /* We can try to use the dirname path. */
-      if ((ndata_filename == NULL) && (ndata_dirname != NULL) &&
-            (ndata_source <= NDATA_SRC_DIRNAME)) {
-         nsnprintf( path, sizeof(path), "%s/%s", ndata_dirname, filename );
-         if (nfile_fileExists( path ))
-            return 1;
-      }
-
-      /* We can also try default location. */
-      if (ndata_source <= NDATA_SRC_NDATADEF) {
-         buf = strdup( NDATA_DEF );
-         nsnprintf( path, sizeof(path), "%s/%s", nfile_dirname(buf), filename );
-         free(buf);
-         if (nfile_fileExists( path ))
-            return 1;
-      }
-
-      /* Try binary location. */
-      if (ndata_source <= NDATA_SRC_BINARY) {
-         buf = strdup( naev_binary() );
-         nsnprintf( path, sizeof(path), "%s/%s", nfile_dirname(buf), filename );
-         free(buf);
-         if (nfile_fileExists( path ))
-            return 1;
-      }
-
-      return 0;
-   }
-
-   /* Try to get it from the archive. */
-   return nzip_hasFile( ndata_archive, filename );
+   return (ndata_indexFind( filename, NULL, 0 ) >= 0);
 }
 
 
@@ -658,75 +1047,12 @@ int ndata_exists( const char* filename )
  */
 void* ndata_read( const char* filename, size_t *filesize )
 {
-   char *buf, path[PATH_MAX];
-   size_t nbuf;
-
-   /* See if needs to load ndata archive. */
-   if (ndata_archive == NULL) {
-
-      /* Try to read the file as locally. */
-      if (nfile_fileExists( filename ) && (ndata_source <= NDATA_SRC_LAIDOUT)) {
-         buf = nfile_readFile( &nbuf, filename );
-         if (buf != NULL) {
-            ndata_loadedfile = 1;
-            *filesize = nbuf;
-            return buf;
-         }
-      }
-
-      /* We can try to use the dirname path. */
-      if ((ndata_filename == NULL) && (ndata_dirname != NULL) &&
-            (ndata_source <= NDATA_SRC_DIRNAME)) {
-         nsnprintf( path, sizeof(path), "%s/%s", ndata_dirname, filename );
-         if (nfile_fileExists( path )) {
-            buf = nfile_readFile( &nbuf, path );
-            if (buf != NULL) {
-               ndata_source = NDATA_SRC_DIRNAME;
-               ndata_loadedfile = 1;
-               *filesize = nbuf;
-               return buf;
-            }
-         }
-      }
-
-      /* We can also try default location. */
-      if (ndata_source <= NDATA_SRC_NDATADEF) {
-         buf = strdup( NDATA_DEF );
-         nsnprintf( path, sizeof(path), "%s/%s", nfile_dirname(buf), filename );
-         free(buf);
-         if (nfile_fileExists( path )) {
-            buf = nfile_readFile( &nbuf, path );
-            if (buf != NULL) {
-               ndata_source = NDATA_SRC_NDATADEF;
-               ndata_loadedfile = 1;
-               *filesize = nbuf;
-               return buf;
-            }
-         }
-      }
-
-      /* Try binary location. */
-      if (ndata_source <= NDATA_SRC_BINARY) {
-         buf = strdup( naev_binary() );
-         nsnprintf( path, sizeof(path), "%s/%s", nfile_dirname(buf), filename );
-         free(buf);
-         if (nfile_fileExists( path )) {
-            buf = nfile_readFile( &nbuf, path );
-            if (buf != NULL) {
-               ndata_source = NDATA_SRC_BINARY;
-               ndata_loadedfile = 1;
-               *filesize = nbuf;
-               return buf;
-            }
-         }
-      }
-
-      /* Load the ndata archive. */
-      ndata_openFile();
-   }
+   char path[PATH_MAX], *buf;
+   int laidout;
 
-   /* Wasn't able to open the file. */
-   if (ndata_archive == NULL) {
+   /* Wasn't able to find the file. */
+   laidout = ndata_indexFind( filename, path, sizeof(path) );
+   if (laidout < 0) {
       WARN(_("Unable to open file '%s': not found."), filename);
       *filesize = 0;
       return NULL;
@@ -735,264 +1061,183 @@ void* ndata_read( const char* filename, size_t *filesize )
    /* Mark that we loaded a file. */
    ndata_loadedfile = 1;
 
-   /* Get data from ndata archive. */
-   return nzip_readFile( ndata_archive, filename, filesize );
+   /* Laid out file. */
+   if (laidout) {
+      buf = nfile_readFile( filesize, "%s", path );
+      if (buf == NULL)
+         *filesize = 0;
+      return buf;
+   }
+
+   /* Get data from ndata archive, libzip archives can't be shared between threads. */
+   SDL_mutexP(ndata_lock);
+   buf = nzip_readFile( ndata_archive, path, filesize );
+   SDL_mutexV(ndata_lock);
+   return buf;
 }
 
 
+#if HAS_POSIX
 /**
- * @brief Creates an rwops from a file in the ndata.
- *
- *    @param filename Name of the file to create rwops of.
- *    @return rwops that accesses the file in the ndata.
+ * @brief Closes a mapped rwops.
  */
-SDL_RWops *ndata_rwops( const char* filename )
+static int ndata_rwopsUnmap( SDL_RWops *rw )
 {
-   char path[PATH_MAX], *tmp;
-   SDL_RWops *rw;
-
-   if (ndata_archive == NULL) {
-
-      /* Try to open from file. */
-      if (ndata_source <= NDATA_SRC_LAIDOUT) {
-         rw = SDL_RWFromFile( filename, "rb" );
-         if (rw != NULL) {
-            ndata_loadedfile = 1;
-            return rw;
-         }
-      }
-
-      /* Try to open from dirname. */
-      if ((ndata_filename == NULL) && (ndata_dirname != NULL) &&
-            (ndata_source <= NDATA_SRC_DIRNAME)) {
-         nsnprintf( path, sizeof(path), "%s/%s", ndata_dirname, filename );
-         rw = SDL_RWFromFile( path, "rb" );
-         if (rw != NULL) {
-            ndata_source = NDATA_SRC_DIRNAME;
-            ndata_loadedfile = 1;
-            return rw;
-         }
-      }
-
-      /* Try to open from def. */
-      if (ndata_source <= NDATA_SRC_NDATADEF) {
-         tmp = strdup( NDATA_DEF );
-         nsnprintf( path, sizeof(path), "%s/%s", nfile_dirname(tmp), filename );
-         free(tmp);
-         rw = SDL_RWFromFile( path, "rb" );
-         if (rw != NULL) {
-            ndata_source = NDATA_SRC_NDATADEF;
-            ndata_loadedfile = 1;
-            return rw;
-         }
-      }
-
-      /* Try to open from binary. */
-      if (ndata_source <= NDATA_SRC_BINARY) {
-         tmp = strdup( naev_binary() );
-         nsnprintf( path, sizeof(path), "%s/%s", nfile_dirname(tmp), filename );
-         free(tmp);
-         rw = SDL_RWFromFile( path, "rb" );
-         if (rw != NULL) {
-            ndata_source = NDATA_SRC_BINARY;
-            ndata_loadedfile = 1;
-            return rw;
-         }
-      }
-
-      /* Load the ndata archive. */
-      ndata_openFile();
-   }
-
-   /* Wasn't able to open the file. */
-   if (ndata_archive == NULL) {
-      WARN(_("Unable to open file '%s': not found."), filename);
-      return NULL;
-   }
-
-   /* Mark that we loaded a file. */
-   ndata_loadedfile = 1;
-
-   return nzip_rwops( ndata_archive, filename );
+   munmap( rw->hidden.mem.base, rw->hidden.mem.stop - rw->hidden.mem.base );
+   SDL_FreeRW( rw );
+   return 0;
 }
 
 
 /**
- * @brief Removes a common path from a list of files, if present.
+ * @brief Maps a large file into memory and wraps it in a rwops.
  *
- *    @param list List of files to filter.
- *    @param nlist Number of files in the list.
- *    @param path Path to remove from the filenames.
+ *    @param path Path of the file on disk.
+ *    @return The rwops or NULL if the file is too small or can't be mapped.
  */
-static char **stripPath( const char **list, int nlist, const char *path )
+static SDL_RWops *ndata_rwopsMap( const char *path )
 {
-   int i, len;
-   char **out, *buf;
-
-   out = malloc(sizeof(char*) * nlist);
-   len = strlen( path );
+   int fd;
+   struct stat sb;
+   void *map;
+   SDL_RWops *rw;
 
-   /* Slash-terminate as needed. */
-   if (strcmp(&path[len],"/")!=0) {
-      len++;
-      buf = malloc(len + 1);
-      nsnprintf(buf, len+1,  "%s/", path );
+   fd = open( path, O_RDONLY );
+   if (fd < 0)
+      return NULL;
+   if ((fstat( fd, &sb ) != 0) || (sb.st_size < NDATA_MMAP_MIN)) {
+      close( fd );
+      return NULL;
    }
-   else
-      buf = strdup(path);
+   map = mmap( NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+   close( fd );
+   if (map == MAP_FAILED)
+      return NULL;
+   posix_madvise( map, sb.st_size, POSIX_MADV_SEQUENTIAL );
 
-   for (i=0; i<nlist; i++) {
-      if (strncmp(list[i],buf,len)==0)
-         out[i] = strdup( &list[i][len] );
-      else
-         out[i] = strdup( list[i] );
+   rw = SDL_RWFromConstMem( map, sb.st_size );
+   if (rw == NULL) {
+      munmap( map, sb.st_size );
+      return NULL;
    }
-
-   free(buf);
-   return out;
+   rw->close = ndata_rwopsUnmap;
+   return rw;
 }
+#endif /* HAS_POSIX */
 
 
 /**
- * @brief Filters a file list to match path.
+ * @brief Creates an rwops from a file in the ndata.
  *
- *    @param list List to filter.
- *    @param nlist Members in list.
- *    @param path Path to filter.
- *    @param recursive Whether all children at any depth should be listed.
- *    @param[out] nfiles Files that match.
+ *    @param filename Name of the file to create rwops of.
+ *    @return rwops that accesses the file in the ndata.
  */
-static char** filterList( const char** list, int nlist,
-      const char* path, size_t* nfiles, int recursive )
+SDL_RWops *ndata_rwops( const char* filename )
 {
-   char **filtered;
-   int i, j, k, len;
-
-   /* Maximum size by default. */
-   filtered = malloc(sizeof(char*) * nlist);
-   len = strlen( path );
-
-   /* Filter list. */
-   j = 0;
-   for (i=0; i<nlist; i++) {
-      /* Must match path. */
-      if (strncmp(list[i], path, len)!=0)
-         continue;
+   char path[PATH_MAX];
+   SDL_RWops *rw;
+   int laidout;
 
-      /* Make sure there are no stray file delimitors. */
-      for (k=len; list[i][k] != '\0'; k++)
-         if (nfile_isSeparator(list[i][k]))
-            if (!recursive)
-               break;
+   /* Wasn't able to find the file. */
+   laidout = ndata_indexFind( filename, path, sizeof(path) );
+   if (laidout < 0) {
+      WARN(_("Unable to open file '%s': not found."), filename);
+      return NULL;
+   }
 
-      if (list[i][k] != '\0')
-         continue;
+   /* Mark that we loaded a file. */
+   ndata_loadedfile = 1;
 
-      /* Copy the file name without the path. */
-      if (!recursive)
-         filtered[j++] = strdup(&list[i][len]);
-      else /* Recursive needs paths. */
-         filtered[j++] = strdup(list[i]);
+   /* Laid out file, big ones get mapped. */
+   if (laidout) {
+#if HAS_POSIX
+      rw = ndata_rwopsMap( path );
+      if (rw != NULL)
+         return rw;
+#endif /* HAS_POSIX */
+      return SDL_RWFromFile( path, "rb" );
    }
 
-   /* Return results. */
-   *nfiles = j;
-   return filtered;
+   SDL_mutexP(ndata_lock);
+   rw = nzip_rwops( ndata_archive, path );
+   SDL_mutexV(ndata_lock);
+   return rw;
 }
 
 
 /**
  * @brief Gets the list of files in the ndata.
  *
- * @note Strips the path.
+ * The index is sorted so the files below path are a contiguous range.
+ *  Only files are listed, never directories, be it laid out or archived.
  *
  *    @param path List files in path.
  *    @param nfiles Number of files found.
- *    @return List of files found.
+ *    @param recursive Whether all children at any depth should be listed.
+ *    @return List of files found, stripped of the path if not recursive.
  */
 static char** ndata_listBackend( const char* path, size_t* nfiles, int recursive )
 {
-   (void) path;
-   char **files, **tfiles, buf[PATH_MAX], *tmp;
-   size_t n;
-   char** (*nfile_readFunc) ( size_t* nfiles, const char* path, ... ) = NULL;
-
-   if (recursive)
-      nfile_readFunc = nfile_readDirRecursive;
-   else
-      nfile_readFunc = nfile_readDir;
-
-   /* Already loaded the list. */
-   if (ndata_fileList != NULL)
-      return filterList( (const char**) ndata_fileList, ndata_fileNList, path, nfiles, recursive );
-
-   /* See if can load from local directory. */
-   if (ndata_archive == NULL) {
-
-      /* Local search. */
-      if (ndata_source <= NDATA_SRC_LAIDOUT) {
-         files = nfile_readFunc( &n, path );
-         if (files != NULL) {
-            *nfiles = n;
-            return files;
-         }
-      }
+   char prefix[PATH_MAX], **files;
+   int lo, hi, mid, n, i, j;
+   size_t len, k;
 
-      /* Dirname search. */
-      if ((ndata_filename == NULL) && (ndata_dirname != NULL) &&
-            (ndata_source <= NDATA_SRC_DIRNAME)) {
-         nsnprintf( buf, sizeof(buf), "%s/%s", ndata_dirname, path );
-         tfiles = nfile_readFunc( &n, buf );
-         files = stripPath( (const char**)tfiles, n, ndata_dirname );
-         free(tfiles);
-         if (files != NULL) {
-            *nfiles = n;
-            return files;
-         }
-      }
-
-      /* NDATA_DEF. */
-      if (ndata_source <= NDATA_SRC_NDATADEF) {
-         tmp = strdup( NDATA_DEF );
-         nsnprintf( buf, sizeof(buf), "%s/%s", nfile_dirname(tmp), path );
-         tfiles = nfile_readFunc( &n, buf );
-         files = stripPath( (const char**)tfiles, n, tmp );
-         free(tmp);
-         free(tfiles);
-         if (files != NULL) {
-            *nfiles = n;
-            return files;
-         }
-      }
+   *nfiles = 0;
+   if (ndata_normalize( prefix, sizeof(prefix)-1, path ))
+      return NULL;
 
-      /* Binary. */
-      if (ndata_source <= NDATA_SRC_BINARY) {
-         tmp = strdup( naev_binary() );
-         nsnprintf( buf, sizeof(buf), "%s/%s", nfile_dirname(tmp), path );
-         tfiles = nfile_readFunc( &n, buf );
-         files = stripPath( (const char**)tfiles, n, nfile_dirname(tmp) );
-         free(tmp);
-         free(tfiles);
-         if (files != NULL) {
-            *nfiles = n;
-            return files;
-         }
-      }
+   /* Must be a directory. */
+   len = strlen( prefix );
+   if ((len > 0) && (prefix[len-1] != '/')) {
+      prefix[len++] = '/';
+      prefix[len]   = '\0';
+   }
 
-      /* Open ndata archive. */
-      ndata_openFile();
+   /* The index may be rebuilt by ndata_rescan. */
+   SDL_mutexP(ndata_lock);
+   if (ndata_index == NULL) {
+      SDL_mutexV(ndata_lock);
+      return NULL;
    }
 
-   /* Wasn't able to open the file. */
-   if (ndata_archive == NULL) {
-      *nfiles = 0;
+   /* Find the first file below path. */
+   n  = array_size( ndata_index );
+   lo = 0;
+   hi = n;
+   while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if (strcmp( ndata_index[mid].path, prefix ) < 0)
+         lo = mid+1;
+      else
+         hi = mid;
+   }
+   for (hi=lo; hi<n; hi++)
+      if (strncmp( ndata_index[hi].path, prefix, len ) != 0)
+         break;
+   if (hi == lo) {
+      SDL_mutexV(ndata_lock);
       return NULL;
    }
 
-   /* Load list. */
-   ndata_fileList = nzip_listFiles( ndata_archive, &ndata_fileNList );
+   files = malloc( sizeof(char*) * (hi-lo) );
+   j = 0;
+   for (i=lo; i<hi; i++) {
+      if (recursive) {
+         files[j++] = strdup( ndata_index[i].path );
+         continue;
+      }
+
+      /* Skip files in subdirectories. */
+      for (k=len; ndata_index[i].path[k] != '\0'; k++)
+         if (ndata_index[i].path[k] == '/')
+            break;
+      if (ndata_index[i].path[k] == '\0')
+         files[j++] = strdup( &ndata_index[i].path[len] );
+   }
+   SDL_mutexV(ndata_lock);
 
-   return filterList( (const char**) ndata_fileList, ndata_fileNList, path, nfiles, recursive );
+   *nfiles = j;
+   return files;
 }
 
 /**
@@ -70,6 +70,7 @@
  */
 int ndata_open (void);
 void ndata_close (void);
+int ndata_rescan (void);
 
 /*
  * General.
@@ -87,6 +88,7 @@ int ndata_exists( const char* filename );
 void* ndata_read( const char* filename, size_t *filesize );
 char** ndata_list( const char *path, size_t* nfiles );
 char** ndata_listRecursive( const char *path, size_t* nfiles );
+void ndata_prefetch( const char *path );
 void ndata_sortName( char **files, size_t nfiles );
 
 
@@ -29,6 +29,7 @@
 #include "camera.h"
 #include "nstring.h"
 #include "ndata.h"
+#include "nmem.h"
 
 
 #define NEBULA_Z             16 /**< Z plane */
@@ -469,13 +470,15 @@ void nebu_movePuffs( double x, double y )
 void nebu_prep( double density, double volatility )
 {
    (void)volatility;
-   int i;
+   int i, npuffs;
 
    nebu_view = 1000. - density;  /* At density 1000 you're blind */
    nebu_dt   = 2000. / (density + 100.); /* Faster at higher density */
    nebu_timer = nebu_dt;
 
-   nebu_npuffs = density/4.;
+   npuffs = density/4.;
+   nmem_realloc( MEM_NEBULA, sizeof(NebulaPuff)*nebu_npuffs, sizeof(NebulaPuff)*npuffs );
+   nebu_npuffs = npuffs;
    nebu_puffs = realloc(nebu_puffs, sizeof(NebulaPuff)*nebu_npuffs);
    for (i=0; i<nebu_npuffs; i++) {
       /* Position */
@@ -531,6 +534,7 @@ static int nebu_generate (void)
 
    /* Generate all the nebula backgrounds */
    nebu = noise_genNebulaMap( w, h, NEBULA_Z, 5. );
+   nmem_alloc( MEM_NEBULA, sizeof(float)*w*h*NEBULA_Z );
 
    /* Start saving - compression can take a bit. */
    loadscreen_render( 0.05, _("Compressing Nebula layers...") );
@@ -545,6 +549,7 @@ static int nebu_generate (void)
 
    /* Cleanup */
    free(nebu);
+   nmem_free( MEM_NEBULA, sizeof(float)*w*h*NEBULA_Z );
    return ret;
 }
 
@@ -568,8 +573,10 @@ static void nebu_generatePuffs (void)
       /* Generate the nebula */
       w = h = RNG(20,64);
       nebu = noise_genNebulaPuffMap( w, h, 1. );
+      nmem_alloc( MEM_NEBULA, sizeof(float)*w*h );
       sur = nebu_surfaceFromNebulaMap( nebu, w, h );
       free(nebu);
+      nmem_free( MEM_NEBULA, sizeof(float)*w*h );
 
       /* Load the texture */
       nebu_pufftexs[i] =  gl_loadImage( sur, 0 );
@@ -12,6 +12,8 @@
 
 #include "naev.h"
 
+#include <stdarg.h>
+
 #include "nluadef.h"
 #include "log.h"
 #include "ndata.h"
@@ -32,19 +34,61 @@
 #include "nlua_commodity.h"
 #include "nlua_cli.h"
 #include "nstring.h"
+#include "nmem.h"
+#include "nlua_prof.h"
+#include "conf.h"
+
+
+#define NLUA_GC_STEPSIZE   8  /**< Size of a single collector step in kilobytes. */
+#define NLUA_GC_STEPMUL    2  /**< How much faster than allocation the collector should go. */
+#define NLUA_GC_MINSTEP    4  /**< Minimum amount of collection per frame in kilobytes. */
+#define NLUA_GC_EMERGENCY  4  /**< Heap growth over the last collected size that ignores the pause limit. */
 
 
 lua_State *naevL = NULL;
 nlua_env __NLUA_CURENV = LUA_NOREF;
+static char **nlua_envnames = NULL; /**< Names of the environments, indexed by reference. */
+static int nlua_nenvnames = 0; /**< Size of nlua_envnames. */
+static int nlua_envMeta = LUA_NOREF; /**< Metatable shared by the environments. */
+static int nlua_stdMeta = LUA_NOREF; /**< Metatable shared by the environments with the standard libraries. */
+
+/*
+ * include() cache, shared by all the environments.
+ */
+#define NLUA_INCLUDE_PURE  "--@pure" /**< First line of modules that can be shared as is. */
+static int nlua_includePaths  = LUA_NOREF; /**< Table of include names to resolved paths. */
+static int nlua_includeChunks = LUA_NOREF; /**< Table of resolved paths to compiled chunks. */
+static int nlua_includePure   = LUA_NOREF; /**< Table of resolved paths to the values of pure modules. */
+static nlua_env nlua_includeEnv = LUA_NOREF; /**< Environment pure modules are run in. */
+
+/*
+ * Garbage collection.
+ */
+static int nlua_gcManual   = 0; /**< Whether the collector is being driven by the engine. */
+static int nlua_gcLast     = 0; /**< Heap size in kilobytes after the last step. */
+static int nlua_gcBase     = 0; /**< Heap size in kilobytes at the end of the last cycle. */
+static double nlua_gcDebt  = 0.; /**< Kilobytes of collection owed from previous frames. */
+static double nlua_gcAcc   = 0.; /**< Accumulated collection time in milliseconds. */
+static int nlua_gcFrames   = 0; /**< Frames accumulated in nlua_gcAcc. */
+static double nlua_gcMs    = 0.; /**< Average collection time per frame in milliseconds. */
+static double nlua_gcMax   = 0.; /**< Longest collection time in milliseconds over the last period. */
+static double nlua_gcMaxAcc = 0.; /**< Longest collection time in the current period. */
+static double nlua_gcPeriod = 0.; /**< Time elapsed in the current period in seconds. */
 
 
 /*
  * prototypes
  */
 static int nlua_packfileLoader( lua_State* L );
+static int nlua_includeTable( lua_State *L, int *ref );
+static const char* nlua_includeResolve( lua_State *L, const char *filename );
+static int nlua_includeLoad( lua_State *L, const char *path, const char *filename, int *pure );
 static lua_State *nlua_newState (void); /* creates a new state */
+static int nlua_panic( lua_State *L );
 static int nlua_loadBasic( lua_State* L );
 static int nlua_errTrace( lua_State *L );
+static int nlua_readOnly( lua_State *L );
+static int nlua_newMeta( int index );
 /* gettext */
 static int nlua_gettext( lua_State *L );
 static int nlua_ngettext( lua_State *L );
@@ -105,8 +149,24 @@ void lua_init(void) {
  * @brief Closes the global Lua state.
  */
 void lua_exit(void) {
+   int i;
+   nlua_profStop();
+   nlua_profClear();
    lua_close(naevL);
    naevL = NULL;
+   nlua_vectorScratchFree();
+   nlua_gcManual = 0;
+   for (i=0; i<nlua_nenvnames; i++)
+      free(nlua_envnames[i]);
+   free(nlua_envnames);
+   nlua_envnames = NULL;
+   nlua_nenvnames = 0;
+   nlua_envMeta = LUA_NOREF;
+   nlua_stdMeta = LUA_NOREF;
+   nlua_includePaths  = LUA_NOREF;
+   nlua_includeChunks = LUA_NOREF;
+   nlua_includePure   = LUA_NOREF;
+   nlua_includeEnv    = LUA_NOREF;
 }
 
 
@@ -149,6 +209,64 @@ int nlua_dofileenv(nlua_env env, const char *filename) {
 }
 
 
+/*
+ * @brief Runs a Lua file in an environment, compiling it only the first time.
+ *
+ * The compiled chunk is kept in the registry and shared by every
+ *  environment that runs the file. Its environment is set right before it
+ *  runs, so the functions it defines are bound to that environment.
+ *
+ *    @param env Lua environment.
+ *    @param[in,out] chunk Registry reference of the compiled chunk, LUA_NOREF
+ *           if it hasn't been compiled yet.
+ *    @param filename Lua file in the ndata.
+ *    @return 0 on success, -1 on error with the message on the stack.
+ */
+int nlua_dochunkenv(nlua_env env, int *chunk, const char *filename) {
+   char *buf;
+   size_t bufsize;
+   int ret;
+
+   if (*chunk == LUA_NOREF) {
+      buf = ndata_read( filename, &bufsize );
+      if (buf == NULL) {
+         lua_pushfstring(naevL, _("%s not found"), filename);
+         return -1;
+      }
+      ret = luaL_loadbuffer(naevL, buf, bufsize, filename);
+      free(buf);
+      if (ret != 0)
+         return -1;
+      *chunk = luaL_ref(naevL, LUA_REGISTRYINDEX);
+   }
+
+   lua_rawgeti(naevL, LUA_REGISTRYINDEX, *chunk);
+   nlua_pushenv(env);
+   lua_setfenv(naevL, -2);
+   ret = nlua_pcall(env, 0, LUA_MULTRET);
+
+   /* Put it back without keeping the environment alive. */
+   lua_rawgeti(naevL, LUA_REGISTRYINDEX, *chunk);
+   lua_pushvalue(naevL, LUA_GLOBALSINDEX);
+   lua_setfenv(naevL, -2);
+   lua_pop(naevL, 1);
+
+   return (ret != 0) ? -1 : 0;
+}
+
+
+/*
+ * @brief Releases a chunk compiled by nlua_dochunkenv.
+ *
+ *    @param[in,out] chunk Registry reference of the chunk, reset to LUA_NOREF.
+ */
+void nlua_freeChunk(int *chunk) {
+   if ((*chunk != LUA_NOREF) && (naevL != NULL))
+      luaL_unref(naevL, LUA_REGISTRYINDEX, *chunk);
+   *chunk = LUA_NOREF;
+}
+
+
 /*
  * @brief Create an new environment in global Lua state.
  *
@@ -162,10 +280,13 @@ nlua_env nlua_newEnv(int rw) {
    lua_pushvalue(naevL, -1);
    ref = luaL_ref(naevL, LUA_REGISTRYINDEX);
 
-   /* Metatable */
-   lua_newtable(naevL);
-   lua_pushvalue(naevL, LUA_GLOBALSINDEX);
-   lua_setfield(naevL, -2, "__index");
+   /* Metatable, the same for all of them. */
+   if (nlua_envMeta == LUA_NOREF) {
+      lua_pushvalue(naevL, LUA_GLOBALSINDEX);
+      nlua_envMeta = nlua_newMeta(lua_gettop(naevL));
+      lua_pop(naevL, 1);
+   }
+   lua_rawgeti(naevL, LUA_REGISTRYINDEX, nlua_envMeta);
    lua_setmetatable(naevL, -2);
 
    /* Replace include() function with one that considers fenv */
@@ -181,6 +302,9 @@ nlua_env nlua_newEnv(int rw) {
    lua_setfield(naevL, -2, "__RW");
 
    lua_pop(naevL, 1);
+
+   /* Memory accounting. */
+   nmem_luaEnvNew(ref);
    return ref;
 }
 
@@ -191,8 +315,55 @@ nlua_env nlua_newEnv(int rw) {
  *    @param env Enviornment to free.
  */
 void nlua_freeEnv(nlua_env env) {
-   if (naevL != NULL)
-      luaL_unref(naevL, LUA_REGISTRYINDEX, env);
+   if (naevL == NULL)
+      return;
+   nmem_luaEnvFree(env);
+   if ((env >= 0) && (env < nlua_nenvnames)) {
+      free(nlua_envnames[env]);
+      nlua_envnames[env] = NULL;
+   }
+   luaL_unref(naevL, LUA_REGISTRYINDEX, env);
+}
+
+
+/*
+ * @brief Sets the name of an environment.
+ *
+ * The name is used to attribute memory and time spent in the environment.
+ *
+ *    @param env Environment to name.
+ *    @param fmt Format of the name to set (such as "misn:%s").
+ */
+void nlua_setEnvName(nlua_env env, const char *fmt, ...) {
+   char name[PATH_MAX];
+   va_list ap;
+   int n;
+   if (env < 0)
+      return;
+   va_start(ap, fmt);
+   vsnprintf(name, sizeof(name), fmt, ap);
+   va_end(ap);
+   if (env >= nlua_nenvnames) {
+      n = MAX(2*nlua_nenvnames, env+1);
+      nlua_envnames = realloc(nlua_envnames, n*sizeof(char*));
+      memset(&nlua_envnames[nlua_nenvnames], 0, (n-nlua_nenvnames)*sizeof(char*));
+      nlua_nenvnames = n;
+   }
+   free(nlua_envnames[env]);
+   nlua_envnames[env] = strdup(name);
+}
+
+
+/*
+ * @brief Gets the name of an environment.
+ *
+ *    @param env Environment to get name of.
+ *    @return The name or NULL if not set.
+ */
+const char* nlua_getEnvName(nlua_env env) {
+   if ((env < 0) || (env >= nlua_nenvnames))
+      return NULL;
+   return nlua_envnames[env];
 }
 
 
@@ -261,6 +432,31 @@ void nlua_register(nlua_env env, const char *libname,
 }
 
 
+/**
+ * @brief Errors out when trying to modify the shared standard libraries.
+ */
+static int nlua_readOnly( lua_State *L )
+{
+   return luaL_error( L, _("Attempt to modify the standard libraries with '%s'."),
+         luaL_optstring( L, 2, "?" ) );
+}
+
+
+/**
+ * @brief Creates a metatable that looks values up in a table.
+ *
+ *    @param index Stack position of the table to look up values in.
+ *    @return Registry reference to the new metatable.
+ */
+static int nlua_newMeta( int index )
+{
+   lua_newtable(naevL);
+   lua_pushvalue(naevL, index);
+   lua_setfield(naevL, -2, "__index");
+   return luaL_ref(naevL, LUA_REGISTRYINDEX);
+}
+
+
 /**
  * @brief Wrapper around luaL_newstate.
  *
@@ -270,17 +466,34 @@ static lua_State *nlua_newState (void)
 {
    lua_State *L;
 
-   /* try to create the new state */
-   L = luaL_newstate();
-   if (L == NULL) {
-      WARN(_("Failed to create new Lua state."));
-      return NULL;
+   /* try to create the new state with memory accounting */
+   L = lua_newstate( nmem_luaAlloc, NULL );
+   if (L != NULL)
+      lua_atpanic( L, nlua_panic );
+   else {
+      /* LuaJIT on 64 bit targets doesn't support custom allocators. */
+      L = luaL_newstate();
+      if (L == NULL) {
+         WARN(_("Failed to create new Lua state."));
+         return NULL;
+      }
    }
 
    return L;
 }
 
 
+/**
+ * @brief Handles unprotected Lua errors, as luaL_newstate does.
+ */
+static int nlua_panic( lua_State *L )
+{
+   WARN(_("PANIC: unprotected error in call to Lua API (%s)"),
+         lua_tostring(L, -1));
+   return 0;
+}
+
+
 /**
  * @brief Loads specially modified basic stuff.
  *
@@ -327,22 +540,118 @@ static int nlua_loadBasic( lua_State* L )
 }
 
 
+/**
+ * @brief Pushes one of the include() cache tables, creating it if needed.
+ *
+ *    @param L Lua state.
+ *    @param ref Registry reference of the table.
+ *    @return Stack position of the table.
+ */
+static int nlua_includeTable( lua_State *L, int *ref )
+{
+   if (*ref == LUA_NOREF) {
+      lua_newtable(L);
+      lua_pushvalue(L, -1);
+      *ref = luaL_ref(L, LUA_REGISTRYINDEX);
+   }
+   else
+      lua_rawgeti(L, LUA_REGISTRYINDEX, *ref);
+   return lua_gettop(L);
+}
+
+
+/**
+ * @brief Resolves the path of an include, caching it.
+ *
+ *    @param L Lua state.
+ *    @param filename Name passed to include().
+ *    @return The path in ndata or NULL if not found.
+ */
+static const char* nlua_includeResolve( lua_State *L, const char *filename )
+{
+   const char *path;
+   char *path_filename;
+   int len, t;
+
+   t = nlua_includeTable( L, &nlua_includePaths ); /* paths */
+   lua_getfield(L, t, filename); /* paths, path */
+   if (lua_isstring(L, -1)) {
+      path = lua_tostring(L, -1);
+      lua_pop(L, 2); /* The table keeps it alive. */
+      return path;
+   }
+   lua_pop(L, 1); /* paths */
+
+   /* Try to locate the data directly, then with the INCLUDE_PATH prefix. */
+   if (ndata_exists( filename ))
+      lua_pushstring(L, filename);
+   else {
+      len           = strlen(LUA_INCLUDE_PATH)+strlen(filename)+2;
+      path_filename = malloc( len );
+      nsnprintf( path_filename, len, "%s%s", LUA_INCLUDE_PATH, filename );
+      if (!ndata_exists( path_filename )) {
+         free( path_filename );
+         lua_pop(L, 1);
+         return NULL;
+      }
+      lua_pushstring(L, path_filename);
+      free( path_filename );
+   }
+   /* paths, path */
+   lua_pushvalue(L, -1); /* paths, path, path */
+   lua_setfield(L, t, filename); /* paths, path */
+   path = lua_tostring(L, -1);
+   lua_pop(L, 2); /* The table keeps it alive. */
+   return path;
+}
+
+
+/**
+ * @brief Loads and compiles a module for include().
+ *
+ *    @param L Lua state.
+ *    @param path Path of the module in ndata.
+ *    @param filename Name to use in error messages.
+ *    @param[out] pure Whether the module declared itself pure.
+ *    @return 0 on success with the chunk pushed, otherwise the error is pushed.
+ */
+static int nlua_includeLoad( lua_State *L, const char *path, const char *filename, int *pure )
+{
+   char *buf;
+   size_t bufsize;
+   int ret;
+
+   buf = ndata_read( path, &bufsize );
+   if (buf == NULL) {
+      lua_pushfstring(L, _("include(): %s not found in ndata."), filename);
+      return -1;
+   }
+   *pure = (bufsize >= strlen(NLUA_INCLUDE_PURE)) &&
+         (strncmp( buf, NLUA_INCLUDE_PURE, strlen(NLUA_INCLUDE_PURE) )==0);
+   ret = luaL_loadbuffer(L, buf, bufsize, filename);
+   free(buf);
+   return ret;
+}
+
+
 /**
  * @brief include( string module )
  *
  * Loads a module into the current Lua state from inside the data file.
  *
+ * Modules are only compiled once and the chunk is shared by all the
+ *  environments, each one only runs it. Modules starting with the line
+ *  "--@pure" are only run once, in an environment with the standard
+ *  libraries, and every environment gets the same value. They must return
+ *  everything they export and not rely on the environment including them.
+ *
  *    @param module Name of the module to load.
  *    @return The return value of the chunk, or true.
  */
 static int nlua_packfileLoader( lua_State* L )
 {
-   const char *filename;
-   char *path_filename;
-   char *buf;
-   int len;
-   size_t bufsize;
-   int envtab;
+   const char *filename, *path;
+   int envtab, chunks, pure;
 
    /* Environment table to load module into */
    envtab = lua_upvalueindex(1);
@@ -367,56 +676,92 @@ static int nlua_packfileLoader( lua_State* L )
       lua_setfield(L, envtab, "_include"); /* */
    }
 
-   /* Try to locate the data directly */
-   buf = NULL;
-   if (ndata_exists( filename ))
-      buf = ndata_read( filename, &bufsize );
-   /* If failed to load or doesn't exist try again with INCLUDE_PATH prefix. */
-   if (buf == NULL) {
-      /* Try to locate the data in the data path */
-      len           = strlen(LUA_INCLUDE_PATH)+strlen(filename)+2;
-      path_filename = malloc( len );
-      nsnprintf( path_filename, len, "%s%s", LUA_INCLUDE_PATH, filename );
-      if (ndata_exists( path_filename ))
-         buf = ndata_read( path_filename, &bufsize );
-      free( path_filename );
-   }
-
-   /* Must have buf by now. */
-   if (buf == NULL) {
+   /* Find where it is. */
+   path = nlua_includeResolve( L, filename );
+   if (path == NULL) {
       DEBUG(_("include(): %s not found in ndata."), filename);
       luaL_error(L, _("include(): %s not found in ndata."), filename);
       return 1;
    }
 
-   if (luaL_loadbuffer(L, buf, bufsize, filename) != 0) {
-      lua_error(L);
-      return 1;
-   }
+   /* Pure modules are shared as is. */
+   nlua_includeTable( L, &nlua_includePure ); /* pure */
+   lua_getfield(L, -1, path); /* pure, val */
+   lua_remove(L, -2); /* val */
+   if (lua_isnil(L,-1)) {
+      lua_pop(L, 1); /* */
+
+      /* Get the compiled chunk. It's taken out of the cache while running so
+       * that including it again in the meantime gets its own. */
+      chunks = nlua_includeTable( L, &nlua_includeChunks ); /* chunks */
+      lua_getfield(L, chunks, path); /* chunks, f */
+      pure = 0;
+      if (lua_isnil(L,-1)) {
+         lua_pop(L, 1); /* chunks */
+         if (nlua_includeLoad( L, path, filename, &pure ) != 0) {
+            lua_error(L);
+            return 1;
+         }
+      }
+      else {
+         lua_pushnil(L); /* chunks, f, nil */
+         lua_setfield(L, chunks, path); /* chunks, f */
+      }
 
-   lua_pushvalue(L, envtab);
-   lua_setfenv(L, -2);
+      /* Run it in the environment, or the shared one if pure. */
+      if (pure) {
+         if (nlua_includeEnv == LUA_NOREF) {
+            nlua_includeEnv = nlua_newEnv(0);
+            nlua_setEnvName( nlua_includeEnv, "include" );
+            nlua_loadStandard( nlua_includeEnv );
+         }
+         lua_rawgeti(L, LUA_REGISTRYINDEX, nlua_includeEnv);
+      }
+      else
+         lua_pushvalue(L, envtab);
+      lua_setfenv(L, -2);
+      lua_pushvalue(L, -1); /* chunks, f, f */
+
+      /* run the buffer */
+      if (lua_pcall(L, 0, 1, 0) != 0) {
+         /* will push the current error from the dobuffer */
+         lua_error(L);
+         return 1;
+      }
+      /* chunks, f, val */
+
+      /* Put it back without keeping the environment alive. */
+      if (!pure) {
+         lua_pushvalue(L, LUA_GLOBALSINDEX);
+         lua_setfenv(L, -3);
+         lua_pushvalue(L, -2); /* chunks, f, val, f */
+         lua_setfield(L, chunks, path); /* chunks, f, val */
+      }
+      lua_replace(L, chunks); /* val, f */
+      lua_pop(L, 1); /* val */
 
-   /* run the buffer */
-   if (lua_pcall(L, 0, 1, 0) != 0) {
-      /* will push the current error from the dobuffer */
-      lua_error(L);
-      return 1;
+      if (lua_isnil(L,-1)) {
+         lua_pop(L, 1);
+         lua_pushboolean(L, 1);
+      }
+
+      /* Pure modules don't run again. */
+      if (pure) {
+         nlua_includeTable( L, &nlua_includePure ); /* val, pure */
+         lua_pushvalue(L, -2); /* val, pure, val */
+         lua_setfield(L, -2, path); /* val, pure */
+         lua_pop(L, 1); /* val */
+      }
    }
 
    /* Mark as loaded. */
    /* val */
-   if (lua_isnil(L,-1)) {
-      lua_pop(L, 1);
-      lua_pushboolean(L, 1);
-   }
    lua_getfield(L, envtab, "_include"); /* val, t */
    lua_pushvalue(L, -2); /* val, t, val */
    lua_setfield(L, -2, filename);   /* val, t */
    lua_pop(L, 1); /* val */
 
    /* cleanup, success */
-   free(buf);
    return 1;
 }
 
@@ -454,25 +799,56 @@ static int nlua_packfileLoader( lua_State* L )
 int nlua_loadStandard( nlua_env env )
 {
    int r;
+   nlua_env std;
+
+   /* The libraries are only registered once into a shared table. */
+   if (nlua_stdMeta == LUA_NOREF) {
+      lua_newtable(naevL);
+      std = luaL_ref(naevL, LUA_REGISTRYINDEX);
+
+      r = 0;
+      r |= nlua_loadNaev(std);
+      r |= nlua_loadVar(std);
+      r |= nlua_loadPlanet(std);
+      r |= nlua_loadSystem(std);
+      r |= nlua_loadJump(std);
+      r |= nlua_loadTime(std);
+      r |= nlua_loadPlayer(std);
+      r |= nlua_loadPilot(std);
+      r |= nlua_loadRnd(std);
+      r |= nlua_loadDiff(std);
+      r |= nlua_loadFaction(std);
+      r |= nlua_loadVector(std);
+      r |= nlua_loadOutfit(std);
+      r |= nlua_loadCommodity(std);
+      r |= nlua_loadNews(std);
+      if (r) {
+         luaL_unref(naevL, LUA_REGISTRYINDEX, std);
+         return r;
+      }
+
+      /* Read-only and falling back to the globals. */
+      nlua_pushenv(std);
+      lua_newtable(naevL);
+      lua_pushvalue(naevL, LUA_GLOBALSINDEX);
+      lua_setfield(naevL, -2, "__index");
+      lua_pushcfunction(naevL, nlua_readOnly);
+      lua_setfield(naevL, -2, "__newindex");
+      lua_setmetatable(naevL, -2);
+
+      /* Environments reach it through their metatable. */
+      nlua_stdMeta = nlua_newMeta(lua_gettop(naevL));
+      lua_pop(naevL, 1);
+      luaL_unref(naevL, LUA_REGISTRYINDEX, std);
+   }
+
+   /* Environment variables, such as __RW, stay in the environment. */
+   nlua_pushenv(env);
+   lua_rawgeti(naevL, LUA_REGISTRYINDEX, nlua_stdMeta);
+   lua_setmetatable(naevL, -2);
+   lua_pop(naevL, 1);
 
-   r = 0;
-   r |= nlua_loadNaev(env);
-   r |= nlua_loadVar(env);
-   r |= nlua_loadPlanet(env);
-   r |= nlua_loadSystem(env);
-   r |= nlua_loadJump(env);
-   r |= nlua_loadTime(env);
-   r |= nlua_loadPlayer(env);
-   r |= nlua_loadPilot(env);
-   r |= nlua_loadRnd(env);
-   r |= nlua_loadDiff(env);
-   r |= nlua_loadFaction(env);
-   r |= nlua_loadVector(env);
-   r |= nlua_loadOutfit(env);
-   r |= nlua_loadCommodity(env);
-   r |= nlua_loadNews(env);
-
-   return r;
+   return 0;
 }
 
 
@@ -526,9 +902,11 @@ int nlua_pcall( nlua_env env, int nargs, int nresults ) {
 
    prev_env = __NLUA_CURENV;
    __NLUA_CURENV = env;
+   nlua_profEnter(env);
 
    ret = lua_pcall(naevL, nargs, nresults, errf);
 
+   nlua_profLeave(prev_env);
    __NLUA_CURENV = prev_env;
 
 #if DEBUGGING
@@ -537,3 +915,108 @@ int nlua_pcall( nlua_env env, int nargs, int nresults ) {
 
    return ret;
 }
+
+
+/**
+ * @brief Runs the Lua garbage collector for a frame.
+ *
+ * The first call takes the collector over from Lua so that collections no
+ * longer happen at random allocations. Every frame then collects a bit more
+ * than what was allocated since the previous frame, stopping once the
+ * configured maximum pause is exceeded and carrying the remainder over to
+ * the next frame. If the heap grows too much the pause limit is ignored so
+ * memory stays bounded.
+ *
+ *    @param dt Real time elapsed since the last frame in seconds.
+ */
+void nlua_gcStep( double dt )
+{
+   Uint64 t0, limit, freq;
+   int kb, done, emergency;
+   double ms;
+
+   if (naevL == NULL)
+      return;
+
+   if (!nlua_gcManual) {
+      lua_gc( naevL, LUA_GCSTOP, 0 );
+      nlua_gcManual = 1;
+      nlua_gcLast   = lua_gc( naevL, LUA_GCCOUNT, 0 );
+      nlua_gcBase   = nlua_gcLast;
+   }
+
+   freq  = SDL_GetPerformanceFrequency();
+   t0    = SDL_GetPerformanceCounter();
+   limit = t0 + (Uint64)(conf.lua_gcpause / 1000. * (double)freq);
+
+   /* Work owed is proportional to what was allocated. */
+   kb = lua_gc( naevL, LUA_GCCOUNT, 0 );
+   if (kb > nlua_gcLast)
+      nlua_gcDebt += NLUA_GC_STEPMUL * (kb - nlua_gcLast);
+   nlua_gcDebt += NLUA_GC_MINSTEP;
+   emergency = (kb > NLUA_GC_EMERGENCY * MAX(nlua_gcBase, 1024));
+
+   while (nlua_gcDebt > 0.) {
+      /* Lua restarts its own collector after stepping. */
+      done = lua_gc( naevL, LUA_GCSTEP, NLUA_GC_STEPSIZE );
+      lua_gc( naevL, LUA_GCSTOP, 0 );
+      nlua_gcDebt -= NLUA_GC_STEPSIZE;
+      if (done) {
+         nlua_gcBase = lua_gc( naevL, LUA_GCCOUNT, 0 );
+         /* Nothing left to owe once a cycle finishes. */
+         nlua_gcDebt = 0.;
+         break;
+      }
+      if (!emergency && (SDL_GetPerformanceCounter() >= limit))
+         break;
+   }
+   /* Don't let the debt pile up forever when the heap is idle. */
+   nlua_gcDebt = CLAMP( 0., NLUA_GC_EMERGENCY * MAX(nlua_gcBase, 1024), nlua_gcDebt );
+   nlua_gcLast = lua_gc( naevL, LUA_GCCOUNT, 0 );
+
+   /* Statistics. */
+   ms = 1000. * (double)(SDL_GetPerformanceCounter() - t0) / (double)freq;
+   nlua_gcAcc   += ms;
+   nlua_gcFrames++;
+   nlua_gcMaxAcc = MAX( nlua_gcMaxAcc, ms );
+   nlua_gcPeriod += dt;
+   if (nlua_gcPeriod > 1.) {
+      nlua_gcMs      = nlua_gcAcc / (double)nlua_gcFrames;
+      nlua_gcMax     = nlua_gcMaxAcc;
+      nlua_gcAcc     = 0.;
+      nlua_gcMaxAcc  = 0.;
+      nlua_gcFrames  = 0;
+      nlua_gcPeriod  = 0.;
+   }
+}
+
+
+/**
+ * @brief Hands the Lua garbage collector back to Lua.
+ *
+ * Used before running a lot of Lua outside of the frame loop (loading data,
+ * saves or landing) so that the heap doesn't grow unbounded while nothing is
+ * stepping the collector. The next nlua_gcStep() takes it over again.
+ */
+void nlua_gcAuto (void)
+{
+   if ((naevL == NULL) || !nlua_gcManual)
+      return;
+   lua_gc( naevL, LUA_GCRESTART, 0 );
+   nlua_gcManual = 0;
+   nlua_gcDebt   = 0.;
+}
+
+
+/**
+ * @brief Gets the time spent in the Lua garbage collector.
+ *
+ *    @param[out] max Longest collection in milliseconds over the last second.
+ *    @return Average collection time per frame in milliseconds over the last second.
+ */
+double nlua_gcTime( double *max )
+{
+   if (max != NULL)
+      *max = nlua_gcMax;
+   return nlua_gcMs;
+}
@@ -24,6 +24,8 @@ void lua_init(void);
 void lua_exit(void);
 nlua_env nlua_newEnv(int rw);
 void nlua_freeEnv(nlua_env env);
+void nlua_setEnvName(nlua_env env, const char *fmt, ...);
+const char* nlua_getEnvName(nlua_env env);
 void nlua_pushenv(nlua_env env);
 void nlua_setenv(nlua_env env, const char *name);
 void nlua_getenv(nlua_env env, const char *name);
@@ -34,7 +36,16 @@ int nlua_dobufenv(nlua_env env,
                   size_t sz,
                   const char *name);
 int nlua_dofileenv(nlua_env env, const char *filename);
+int nlua_dochunkenv(nlua_env env, int *chunk, const char *filename);
+void nlua_freeChunk(int *chunk);
 int nlua_loadStandard( nlua_env env );
 int nlua_pcall( nlua_env env, int nargs, int nresults );
 
+/*
+ * garbage collection
+ */
+void nlua_gcStep( double dt );
+void nlua_gcAuto (void);
+double nlua_gcTime( double *max );
+
 #endif /* NLUA_H */
@@ -17,10 +17,32 @@
 #include "nluadef.h"
 #include "log.h"
 #include "mission.h"
+#include "console.h"
+#include "cond.h"
+#include "hook.h"
+#include "nmem.h"
+#include "opengl.h"
+#include "nlua_prof.h"
+#include "nfile.h"
+#include "nstring.h"
 
 
 /* CLI */
+static int cli_memory( lua_State *L );
+static int cli_profStart( lua_State *L );
+static int cli_profStop( lua_State *L );
+static int cli_profReport( lua_State *L );
+static int cli_profClear( lua_State *L );
+static int cli_condStats( lua_State *L );
+static int cli_hookTimers( lua_State *L );
 static const luaL_Reg cli_methods[] = {
+   { "memory", cli_memory },
+   { "profStart", cli_profStart },
+   { "profStop", cli_profStop },
+   { "profReport", cli_profReport },
+   { "profClear", cli_profClear },
+   { "condStats", cli_condStats },
+   { "hookTimers", cli_hookTimers },
    {0,0}
 }; /**< CLI Lua methods. */
 
@@ -37,3 +59,146 @@ int nlua_loadCLI( nlua_env env )
    return 0;
 }
 
+
+
+/**
+ * @brief Displays the memory used by each subsystem and Lua environment.
+ *
+ * Also shows how the texture cache is doing.
+ *
+ * @usage cli.memory() -- Prints memory usage to the console
+ * @usage cli.memory( "memory.json" ) -- Also writes a JSON report
+ *
+ *    @luatparam[opt] string filename File to write a JSON report to.
+ *    @luatreturn boolean true on success.
+ * @luafunc memory( filename )
+ */
+static int cli_memory( lua_State *L )
+{
+   const char *filename;
+
+   nmem_print( cli_addMessage );
+   gl_texPrint( cli_addMessage );
+
+   filename = luaL_optstring(L, 1, NULL);
+   if (filename != NULL) {
+      lua_pushboolean( L, nmem_report( filename )==0 );
+      return 1;
+   }
+
+   lua_pushboolean( L, 1 );
+   return 1;
+}
+
+
+/**
+ * @brief Starts the Lua profiler.
+ *
+ * Samples keep on accumulating over several runs until cleared.
+ *
+ * @usage cli.profStart() -- Samples every millisecond
+ * @usage cli.profStart( 0.5 ) -- Samples every half millisecond
+ *
+ *    @luatparam[opt=1] number interval Sampling interval in milliseconds.
+ * @luafunc profStart( interval )
+ */
+static int cli_profStart( lua_State *L )
+{
+   double interval = luaL_optnumber(L, 1, NLUA_PROF_INTERVAL);
+   nlua_profStart( interval );
+   return 0;
+}
+
+
+/**
+ * @brief Stops the Lua profiler.
+ *
+ * @usage cli.profStop()
+ *
+ * @luafunc profStop()
+ */
+static int cli_profStop( lua_State *L )
+{
+   (void) L;
+   nlua_profStop();
+   return 0;
+}
+
+
+/**
+ * @brief Writes the Lua profiler report.
+ *
+ * The report has the time spent in each environment, a flat profile and a
+ * call tree.
+ *
+ * @usage cli.profReport() -- Writes lua_profile.txt to the user data directory
+ * @usage cli.profReport( "/tmp/profile.txt" )
+ *
+ *    @luatparam[opt] string filename File to write the report to.
+ *    @luatreturn boolean true on success.
+ * @luafunc profReport( filename )
+ */
+static int cli_profReport( lua_State *L )
+{
+   char buf[PATH_MAX];
+   const char *filename;
+
+   filename = luaL_optstring(L, 1, NULL);
+   if (filename == NULL) {
+      nsnprintf( buf, sizeof(buf), "%slua_profile.txt", nfile_dataPath() );
+      filename = buf;
+   }
+   lua_pushboolean( L, nlua_profReport( filename )==0 );
+   return 1;
+}
+
+
+/**
+ * @brief Clears the samples of the Lua profiler.
+ *
+ * @usage cli.profClear()
+ *
+ * @luafunc profClear()
+ */
+static int cli_profClear( lua_State *L )
+{
+   (void) L;
+   nlua_profClear();
+   return 0;
+}
+
+
+/**
+ * @brief Displays how the mission and event conditions are doing.
+ *
+ * Shows how many conditions were compiled, how many checks found them
+ * already compiled and the time spent checking them.
+ *
+ * @usage cli.condStats()
+ *
+ * @luafunc condStats()
+ */
+static int cli_condStats( lua_State *L )
+{
+   (void) L;
+   cond_printStats( cli_addMessage );
+   return 0;
+}
+
+
+/**
+ * @brief Displays the upcoming timer and date hooks.
+ *
+ * Shows when the next hooks will fire and the function they will run.
+ *
+ * @usage cli.hookTimers() -- Shows the next 20 of each
+ * @usage cli.hookTimers( 50 )
+ *
+ *    @luatparam[opt=20] number max Maximum number of hooks of each kind to show.
+ * @luafunc hookTimers( max )
+ */
+static int cli_hookTimers( lua_State *L )
+{
+   hooks_printScheduled( cli_addMessage, luaL_optinteger( L, 1, 20 ) );
+   return 0;
+}
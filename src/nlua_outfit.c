@@ -327,7 +327,7 @@ static int outfitL_slot( lua_State *L )
 static int outfitL_icon( lua_State *L )
 {
    Outfit *o = luaL_validoutfit(L,1);
-   lua_pushtex( L, gl_dupTexture( o->gfx_store ) );
+   lua_pushtex( L, gl_dupTexture( outfit_gfxStore( o ) ) );
    return 1;
 }
 
@@ -54,10 +54,36 @@ extern int pilot_nstack;
 extern Pilot *cur_pilot;
 
 
+#define PILOTL_CACHE             "pilot_cache" /**< Registry field of the shared pilot userdata. */
+#define PILOTL_FILTER_FACTIONS   32 /**< Maximum factions a pilot filter can have. */
+
+
+/**
+ * @brief Filter for pilot.iter() and pilot.getInRange().
+ */
+typedef struct PilotFilter_ {
+   int factions[ PILOTL_FILTER_FACTIONS ]; /**< Factions to match. */
+   int nfactions; /**< Number of factions, 0 to match all. */
+   int disabled; /**< Whether or not to match disabled pilots. */
+   int hostile; /**< Whether they must be hostile to the player, -1 to ignore. */
+   unsigned int detected; /**< Pilot that must detect them, 0 to ignore. */
+   unsigned int exclude; /**< Pilot to skip, 0 for none. */
+   int range; /**< Whether or not to check the range. */
+   Vector2d pos; /**< Centre of the range. */
+   double r2; /**< Squared radius of the range. */
+} PilotFilter;
+
+
 /*
  * Prototypes.
  */
 static Task *pilotL_newtask( lua_State *L, Pilot* p, const char *task );
+static void pilotL_pushCached( lua_State *L, unsigned int id );
+static void pilotL_parseFilter( lua_State *L, int ind, PilotFilter *f );
+static int pilotL_matchFilter( const PilotFilter *f, const Pilot *p, const Pilot *detector );
+static int pilotL_iterNext( lua_State *L );
+static Vector2d* pilotL_checkPos( lua_State *L, int ind );
+static int pilotL_pushVector( lua_State *L, int ind, const Vector2d *v );
 static int pilotL_addFleetFrom( lua_State *L, int from_ship );
 static int outfit_compareActive( const void *slot1, const void *slot2 );
 
@@ -69,6 +95,8 @@ static int pilotL_remove( lua_State *L );
 static int pilotL_clear( lua_State *L );
 static int pilotL_toggleSpawn( lua_State *L );
 static int pilotL_getPilots( lua_State *L );
+static int pilotL_iter( lua_State *L );
+static int pilotL_getInRange( lua_State *L );
 static int pilotL_eq( lua_State *L );
 static int pilotL_name( lua_State *L );
 static int pilotL_id( lua_State *L );
@@ -85,6 +113,9 @@ static int pilotL_rename( lua_State *L );
 static int pilotL_position( lua_State *L );
 static int pilotL_velocity( lua_State *L );
 static int pilotL_dir( lua_State *L );
+static int pilotL_distance( lua_State *L );
+static int pilotL_distance2( lua_State *L );
+static int pilotL_angleTo( lua_State *L );
 static int pilotL_ew( lua_State *L );
 static int pilotL_temp( lua_State *L );
 static int pilotL_faction( lua_State *L );
@@ -158,6 +189,8 @@ static const luaL_Reg pilotL_methods[] = {
    { "add", pilotL_addFleet },
    { "rm", pilotL_remove },
    { "get", pilotL_getPilots },
+   { "iter", pilotL_iter },
+   { "getInRange", pilotL_getInRange },
    { "__eq", pilotL_eq },
    /* Info. */
    { "name", pilotL_name },
@@ -175,6 +208,9 @@ static const luaL_Reg pilotL_methods[] = {
    { "pos", pilotL_position },
    { "vel", pilotL_velocity },
    { "dir", pilotL_dir },
+   { "dist", pilotL_distance },
+   { "dist2", pilotL_distance2 },
+   { "angleTo", pilotL_angleTo },
    { "ew", pilotL_ew },
    { "temp", pilotL_temp },
    { "cooldown", pilotL_cooldown },
@@ -815,6 +851,279 @@ static int pilotL_getPilots( lua_State *L )
    return 1;
 }
 
+/**
+ * @brief Pushes a pilot, reusing the userdata if it's still alive.
+ *
+ * Pilot IDs are never reused so the userdata can be shared. This keeps
+ *  iterating over pilots from creating garbage.
+ *
+ *    @param L Lua state.
+ *    @param id ID of the pilot to push.
+ */
+static void pilotL_pushCached( lua_State *L, unsigned int id )
+{
+   lua_getfield(L, LUA_REGISTRYINDEX, PILOTL_CACHE); /* t */
+   if (lua_isnil(L,-1)) {
+      lua_pop(L,1);
+      lua_newtable(L); /* t */
+      lua_newtable(L); /* t, mt */
+      lua_pushstring(L, "v");
+      lua_setfield(L, -2, "__mode");
+      lua_setmetatable(L, -2); /* t */
+      lua_pushvalue(L, -1); /* t, t */
+      lua_setfield(L, LUA_REGISTRYINDEX, PILOTL_CACHE); /* t */
+   }
+   lua_rawgeti(L, -1, id); /* t, p */
+   if (lua_isnil(L,-1)) {
+      lua_pop(L,1); /* t */
+      lua_pushpilot(L, id); /* t, p */
+      lua_pushvalue(L, -1); /* t, p, p */
+      lua_rawseti(L, -3, id); /* t, p */
+   }
+   lua_remove(L, -2); /* p */
+}
+
+
+/**
+ * @brief Parses a pilot filter table.
+ *
+ *    @param L Lua state.
+ *    @param ind Index of the filter table, may be nil or none.
+ *    @param[out] f Filter to fill out.
+ */
+static void pilotL_parseFilter( lua_State *L, int ind, PilotFilter *f )
+{
+   memset( f, 0, sizeof(PilotFilter) );
+   f->hostile = -1;
+
+   if (lua_isnoneornil(L,ind))
+      return;
+   luaL_checktype(L, ind, LUA_TTABLE);
+
+   /* Factions. */
+   lua_getfield(L, ind, "faction");
+   if (lua_isfaction(L,-1))
+      f->factions[ f->nfactions++ ] = lua_tofaction(L,-1);
+   else if (lua_istable(L,-1)) {
+      lua_pushnil(L);
+      while (lua_next(L, -2) != 0) {
+         if (lua_isfaction(L,-1)) {
+            if (f->nfactions < PILOTL_FILTER_FACTIONS)
+               f->factions[ f->nfactions++ ] = lua_tofaction(L,-1);
+            else
+               WARN(_("Pilot filter has more than %d factions, ignoring the rest."),
+                     PILOTL_FILTER_FACTIONS);
+         }
+         lua_pop(L,1);
+      }
+   }
+   else if (!lua_isnil(L,-1))
+      luaL_error( L, "Invalid parameter for %s.", __func__ );
+   lua_pop(L,1);
+
+   /* Flags. */
+   lua_getfield(L, ind, "disabled");
+   f->disabled = lua_toboolean(L,-1);
+   lua_pop(L,1);
+   lua_getfield(L, ind, "hostile");
+   if (!lua_isnil(L,-1))
+      f->hostile = lua_toboolean(L,-1);
+   lua_pop(L,1);
+
+   /* Pilots. */
+   lua_getfield(L, ind, "detectedBy");
+   if (!lua_isnil(L,-1))
+      f->detected = luaL_validpilot(L,-1)->id;
+   lua_pop(L,1);
+   lua_getfield(L, ind, "exclude");
+   if (!lua_isnil(L,-1))
+      f->exclude = luaL_checkpilot(L,-1);
+   lua_pop(L,1);
+}
+
+
+/**
+ * @brief Checks to see if a pilot matches a filter.
+ *
+ *    @param f Filter to match.
+ *    @param p Pilot to check.
+ *    @param detector Pilot that must detect it or NULL.
+ *    @return 1 if it matches.
+ */
+static int pilotL_matchFilter( const PilotFilter *f, const Pilot *p, const Pilot *detector )
+{
+   int i;
+   double dx, dy;
+
+   if (pilot_isFlag(p, PILOT_DELETE))
+      return 0;
+   if (p->id == f->exclude)
+      return 0;
+   if (!f->disabled && pilot_isDisabled(p))
+      return 0;
+
+   /* Cheap range check before the rest. */
+   if (f->range) {
+      dx = p->solid->pos.x - f->pos.x;
+      dy = p->solid->pos.y - f->pos.y;
+      if (dx*dx + dy*dy > f->r2)
+         return 0;
+   }
+
+   if (f->nfactions > 0) {
+      for (i=0; i<f->nfactions; i++)
+         if (p->faction == f->factions[i])
+            break;
+      if (i >= f->nfactions)
+         return 0;
+   }
+
+   if ((f->hostile >= 0) && (!pilot_isHostile(p) != !f->hostile))
+      return 0;
+
+   if ((detector != NULL) && (p != detector) &&
+         (pilot_inRangePilot( detector, p ) == 0))
+      return 0;
+
+   return 1;
+}
+
+
+/**
+ * @brief Gets the next pilot for pilot.iter().
+ */
+static int pilotL_iterNext( lua_State *L )
+{
+   PilotFilter *f;
+   Pilot **pilots, *detector;
+   unsigned int last;
+   int n, i, lo, hi;
+
+   f = lua_touserdata(L,1);
+   if ((f == NULL) || (lua_objlen(L,1) != sizeof(PilotFilter))) {
+      NLUA_INVALID_PARAMETER(L);
+      return 0;
+   }
+   last = lua_isnoneornil(L,2) ? 0 : luaL_checkpilot(L,2);
+
+   /* The sensors may have gone away. */
+   detector = NULL;
+   if (f->detected != 0) {
+      detector = pilot_get( f->detected );
+      if (detector == NULL)
+         return 0;
+   }
+
+   /* The stack is sorted by ID, so continue after the last one even if the
+    * stack changed while iterating. */
+   pilots = pilot_getAll( &n );
+   lo = 0;
+   hi = n;
+   while (lo < hi) {
+      i = (lo + hi) / 2;
+      if (pilots[i]->id <= last)
+         lo = i+1;
+      else
+         hi = i;
+   }
+
+   for (i=lo; i<n; i++) {
+      if (!pilotL_matchFilter( f, pilots[i], detector ))
+         continue;
+      pilotL_pushCached( L, pilots[i]->id );
+      return 1;
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Iterates over the pilots in the system matching a filter.
+ *
+ * Unlike pilot.get() it doesn't build a table, so it's better suited for
+ *  loops that run often or stop early.
+ *
+ * The filter can have the fields:
+ *  - faction: Faction or table of factions the pilots must belong to.
+ *  - disabled: Whether or not to include disabled pilots (off by default).
+ *  - hostile: If set, whether or not the pilots must be hostile to the player.
+ *  - detectedBy: Pilot whose sensors must detect the pilots.
+ *  - exclude: Pilot to skip.
+ *
+ * @usage for p in pilot.iter() do -- All the pilots
+ * @usage for p in pilot.iter{ faction=faction.get("Pirate"), detectedBy=player.pilot() } do
+ *
+ *    @luatparam[opt] table filter Filter the pilots must match.
+ *    @luatreturn function Iterator over the matching pilots.
+ * @luafunc iter( filter )
+ */
+static int pilotL_iter( lua_State *L )
+{
+   PilotFilter f, *ud;
+
+   pilotL_parseFilter( L, 1, &f );
+
+   lua_pushcfunction(L, pilotL_iterNext);
+   ud = lua_newuserdata(L, sizeof(PilotFilter));
+   *ud = f;
+   lua_pushnil(L);
+   return 3;
+}
+
+
+/**
+ * @brief Gets the pilots within a radius of a position.
+ *
+ * Takes the same filter as pilot.iter() and checks it in C, so only the
+ *  pilots that match end up in the table.
+ *
+ * @usage p = pilot.getInRange( player.pilot():pos(), 3000 ) -- Pilots near the player
+ * @usage p = pilot.getInRange( target, 1000, { hostile=true, exclude=target } )
+ *
+ *    @luatparam Vec2|Pilot pos Position or pilot to get the pilots around.
+ *    @luatparam number radius Distance from the position.
+ *    @luatparam[opt] table filter Filter the pilots must match.
+ *    @luatreturn {Pilot,...} A table containing the pilots.
+ * @luafunc getInRange( pos, radius, filter )
+ */
+static int pilotL_getInRange( lua_State *L )
+{
+   PilotFilter f;
+   Pilot **pilots, *detector;
+   double r;
+   int i, n, k;
+
+   pilotL_parseFilter( L, 3, &f );
+   if (lua_ispilot(L,1))
+      f.pos = luaL_validpilot(L,1)->solid->pos;
+   else
+      f.pos = *luaL_checkvector(L,1);
+   r = luaL_checknumber(L,2);
+   f.range = 1;
+   f.r2    = r*r;
+
+   lua_newtable(L);
+
+   /* Nothing is detected by sensors that went away. */
+   detector = NULL;
+   if (f.detected != 0) {
+      detector = pilot_get( f.detected );
+      if (detector == NULL)
+         return 1;
+   }
+
+   k = 1;
+   pilots = pilot_getAll( &n );
+   for (i=0; i<n; i++) {
+      if (!pilotL_matchFilter( &f, pilots[i], detector ))
+         continue;
+      pilotL_pushCached( L, pilots[i]->id );
+      lua_rawseti(L, -2, k++);
+   }
+   return 1;
+}
+
+
 /**
  * @brief Checks to see if pilot and p are the same.
  *
@@ -1637,14 +1946,53 @@ static int pilotL_rename( lua_State *L )
    return 0;
 }
 
+/**
+ * @brief Gets a position from a pilot or a vector.
+ *
+ *    @param L Lua state to get position from.
+ *    @param ind Index of the pilot or vector.
+ *    @return The position at ind.
+ */
+static Vector2d* pilotL_checkPos( lua_State *L, int ind )
+{
+   if (lua_isvector(L,ind))
+      return lua_tovector(L,ind);
+   return &luaL_validpilot(L,ind)->solid->pos;
+}
+
+
+/**
+ * @brief Pushes a vector, reusing the vector at ind if there is one.
+ *
+ *    @param L Lua state to push vector onto.
+ *    @param ind Index of the optional output vector.
+ *    @param v Value of the vector.
+ *    @return Number of values pushed.
+ */
+static int pilotL_pushVector( lua_State *L, int ind, const Vector2d *v )
+{
+   if (lua_isvector(L,ind)) {
+      *lua_tovector(L,ind) = *v;
+      lua_pushvalue(L,ind);
+   }
+   else
+      lua_pushvector(L,*v);
+   return 1;
+}
+
+
 /**
  * @brief Gets the pilot's position.
  *
+ * Passing a vector stores the position in it instead of creating a new one.
+ *
  * @usage v = p:pos()
+ * @usage p:pos( v ) -- v is now the position of p
  *
  *    @luatparam Pilot p Pilot to get the position of.
+ *    @luatparam[opt] Vec2 out Vector to store the position in.
  *    @luatreturn Vec2 The pilot's current position.
- * @luafunc pos( p )
+ * @luafunc pos( p, out )
  */
 static int pilotL_position( lua_State *L )
 {
@@ -1654,18 +2002,21 @@ static int pilotL_position( lua_State *L )
    p     = luaL_validpilot(L,1);
 
    /* Push position. */
-   lua_pushvector(L, p->solid->pos);
-   return 1;
+   return pilotL_pushVector(L, 2, &p->solid->pos);
 }
 
 /**
  * @brief Gets the pilot's velocity.
  *
+ * Passing a vector stores the velocity in it instead of creating a new one.
+ *
  * @usage vel = p:vel()
+ * @usage p:vel( v ) -- v is now the velocity of p
  *
  *    @luatparam Pilot p Pilot to get the velocity of.
+ *    @luatparam[opt] Vec2 out Vector to store the velocity in.
  *    @luatreturn Vec2 The pilot's current velocity.
- * @luafunc vel( p )
+ * @luafunc vel( p, out )
  */
 static int pilotL_velocity( lua_State *L )
 {
@@ -1675,8 +2026,7 @@ static int pilotL_velocity( lua_State *L )
    p     = luaL_validpilot(L,1);
 
    /* Push velocity. */
-   lua_pushvector(L, p->solid->vel);
-   return 1;
+   return pilotL_pushVector(L, 2, &p->solid->vel);
 }
 
 /**
@@ -1721,6 +2071,76 @@ static int pilotL_dir( lua_State *L )
    return 1;
 }
 
+/**
+ * @brief Gets the distance from the pilot to a pilot or position.
+ *
+ * @usage d = p:dist( target ) -- Same as vec2.dist( p:pos(), target:pos() )
+ *
+ *    @luatparam Pilot p Pilot to get the distance from.
+ *    @luatparam Pilot|Vec2 target Pilot or position to get the distance to.
+ *    @luatreturn number The distance between both.
+ * @luafunc dist( p, target )
+ */
+static int pilotL_distance( lua_State *L )
+{
+   Pilot *p;
+   Vector2d *v;
+
+   /* Parse parameters */
+   p     = luaL_validpilot(L,1);
+   v     = pilotL_checkPos(L,2);
+
+   lua_pushnumber( L, vect_dist( &p->solid->pos, v ) );
+   return 1;
+}
+
+/**
+ * @brief Gets the squared distance from the pilot to a pilot or position (saves a sqrt()).
+ *
+ * @usage d2 = p:dist2( target )
+ *
+ *    @luatparam Pilot p Pilot to get the distance from.
+ *    @luatparam Pilot|Vec2 target Pilot or position to get the distance to.
+ *    @luatreturn number The squared distance between both.
+ * @luafunc dist2( p, target )
+ */
+static int pilotL_distance2( lua_State *L )
+{
+   Pilot *p;
+   Vector2d *v;
+
+   /* Parse parameters */
+   p     = luaL_validpilot(L,1);
+   v     = pilotL_checkPos(L,2);
+
+   lua_pushnumber( L, vect_dist2( &p->solid->pos, v ) );
+   return 1;
+}
+
+/**
+ * @brief Gets the angle from the pilot to a pilot or position.
+ *
+ * @usage a = p:angleTo( target ) -- Same as (target:pos() - p:pos()):polar()
+ *
+ *    @luatparam Pilot p Pilot to get the angle from.
+ *    @luatparam Pilot|Vec2 target Pilot or position to get the angle to.
+ *    @luatreturn number The angle to the target (in degrees).
+ * @luafunc angleTo( p, target )
+ */
+static int pilotL_angleTo( lua_State *L )
+{
+   Pilot *p;
+   Vector2d *v;
+
+   /* Parse parameters */
+   p     = luaL_validpilot(L,1);
+   v     = pilotL_checkPos(L,2);
+
+   lua_pushnumber( L, ANGLE( v->x - p->solid->pos.x,
+         v->y - p->solid->pos.y ) * 180./M_PI );
+   return 1;
+}
+
 /**
  * @brief Gets the temperature of a pilot.
  *
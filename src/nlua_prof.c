@@ -0,0 +1,582 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file nlua_prof.c
+ *
+ * @brief Sampling profiler for Lua code.
+ *
+ * A count hook is installed on the Lua state, and every time it fires after
+ * the sampling interval has elapsed the Lua stack is walked and the elapsed
+ * time is added to a call tree. Trees are kept per environment name (mission,
+ * event, AI profile, GUI, ...). Besides the samples, the exact time spent in
+ * each environment is measured by nlua_pcall() through nlua_profEnter() and
+ * nlua_profLeave().
+ */
+
+
+#include "nlua_prof.h"
+
+#include "naev.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "nstring.h"
+
+#include "SDL.h"
+
+#include "log.h"
+#include "array.h"
+
+
+#define PROF_HOOK_COUNT    1000 /**< Instructions between hook calls. */
+#define PROF_MAX_DEPTH     64 /**< Maximum stack depth to record. */
+#define PROF_TREE_MIN      0.001 /**< Minimum fraction of the time for a node to be written in the tree. */
+
+
+/**
+ * @brief Node of the call tree.
+ */
+typedef struct ProfNode_ {
+   char *name; /**< Function name and location. */
+   int child; /**< First child or -1. */
+   int sibling; /**< Next sibling or -1. */
+   double self; /**< Time sampled in the function itself. */
+   double total; /**< Time sampled in the function and its callees. */
+} ProfNode;
+
+/**
+ * @brief Profiling information of an environment.
+ */
+typedef struct ProfEnv_ {
+   char *name; /**< Name of the environment. */
+   double time; /**< Time measured running in the environment. */
+   unsigned long calls; /**< Number of calls into the environment. */
+   int root; /**< Root node of the call tree. */
+} ProfEnv;
+
+/**
+ * @brief Entry of the flat profile.
+ */
+typedef struct ProfFlat_ {
+   const char *name; /**< Function name and location. */
+   double self; /**< Time sampled in the function itself. */
+   double total; /**< Time sampled in the function and its callees. */
+} ProfFlat;
+
+
+static int prof_active        = 0; /**< Whether or not profiling. */
+static Uint64 prof_interval   = 0; /**< Sampling interval in performance counter ticks. */
+static Uint64 prof_last       = 0; /**< Time of the last sample. */
+static Uint64 prof_switch     = 0; /**< Time of the last environment switch. */
+static Uint64 prof_start      = 0; /**< Time profiling started. */
+static double prof_elapsed    = 0.; /**< Time profiled in previous runs. */
+static int prof_depth         = 0; /**< Depth of nested nlua_pcall. */
+static int prof_curenv        = -1; /**< Environment currently running. */
+static ProfNode *prof_nodes   = NULL; /**< Call tree nodes. */
+static ProfEnv *prof_envs     = NULL; /**< Profiled environments. */
+static int *prof_envcache     = NULL; /**< Environment reference to index cache. */
+static int prof_nenvcache     = 0; /**< Size of prof_envcache. */
+
+
+/*
+ * Prototypes.
+ */
+static double prof_seconds( Uint64 ticks );
+static int prof_newNode( const char *name );
+static int prof_child( int parent, const char *name );
+static int prof_envIndex( nlua_env env );
+static void prof_frameName( char *buf, size_t len, const lua_Debug *ar );
+static void prof_hook( lua_State *L, lua_Debug *ar );
+static int prof_sortNodes( const void *p1, const void *p2 );
+static int prof_sortEnvs( const void *p1, const void *p2 );
+static int prof_sortFlat( const void *p1, const void *p2 );
+static void prof_flatten( ProfFlat **flat, int node, const char **path, int depth );
+static void prof_writeTree( FILE *f, int node, int depth, double min );
+
+
+/**
+ * @brief Converts performance counter ticks to seconds.
+ */
+static double prof_seconds( Uint64 ticks )
+{
+   return (double)ticks / (double)SDL_GetPerformanceFrequency();
+}
+
+
+/**
+ * @brief Creates a new call tree node.
+ */
+static int prof_newNode( const char *name )
+{
+   ProfNode *n;
+
+   if (prof_nodes == NULL)
+      prof_nodes = array_create( ProfNode );
+   n = &array_grow( &prof_nodes );
+   n->name     = strdup( name );
+   n->child    = -1;
+   n->sibling  = -1;
+   n->self     = 0.;
+   n->total    = 0.;
+   return array_size(prof_nodes)-1;
+}
+
+
+/**
+ * @brief Gets or creates the child of a node.
+ */
+static int prof_child( int parent, const char *name )
+{
+   int i, n;
+
+   for (i=prof_nodes[parent].child; i>=0; i=prof_nodes[i].sibling)
+      if (strcmp( prof_nodes[i].name, name )==0)
+         return i;
+
+   /* Note that the array may move. */
+   n = prof_newNode( name );
+   prof_nodes[n].sibling      = prof_nodes[parent].child;
+   prof_nodes[parent].child   = n;
+   return n;
+}
+
+
+/**
+ * @brief Gets the profiling information index of an environment.
+ *
+ * Environments are merged by name, so all the instances of a mission are
+ * accounted together.
+ */
+static int prof_envIndex( nlua_env env )
+{
+   const char *name;
+   ProfEnv *e;
+   int i, n;
+
+   name = nlua_getEnvName( env );
+   if (name == NULL)
+      name = (env == LUA_NOREF) ? "global" : "unnamed";
+
+   /* Try cache first. */
+   if ((env >= 0) && (env < prof_nenvcache) && (prof_envcache[env] > 0)) {
+      i = prof_envcache[env]-1;
+      if (strcmp( prof_envs[i].name, name )==0)
+         return i;
+   }
+
+   /* Look up. */
+   if (prof_envs == NULL)
+      prof_envs = array_create( ProfEnv );
+   for (i=0; i<array_size(prof_envs); i++)
+      if (strcmp( prof_envs[i].name, name )==0)
+         break;
+   if (i >= array_size(prof_envs)) {
+      e = &array_grow( &prof_envs );
+      e->name  = strdup( name );
+      e->time  = 0.;
+      e->calls = 0;
+      e->root  = prof_newNode( name );
+   }
+
+   /* Update cache. */
+   if (env >= 0) {
+      if (env >= prof_nenvcache) {
+         n = MAX( 2*prof_nenvcache, env+1 );
+         prof_envcache = realloc( prof_envcache, n*sizeof(int) );
+         memset( &prof_envcache[prof_nenvcache], 0, (n-prof_nenvcache)*sizeof(int) );
+         prof_nenvcache = n;
+      }
+      prof_envcache[env] = i+1;
+   }
+   return i;
+}
+
+
+/**
+ * @brief Starts profiling Lua.
+ *
+ * Samples are accumulated with those of previous runs until nlua_profClear()
+ * is called.
+ *
+ *    @param interval Sampling interval in milliseconds.
+ *    @return 0 on success.
+ */
+int nlua_profStart( double interval )
+{
+   if (naevL == NULL)
+      return -1;
+   if (interval <= 0.)
+      interval = NLUA_PROF_INTERVAL;
+
+   prof_interval  = (Uint64)(interval / 1000. * (double)SDL_GetPerformanceFrequency());
+   prof_start     = SDL_GetPerformanceCounter();
+   prof_last      = prof_start;
+   prof_switch    = prof_start;
+   prof_depth     = 0;
+   prof_curenv    = -1;
+   prof_active    = 1;
+   lua_sethook( naevL, prof_hook, LUA_MASKCOUNT, PROF_HOOK_COUNT );
+   return 0;
+}
+
+
+/**
+ * @brief Stops profiling Lua.
+ */
+void nlua_profStop (void)
+{
+   if (!prof_active)
+      return;
+   prof_elapsed  += prof_seconds( SDL_GetPerformanceCounter() - prof_start );
+   prof_active    = 0;
+   if (naevL != NULL)
+      lua_sethook( naevL, NULL, 0, 0 );
+}
+
+
+/**
+ * @brief Clears the profiling data.
+ */
+void nlua_profClear (void)
+{
+   int i;
+
+   if (prof_nodes != NULL) {
+      for (i=0; i<array_size(prof_nodes); i++)
+         free( prof_nodes[i].name );
+      array_free( prof_nodes );
+      prof_nodes = NULL;
+   }
+   if (prof_envs != NULL) {
+      for (i=0; i<array_size(prof_envs); i++)
+         free( prof_envs[i].name );
+      array_free( prof_envs );
+      prof_envs = NULL;
+   }
+   free( prof_envcache );
+   prof_envcache  = NULL;
+   prof_nenvcache = 0;
+   prof_curenv    = -1;
+   prof_elapsed   = 0.;
+   prof_start     = SDL_GetPerformanceCounter();
+}
+
+
+/**
+ * @brief Checks to see if profiling.
+ *
+ *    @return 1 if profiling.
+ */
+int nlua_profActive (void)
+{
+   return prof_active;
+}
+
+
+/**
+ * @brief Marks entering an environment.
+ *
+ *    @param env Environment being entered.
+ */
+void nlua_profEnter( nlua_env env )
+{
+   Uint64 now;
+
+   if (!prof_active)
+      return;
+
+   now = SDL_GetPerformanceCounter();
+   if ((prof_depth > 0) && (prof_curenv >= 0))
+      prof_envs[ prof_curenv ].time += prof_seconds( now - prof_switch );
+   else
+      prof_last = now; /* Don't sample time spent outside of Lua. */
+   prof_switch = now;
+   prof_curenv = prof_envIndex( env );
+   prof_envs[ prof_curenv ].calls++;
+   prof_depth++;
+}
+
+
+/**
+ * @brief Marks leaving an environment.
+ *
+ *    @param env Environment being returned to.
+ */
+void nlua_profLeave( nlua_env env )
+{
+   Uint64 now;
+
+   /* May have started profiling in the middle of a call. */
+   if (!prof_active || (prof_depth <= 0))
+      return;
+
+   now = SDL_GetPerformanceCounter();
+   if (prof_curenv >= 0)
+      prof_envs[ prof_curenv ].time += prof_seconds( now - prof_switch );
+   prof_switch = now;
+   prof_depth--;
+   prof_curenv = (prof_depth > 0) ? prof_envIndex( env ) : -1;
+}
+
+
+/**
+ * @brief Gets a human readable name for a stack frame.
+ */
+static void prof_frameName( char *buf, size_t len, const lua_Debug *ar )
+{
+   if (ar->what[0] == 'C')
+      nsnprintf( buf, len, "%s [C]", (ar->name != NULL) ? ar->name : "?" );
+   else if (ar->what[0] == 'm')
+      nsnprintf( buf, len, "main chunk (%s)", ar->short_src );
+   else
+      nsnprintf( buf, len, "%s (%s:%d)", (ar->name != NULL) ? ar->name : "?",
+            ar->short_src, ar->linedefined );
+}
+
+
+/**
+ * @brief Count hook that takes the samples.
+ */
+static void prof_hook( lua_State *L, lua_Debug *ar )
+{
+   lua_Debug stack[PROF_MAX_DEPTH];
+   char buf[256];
+   Uint64 now;
+   double dt;
+   int i, n, env, node;
+
+   (void) ar;
+
+   now = SDL_GetPerformanceCounter();
+   if (now - prof_last < prof_interval)
+      return;
+   dt          = prof_seconds( now - prof_last );
+   prof_last   = now;
+
+   /* Get environment. */
+   env = (prof_curenv >= 0) ? prof_curenv : prof_envIndex( __NLUA_CURENV );
+
+   /* Get the stack. */
+   for (n=0; n<PROF_MAX_DEPTH; n++)
+      if (!lua_getstack( L, n, &stack[n] ))
+         break;
+
+   /* Add the sample from the outermost frame in. */
+   node = prof_envs[env].root;
+   prof_nodes[node].total += dt;
+   for (i=n-1; i>=0; i--) {
+      lua_getinfo( L, "Sn", &stack[i] );
+      prof_frameName( buf, sizeof(buf), &stack[i] );
+      node = prof_child( node, buf );
+      prof_nodes[node].total += dt;
+   }
+   prof_nodes[node].self += dt;
+}
+
+
+/**
+ * @brief Sorts nodes by total time, largest first.
+ */
+static int prof_sortNodes( const void *p1, const void *p2 )
+{
+   const ProfNode *n1, *n2;
+   n1 = &prof_nodes[ *(const int*) p1 ];
+   n2 = &prof_nodes[ *(const int*) p2 ];
+   if (n1->total > n2->total)
+      return -1;
+   else if (n1->total < n2->total)
+      return +1;
+   return 0;
+}
+
+
+/**
+ * @brief Sorts environments by time, largest first.
+ */
+static int prof_sortEnvs( const void *p1, const void *p2 )
+{
+   const ProfEnv *e1, *e2;
+   e1 = (const ProfEnv*) p1;
+   e2 = (const ProfEnv*) p2;
+   if (e1->time > e2->time)
+      return -1;
+   else if (e1->time < e2->time)
+      return +1;
+   return 0;
+}
+
+
+/**
+ * @brief Sorts flat profile by self time, largest first.
+ */
+static int prof_sortFlat( const void *p1, const void *p2 )
+{
+   const ProfFlat *f1, *f2;
+   f1 = (const ProfFlat*) p1;
+   f2 = (const ProfFlat*) p2;
+   if (f1->self > f2->self)
+      return -1;
+   else if (f1->self < f2->self)
+      return +1;
+   return 0;
+}
+
+
+/**
+ * @brief Builds the flat profile from the call tree.
+ *
+ * Recursive calls are only counted once towards the total time.
+ */
+static void prof_flatten( ProfFlat **flat, int node, const char **path, int depth )
+{
+   ProfNode *n;
+   ProfFlat *f;
+   int i, recursive;
+
+   n = &prof_nodes[node];
+
+   /* Find entry. */
+   f = NULL;
+   for (i=0; i<array_size(*flat); i++) {
+      if (strcmp( (*flat)[i].name, n->name )==0) {
+         f = &(*flat)[i];
+         break;
+      }
+   }
+   if (f == NULL) {
+      f = &array_grow( flat );
+      f->name  = n->name;
+      f->self  = 0.;
+      f->total = 0.;
+   }
+
+   /* Add times. */
+   recursive = 0;
+   for (i=0; i<depth; i++) {
+      if (strcmp( path[i], n->name )==0) {
+         recursive = 1;
+         break;
+      }
+   }
+   f->self += n->self;
+   if (!recursive)
+      f->total += n->total;
+
+   /* Recurse. */
+   if (depth >= PROF_MAX_DEPTH)
+      return;
+   path[depth] = n->name;
+   for (i=n->child; i>=0; i=prof_nodes[i].sibling)
+      prof_flatten( flat, i, path, depth+1 );
+}
+
+
+/**
+ * @brief Writes a node of the call tree and its children.
+ */
+static void prof_writeTree( FILE *f, int node, int depth, double min )
+{
+   ProfNode *n;
+   int *children;
+   int i, nchildren;
+
+   n = &prof_nodes[node];
+   fprintf( f, "%10.3f %10.3f  %*s%s\n", n->total*1000., n->self*1000.,
+         2*depth, "", n->name );
+
+   /* Sort children. */
+   nchildren = 0;
+   for (i=n->child; i>=0; i=prof_nodes[i].sibling)
+      nchildren++;
+   if (nchildren == 0)
+      return;
+   children = malloc( nchildren*sizeof(int) );
+   nchildren = 0;
+   for (i=n->child; i>=0; i=prof_nodes[i].sibling)
+      children[nchildren++] = i;
+   qsort( children, nchildren, sizeof(int), prof_sortNodes );
+
+   for (i=0; i<nchildren; i++)
+      if (prof_nodes[ children[i] ].total >= min)
+         prof_writeTree( f, children[i], depth+1, min );
+   free( children );
+}
+
+
+/**
+ * @brief Writes the profiling report.
+ *
+ * The report has the exact time per environment, a flat profile and the call
+ * tree of the samples.
+ *
+ *    @param filename File to write report to.
+ *    @return 0 on success.
+ */
+int nlua_profReport( const char *filename )
+{
+   FILE *f;
+   ProfFlat *flat;
+   ProfEnv *sorted;
+   const char *path[PROF_MAX_DEPTH];
+   double elapsed, sampled;
+   int i, n;
+
+   f = fopen( filename, "w" );
+   if (f == NULL) {
+      WARN(_("Unable to open '%s' for writing Lua profile."), filename);
+      return -1;
+   }
+
+   elapsed = prof_elapsed;
+   if (prof_active)
+      elapsed += prof_seconds( SDL_GetPerformanceCounter() - prof_start );
+   n = (prof_envs != NULL) ? array_size(prof_envs) : 0;
+
+   /* Sort environments by time. */
+   sampled = 0.;
+   sorted = malloc( (n+1) * sizeof(ProfEnv) );
+   for (i=0; i<n; i++) {
+      sorted[i] = prof_envs[i];
+      sampled += prof_nodes[ prof_envs[i].root ].total;
+   }
+   qsort( sorted, n, sizeof(ProfEnv), prof_sortEnvs );
+
+   fprintf( f, "Lua profile: %.3f s profiled, %.3f s sampled\n\n", elapsed, sampled );
+
+   /* Environments. */
+   fprintf( f, "Environments:\n" );
+   fprintf( f, "%10s %10s %10s  %s\n", "time (ms)", "time (%)", "calls", "environment" );
+   for (i=0; i<n; i++)
+      fprintf( f, "%10.3f %10.2f %10lu  %s\n", sorted[i].time*1000.,
+            (elapsed > 0.) ? 100.*sorted[i].time/elapsed : 0.,
+            sorted[i].calls, sorted[i].name );
+   free( sorted );
+
+   /* Flat profile. */
+   flat = array_create( ProfFlat );
+   for (i=0; i<n; i++)
+      prof_flatten( &flat, prof_envs[i].root, path, 0 );
+   qsort( flat, array_size(flat), sizeof(ProfFlat), prof_sortFlat );
+   fprintf( f, "\nFlat profile:\n" );
+   fprintf( f, "%10s %10s %10s  %s\n", "self (ms)", "self (%)", "total (ms)", "function" );
+   for (i=0; i<array_size(flat); i++) {
+      if (flat[i].self <= 0.)
+         break;
+      fprintf( f, "%10.3f %10.2f %10.3f  %s\n", flat[i].self*1000.,
+            (sampled > 0.) ? 100.*flat[i].self/sampled : 0.,
+            flat[i].total*1000., flat[i].name );
+   }
+   array_free( flat );
+
+   /* Call tree. */
+   fprintf( f, "\nCall tree:\n" );
+   fprintf( f, "%10s %10s  %s\n", "total (ms)", "self (ms)", "function" );
+   for (i=0; i<n; i++)
+      if (prof_nodes[ prof_envs[i].root ].total > 0.)
+         prof_writeTree( f, prof_envs[i].root, 0, PROF_TREE_MIN*sampled );
+
+   fclose( f );
+   return 0;
+}
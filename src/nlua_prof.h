@@ -0,0 +1,28 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef NLUA_PROF_H
+#  define NLUA_PROF_H
+
+
+#include "nlua.h"
+
+
+#define NLUA_PROF_INTERVAL    1. /**< Default sampling interval in milliseconds. */
+
+
+/* Control. */
+int nlua_profStart( double interval );
+void nlua_profStop (void);
+void nlua_profClear (void);
+int nlua_profActive (void);
+int nlua_profReport( const char *filename );
+
+/* Environment tracking, used by nlua_pcall. */
+void nlua_profEnter( nlua_env env );
+void nlua_profLeave( nlua_env env );
+
+
+#endif /* NLUA_PROF_H */
@@ -67,13 +67,19 @@ int nlua_loadTex( nlua_env env )
 /**
  * @brief Gets texture at index.
  *
+ * Textures from tex.open() load in the background, this makes sure the
+ *  texture is uploaded before it gets used.
+ *
  *    @param L Lua state to get texture from.
  *    @param ind Index position to find the texture.
  *    @return Texture found at the index in the state.
  */
 glTexture* lua_totex( lua_State *L, int ind )
 {
-   return *((glTexture**) lua_touserdata(L,ind));
+   glTexture *tex;
+   tex = *((glTexture**) lua_touserdata(L,ind));
+   gl_texFinish( tex );
+   return tex;
 }
 /**
  * @brief Gets texture at index or raises error if there is no texture at index.
@@ -147,6 +153,9 @@ static int texL_close( lua_State *L )
 /**
  * @brief Opens a texture.
  *
+ * The texture is read in the background and only waited for when it is
+ *  first used, so it's best to open all the textures first.
+ *
  * @usage t = tex.open( "no_sprites.png" )
  * @usage t = tex.open( "spritesheet.png", 6, 6 )
  *
@@ -178,10 +187,14 @@ static int texL_open( lua_State *L )
    }
 
    /* Push new texture. */
+   if (!ndata_exists( path )) {
+      WARN(_("Failed to load surface '%s' from ndata."), path);
+      return 0;
+   }
    if ((sx <=0 ) || (sy <= 0))
-      tex = gl_newImage( path, 0 );
+      tex = gl_texRequest( path, 0, 0, 0 );
    else
-      tex = gl_newSprite( path, sx, sy, 0 );
+      tex = gl_texRequest( path, sx, sy, 0 );
    /* Failed to load. */
    if (tex == NULL)
       return 0;
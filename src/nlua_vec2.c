@@ -23,6 +23,7 @@
 /* Vector metatable methods */
 static int vectorL_new( lua_State *L );
 static int vectorL_newP( lua_State *L );
+static int vectorL_tmp( lua_State *L );
 static int vectorL_add__( lua_State *L );
 static int vectorL_add( lua_State *L );
 static int vectorL_sub__( lua_State *L );
@@ -41,6 +42,7 @@ static int vectorL_mod( lua_State *L );
 static const luaL_Reg vector_methods[] = {
    { "new", vectorL_new },
    { "newP", vectorL_newP },
+   { "tmp", vectorL_tmp },
    { "__add", vectorL_add },
    { "add", vectorL_add__ },
    { "__sub", vectorL_sub },
@@ -60,6 +62,14 @@ static const luaL_Reg vector_methods[] = {
 }; /**< Vector metatable methods. */
 
 
+#define VECTOR_SCRATCH_MAX    256 /**< Maximum amount of pooled scratch vectors. */
+
+
+static int vector_scratch     = LUA_NOREF; /**< Registry table holding the scratch vectors. */
+static int vector_nscratch    = 0; /**< Amount of scratch vectors created. */
+static int vector_scratchused = 0; /**< Amount of scratch vectors handed out this tick. */
+
+
 /**
  * @brief Loads the vector metatable.
  *
@@ -73,6 +83,31 @@ int nlua_loadVector( nlua_env env )
 }
 
 
+/**
+ * @brief Makes all the scratch vectors available again.
+ *
+ * Should be called once per tick of the code using vec2.tmp(), the AI calls
+ * it before each pilot thinks.
+ */
+void nlua_vectorScratchReset (void)
+{
+   vector_scratchused = 0;
+}
+
+
+/**
+ * @brief Forgets the scratch vectors of the Lua state being closed.
+ *
+ * The pool lives in the registry, so it goes away with the state.
+ */
+void nlua_vectorScratchFree (void)
+{
+   vector_scratch     = LUA_NOREF;
+   vector_nscratch    = 0;
+   vector_scratchused = 0;
+}
+
+
 /**
  * @brief Represents a 2D vector in Lua.
  *
@@ -86,6 +121,9 @@ int nlua_loadVector( nlua_env env )
  * my_vec = my_vec - your_vec -- my_vec is now (19,13)
  * @endcode
  *
+ * The operators always create a new vector, while the methods (add, sub, mul
+ * and div) modify the vector and return it, so they don't generate garbage.
+ *
  * To call members of the metatable always use:
  * @code
  * vector:function( param )
@@ -219,6 +257,56 @@ static int vectorL_newP( lua_State *L )
    return 1;
 }
 
+/**
+ * @brief Gets a scratch vector.
+ *
+ * Scratch vectors come from a pool that is reused every AI tick, so they
+ * don't create garbage. They must not be kept around after the current tick,
+ * use vec2.new() for vectors that are stored.
+ *
+ * @usage v = vec2.tmp( 5, 3 ) -- gets a temporary vector at (5,3)
+ * @usage d = p:pos( vec2.tmp() ):dist( goal ) -- no allocation at all
+ *
+ *    @luatparam[opt=0] number x X value for the vector.
+ *    @luatparam[opt=0] number y Y value for the vector.
+ *    @luatreturn Vec2 The scratch vector.
+ * @luafunc tmp( x, y )
+ */
+static int vectorL_tmp( lua_State *L )
+{
+   Vector2d v;
+
+   vect_cset( &v, luaL_optnumber(L,1,0.), luaL_optnumber(L,2,0.) );
+
+   /* Pool is exhausted, just create a normal vector. */
+   if (vector_scratchused >= VECTOR_SCRATCH_MAX) {
+      lua_pushvector(L, v);
+      return 1;
+   }
+
+   /* Create the pool on first use. */
+   if (vector_scratch == LUA_NOREF) {
+      lua_createtable(L, VECTOR_SCRATCH_MAX, 0);
+      vector_scratch = luaL_ref(L, LUA_REGISTRYINDEX);
+   }
+
+   /* Reuse a vector or grow the pool. */
+   lua_rawgeti(L, LUA_REGISTRYINDEX, vector_scratch);
+   vector_scratchused++;
+   if (vector_scratchused > vector_nscratch) {
+      lua_pushvector(L, v);
+      lua_pushvalue(L, -1);
+      lua_rawseti(L, -3, vector_scratchused);
+      vector_nscratch = vector_scratchused;
+   }
+   else {
+      lua_rawgeti(L, -1, vector_scratchused);
+      *lua_tovector(L, -1) = v;
+   }
+   lua_remove(L, -2);
+   return 1;
+}
+
 /**
  * @brief Adds two vectors or a vector and some cartesian coordinates.
  *
@@ -291,7 +379,7 @@ static int vectorL_add__( lua_State *L )
 
    /* Actually add it */
    vect_cset( v1, v1->x + x, v1->y + y );
-   lua_pushvector( L, *v1 );
+   lua_pushvalue( L, 1 );
 
    return 1;
 }
@@ -367,7 +455,7 @@ static int vectorL_sub__( lua_State *L )
 
    /* Actually add it */
    vect_cset( v1, v1->x - x, v1->y - y );
-   lua_pushvector( L, *v1 );
+   lua_pushvalue( L, 1 );
    return 1;
 }
 
@@ -407,7 +495,7 @@ static int vectorL_mul__( lua_State *L )
 
    /* Actually add it */
    vect_cset( v1, v1->x * mod, v1->y * mod );
-   lua_pushvector( L, *v1 );
+   lua_pushvalue( L, 1 );
    return 1;
 }
 
@@ -447,7 +535,7 @@ static int vectorL_div__( lua_State *L )
 
    /* Actually add it */
    vect_cset( v1, v1->x / mod, v1->y / mod );
-   lua_pushvector( L, *v1 );
+   lua_pushvalue( L, 1 );
    return 1;
 }
 
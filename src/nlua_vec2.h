@@ -19,6 +19,8 @@
  * Vector library.
  */
 int nlua_loadVector( nlua_env env );
+void nlua_vectorScratchReset (void);
+void nlua_vectorScratchFree (void);
 
 /*
  * Vector operations.
@@ -0,0 +1,606 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file nmem.c
+ *
+ * @brief Tagged memory accounting for the different subsystems.
+ *
+ * Subsystems report what they allocate and free with nmem_alloc() and
+ * nmem_free(), and running totals and high-water marks are kept per tag.
+ *
+ * The Lua heap and libxml2 use custom allocators which prepend a small header
+ * to each block, so that the memory can be attributed exactly. For Lua the
+ * header holds the slot of the environment that was running when the block
+ * was allocated, which lets the report split the heap per mission, event, AI
+ * profile and so on.
+ */
+
+
+#include "nmem.h"
+
+#include "naev.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "nstring.h"
+
+#include "SDL_atomic.h"
+#include "libxml/xmlmemory.h"
+
+#include "log.h"
+#include "nlua.h"
+#include "array.h"
+
+
+/**
+ * @brief Memory statistics of a tag.
+ */
+typedef struct MemStat_ {
+   size_t cur; /**< Currently allocated bytes. */
+   size_t peak; /**< High-water mark in bytes. */
+   unsigned long nalloc; /**< Number of allocations. */
+   unsigned long nfree; /**< Number of frees. */
+} MemStat;
+
+static MemStat nmem_stats[MEM_SENTINEL]; /**< Statistics per tag. */
+static SDL_SpinLock nmem_lock = 0; /**< Protects the statistics, sound loads from a thread. */
+
+/**
+ * @brief Names of the tags, also used as keys in the report.
+ */
+static const char *nmem_names[MEM_SENTINEL] = {
+   "texture",
+   "collision",
+   "lua",
+   "pilot",
+   "weapon",
+   "spfx",
+   "nebula",
+   "sound",
+   "xml",
+   "ndata"
+};
+
+
+/**
+ * @brief Header prepended to blocks allocated through the custom allocators.
+ *
+ * Must keep the maximum alignment so the block itself stays aligned.
+ */
+typedef union MemHeader_ {
+   double d; /**< Alignment. */
+   void *p; /**< Alignment. */
+   long l; /**< Alignment. */
+   size_t size; /**< Size of the block (libxml2). */
+   int slot; /**< Lua environment slot (Lua). */
+} MemHeader;
+
+
+/**
+ * @brief Lua memory attributed to an environment.
+ */
+typedef struct LuaMemEnv_ {
+   int env; /**< Environment reference, LUA_NOREF once freed. */
+   char *name; /**< Name of the environment, kept after it is freed. */
+   size_t cur; /**< Currently allocated bytes. */
+   size_t peak; /**< High-water mark in bytes. */
+} LuaMemEnv;
+
+static LuaMemEnv *nmem_luaenv = NULL; /**< Environment slots, slot 0 is the global state. */
+static int *nmem_luaslot = NULL; /**< Maps environment references to slots. */
+static int nmem_nluaslot = 0; /**< Size of nmem_luaslot. */
+static int nmem_luaactive = 0; /**< Whether the Lua allocator is in use. */
+
+
+/*
+ * Prototypes.
+ */
+static void nmem_add( MemStat *s, size_t osize, size_t nsize );
+static int nmem_luaSlot( int env );
+static const char *nmem_luaName( const LuaMemEnv *e );
+static void *nmem_xmlMalloc( size_t size );
+static void *nmem_xmlRealloc( void *ptr, size_t size );
+static void nmem_xmlFree( void *ptr );
+static char *nmem_xmlStrdup( const char *str );
+static int nmem_sortLua( const void *p1, const void *p2 );
+static LuaMemEnv **nmem_luaSorted( int *n );
+
+
+/**
+ * @brief Initializes the memory accounting.
+ *
+ * Must be called before libxml2 and Lua are initialized.
+ */
+void nmem_init (void)
+{
+   memset( nmem_stats, 0, sizeof(nmem_stats) );
+   if (xmlMemSetup( nmem_xmlFree, nmem_xmlMalloc, nmem_xmlRealloc, nmem_xmlStrdup ) != 0)
+      WARN(_("Unable to set up XML memory accounting."));
+}
+
+
+/**
+ * @brief Cleans up the memory accounting.
+ *
+ * Must be called after the Lua state is closed.
+ */
+void nmem_exit (void)
+{
+   int i;
+
+   if (nmem_luaenv != NULL) {
+      for (i=0; i<array_size(nmem_luaenv); i++)
+         free( nmem_luaenv[i].name );
+      array_free( nmem_luaenv );
+      nmem_luaenv = NULL;
+   }
+   free( nmem_luaslot );
+   nmem_luaslot   = NULL;
+   nmem_nluaslot  = 0;
+   nmem_luaactive = 0;
+}
+
+
+/**
+ * @brief Updates statistics, must be called with the lock held if needed.
+ */
+static void nmem_add( MemStat *s, size_t osize, size_t nsize )
+{
+   if (osize > 0)
+      s->nfree++;
+   if (nsize > 0)
+      s->nalloc++;
+   s->cur -= MIN( s->cur, osize );
+   s->cur += nsize;
+   if (s->cur > s->peak)
+      s->peak = s->cur;
+}
+
+
+/**
+ * @brief Accounts for an allocation.
+ *
+ *    @param tag Subsystem doing the allocation.
+ *    @param size Size of the allocation in bytes.
+ */
+void nmem_alloc( MemTag tag, size_t size )
+{
+   nmem_realloc( tag, 0, size );
+}
+
+
+/**
+ * @brief Accounts for a free.
+ *
+ *    @param tag Subsystem doing the free.
+ *    @param size Size that was freed in bytes.
+ */
+void nmem_free( MemTag tag, size_t size )
+{
+   nmem_realloc( tag, size, 0 );
+}
+
+
+/**
+ * @brief Accounts for an allocation changing size.
+ *
+ *    @param tag Subsystem doing the reallocation.
+ *    @param osize Old size in bytes (0 if new allocation).
+ *    @param nsize New size in bytes (0 if freed).
+ */
+void nmem_realloc( MemTag tag, size_t osize, size_t nsize )
+{
+   if ((osize == 0) && (nsize == 0))
+      return;
+   SDL_AtomicLock( &nmem_lock );
+   nmem_add( &nmem_stats[tag], osize, nsize );
+   SDL_AtomicUnlock( &nmem_lock );
+}
+
+
+/**
+ * @brief Gets the slot of a Lua environment.
+ */
+static int nmem_luaSlot( int env )
+{
+   if ((env < 0) || (env >= nmem_nluaslot))
+      return 0;
+   return nmem_luaslot[ env ];
+}
+
+
+/**
+ * @brief Custom Lua allocator that tracks memory per environment.
+ *
+ * Memory is attributed to the environment running when the block was first
+ * allocated (see __NLUA_CURENV), and is given back to it when freed.
+ *
+ * @sa lua_Alloc
+ */
+void *nmem_luaAlloc( void *ud, void *ptr, size_t osize, size_t nsize )
+{
+   MemHeader *h;
+   LuaMemEnv *e;
+   int slot;
+
+   (void) ud;
+
+   /* Create global slot as necessary. */
+   if (nmem_luaenv == NULL) {
+      nmem_luaenv = array_create( LuaMemEnv );
+      e = &array_grow( &nmem_luaenv );
+      memset( e, 0, sizeof(LuaMemEnv) );
+      e->env   = LUA_NOREF;
+      nmem_luaactive = 1;
+   }
+
+   /* Get the header. */
+   if (ptr != NULL) {
+      h     = (MemHeader*)ptr - 1;
+      slot  = h->slot;
+   }
+   else {
+      h     = NULL;
+      slot  = nmem_luaSlot( __NLUA_CURENV );
+   }
+
+   /* Free. */
+   if (nsize == 0) {
+      free( h );
+      h = NULL;
+   }
+   /* Allocate or resize. */
+   else {
+      h = realloc( h, sizeof(MemHeader) + nsize );
+      if (h == NULL)
+         return NULL;
+      h->slot = slot;
+   }
+
+   /* Update statistics, Lua only runs on the main thread. */
+   e = &nmem_luaenv[ slot ];
+   e->cur -= MIN( e->cur, osize );
+   e->cur += nsize;
+   if (e->cur > e->peak)
+      e->peak = e->cur;
+   nmem_add( &nmem_stats[MEM_LUA], osize, nsize );
+
+   return (h == NULL) ? NULL : h+1;
+}
+
+
+/**
+ * @brief Starts attributing Lua memory to a new environment.
+ *
+ *    @param env Environment just created.
+ */
+void nmem_luaEnvNew( int env )
+{
+   int i, slot, n;
+   LuaMemEnv *e;
+
+   if (!nmem_luaactive || (env < 0))
+      return;
+
+   /* Reuse a slot that was freed and drained. */
+   slot = -1;
+   for (i=1; i<array_size(nmem_luaenv); i++) {
+      e = &nmem_luaenv[i];
+      if ((e->env == LUA_NOREF) && (e->cur == 0)) {
+         slot = i;
+         break;
+      }
+   }
+   if (slot < 0) {
+      slot = array_size(nmem_luaenv);
+      e = &array_grow( &nmem_luaenv );
+   }
+   else
+      e = &nmem_luaenv[slot];
+   free( e->name );
+   memset( e, 0, sizeof(LuaMemEnv) );
+   e->env = env;
+
+   /* Map the reference. */
+   if (env >= nmem_nluaslot) {
+      n = MAX( 2*nmem_nluaslot, env+1 );
+      nmem_luaslot = realloc( nmem_luaslot, n*sizeof(int) );
+      memset( &nmem_luaslot[nmem_nluaslot], 0, (n-nmem_nluaslot)*sizeof(int) );
+      nmem_nluaslot = n;
+   }
+   nmem_luaslot[env] = slot;
+}
+
+
+/**
+ * @brief Stops attributing Lua memory to an environment.
+ *
+ * Memory still alive stays accounted to the environment until collected.
+ *
+ *    @param env Environment being freed.
+ */
+void nmem_luaEnvFree( int env )
+{
+   int slot;
+   const char *name;
+   LuaMemEnv *e;
+
+   slot = nmem_luaSlot( env );
+   if (slot == 0)
+      return;
+   e = &nmem_luaenv[slot];
+   name = nlua_getEnvName( env );
+   free( e->name );
+   e->name = (name != NULL) ? strdup(name) : NULL;
+   e->env  = LUA_NOREF;
+   nmem_luaslot[env] = 0;
+}
+
+
+/**
+ * @brief Gets the name to display for a Lua environment slot.
+ */
+static const char *nmem_luaName( const LuaMemEnv *e )
+{
+   const char *name;
+   if (e == &nmem_luaenv[0])
+      return "global";
+   if (e->env != LUA_NOREF) {
+      name = nlua_getEnvName( e->env );
+      if (name != NULL)
+         return name;
+   }
+   else if (e->name != NULL)
+      return e->name;
+   return "unnamed";
+}
+
+
+/**
+ * @brief Custom libxml2 allocator.
+ */
+static void *nmem_xmlMalloc( size_t size )
+{
+   return nmem_xmlRealloc( NULL, size );
+}
+
+
+/**
+ * @brief Custom libxml2 reallocator.
+ */
+static void *nmem_xmlRealloc( void *ptr, size_t size )
+{
+   MemHeader *h;
+   size_t osize;
+
+   if (ptr != NULL) {
+      h     = (MemHeader*)ptr - 1;
+      osize = h->size;
+   }
+   else {
+      h     = NULL;
+      osize = 0;
+   }
+
+   h = realloc( h, sizeof(MemHeader) + size );
+   if (h == NULL)
+      return NULL;
+   h->size = size;
+   nmem_realloc( MEM_XML, osize, size );
+   return h+1;
+}
+
+
+/**
+ * @brief Custom libxml2 free.
+ */
+static void nmem_xmlFree( void *ptr )
+{
+   MemHeader *h;
+
+   if (ptr == NULL)
+      return;
+   h = (MemHeader*)ptr - 1;
+   nmem_realloc( MEM_XML, h->size, 0 );
+   free( h );
+}
+
+
+/**
+ * @brief Custom libxml2 strdup.
+ */
+static char *nmem_xmlStrdup( const char *str )
+{
+   size_t len;
+   char *s;
+
+   len = strlen(str)+1;
+   s   = nmem_xmlMalloc( len );
+   if (s != NULL)
+      memcpy( s, str, len );
+   return s;
+}
+
+
+/**
+ * @brief Gets the name of a tag.
+ *
+ *    @param tag Tag to get name of.
+ *    @return Name of the tag.
+ */
+const char *nmem_tagName( MemTag tag )
+{
+   return nmem_names[tag];
+}
+
+
+/**
+ * @brief Gets the memory currently allocated by a tag.
+ *
+ *    @param tag Tag to get memory of.
+ *    @return Allocated memory in bytes.
+ */
+size_t nmem_current( MemTag tag )
+{
+   size_t cur;
+
+   /* Lua may be using its own allocator. */
+   if ((tag == MEM_LUA) && !nmem_luaactive) {
+      if (naevL == NULL)
+         return 0;
+      return (size_t)lua_gc( naevL, LUA_GCCOUNT, 0 ) * 1024 +
+            (size_t)lua_gc( naevL, LUA_GCCOUNTB, 0 );
+   }
+
+   SDL_AtomicLock( &nmem_lock );
+   cur = nmem_stats[tag].cur;
+   SDL_AtomicUnlock( &nmem_lock );
+   return cur;
+}
+
+
+/**
+ * @brief Gets the high-water mark of a tag.
+ *
+ *    @param tag Tag to get high-water mark of.
+ *    @return Peak memory in bytes.
+ */
+size_t nmem_peak( MemTag tag )
+{
+   size_t peak;
+
+   if ((tag == MEM_LUA) && !nmem_luaactive)
+      return nmem_current( tag );
+
+   SDL_AtomicLock( &nmem_lock );
+   peak = nmem_stats[tag].peak;
+   SDL_AtomicUnlock( &nmem_lock );
+   return peak;
+}
+
+
+/**
+ * @brief Sorts Lua environments by memory use, largest first.
+ */
+static int nmem_sortLua( const void *p1, const void *p2 )
+{
+   const LuaMemEnv *e1, *e2;
+   e1 = *(const LuaMemEnv**) p1;
+   e2 = *(const LuaMemEnv**) p2;
+   if (e1->cur > e2->cur)
+      return -1;
+   else if (e1->cur < e2->cur)
+      return +1;
+   return 0;
+}
+
+
+/**
+ * @brief Gets the Lua environments sorted by memory use.
+ *
+ *    @param[out] n Number of environments.
+ *    @return Array of pointers to the environments (must be freed).
+ */
+static LuaMemEnv **nmem_luaSorted( int *n )
+{
+   LuaMemEnv **sorted;
+   int i;
+
+   *n = 0;
+   if (nmem_luaenv == NULL)
+      return NULL;
+
+   sorted = malloc( array_size(nmem_luaenv) * sizeof(LuaMemEnv*) );
+   for (i=0; i<array_size(nmem_luaenv); i++)
+      if ((nmem_luaenv[i].cur > 0) || (nmem_luaenv[i].env != LUA_NOREF))
+         sorted[(*n)++] = &nmem_luaenv[i];
+   qsort( sorted, *n, sizeof(LuaMemEnv*), nmem_sortLua );
+   return sorted;
+}
+
+
+/**
+ * @brief Prints the memory usage.
+ *
+ *    @param print Function to print each line with.
+ */
+void nmem_print( void (*print)( const char *msg ) )
+{
+   char buf[256];
+   LuaMemEnv **sorted;
+   int i, n;
+
+   print( _("Memory usage (current / peak KiB):") );
+   for (i=0; i<MEM_SENTINEL; i++) {
+      nsnprintf( buf, sizeof(buf), "   %-12s %10.1f / %10.1f",
+            nmem_names[i], nmem_current(i) / 1024., nmem_peak(i) / 1024. );
+      print( buf );
+   }
+
+   if (!nmem_luaactive)
+      return;
+
+   print( _("Lua memory by environment (current / peak KiB):") );
+   sorted = nmem_luaSorted( &n );
+   for (i=0; i<n; i++) {
+      nsnprintf( buf, sizeof(buf), "   %-32s %10.1f / %10.1f",
+            nmem_luaName( sorted[i] ),
+            sorted[i]->cur / 1024., sorted[i]->peak / 1024. );
+      print( buf );
+   }
+   free( sorted );
+}
+
+
+/**
+ * @brief Writes a JSON report of the memory usage.
+ *
+ *    @param filename File to write to.
+ *    @return 0 on success.
+ */
+int nmem_report( const char *filename )
+{
+   FILE *f;
+   LuaMemEnv **sorted;
+   const char *name;
+   int i, j, n;
+
+   f = fopen( filename, "w" );
+   if (f == NULL) {
+      WARN(_("Unable to open '%s' for writing memory report."), filename);
+      return -1;
+   }
+
+   fprintf( f, "{\n   \"tags\": {\n" );
+   for (i=0; i<MEM_SENTINEL; i++) {
+      SDL_AtomicLock( &nmem_lock );
+      fprintf( f, "      \"%s\": { \"current\": %lu, \"peak\": %lu, \"allocs\": %lu, \"frees\": %lu }%s\n",
+            nmem_names[i],
+            (unsigned long)nmem_stats[i].cur, (unsigned long)nmem_stats[i].peak,
+            nmem_stats[i].nalloc, nmem_stats[i].nfree,
+            (i < MEM_SENTINEL-1) ? "," : "" );
+      SDL_AtomicUnlock( &nmem_lock );
+   }
+   fprintf( f, "   },\n   \"lua\": [\n" );
+   sorted = nmem_luaSorted( &n );
+   for (i=0; i<n; i++) {
+      fprintf( f, "      { \"env\": \"" );
+      /* Names come from data, escape them. */
+      name = nmem_luaName( sorted[i] );
+      for (j=0; name[j]!='\0'; j++) {
+         if ((name[j] == '"') || (name[j] == '\\'))
+            fputc( '\\', f );
+         fputc( name[j], f );
+      }
+      fprintf( f, "\", \"current\": %lu, \"peak\": %lu }%s\n",
+            (unsigned long)sorted[i]->cur, (unsigned long)sorted[i]->peak,
+            (i < n-1) ? "," : "" );
+   }
+   free( sorted );
+   fprintf( f, "   ]\n}\n" );
+
+   fclose( f );
+   return 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef NMEM_H
+#  define NMEM_H
+
+
+#include <stddef.h>
+
+
+/**
+ * @brief Subsystems memory usage is accounted for.
+ */
+typedef enum MemTag_ {
+   MEM_TEXTURE,   /**< Texture memory uploaded to the graphics card. */
+   MEM_COLLISION, /**< Transparency maps used for collisions. */
+   MEM_LUA,       /**< Lua heap. */
+   MEM_PILOT,     /**< Pilot stack and pilots. */
+   MEM_WEAPON,    /**< Weapon layers and weapons. */
+   MEM_SPFX,      /**< Special effect stacks. */
+   MEM_NEBULA,    /**< Nebula maps and puffs. */
+   MEM_SOUND,     /**< Sound buffers. */
+   MEM_XML,       /**< XML documents held by libxml2. */
+   MEM_NDATA,     /**< Decompressed data files cached by nzip. */
+   MEM_SENTINEL   /**< Number of tags, not a real tag. */
+} MemTag;
+
+
+/* Init/exit. */
+void nmem_init (void);
+void nmem_exit (void);
+
+/* Accounting. */
+void nmem_alloc( MemTag tag, size_t size );
+void nmem_free( MemTag tag, size_t size );
+void nmem_realloc( MemTag tag, size_t osize, size_t nsize );
+
+/* Lua. */
+void *nmem_luaAlloc( void *ud, void *ptr, size_t osize, size_t nsize );
+void nmem_luaEnvNew( int env );
+void nmem_luaEnvFree( int env );
+
+/* Info. */
+const char *nmem_tagName( MemTag tag );
+size_t nmem_current( MemTag tag );
+size_t nmem_peak( MemTag tag );
+void nmem_print( void (*print)( const char *msg ) );
+int nmem_report( const char *filename );
+
+
+#endif /* NMEM_H */
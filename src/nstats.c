@@ -0,0 +1,427 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file nstats.c
+ *
+ * @brief Periodic export of engine gauges for long unattended runs.
+ *
+ * Once per second a snapshot of the gauges is written to a file or sent to a
+ * UNIX domain socket using the Graphite plaintext protocol, one gauge per
+ * line:
+ *
+ * @code
+ * naev.pilots 42 1500000000
+ * @endcode
+ *
+ * Frame times are the time spent working on a frame, excluding the frame
+ * limiter, and are reported as percentiles over the last period.
+ */
+
+
+#include "nstats.h"
+
+#include "naev.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include "nstring.h"
+
+#if HAS_UNIX
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif /* HAS_UNIX */
+
+#include "log.h"
+#include "array.h"
+#include "nmem.h"
+#include "opengl.h"
+#include "pilot.h"
+#include "weapon.h"
+#include "spfx.h"
+#include "sound.h"
+#include "hook.h"
+#include "cond.h"
+
+
+#define STATS_BUFSIZE   8192 /**< Size of the snapshot buffer. */
+
+
+/*
+ * From pilot.c
+ */
+extern int pilot_nstack;
+
+
+static int stats_active       = 0; /**< Whether or not exporting. */
+static FILE *stats_file       = NULL; /**< File being written to. */
+static char *stats_sock       = NULL; /**< Path of the socket being written to. */
+static int stats_fd           = -1; /**< Socket file descriptor. */
+static double stats_timer     = 0.; /**< Time elapsed in the current period. */
+static double *stats_frames   = NULL; /**< Frame times of the current period in milliseconds. */
+static double stats_hyp_last  = 0.; /**< Last hyperspace load time in milliseconds. */
+static double stats_hyp_max   = 0.; /**< Longest hyperspace load time in milliseconds. */
+static int stats_hyp_count    = 0; /**< Number of hyperspace jumps. */
+
+static char stats_buf[STATS_BUFSIZE]; /**< Snapshot being built. */
+static size_t stats_len       = 0; /**< Length of the snapshot. */
+static long stats_now         = 0; /**< Timestamp of the snapshot. */
+static char stats_tail[STATS_BUFSIZE]; /**< Part of the last snapshot the socket didn't take. */
+static size_t stats_ntail     = 0; /**< Length of stats_tail. */
+
+
+/*
+ * Prototypes.
+ */
+static void stats_gauge( const char *name, double value );
+static void stats_hook( const char *stack, int n, void *data );
+static int stats_sortFrames( const void *p1, const void *p2 );
+static double stats_percentile( double p );
+static void stats_snapshot (void);
+static void stats_write (void);
+static int stats_connect (void);
+static int stats_send( const char *buf, size_t len );
+
+
+/**
+ * @brief Starts exporting statistics.
+ *
+ *    @param target File to append to, or socket path prefixed by "unix:".
+ *    @return 0 on success.
+ */
+int nstats_init( const char *target )
+{
+   nstats_exit();
+
+   if (strncmp( target, NSTATS_UNIX_PREFIX, strlen(NSTATS_UNIX_PREFIX) ) == 0) {
+#if HAS_UNIX
+      stats_sock = strdup( &target[ strlen(NSTATS_UNIX_PREFIX) ] );
+      /* The listener may come up later, so failing to connect isn't fatal. */
+      stats_connect();
+#else /* HAS_UNIX */
+      WARN(_("UNIX domain sockets are not supported on this platform, not exporting statistics to '%s'."), target);
+      return -1;
+#endif /* HAS_UNIX */
+   }
+   else {
+      stats_file = fopen( target, "a" );
+      if (stats_file == NULL) {
+         WARN(_("Unable to open '%s' for writing statistics: %s"), target, strerror(errno));
+         return -1;
+      }
+   }
+
+   stats_frames = array_create( double );
+   stats_timer  = 0.;
+   stats_active = 1;
+   return 0;
+}
+
+
+/**
+ * @brief Stops exporting statistics.
+ */
+void nstats_exit (void)
+{
+   if (stats_file != NULL) {
+      fclose( stats_file );
+      stats_file = NULL;
+   }
+#if HAS_UNIX
+   if (stats_fd >= 0) {
+      close( stats_fd );
+      stats_fd = -1;
+   }
+   stats_ntail = 0;
+#endif /* HAS_UNIX */
+   free( stats_sock );
+   stats_sock = NULL;
+   if (stats_frames != NULL) {
+      array_free( stats_frames );
+      stats_frames = NULL;
+   }
+   stats_active = 0;
+}
+
+
+/**
+ * @brief Records a frame and writes a snapshot once a period has elapsed.
+ *
+ *    @param frame Time spent working on the frame in milliseconds.
+ *    @param dt Real time elapsed since the last frame in seconds.
+ */
+void nstats_frame( double frame, double dt )
+{
+   if (!stats_active)
+      return;
+
+   array_push_back( &stats_frames, frame );
+
+   stats_timer += dt;
+   if (stats_timer < NSTATS_PERIOD)
+      return;
+   stats_timer = 0.;
+
+   stats_snapshot();
+   stats_write();
+   array_resize( &stats_frames, 0 );
+}
+
+
+/**
+ * @brief Records how long entering a system through hyperspace took.
+ *
+ *    @param ms Load time in milliseconds.
+ */
+void nstats_hyperspace( double ms )
+{
+   stats_hyp_last = ms;
+   stats_hyp_max  = MAX( stats_hyp_max, ms );
+   stats_hyp_count++;
+}
+
+
+/**
+ * @brief Adds a gauge to the snapshot.
+ *
+ * Only whole lines are added, gauges that don't fit are dropped.
+ */
+static void stats_gauge( const char *name, double value )
+{
+   static int warned = 0;
+   size_t left;
+   int ret;
+
+   left = sizeof(stats_buf) - stats_len;
+   ret  = nsnprintf( &stats_buf[stats_len], left,
+         "naev.%s %g %ld\n", name, value, stats_now );
+   if ((ret < 0) || ((size_t)ret >= left)) {
+      if (!warned) {
+         WARN(_("Statistics snapshot is full, dropping gauge '%s'."), name);
+         warned = 1;
+      }
+      return;
+   }
+   stats_len += ret;
+}
+
+
+/**
+ * @brief Adds the hook count of a stack to the snapshot.
+ */
+static void stats_hook( const char *stack, int n, void *data )
+{
+   char name[PATH_MAX];
+   (void) data;
+   nsnprintf( name, sizeof(name), "hooks.%s", stack );
+   stats_gauge( name, n );
+}
+
+
+/**
+ * @brief Compares frame times for qsort.
+ */
+static int stats_sortFrames( const void *p1, const void *p2 )
+{
+   double f1, f2;
+   f1 = *(const double*) p1;
+   f2 = *(const double*) p2;
+   if (f1 < f2)
+      return -1;
+   else if (f1 > f2)
+      return +1;
+   return 0;
+}
+
+
+/**
+ * @brief Gets a percentile of the sorted frame times.
+ *
+ *    @param p Percentile to get (0-1).
+ *    @return Frame time at the percentile in milliseconds.
+ */
+static double stats_percentile( double p )
+{
+   int n;
+   n = array_size( stats_frames );
+   if (n == 0)
+      return 0.;
+   return stats_frames[ CLAMP( 0, n-1, (int)(p * (double)(n-1) + 0.5) ) ];
+}
+
+
+/**
+ * @brief Builds a snapshot of all the gauges.
+ */
+static void stats_snapshot (void)
+{
+   glTexStats tex;
+   CondStats cond;
+
+   stats_len = 0;
+   stats_now = (long) time(NULL);
+
+   /* Objects. */
+   stats_gauge( "pilots", pilot_nstack );
+   stats_gauge( "weapons.bg", weapon_count( WEAPON_LAYER_BG ) );
+   stats_gauge( "weapons.fg", weapon_count( WEAPON_LAYER_FG ) );
+   stats_gauge( "spfx.back", spfx_count( SPFX_LAYER_BACK ) );
+   stats_gauge( "spfx.front", spfx_count( SPFX_LAYER_FRONT ) );
+   stats_gauge( "voices", sound_voices() );
+   hooks_stats( stats_hook, NULL );
+
+   /* Memory. */
+   stats_gauge( "memory.lua", nmem_current( MEM_LUA ) );
+   stats_gauge( "memory.texture", nmem_current( MEM_TEXTURE ) );
+   gl_texStats( &tex );
+   stats_gauge( "texture.count", tex.textures );
+   stats_gauge( "texture.cached", tex.cached );
+   stats_gauge( "texture.cached_mem", tex.cached_mem );
+   stats_gauge( "texture.evictions", tex.evictions );
+
+   /* Conditions. */
+   cond_getStats( &cond );
+   stats_gauge( "cond.compiled", cond.compiled );
+   stats_gauge( "cond.checks", cond.hits + cond.misses );
+   stats_gauge( "cond.misses", cond.misses );
+   stats_gauge( "cond.time", cond.time * 1000. );
+
+   /* Frame times. */
+   qsort( stats_frames, array_size(stats_frames), sizeof(double), stats_sortFrames );
+   stats_gauge( "frame.count", array_size(stats_frames) );
+   stats_gauge( "frame.p50", stats_percentile( 0.50 ) );
+   stats_gauge( "frame.p90", stats_percentile( 0.90 ) );
+   stats_gauge( "frame.p99", stats_percentile( 0.99 ) );
+   stats_gauge( "frame.max", stats_percentile( 1.00 ) );
+
+   /* Hyperspace. */
+   stats_gauge( "hyperspace.count", stats_hyp_count );
+   stats_gauge( "hyperspace.last", stats_hyp_last );
+   stats_gauge( "hyperspace.max", stats_hyp_max );
+}
+
+
+/**
+ * @brief Writes the snapshot to the target.
+ *
+ * Writing never blocks the game, if the socket can't keep up the snapshot is
+ * dropped. Snapshots are never cut short though, whatever the socket didn't
+ * take is sent first the next time so the stream stays line aligned.
+ */
+static void stats_write (void)
+{
+   if (stats_file != NULL) {
+      fwrite( stats_buf, 1, stats_len, stats_file );
+      fflush( stats_file );
+      return;
+   }
+
+#if HAS_UNIX
+   {
+      int ret;
+
+      if ((stats_fd < 0) && (stats_connect() != 0))
+         return;
+
+      /* Finish the previous snapshot first. */
+      if (stats_ntail > 0) {
+         ret = stats_send( stats_tail, stats_ntail );
+         if (ret < 0)
+            return;
+         stats_ntail -= ret;
+         memmove( stats_tail, &stats_tail[ret], stats_ntail );
+         if (stats_ntail > 0)
+            return;
+      }
+
+      ret = stats_send( stats_buf, stats_len );
+      if (ret < 0)
+         return;
+      stats_ntail = stats_len - ret;
+      memcpy( stats_tail, &stats_buf[ret], stats_ntail );
+   }
+#endif /* HAS_UNIX */
+}
+
+
+/**
+ * @brief Sends as much of a buffer as the socket will take without blocking.
+ *
+ *    @param buf Buffer to send.
+ *    @param len Length of the buffer.
+ *    @return Number of bytes sent or -1 if the connection was closed.
+ */
+static int stats_send( const char *buf, size_t len )
+{
+#if HAS_UNIX
+   ssize_t ret;
+   int flags;
+
+#ifdef MSG_NOSIGNAL
+   flags = MSG_NOSIGNAL;
+#else /* MSG_NOSIGNAL */
+   flags = 0;
+#endif /* MSG_NOSIGNAL */
+   ret = send( stats_fd, buf, len, flags );
+   if (ret >= 0)
+      return ret;
+   if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+      return 0;
+
+   /* Listener went away, try again next snapshot. */
+   close( stats_fd );
+   stats_fd    = -1;
+   stats_ntail = 0;
+   return -1;
+#else /* HAS_UNIX */
+   (void) buf;
+   (void) len;
+   return -1;
+#endif /* HAS_UNIX */
+}
+
+
+/**
+ * @brief Connects to the statistics socket.
+ *
+ *    @return 0 on success.
+ */
+static int stats_connect (void)
+{
+#if HAS_UNIX
+   struct sockaddr_un addr;
+   int fd;
+
+   fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+   if (fd < 0)
+      return -1;
+
+   memset( &addr, 0, sizeof(addr) );
+   addr.sun_family = AF_UNIX;
+   strncpy( addr.sun_path, stats_sock, sizeof(addr.sun_path)-1 );
+   if (connect( fd, (struct sockaddr*) &addr, sizeof(addr) ) != 0) {
+      close( fd );
+      return -1;
+   }
+
+   /* Don't let a slow listener stall the game. */
+   fcntl( fd, F_SETFL, fcntl( fd, F_GETFL, 0 ) | O_NONBLOCK );
+#ifdef SO_NOSIGPIPE
+   {
+      int one = 1;
+      setsockopt( fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one) );
+   }
+#endif /* SO_NOSIGPIPE */
+
+   stats_fd = fd;
+   return 0;
+#else /* HAS_UNIX */
+   return -1;
+#endif /* HAS_UNIX */
+}
@@ -0,0 +1,23 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef NSTATS_H
+#  define NSTATS_H
+
+
+#define NSTATS_PERIOD      1.       /**< Time between snapshots in seconds. */
+#define NSTATS_UNIX_PREFIX "unix:"  /**< Prefix of targets that are UNIX domain sockets. */
+
+
+/* Init/exit. */
+int nstats_init( const char *target );
+void nstats_exit (void);
+
+/* Recording. */
+void nstats_frame( double frame, double dt );
+void nstats_hyperspace( double ms );
+
+
+#endif /* NSTATS_H */
@@ -14,11 +14,56 @@
 #include "naev.h"
 
 #include "nstring.h"
+#include "log.h"
+
+
+/**
+ * @brief State of a stream reader, passed to its error handler.
+ */
+typedef struct XmlsState_ {
+   char *url;     /**< Name of the document for error messages. */
+   int errors;    /**< Number of errors found while reading. */
+} XmlsState;
+
+
+static XmlsState* xmls_state( xmlTextReaderPtr reader );
+static glTexture* xml_requestTexture( const char *name, const char *path,
+      int sx, int sy, const unsigned int flags );
+static void xmls_error( void *arg, const char *msg,
+      xmlParserSeverities severity, xmlTextReaderLocatorPtr locator );
+
+
+/**
+ * @brief Gets a property of a node.
+ *
+ * The property is copied so it can be freed with free() instead of xmlFree(),
+ * libxml2 memory is accounted separately.
+ *
+ *    @param node Node to get property of.
+ *    @param prop Name of the property.
+ *    @return Newly allocated value of the property or NULL if not found.
+ */
+char* xml_nodeProp( xmlNodePtr node, const char *prop )
+{
+   xmlChar *val;
+   char *str;
+
+   val = xmlGetProp( node, (xmlChar*)prop );
+   if (val == NULL)
+      return NULL;
+   str = strdup( (char*)val );
+   xmlFree( val );
+   return str;
+}
 
 
 /**
  * @brief Parses a texture handling the sx and sy elements.
  *
+ * The texture is only requested, it gets read in the background and the
+ *  caller has to gl_texFlush() once it's done parsing. Textures that failed
+ *  to decode are then dropped with gl_texCheck().
+ *
  *    @param node Node to parse.
  *    @param path Path to get file from, should be in the format of
  *           "PREFIX%sSUFFIX".
@@ -32,8 +77,7 @@ glTexture* xml_parseTexture( xmlNodePtr node,
       const unsigned int flags )
 {
    int sx, sy;
-   char *buf, filename[PATH_MAX];
-   glTexture *tex;
+   char *buf;
 
    /*
     * Sane defaults.
@@ -60,17 +104,299 @@ glTexture* xml_parseTexture( xmlNodePtr node,
    if (buf == NULL)
       return NULL;
 
+   return xml_requestTexture( buf, path, sx, sy, flags );
+}
+
+
+/**
+ * @brief Parses a texture from a stream handling the sx and sy elements.
+ *
+ *    @param reader Reader positioned on the texture element.
+ *    @sa xml_parseTexture
+ */
+glTexture* xmls_parseTexture( xmlTextReaderPtr reader,
+      const char *path, int defsx, int defsy,
+      const unsigned int flags )
+{
+   int sx, sy;
+   char *buf;
+   const char *name;
+
+   /* Sane defaults. */
+   sx = defsx;
+   sy = defsy;
+
+   /* Attributes must be read before moving to the contents. */
+   buf = xmls_attr( reader, "sx" );
+   if (buf != NULL) {
+      sx = atoi(buf);
+      free(buf);
+   }
+   buf = xmls_attr( reader, "sy" );
+   if (buf != NULL) {
+      sy = atoi(buf);
+      free(buf);
+   }
+
+   /* Get graphic to load. */
+   name = xmls_get( reader );
+   if (name == NULL)
+      return NULL;
+
+   return xml_requestTexture( name, path, sx, sy, flags );
+}
+
+
+/**
+ * @brief Requests the texture named by an element.
+ */
+static glTexture* xml_requestTexture( const char *name, const char *path,
+      int sx, int sy, const unsigned int flags )
+{
+   char filename[PATH_MAX];
+
    /* Convert name. */
-   nsnprintf( filename, PATH_MAX, (path != NULL) ? path : "%s", buf );
+   nsnprintf( filename, PATH_MAX, (path != NULL) ? path : "%s", name );
 
-   /* Load the graphic. */
+   /* Request the graphic, a single sprite uses the metadata. */
    if ((sx == 1) && (sy == 1))
-      tex = gl_newImage( filename, flags );
-   else
-      tex = gl_newSprite( filename, sx, sy, flags );
+      return gl_texRequest( filename, 0, 0, flags );
+   return gl_texRequest( filename, sx, sy, flags );
+}
+
+
+/**
+ * @brief Opens a stream reader over a document in memory.
+ *
+ * Bulk loaders use it to pick out the fields they want without building the
+ *  whole tree, the buffer must outlive the reader.
+ *
+ *    @param buf Document to read.
+ *    @param len Length of the document.
+ *    @param url Name of the document for error messages.
+ *    @return The reader or NULL on error, must be closed with xmls_close().
+ */
+xmlTextReaderPtr xmls_open( const char *buf, size_t len, const char *url )
+{
+   xmlTextReaderPtr reader;
+   XmlsState *state;
+
+   if (buf == NULL)
+      return NULL;
+   reader = xmlReaderForMemory( buf, len, url, NULL, XML_PARSE_NONET );
+   if (reader == NULL)
+      return NULL;
+
+   state = calloc( 1, sizeof(XmlsState) );
+   state->url = strdup( (url != NULL) ? url : "" );
+   xmlTextReaderSetErrorHandler( reader, xmls_error, state );
+   return reader;
+}
+
+
+/**
+ * @brief Closes a stream reader.
+ *
+ *    @param reader Reader to close.
+ */
+void xmls_close( xmlTextReaderPtr reader )
+{
+   XmlsState *state;
+
+   state = xmls_state( reader );
+   if (state != NULL) {
+      free( state->url );
+      free( state );
+   }
+   xmlFreeTextReader( reader );
+}
+
+
+/**
+ * @brief Checks to see if the document was malformed.
+ *
+ * Reading stops at the first error, so xmls_nextChild() just finds no more
+ *  children. Loaders have to check this once done to tell a short document
+ *  apart from a broken one.
+ *
+ *    @param reader Reader to check.
+ *    @return 1 if an error was found while reading.
+ */
+int xmls_failed( xmlTextReaderPtr reader )
+{
+   XmlsState *state;
+
+   state = xmls_state( reader );
+   return (state != NULL) && (state->errors > 0);
+}
+
+
+/**
+ * @brief Gets the state set up by xmls_open().
+ */
+static XmlsState* xmls_state( xmlTextReaderPtr reader )
+{
+   xmlTextReaderErrorFunc f;
+   void *arg;
+
+   xmlTextReaderGetErrorHandler( reader, &f, &arg );
+   if (f != xmls_error)
+      return NULL;
+   return (XmlsState*) arg;
+}
+
+
+/**
+ * @brief Records errors found while streaming a document.
+ *
+ * The document is only parsed as it's read, so this is where malformed files
+ *  are noticed. Only the first error is reported.
+ */
+static void xmls_error( void *arg, const char *msg,
+      xmlParserSeverities severity, xmlTextReaderLocatorPtr locator )
+{
+   XmlsState *state;
+   int len;
+
+   if ((severity != XML_PARSER_SEVERITY_ERROR) &&
+         (severity != XML_PARSER_SEVERITY_VALIDITY_ERROR))
+      return;
+
+   state = (XmlsState*) arg;
+   if (state->errors++ > 0)
+      return;
+
+   /* libxml2 messages end with a newline. */
+   len = strlen( msg );
+   while ((len > 0) && (msg[len-1] == '\n'))
+      len--;
+   WARN(_("'%s' is not valid XML (line %d): %.*s"), state->url,
+         xmlTextReaderLocatorLineNumber( locator ), len, msg );
+}
+
+
+/**
+ * @brief Moves to the next child element.
+ *
+ * Anything that isn't an element, and anything deeper than the children, is
+ *  skipped. Typical use is:
+ *
+ * @code
+ * depth = xmls_depth( reader );
+ * while (xmls_nextChild( reader, depth )) {
+ *    xmls_float( reader, "speed", speed );
+ * }
+ * @endcode
+ *
+ *    @param reader Reader to move.
+ *    @param depth Depth of the parent element, -1 for the root element.
+ *    @return 1 if positioned on a child, 0 when the parent is done.
+ */
+int xmls_nextChild( xmlTextReaderPtr reader, int depth )
+{
+   int type, d;
+
+   /* Still on an empty parent, no children to find. */
+   if ((xmlTextReaderNodeType( reader ) == XML_READER_TYPE_ELEMENT) &&
+         (xmlTextReaderDepth( reader ) == depth) &&
+         xmlTextReaderIsEmptyElement( reader ))
+      return 0;
+
+   while (xmlTextReaderRead( reader ) == 1) {
+      type  = xmlTextReaderNodeType( reader );
+      d     = xmlTextReaderDepth( reader );
+      if (d <= depth)
+         return 0;
+      if ((type == XML_READER_TYPE_ELEMENT) && (d == depth+1))
+         return 1;
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Gets the text of the current element.
+ *
+ * Moves into the element, so attributes have to be read first.
+ *
+ *    @param reader Reader positioned on the element.
+ *    @return The text, valid until the reader moves again, or NULL if empty.
+ */
+const char* xmls_get( xmlTextReaderPtr reader )
+{
+   int type;
+
+   if (xmlTextReaderIsEmptyElement( reader ))
+      return NULL;
+   if (xmlTextReaderRead( reader ) != 1)
+      return NULL;
+
+   type = xmlTextReaderNodeType( reader );
+   if ((type != XML_READER_TYPE_TEXT) && (type != XML_READER_TYPE_CDATA) &&
+         (type != XML_READER_TYPE_SIGNIFICANT_WHITESPACE))
+      return NULL;
+   return (const char*)xmlTextReaderConstValue( reader );
+}
+
+
+/**
+ * @brief Gets the text of the current element as a long.
+ */
+long xmls_getLong( xmlTextReaderPtr reader )
+{
+   const char *str = xmls_get( reader );
+   return (str == NULL) ? 0 : strtol( str, NULL, 10 );
+}
+
+
+/**
+ * @brief Gets the text of the current element as an unsigned long.
+ */
+unsigned long xmls_getULong( xmlTextReaderPtr reader )
+{
+   const char *str = xmls_get( reader );
+   return (str == NULL) ? 0 : strtoul( str, NULL, 10 );
+}
 
-   /* Return result. */
-   return tex;
+
+/**
+ * @brief Gets the text of the current element as a double.
+ */
+double xmls_getFloat( xmlTextReaderPtr reader )
+{
+   const char *str = xmls_get( reader );
+   return (str == NULL) ? 0. : atof( str );
+}
+
+
+/**
+ * @brief Gets a copy of the text of the current element.
+ */
+char* xmls_getStrd( xmlTextReaderPtr reader )
+{
+   const char *str = xmls_get( reader );
+   return (str == NULL) ? NULL : strdup( str );
+}
+
+
+/**
+ * @brief Gets an attribute of the current element.
+ *
+ *    @param reader Reader positioned on the element.
+ *    @param prop Name of the attribute.
+ *    @return Newly allocated value of the attribute or NULL if not found.
+ */
+char* xmls_attr( xmlTextReaderPtr reader, const char *prop )
+{
+   xmlChar *val;
+   char *str;
+
+   val = xmlTextReaderGetAttribute( reader, (const xmlChar*)prop );
+   if (val == NULL)
+      return NULL;
+   str = strdup( (char*)val );
+   xmlFree( val );
+   return str;
 }
 
 
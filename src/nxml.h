@@ -10,6 +10,7 @@
 #include <errno.h>
 
 #include "libxml/parser.h"
+#include "libxml/xmlreader.h"
 #include "libxml/xmlwriter.h"
 
 #include "log.h"
@@ -36,7 +37,7 @@
    ((n!=NULL) && ((n = n->next) != NULL))
 
 /* gets the property s of node n. WARNING: MALLOCS! */
-#define xml_nodeProp(n,s)     (char*)xmlGetProp(n,(xmlChar*)s)
+char* xml_nodeProp( xmlNodePtr node, const char *prop );
 
 /* get data different ways */
 #define xml_raw(n)            ((char*)(n)->children->content)
@@ -82,6 +83,46 @@
 #define xmlr_attr(n,s,a) \
    a = xml_nodeProp(n,s)
 
+/*
+ * stream crap, walks the document without building the tree
+ */
+#define xmls_name(r)       ((const char*)xmlTextReaderConstName(r))
+#define xmls_depth(r)      xmlTextReaderDepth(r)
+#define xmls_isNode(r,s)   (strcmp(xmls_name(r),s)==0)
+
+xmlTextReaderPtr xmls_open( const char *buf, size_t len, const char *url );
+void xmls_close( xmlTextReaderPtr reader );
+int xmls_failed( xmlTextReaderPtr reader );
+int xmls_nextChild( xmlTextReaderPtr reader, int depth );
+const char* xmls_get( xmlTextReaderPtr reader );
+long xmls_getLong( xmlTextReaderPtr reader );
+unsigned long xmls_getULong( xmlTextReaderPtr reader );
+double xmls_getFloat( xmlTextReaderPtr reader );
+char* xmls_getStrd( xmlTextReaderPtr reader );
+char* xmls_attr( xmlTextReaderPtr reader, const char *prop );
+
+#define xmls_int(r,s,i) \
+   {if (xmls_isNode(r,s)) { \
+      i = xmls_getLong(r); continue; }}
+#define xmls_uint(r,s,i) \
+   {if (xmls_isNode(r,s)) { \
+      i = xmls_getULong(r); continue; }}
+#define xmls_long(r,s,l) \
+   {if (xmls_isNode(r,s)) { \
+      l = xmls_getLong(r); continue; }}
+#define xmls_ulong(r,s,l) \
+   {if (xmls_isNode(r,s)) { \
+      l = xmls_getULong(r); continue; }}
+#define xmls_float(r,s,f) \
+   {if (xmls_isNode(r,s)) { \
+      f = xmls_getFloat(r); continue; }}
+#define xmls_strd(r,s,str) \
+   {if (xmls_isNode(r,s)) { \
+      if (str != NULL) { \
+         WARN("Node '%s' already loaded and being trying to replace '%s'", \
+               s, str ); } \
+      str = xmls_getStrd(r); continue; }}
+
 /*
  * writer crap
  */
@@ -124,6 +165,9 @@ do {if (xmlTextWriterEndDocument(w) < 0) { \
 glTexture* xml_parseTexture( xmlNodePtr node,
       const char *path, int defsx, int defsy,
       const unsigned int flags );
+glTexture* xmls_parseTexture( xmlTextReaderPtr reader,
+      const char *path, int defsx, int defsy,
+      const unsigned int flags );
 
 
 /*
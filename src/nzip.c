@@ -4,8 +4,35 @@
 
 #include <zip.h>
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "log.h"
 #include "nfile.h"
+#include "nmem.h"
+
+
+#define NZIP_CACHE_MAX        (32*1024*1024) /**< Bytes of decompressed entries kept around. */
+#define NZIP_CACHE_ENTRY_MAX  (1024*1024) /**< Bigger entries are not worth keeping. */
+#define NZIP_CACHE_BUCKETS    1024 /**< Hash buckets, must be a power of two. */
+
+
+/**
+ * @brief A decompressed archive entry.
+ */
+typedef struct NzipCache_ {
+   struct zip *arc;           /**< Archive the entry belongs to. */
+   zip_uint64_t index;        /**< Index of the entry in the archive. */
+   void *data;                /**< Decompressed data. */
+   size_t size;               /**< Size of the data. */
+   struct NzipCache_ *next;   /**< Next in the hash bucket. */
+   struct NzipCache_ *lru_prev; /**< More recently used. */
+   struct NzipCache_ *lru_next; /**< Less recently used. */
+} NzipCache;
+static NzipCache *nzip_cache[NZIP_CACHE_BUCKETS]; /**< Hash buckets by entry index. */
+static NzipCache *nzip_lruHead = NULL; /**< Most recently used entry. */
+static NzipCache *nzip_lruTail = NULL; /**< Least recently used entry. */
+static size_t nzip_cacheMem    = 0; /**< Bytes held by the cache. */
 
 
 /**
@@ -13,6 +40,12 @@
  */
 void nzip_printError ( int err );
 int nzip_rwopsClose ( struct SDL_RWops* context );
+static void* nzip_inflate ( struct zip* arc, const char* filename, size_t* size );
+static NzipCache* nzip_cacheFind ( struct zip* arc, zip_uint64_t index );
+static void nzip_cacheAdd ( struct zip* arc, zip_uint64_t index, void* data, size_t size );
+static void nzip_cacheRemove ( NzipCache* c );
+static void nzip_lruUnlink ( NzipCache* c );
+static void nzip_lruPush ( NzipCache* c );
 
 
 /**
@@ -64,6 +97,15 @@ struct zip* nzip_open ( const char* filename )
  */
 void nzip_close ( struct zip* arc )
 {
+   NzipCache *c, *next;
+
+   // Drop its cached entries, the pointer may be reused
+   for ( c = nzip_lruHead; c != NULL; c = next ) {
+      next = c->lru_next;
+      if ( c->arc == arc )
+         nzip_cacheRemove ( c );
+   }
+
    if ( zip_close ( arc ) ) {
       WARN ( _("Error closing zip file") );
       WARN ( "%s", zip_strerror ( arc ) );
@@ -83,15 +125,186 @@ int nzip_hasFile ( struct zip* arc, const char* filename )
    return zip_name_locate ( arc, filename, flags ) >= 0;
 }
 
+/**
+ * @brief Unlinks an entry from the LRU list.
+ */
+static void nzip_lruUnlink ( NzipCache* c )
+{
+   if ( c->lru_prev != NULL )
+      c->lru_prev->lru_next = c->lru_next;
+   else
+      nzip_lruHead = c->lru_next;
+   if ( c->lru_next != NULL )
+      c->lru_next->lru_prev = c->lru_prev;
+   else
+      nzip_lruTail = c->lru_prev;
+   c->lru_prev = NULL;
+   c->lru_next = NULL;
+}
+
+/**
+ * @brief Puts an entry at the front of the LRU list.
+ */
+static void nzip_lruPush ( NzipCache* c )
+{
+   c->lru_prev = NULL;
+   c->lru_next = nzip_lruHead;
+   if ( nzip_lruHead != NULL )
+      nzip_lruHead->lru_prev = c;
+   else
+      nzip_lruTail = c;
+   nzip_lruHead = c;
+}
+
+/**
+ * @brief Finds a cached entry, marking it as recently used.
+ *
+ *    @param arc Archive the entry belongs to
+ *    @param index Index of the entry in the archive
+ *    @return The cached entry or NULL if not cached
+ */
+static NzipCache* nzip_cacheFind ( struct zip* arc, zip_uint64_t index )
+{
+   NzipCache *c;
+
+   for ( c = nzip_cache[index & ( NZIP_CACHE_BUCKETS - 1 )]; c != NULL; c = c->next ) {
+      if ( ( c->arc == arc ) && ( c->index == index ) ) {
+         nzip_lruUnlink ( c );
+         nzip_lruPush ( c );
+         return c;
+      }
+   }
+   return NULL;
+}
+
+/**
+ * @brief Removes an entry from the cache and frees it.
+ */
+static void nzip_cacheRemove ( NzipCache* c )
+{
+   NzipCache **p;
+
+   for ( p = &nzip_cache[c->index & ( NZIP_CACHE_BUCKETS - 1 )]; *p != NULL; p = &( *p )->next ) {
+      if ( *p == c ) {
+         *p = c->next;
+         break;
+      }
+   }
+   nzip_lruUnlink ( c );
+   nzip_cacheMem -= c->size;
+   nmem_free ( MEM_NDATA, c->size );
+   free ( c->data );
+   free ( c );
+}
+
+/**
+ * @brief Adds decompressed data to the cache, taking ownership of it.
+ *
+ * The least recently used entries are dropped to stay within NZIP_CACHE_MAX.
+ *
+ *    @param arc Archive the entry belongs to
+ *    @param index Index of the entry in the archive
+ *    @param data Decompressed data
+ *    @param size Size of the data
+ */
+static void nzip_cacheAdd ( struct zip* arc, zip_uint64_t index, void* data, size_t size )
+{
+   NzipCache *c;
+   int b;
+
+   while ( ( nzip_lruTail != NULL ) && ( nzip_cacheMem + size > NZIP_CACHE_MAX ) )
+      nzip_cacheRemove ( nzip_lruTail );
+
+   c           = calloc ( 1, sizeof ( NzipCache ) );
+   c->arc      = arc;
+   c->index    = index;
+   c->data     = data;
+   c->size     = size;
+   b           = index & ( NZIP_CACHE_BUCKETS - 1 );
+   c->next     = nzip_cache[b];
+   nzip_cache[b] = c;
+   nzip_lruPush ( c );
+   nzip_cacheMem += size;
+   nmem_alloc ( MEM_NDATA, size );
+}
+
 /**
  * @brief Read the contents of a file from an archive
  *
+ * Small entries are kept decompressed in an LRU cache, so reading them again
+ *  only costs a copy. Access to the archive and the cache must be serialized
+ *  by the caller, like ndata does.
+ *
  *    @param arc Archive to look in
  *    @param filename File to read
  *    @param[out] size Size of returned buffer
  *    @return A pointer to the file contents in memory
  */
 void* nzip_readFile ( struct zip* arc, const char* filename, size_t* size )
+{
+   NzipCache *c;
+   zip_int64_t index;
+   void *data, *copy;
+
+   index = zip_name_locate ( arc, filename, 0 );
+   if ( index >= 0 ) {
+      c = nzip_cacheFind ( arc, index );
+      if ( c != NULL ) {
+         data = malloc ( c->size );
+         memcpy ( data, c->data, c->size );
+         *size = c->size;
+         return data;
+      }
+   }
+
+   data = nzip_inflate ( arc, filename, size );
+   if ( ( data != NULL ) && ( index >= 0 ) && ( *size <= NZIP_CACHE_ENTRY_MAX ) ) {
+      copy = malloc ( *size );
+      memcpy ( copy, data, *size );
+      nzip_cacheAdd ( arc, index, copy, *size );
+   }
+   return data;
+}
+
+/**
+ * @brief Decompresses an entry into the cache ahead of it being read.
+ *
+ *    @param arc Archive to look in
+ *    @param filename File to decompress
+ *    @return 0 on success or if it was already cached
+ */
+int nzip_prefetch ( struct zip* arc, const char* filename )
+{
+   zip_int64_t index;
+   size_t size;
+   void *data;
+
+   index = zip_name_locate ( arc, filename, 0 );
+   if ( index < 0 )
+      return -1;
+   if ( nzip_cacheFind ( arc, index ) != NULL )
+      return 0;
+
+   data = nzip_inflate ( arc, filename, &size );
+   if ( data == NULL )
+      return -1;
+   if ( size > NZIP_CACHE_ENTRY_MAX ) {
+      free ( data );
+      return -1;
+   }
+   nzip_cacheAdd ( arc, index, data, size );
+   return 0;
+}
+
+/**
+ * @brief Decompresses a file from an archive
+ *
+ *    @param arc Archive to look in
+ *    @param filename File to read
+ *    @param[out] size Size of returned buffer
+ *    @return A pointer to the file contents in memory
+ */
+static void* nzip_inflate ( struct zip* arc, const char* filename, size_t* size )
 {
    struct zip_file* file;
    struct zip_stat stats;
@@ -16,6 +16,7 @@ void nzip_close ( struct zip* arc );
 
 int nzip_hasFile ( struct zip* arc, const char* filename );
 void* nzip_readFile ( struct zip* arc, const char* filename, size_t* size );
+int nzip_prefetch ( struct zip* arc, const char* filename );
 char** nzip_listFiles ( struct zip* arc, size_t* nfiles );
 
 SDL_RWops* nzip_rwops ( struct zip* arc, const char* filename );
@@ -28,6 +29,7 @@ SDL_RWops* nzip_rwops ( struct zip* arc, const char* filename );
 
 #define nzip_hasFile(a, b) 0
 #define nzip_readFile(a, b, c) NULL
+#define nzip_prefetch(a, b)
 #define nzip_listFiles(a, b) NULL
 
 #define nzip_rwops(a, b) NULL
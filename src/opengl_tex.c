@@ -24,21 +24,63 @@
 #include "gui.h"
 #include "conf.h"
 #include "npng.h"
-#include "md5.h"
+#include "nmem.h"
+#include "array.h"
+#include "threadpool.h"
+#include "colcache.h"
 
 
 /*
  * graphic list
  */
+#define TEXTURE_HASH_MIN   256 /**< Initial number of hash buckets. */
 /**
- * @brief Represents a node in the texture list.
+ * @brief Represents a node in the texture hash table.
+ *
+ * Textures that can be loaded again from their name are kept around when
+ *  they are no longer used, in least recently used order, until they have
+ *  to be evicted to stay in the texture budget.
  */
 typedef struct glTexList_ {
-   struct glTexList_ *next; /**< Next in linked list */
+   struct glTexList_ *next; /**< Next in the hash bucket. */
+   struct glTexList_ *lru_prev; /**< More recently unused texture. */
+   struct glTexList_ *lru_next; /**< Less recently unused texture. */
    glTexture *tex; /**< associated texture */
+   uint32_t hash; /**< Hash of the name. */
    int used; /**< counts how many times texture is being used */
+   int reload; /**< Texture can be loaded again from its name. */
 } glTexList;
-static glTexList* texture_list = NULL; /**< Texture list. */
+static glTexList **texture_hash = NULL; /**< Hash buckets. */
+static int texture_nhash = 0; /**< Number of buckets, always a power of two. */
+static int texture_count = 0; /**< Number of textures in the table. */
+static glTexList *texture_lruHead = NULL; /**< Most recently unused texture. */
+static glTexList *texture_lruTail = NULL; /**< Least recently unused texture. */
+static glTexStats texture_stats; /**< Cache statistics. */
+
+
+/*
+ * Background loading.
+ */
+/**
+ * @brief Image read on the threadpool, waiting to be uploaded.
+ *
+ * The worker does everything but the upload: reading, PNG decoding, POT
+ *  padding and the transparency map (cache lookup included).
+ */
+struct glTexImage_ {
+   char *path; /**< Image to load. */
+   unsigned int flags; /**< Flags to load with. */
+   SDL_Surface *surface; /**< Decoded and padded surface. */
+   uint8_t *trans; /**< Transparency map if OPENGL_TEX_MAPTRANS is set. */
+   png_uint_32 w; /**< Real width. */
+   png_uint_32 h; /**< Real height. */
+   int sx; /**< X sprites, read from the metadata if not set. */
+   int sy; /**< Y sprites, read from the metadata if not set. */
+   int done; /**< Reading is done, protected by gl_imageLock. */
+};
+static SDL_mutex *gl_imageLock = NULL; /**< Protects glTexImage.done. */
+static SDL_cond *gl_imageCond = NULL; /**< Signalled when an image is read. */
+static glTexture **gl_texPending = NULL; /**< Requested textures not uploaded yet (array.h). */
 
 
 /*
@@ -55,12 +97,37 @@ static int gl_tex_ext_npot = 0; /**< Support for GL_ARB_texture_non_power_of_two
 static int SDL_IsTrans( SDL_Surface* s, int x, int y );
 static uint8_t* SDL_MapTrans( SDL_Surface* s, int w, int h );
 static size_t gl_transSize( const int w, const int h );
+static size_t gl_texMemSize( const glTexture *tex );
+static uint8_t* gl_transLoad( const char *name, SDL_Surface* surface, SDL_RWops *rw,
+      int w, int h );
 /* glTexture */
 static GLuint gl_loadSurface( SDL_Surface* surface, int *rw, int *rh, unsigned int flags, int freesur );
+static void gl_texSetup( glTexture *texture, SDL_Surface* surface,
+      unsigned int flags, int w, int h, int sx, int sy, int freesur );
+static glTexture* gl_texNewPad( const char *name, SDL_Surface* surface, SDL_RWops *rw,
+      unsigned int flags, int w, int h, int sx, int sy, int freesur );
 static glTexture* gl_loadNewImage( const char* path, unsigned int flags );
+/* Background loading. */
+static glTexImage* gl_imageNew( const char* path, int sx, int sy, unsigned int flags );
+static void gl_imageRead( glTexImage *img );
+static int gl_imageThread( void *data );
+static void gl_imageWait( glTexImage *img );
+static void gl_imageFree( glTexImage *img );
+static void gl_imageSetup( glTexture *texture, glTexImage *img );
+static glTexture* gl_imageTexture( glTexImage *img );
+static void gl_texUnpend( glTexture *texture );
 /* List. */
+static uint32_t gl_texHash( const char* name );
+static glTexList* gl_texFind( const char* name, uint32_t hash );
+static void gl_texRehash( int nhash );
 static glTexture* gl_texExists( const char* path );
-static int gl_texAdd( glTexture *tex );
+static int gl_texAdd( glTexture *tex, int reload );
+static void gl_texRemove( glTexList *node );
+static void gl_texLRUAdd( glTexList *node );
+static void gl_texLRURemove( glTexList *node );
+static void gl_texEvict( size_t budget );
+static size_t gl_texBudget (void);
+static void gl_texDestroy( glTexture *texture );
 
 
 /**
@@ -214,6 +281,24 @@ static size_t gl_transSize( const int w, const int h )
 }
 
 
+/*
+ * @brief Estimates the memory used by a texture on the graphics card.
+ *
+ *    @param tex Texture to get memory of.
+ *    @return The size in bytes.
+ */
+static size_t gl_texMemSize( const glTexture *tex )
+{
+   size_t size;
+
+   size = (size_t)tex->rw * (size_t)tex->rh * 4;
+   /* Mipmaps add a third. */
+   if ((tex->flags & OPENGL_TEX_MIPMAPS) && gl_texHasMipmaps())
+      size += size / 3;
+   return size;
+}
+
+
 /**
  * @brief Prepares the surface to be loaded as a texture.
  *
@@ -360,50 +445,34 @@ static GLuint gl_loadSurface( SDL_Surface* surface, int *rw, int *rh, unsigned i
 
 
 /**
- * @brief Wrapper for gl_loadImagePad that includes transparency mapping.
+ * @brief Gets the transparency map of a surface.
  *
- *    @param name Name to load with.
- *    @param surface Surface to load.
+ * Maps are cached by the hash of the file they come from. Safe to call off
+ *  the main thread.
+ *
+ *    @param name Name of the image, only for warnings.
+ *    @param surface Surface to map.
  *    @param rw RWops containing data to hash.
- *    @param flags Flags to use.
  *    @param w Non-padded width.
  *    @param h Non-padded height.
- *    @param sx X sprites.
- *    @param sy Y sprites.
- *    @param freesur Whether or not to free the surface.
- *    @return The glTexture for surface.
+ *    @return The transparency map.
  */
-glTexture* gl_loadImagePadTrans( const char *name, SDL_Surface* surface, SDL_RWops *rw,
-      unsigned int flags, int w, int h, int sx, int sy, int freesur )
+static uint8_t* gl_transLoad( const char *name, SDL_Surface* surface, SDL_RWops *rw,
+      int w, int h )
 {
-   glTexture *texture;
-   size_t i, filesize;
    size_t cachesize, pngsize;
    uint8_t *trans;
-   char *cachefile, *data;
-   char digest[33];
-   md5_state_t md5;
-   md5_byte_t *md5val;
-
-   if (name != NULL) {
-      texture = gl_texExists( name );
-      if (texture != NULL)
-         return texture;
-   }
-
-   if (flags & OPENGL_TEX_MAPTRANS)
-      flags ^= OPENGL_TEX_MAPTRANS;
+   char *data;
+   uint64_t key;
 
    /* Appropriate size for the transparency map, see SDL_MapTrans */
    cachesize = gl_transSize(w, h);
 
-   cachefile = NULL;
-   trans     = NULL;
+   trans   = NULL;
+   key     = 0;
+   pngsize = 0;
 
    if (rw != NULL) {
-      md5val = malloc(16);
-      md5_init(&md5);
-
       pngsize = SDL_RWseek( rw, 0, SEEK_END );
       SDL_RWseek( rw, 0, SEEK_SET );
 
@@ -412,33 +481,11 @@ glTexture* gl_loadImagePadTrans( const char *name, SDL_Surface* surface, SDL_RWo
          WARN(_("Out of Memory"));
       else {
          SDL_RWread( rw, data, pngsize, 1 );
-         md5_append( &md5, (md5_byte_t*)data, pngsize );
+         key = colcache_hash( data, pngsize );
          free(data);
-      }
-      md5_finish( &md5, md5val );
-
-      for (i=0; i<16; i++)
-         nsnprintf( &digest[i * 2], 3, "%02x", md5val[i] );
-      free(md5val);
-
-      cachefile = malloc( PATH_MAX );
-      nsnprintf( cachefile, PATH_MAX, "%scollisions/%s",
-         nfile_cachePath(), digest );
-
-      /* Attempt to find a cached transparency map. */
-      if (nfile_fileExists(cachefile)) {
-         trans = (uint8_t*)nfile_readFile( &filesize, cachefile );
 
-         /* Consider cached data invalid if the length doesn't match. */
-         if (trans != NULL && cachesize != (unsigned int)filesize) {
-            free(trans);
-            trans = NULL;
-         }
-         /* Cached data matches, no need to overwrite. */
-         else {
-            free(cachefile);
-            cachefile = NULL;
-         }
+         /* Attempt to find a cached transparency map. */
+         trans = colcache_get( key, pngsize, cachesize );
       }
    }
    else {
@@ -453,17 +500,44 @@ glTexture* gl_loadImagePadTrans( const char *name, SDL_Surface* surface, SDL_RWo
       trans = SDL_MapTrans( surface, w, h );
       SDL_UnlockSurface(surface);
 
-      if (cachefile != NULL) {
-         /* Cache newly-generated transparency map. */
-         nfile_dirMakeExist( "%s/collisions/", nfile_cachePath() );
-         nfile_writeFile( (char*)trans, cachesize, cachefile );
-         free(cachefile);
+      /* Cache newly-generated transparency map. */
+      if (pngsize > 0)
+         colcache_put( key, pngsize, trans, cachesize );
+   }
+
+   return trans;
+}
+
+
+/**
+ * @brief Wrapper for gl_loadImagePad that includes transparency mapping.
+ *
+ *    @param name Name to load with.
+ *    @param surface Surface to load.
+ *    @param rw RWops containing data to hash.
+ *    @param flags Flags to use.
+ *    @param w Non-padded width.
+ *    @param h Non-padded height.
+ *    @param sx X sprites.
+ *    @param sy Y sprites.
+ *    @param freesur Whether or not to free the surface.
+ *    @return The glTexture for surface.
+ */
+glTexture* gl_loadImagePadTrans( const char *name, SDL_Surface* surface, SDL_RWops *rw,
+      unsigned int flags, int w, int h, int sx, int sy, int freesur )
+{
+   glTexture *texture;
+
+   if (name != NULL) {
+      texture = gl_texExists( name );
+      if (texture != NULL) {
+         gl_texFinish( texture );
+         return texture;
       }
    }
 
-   texture = gl_loadImagePad( name, surface, flags, w, h, sx, sy, freesur );
-   texture->trans = trans;
-   return texture;
+   return gl_texNewPad( name, surface, rw, flags | OPENGL_TEX_MAPTRANS,
+         w, h, sx, sy, freesur );
 }
 
 
@@ -484,21 +558,84 @@ glTexture* gl_loadImagePad( const char *name, SDL_Surface* surface,
       unsigned int flags, int w, int h, int sx, int sy, int freesur )
 {
    glTexture *texture;
-   int rw, rh;
 
    /* Make sure doesn't already exist. */
    if (name != NULL) {
       texture = gl_texExists( name );
-      if (texture != NULL)
+      if (texture != NULL) {
+         gl_texFinish( texture );
          return texture;
+      }
    }
 
-   if (flags & OPENGL_TEX_MAPTRANS)
-      return gl_loadImagePadTrans( name, surface, NULL, flags, w, h,
-            sx, sy, freesur );
+   return gl_texNewPad( name, surface, NULL, flags, w, h, sx, sy, freesur );
+}
+
+
+/**
+ * @brief Creates a texture from an already padded surface.
+ *
+ * Doesn't look for an existing texture, the callers already did.
+ *
+ *    @param name Name to load with.
+ *    @param surface Surface to load.
+ *    @param rw RWops containing data to hash for the transparency map.
+ *    @param flags Flags to use.
+ *    @param w Non-padded width.
+ *    @param h Non-padded height.
+ *    @param sx X sprites.
+ *    @param sy Y sprites.
+ *    @param freesur Whether or not to free the surface.
+ *    @return The glTexture for surface.
+ */
+static glTexture* gl_texNewPad( const char *name, SDL_Surface* surface, SDL_RWops *rw,
+      unsigned int flags, int w, int h, int sx, int sy, int freesur )
+{
+   glTexture *texture;
+   uint8_t *trans;
+
+   /* Map the transparency before the surface is freed. */
+   trans = NULL;
+   if (flags & OPENGL_TEX_MAPTRANS) {
+      flags ^= OPENGL_TEX_MAPTRANS;
+      trans = gl_transLoad( name, surface, rw, w, h );
+   }
 
    /* set up the texture defaults */
    texture = calloc( 1, sizeof(glTexture) );
+   gl_texSetup( texture, surface, flags, w, h, sx, sy, freesur );
+   if (trans != NULL) {
+      texture->trans = trans;
+      nmem_alloc( MEM_COLLISION, gl_transSize(w, h) );
+   }
+
+   if (name != NULL) {
+      texture->name = strdup(name);
+      gl_texAdd( texture, 0 );
+   }
+   else
+      texture->name = NULL;
+
+   return texture;
+}
+
+
+/**
+ * @brief Uploads an already padded surface into a texture.
+ *
+ *    @param texture Texture to set up.
+ *    @param surface Surface to load.
+ *    @param flags Flags to use.
+ *    @param w Non-padded width.
+ *    @param h Non-padded height.
+ *    @param sx X sprites.
+ *    @param sy Y sprites.
+ *    @param freesur Whether or not to free the surface.
+ */
+static void gl_texSetup( glTexture *texture, SDL_Surface* surface,
+      unsigned int flags, int w, int h, int sx, int sy, int freesur )
+{
+   int rw, rh;
 
    texture->w     = (double) w;
    texture->h     = (double) h;
@@ -513,15 +650,11 @@ glTexture* gl_loadImagePad( const char *name, SDL_Surface* surface,
    texture->sh    = texture->h / texture->sy;
    texture->srw   = texture->sw / texture->rw;
    texture->srh   = texture->sh / texture->rh;
+   texture->flags = flags;
+   nmem_alloc( MEM_TEXTURE, gl_texMemSize(texture) );
 
-   if (name != NULL) {
-      texture->name = strdup(name);
-      gl_texAdd( texture );
-   }
-   else
-      texture->name = NULL;
-
-   return texture;
+   /* Make room for it. */
+   gl_texEvict( gl_texBudget() );
 }
 
 
@@ -538,9 +671,69 @@ glTexture* gl_loadImage( SDL_Surface* surface, unsigned int flags )
 }
 
 
+/**
+ * @brief Hashes the name of a texture (FNV-1a).
+ */
+static uint32_t gl_texHash( const char* name )
+{
+   uint32_t h;
+
+   h = 2166136261u;
+   for ( ; *name != '\0'; name++) {
+      h ^= (uint8_t) *name;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+
+/**
+ * @brief Finds the node of a texture by name.
+ */
+static glTexList* gl_texFind( const char* name, uint32_t hash )
+{
+   glTexList *cur;
+
+   if (texture_hash == NULL)
+      return NULL;
+
+   for (cur=texture_hash[ hash & (texture_nhash-1) ]; cur!=NULL; cur=cur->next)
+      if ((cur->hash == hash) && (strcmp(name,cur->tex->name)==0))
+         return cur;
+   return NULL;
+}
+
+
+/**
+ * @brief Resizes the hash table.
+ *
+ *    @param nhash New number of buckets, must be a power of two.
+ */
+static void gl_texRehash( int nhash )
+{
+   glTexList **buckets, *cur, *next;
+   int i;
+
+   buckets = calloc( nhash, sizeof(glTexList*) );
+   for (i=0; i<texture_nhash; i++) {
+      for (cur=texture_hash[i]; cur!=NULL; cur=next) {
+         next = cur->next;
+         cur->next = buckets[ cur->hash & (nhash-1) ];
+         buckets[ cur->hash & (nhash-1) ] = cur;
+      }
+   }
+   free( texture_hash );
+   texture_hash  = buckets;
+   texture_nhash = nhash;
+}
+
+
 /**
  * @brief Check to see if a texture matching a path already exists.
  *
+ * Gets a reference to it if it does, bringing it back from the cache if it
+ *  was no longer in use.
+ *
  *    @param path Path to the texture.
  *    @return The texture, or NULL if none was found.
  */
@@ -552,43 +745,160 @@ static glTexture* gl_texExists( const char* path )
    if (path==NULL)
       return NULL;
 
-   /* check to see if it already exists */
-   if (texture_list != NULL) {
-      for (cur=texture_list; cur!=NULL; cur=cur->next) {
-         if (strcmp(path,cur->tex->name)==0) {
-            cur->used += 1;
-            return cur->tex;
-         }
-      }
+   cur = gl_texFind( path, gl_texHash(path) );
+   if (cur == NULL) {
+      texture_stats.misses++;
+      return NULL;
    }
 
-   return NULL;
+   if (cur->used == 0) {
+      gl_texLRURemove( cur );
+      texture_stats.reused++;
+   }
+   else
+      texture_stats.hits++;
+   cur->used += 1;
+   return cur->tex;
 }
 
 
 /**
- * @brief Adds a texture to the list under the name of path.
+ * @brief Adds a texture to the table under the name of path.
+ *
+ *    @param tex Texture to add, must have a name.
+ *    @param reload Whether the texture can be loaded again from its name.
  */
-static int gl_texAdd( glTexture *tex )
+static int gl_texAdd( glTexture *tex, int reload )
 {
-   glTexList *new, *cur, *last;
+   glTexList *new;
+   int b;
+
+   if (texture_count >= texture_nhash)
+      gl_texRehash( MAX( TEXTURE_HASH_MIN, 2*texture_nhash ) );
 
    /* Create the new node */
-   new = malloc( sizeof(glTexList) );
-   new->next = NULL;
-   new->used = 1;
-   new->tex  = tex;
+   new = calloc( 1, sizeof(glTexList) );
+   new->used   = 1;
+   new->tex    = tex;
+   new->hash   = gl_texHash( tex->name );
+   new->reload = reload;
 
-   if (texture_list == NULL) /* special condition - creating new list */
-      texture_list = new;
-   else {
-      for (cur=texture_list; cur!=NULL; cur=cur->next)
-         last = cur;
+   b = new->hash & (texture_nhash-1);
+   new->next = texture_hash[b];
+   texture_hash[b] = new;
+   texture_count++;
+
+   return 0;
+}
+
+
+/**
+ * @brief Removes a node from the table and frees it, not the texture.
+ */
+static void gl_texRemove( glTexList *node )
+{
+   glTexList **cur;
 
-      last->next = new;
+   for (cur=&texture_hash[ node->hash & (texture_nhash-1) ]; *cur!=NULL; cur=&(*cur)->next) {
+      if (*cur == node) {
+         *cur = node->next;
+         break;
+      }
    }
+   texture_count--;
+   free( node );
+}
 
-   return 0;
+
+/**
+ * @brief Puts an unused texture at the head of the cache.
+ */
+static void gl_texLRUAdd( glTexList *node )
+{
+   node->lru_prev = NULL;
+   node->lru_next = texture_lruHead;
+   if (texture_lruHead != NULL)
+      texture_lruHead->lru_prev = node;
+   else
+      texture_lruTail = node;
+   texture_lruHead = node;
+
+   texture_stats.cached++;
+   texture_stats.cached_mem += gl_texMemSize( node->tex );
+}
+
+
+/**
+ * @brief Takes a texture out of the cache.
+ */
+static void gl_texLRURemove( glTexList *node )
+{
+   if (node->lru_prev != NULL)
+      node->lru_prev->lru_next = node->lru_next;
+   else
+      texture_lruHead = node->lru_next;
+   if (node->lru_next != NULL)
+      node->lru_next->lru_prev = node->lru_prev;
+   else
+      texture_lruTail = node->lru_prev;
+   node->lru_prev = NULL;
+   node->lru_next = NULL;
+
+   texture_stats.cached--;
+   texture_stats.cached_mem -= gl_texMemSize( node->tex );
+}
+
+
+/**
+ * @brief Evicts least recently used textures until under budget.
+ *
+ *    @param budget Texture memory to stay under, 0 empties the cache.
+ */
+static void gl_texEvict( size_t budget )
+{
+   glTexList *node;
+   glTexture *tex;
+
+   while ((texture_lruTail != NULL) &&
+         ((budget == 0) || (nmem_current( MEM_TEXTURE ) > budget))) {
+      node = texture_lruTail;
+      tex  = node->tex;
+      gl_texLRURemove( node );
+      gl_texRemove( node );
+      gl_texDestroy( tex );
+      texture_stats.evictions++;
+   }
+}
+
+
+/**
+ * @brief Gets the texture budget in bytes from the configuration.
+ */
+static size_t gl_texBudget (void)
+{
+   return (size_t)MAX( 0, conf.texture_budget ) * 1024 * 1024;
+}
+
+
+/**
+ * @brief Frees the texture itself, without touching the table.
+ */
+static void gl_texDestroy( glTexture *texture )
+{
+   if (texture->load != NULL) {
+      gl_imageWait( texture->load );
+      gl_imageFree( texture->load );
+      gl_texUnpend( texture );
+   }
+   glDeleteTextures( 1, &texture->texture );
+   nmem_free( MEM_TEXTURE, gl_texMemSize(texture) );
+   if (texture->trans != NULL) {
+      free(texture->trans);
+      nmem_free( MEM_COLLISION, gl_transSize(texture->w, texture->h) );
+   }
+   if (texture->name != NULL)
+      free(texture->name);
+   free(texture);
 }
 
 
@@ -605,10 +915,10 @@ glTexture* gl_newImage( const char* path, const unsigned int flags )
 {
    glTexture *t;
 
-   /* Check if it already exists. */
+   /* Check if it already exists, it may be a request that failed. */
    t = gl_texExists( path );
    if (t != NULL)
-      return t;
+      return gl_texCheck( t );
 
    /* Load the image */
    return gl_loadNewImage( path, flags );
@@ -625,54 +935,18 @@ glTexture* gl_newImage( const char* path, const unsigned int flags )
 static glTexture* gl_loadNewImage( const char* path, const unsigned int flags )
 {
    glTexture *texture;
-   SDL_Surface *surface;
-   SDL_RWops *rw;
-   npng_t *npng;
-   png_uint_32 w, h;
-   int sx, sy;
-   char *str;
-   int len;
+   glTexImage *img;
 
    if (path==NULL) {
       WARN(_("Trying to load image from NULL path."));
       return NULL;
    }
 
-   /* Load from packfile */
-   rw = ndata_rwops( path );
-   if (rw == NULL) {
-      WARN(_("Failed to load surface '%s' from ndata."), path);
-      return NULL;
-   }
-   npng     = npng_open( rw );
-   if (npng == NULL) {
-      WARN(_("File '%s' is not a png."), path );
-      return NULL;
-   }
-   npng_dim( npng, &w, &h );
-
-   /* Process metadata. */
-   len = npng_metadata( npng, "sx", &str );
-   sx  = (len > 0) ? atoi(str) : 1;
-   len = npng_metadata( npng, "sy", &str );
-   sy  = (len > 0) ? atoi(str) : 1;
-
-   /* Load surface. */
-   surface  = npng_readSurface( npng, gl_needPOT(), 1 );
-   npng_close( npng );
-
-   if (surface == NULL) {
-      WARN(_("'%s' could not be opened"), path );
-      SDL_RWclose( rw );
-      return NULL;
-   }
-
-   if (flags & OPENGL_TEX_MAPTRANS)
-      texture = gl_loadImagePadTrans( path, surface, rw, flags, w, h, sx, sy, 1 );
-   else
-      texture = gl_loadImagePad( path, surface, flags, w, h, sx, sy, 1 );
-
-   SDL_RWclose( rw );
+   /* Same as the background loading, just on this thread. */
+   img = gl_imageNew( path, 0, 0, flags );
+   gl_imageRead( img );
+   texture = gl_imageTexture( img );
+   gl_imageFree( img );
    return texture;
 }
 
@@ -709,11 +983,14 @@ glTexture* gl_newSprite( const char* path, const int sx, const int sy,
 /**
  * @brief Frees a texture.
  *
+ * Textures loaded from a file are kept in the cache while there is room in
+ *  the texture budget, so loading them again is free.
+ *
  *    @param texture Texture to free.
  */
 void gl_freeTexture( glTexture* texture )
 {
-   glTexList *cur, *last;
+   glTexList *cur;
 
    /* Shouldn't be NULL (won't segfault though) */
    if (texture == NULL) {
@@ -721,34 +998,31 @@ void gl_freeTexture( glTexture* texture )
       return;
    }
 
-   /* see if we can find it in stack */
-   last = NULL;
-   for (cur=texture_list; cur!=NULL; cur=cur->next) {
-      if (cur->tex == texture) { /* found it */
-         cur->used--;
-         if (cur->used <= 0) { /* not used anymore */
-            /* free the texture */
-            glDeleteTextures( 1, &texture->texture );
-            if (texture->trans != NULL)
-               free(texture->trans);
-            if (texture->name != NULL)
-               free(texture->name);
-            free(texture);
-
-            /* free the list node */
-            if (last == NULL) { /* case there's no texture before it */
-               if (cur->next != NULL)
-                  texture_list = cur->next;
-               else /* case it's the last texture */
-                  texture_list = NULL;
-            }
-            else
-               last->next = cur->next;
-            free(cur);
-         }
-         return; /* we already found it so we can exit */
+   /* see if we can find it in the table */
+   cur = NULL;
+   if (texture->name != NULL)
+      cur = gl_texFind( texture->name, gl_texHash(texture->name) );
+   if ((cur != NULL) && (cur->tex == texture)) {
+      if (cur->used <= 0) {
+         WARN(_("Attempting to free texture '%s' which is not in use!"), texture->name);
+         return;
+      }
+      cur->used--;
+      if (cur->used > 0)
+         return;
+
+      /* Keep it around if it can be loaded again. */
+      if (cur->reload && (texture->load == NULL) && (texture->texture != 0) &&
+            (gl_texBudget() > 0)) {
+         gl_texLRUAdd( cur );
+         gl_texEvict( gl_texBudget() );
+         return;
       }
-      last = cur;
+
+      gl_texRemove( cur );
+      gl_texDestroy( texture );
+      gl_checkErr();
+      return;
    }
 
    /* Not found */
@@ -756,12 +1030,7 @@ void gl_freeTexture( glTexture* texture )
       WARN(_("Attempting to free texture '%s' not found in stack!"), texture->name);
 
    /* Free anyways */
-   glDeleteTextures( 1, &texture->texture );
-   if (texture->trans != NULL)
-      free(texture->trans);
-   if (texture->name != NULL)
-      free(texture->name);
-   free(texture);
+   gl_texDestroy( texture );
 
    gl_checkErr();
 }
@@ -782,12 +1051,11 @@ glTexture* gl_dupTexture( glTexture *texture )
       return NULL;
 
    /* check to see if it already exists */
-   if (texture_list != NULL) {
-      for (cur=texture_list; cur!=NULL; cur=cur->next) {
-         if (texture == cur->tex) {
-            cur->used += 1;
-            return cur->tex;
-         }
+   if (texture->name != NULL) {
+      cur = gl_texFind( texture->name, gl_texHash(texture->name) );
+      if ((cur != NULL) && (cur->tex == texture) && (cur->used > 0)) {
+         cur->used += 1;
+         return cur->tex;
       }
    }
 
@@ -797,6 +1065,349 @@ glTexture* gl_dupTexture( glTexture *texture )
 }
 
 
+/**
+ * @brief Gets the texture cache statistics.
+ *
+ *    @param[out] stats Statistics to fill.
+ */
+void gl_texStats( glTexStats *stats )
+{
+   *stats = texture_stats;
+   stats->textures = texture_count;
+   stats->budget   = gl_texBudget();
+}
+
+
+/**
+ * @brief Prints the texture cache statistics.
+ *
+ *    @param print Function to print each line with.
+ */
+void gl_texPrint( void (*print)( const char *msg ) )
+{
+   char buf[256];
+   glTexStats st;
+
+   gl_texStats( &st );
+   nsnprintf( buf, sizeof(buf), _("Textures: %d loaded, %d cached (%.1f of %.1f MiB)"),
+         st.textures, st.cached, (double)st.cached_mem / (1024.*1024.),
+         (double)st.budget / (1024.*1024.) );
+   print( buf );
+   nsnprintf( buf, sizeof(buf), _("Texture lookups: %lu hits, %lu from cache, %lu misses, %lu evictions"),
+         st.hits, st.reused, st.misses, st.evictions );
+   print( buf );
+}
+
+
+/**
+ * @brief Creates an image to read.
+ *
+ *    @param path Image to read.
+ *    @param sx X sprites, 0 to read them from the metadata.
+ *    @param sy Y sprites, 0 to read them from the metadata.
+ *    @param flags Flags the texture will be loaded with.
+ *    @return The new image.
+ */
+static glTexImage* gl_imageNew( const char* path, int sx, int sy, unsigned int flags )
+{
+   glTexImage *img;
+
+   img = calloc( 1, sizeof(glTexImage) );
+   img->path  = strdup( path );
+   img->flags = flags;
+   img->sx    = sx;
+   img->sy    = sy;
+   return img;
+}
+
+
+/**
+ * @brief Reads, decodes and maps an image, safe to run off the main thread.
+ *
+ *    @param img Image to read.
+ */
+static void gl_imageRead( glTexImage *img )
+{
+   SDL_RWops *rw;
+   npng_t *npng;
+   char *str;
+   int len;
+
+   /* Load from packfile */
+   rw = ndata_rwops( img->path );
+   if (rw == NULL) {
+      WARN(_("Failed to load surface '%s' from ndata."), img->path);
+      return;
+   }
+   npng = npng_open( rw );
+   if (npng == NULL) {
+      WARN(_("File '%s' is not a png."), img->path );
+      SDL_RWclose( rw );
+      return;
+   }
+   npng_dim( npng, &img->w, &img->h );
+
+   /* Process metadata. */
+   if (img->sx <= 0) {
+      len     = npng_metadata( npng, "sx", &str );
+      img->sx = (len > 0) ? atoi(str) : 1;
+   }
+   if (img->sy <= 0) {
+      len     = npng_metadata( npng, "sy", &str );
+      img->sy = (len > 0) ? atoi(str) : 1;
+   }
+
+   /* Load surface, already padded if needed. */
+   img->surface = npng_readSurface( npng, gl_needPOT(), 1 );
+   npng_close( npng );
+
+   if (img->surface == NULL)
+      WARN(_("'%s' could not be opened"), img->path );
+   else if (img->flags & OPENGL_TEX_MAPTRANS)
+      img->trans = gl_transLoad( img->path, img->surface, rw, img->w, img->h );
+
+   SDL_RWclose( rw );
+}
+
+
+/**
+ * @brief Threadpool job to read an image.
+ */
+static int gl_imageThread( void *data )
+{
+   glTexImage *img = data;
+
+   gl_imageRead( img );
+
+   SDL_mutexP( gl_imageLock );
+   img->done = 1;
+   SDL_CondBroadcast( gl_imageCond );
+   SDL_mutexV( gl_imageLock );
+   return 0;
+}
+
+
+/**
+ * @brief Waits for an image to be read.
+ */
+static void gl_imageWait( glTexImage *img )
+{
+   SDL_mutexP( gl_imageLock );
+   while (!img->done)
+      SDL_CondWait( gl_imageCond, gl_imageLock );
+   SDL_mutexV( gl_imageLock );
+}
+
+
+/**
+ * @brief Frees an image.
+ */
+static void gl_imageFree( glTexImage *img )
+{
+   if (img->surface != NULL)
+      SDL_FreeSurface( img->surface );
+   free( img->trans );
+   free( img->path );
+   free( img );
+}
+
+
+/**
+ * @brief Uploads a read image into a texture.
+ *
+ *    @param texture Texture to set up.
+ *    @param img Image to upload, must have a surface.
+ */
+static void gl_imageSetup( glTexture *texture, glTexImage *img )
+{
+   gl_texSetup( texture, img->surface, img->flags & ~OPENGL_TEX_MAPTRANS,
+         img->w, img->h, img->sx, img->sy, 0 );
+   if (img->trans != NULL) {
+      texture->trans = img->trans;
+      img->trans     = NULL;
+      nmem_alloc( MEM_COLLISION, gl_transSize(img->w, img->h) );
+   }
+}
+
+
+/**
+ * @brief Gets the texture of a read image, uploading it if it's not loaded.
+ *
+ *    @param img Image to get texture of.
+ *    @return The texture or NULL on error.
+ */
+static glTexture* gl_imageTexture( glTexImage *img )
+{
+   glTexture *texture;
+
+   if (img->surface == NULL)
+      return NULL;
+
+   texture = gl_texExists( img->path );
+   if (texture != NULL) {
+      gl_texFinish( texture );
+      return texture;
+   }
+
+   texture = calloc( 1, sizeof(glTexture) );
+   texture->name = strdup( img->path );
+   gl_imageSetup( texture, img );
+   gl_texAdd( texture, 1 );
+   return texture;
+}
+
+
+/**
+ * @brief Removes a texture from the pending list.
+ */
+static void gl_texUnpend( glTexture *texture )
+{
+   int i, n;
+
+   n = array_size( gl_texPending );
+   for (i=0; i<n; i++) {
+      if (gl_texPending[i] == texture) {
+         gl_texPending[i] = gl_texPending[n-1];
+         array_resize( &gl_texPending, n-1 );
+         return;
+      }
+   }
+}
+
+
+/**
+ * @brief Requests a texture to be loaded in the background.
+ *
+ * The texture is returned right away but is empty until it gets uploaded by
+ *  gl_texFinish() or gl_texFlush(), so request a batch of textures and then
+ *  flush them. Images that exist but fail to decode are only noticed then,
+ *  gl_texCheck() drops them.
+ *
+ *    @param path Image to load.
+ *    @param sx X sprites, 0 to use the metadata.
+ *    @param sy Y sprites, 0 to use the metadata.
+ *    @param flags Flags to control image parameters.
+ *    @return The texture being loaded or NULL if the image doesn't exist.
+ */
+glTexture* gl_texRequest( const char* path, int sx, int sy, const unsigned int flags )
+{
+   glTexture *texture;
+   glTexImage *img;
+
+   if (path==NULL) {
+      WARN(_("Trying to load image from NULL path."));
+      return NULL;
+   }
+
+   /* Check if it already exists. */
+   texture = gl_texExists( path );
+   if (texture != NULL)
+      return texture;
+
+   /* Missing images fail right away like gl_newImage() does. */
+   if (!ndata_exists( path )) {
+      WARN(_("Failed to load surface '%s' from ndata."), path);
+      return NULL;
+   }
+
+   img = gl_imageNew( path, sx, sy, flags );
+   threadpool_newJob( gl_imageThread, img );
+
+   /* Placeholder until uploaded. */
+   texture = calloc( 1, sizeof(glTexture) );
+   texture->name  = strdup( path );
+   texture->sx    = 1.;
+   texture->sy    = 1.;
+   texture->flags = flags & ~OPENGL_TEX_MAPTRANS;
+   texture->load  = img;
+   gl_texAdd( texture, 1 );
+   array_push_back( &gl_texPending, texture );
+   return texture;
+}
+
+
+/**
+ * @brief Waits for a requested texture and uploads it.
+ *
+ * A texture whose image failed to decode stays empty.
+ *
+ *    @param texture Texture to finish loading, does nothing if it's loaded.
+ *    @return 0 if the texture is loaded, -1 if it failed to load.
+ */
+int gl_texFinish( glTexture *texture )
+{
+   glTexImage *img;
+
+   if (texture == NULL)
+      return -1;
+
+   if (texture->load != NULL) {
+      img = texture->load;
+      texture->load = NULL;
+      gl_texUnpend( texture );
+
+      gl_imageWait( img );
+      if (img->surface != NULL)
+         gl_imageSetup( texture, img );
+      gl_imageFree( img );
+   }
+
+   return (texture->texture == 0) ? -1 : 0;
+}
+
+
+/**
+ * @brief Finishes a requested texture, dropping it if it failed to load.
+ *
+ * Callers that fall back on NULL textures use this once the textures they
+ *  requested have been flushed.
+ *
+ *    @param texture Texture to check, may be NULL.
+ *    @return The texture or NULL if it failed to load, in which case the
+ *       reference to it is freed.
+ */
+glTexture* gl_texCheck( glTexture *texture )
+{
+   if (texture == NULL)
+      return NULL;
+   if (gl_texFinish( texture ) == 0)
+      return texture;
+   gl_freeTexture( texture );
+   return NULL;
+}
+
+
+/**
+ * @brief Uploads all the requested textures.
+ *
+ * Textures are uploaded in the order they finish decoding.
+ */
+void gl_texFlush (void)
+{
+   glTexture *texture;
+   int i, n;
+
+   while (array_size( gl_texPending ) > 0) {
+      texture = NULL;
+      SDL_mutexP( gl_imageLock );
+      while (texture == NULL) {
+         n = array_size( gl_texPending );
+         for (i=0; i<n; i++) {
+            if (gl_texPending[i]->load->done) {
+               texture = gl_texPending[i];
+               break;
+            }
+         }
+         if (texture == NULL)
+            SDL_CondWait( gl_imageCond, gl_imageLock );
+      }
+      SDL_mutexV( gl_imageLock );
+
+      gl_texFinish( texture );
+   }
+}
+
+
 /**
  * @brief Checks to see if a pixel is transparent in a texture.
  *
@@ -883,6 +1494,12 @@ int gl_initTextures (void)
    if (gl_hasVersion(2,0))
       gl_tex_ext_npot = 1;
 
+   /* Background loading. */
+   gl_imageLock   = SDL_CreateMutex();
+   gl_imageCond   = SDL_CreateCond();
+   gl_texPending  = array_create( glTexture* );
+   colcache_init();
+
    return 0;
 }
 
@@ -893,12 +1510,30 @@ int gl_initTextures (void)
 void gl_exitTextures (void)
 {
    glTexList *tex;
+   int i;
+
+   /* Unused textures are only cached. */
+   gl_texEvict( 0 );
 
    /* Make sure there's no texture leak */
-   if (texture_list != NULL) {
+   if (texture_count > 0) {
       DEBUG(_("Texture leak detected!"));
-      for (tex=texture_list; tex!=NULL; tex=tex->next)
-         DEBUG(_("   '%s' opened %d times"), tex->tex->name, tex->used );
+      for (i=0; i<texture_nhash; i++)
+         for (tex=texture_hash[i]; tex!=NULL; tex=tex->next)
+            DEBUG(_("   '%s' opened %d times"), tex->tex->name, tex->used );
    }
+   else {
+      free( texture_hash );
+      texture_hash  = NULL;
+      texture_nhash = 0;
+   }
+
+   array_free( gl_texPending );
+   gl_texPending = NULL;
+   colcache_exit();
+   SDL_DestroyCond( gl_imageCond );
+   SDL_DestroyMutex( gl_imageLock );
+   gl_imageCond = NULL;
+   gl_imageLock = NULL;
 }
 
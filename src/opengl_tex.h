@@ -39,6 +39,10 @@
 #define OPENGL_TEX_MAPTRANS   (1<<0) /**< Create a transparency map. */
 #define OPENGL_TEX_MIPMAPS    (1<<1) /**< Creates mipmaps. */
 
+
+struct glTexImage_;
+typedef struct glTexImage_ glTexImage; /**< Image being decoded in the background. */
+
 /**
  * @brief Abstraction for rendering sprite sheets.
  *
@@ -64,12 +68,28 @@ typedef struct glTexture_ {
    /* data */
    GLuint texture; /**< the opengl texture itself */
    uint8_t* trans; /**< maps the transparency */
+   glTexImage *load; /**< Pending background load, NULL once uploaded. */
 
    /* properties */
    uint8_t flags; /**< flags used for texture properties */
 } glTexture;
 
 
+/**
+ * @brief Texture cache statistics.
+ */
+typedef struct glTexStats_ {
+   int textures; /**< Textures loaded, in use or cached. */
+   int cached; /**< Unused textures kept in the cache. */
+   size_t cached_mem; /**< Texture memory used by the cache. */
+   size_t budget; /**< Texture memory budget. */
+   unsigned long hits; /**< Lookups of textures in use. */
+   unsigned long reused; /**< Lookups of cached textures. */
+   unsigned long misses; /**< Lookups of textures that had to be loaded. */
+   unsigned long evictions; /**< Textures evicted from the cache. */
+} glTexStats;
+
+
 /*
  * Init/exit.
  */
@@ -96,6 +116,14 @@ glTexture* gl_newSprite( const char* path, const int sx, const int sy,
       const unsigned int flags );
 glTexture* gl_dupTexture( glTexture *texture );
 
+/*
+ * Background loading.
+ */
+glTexture* gl_texRequest( const char* path, int sx, int sy, const unsigned int flags );
+int gl_texFinish( glTexture *texture );
+glTexture* gl_texCheck( glTexture *texture );
+void gl_texFlush (void);
+
 /*
  * Clean up.
  */
@@ -113,6 +141,8 @@ int gl_texHasCompress (void);
 int gl_isTrans( const glTexture* t, const int x, const int y );
 void gl_getSpriteFromDir( int* x, int* y, const glTexture* t, const double dir );
 int gl_needPOT (void);
+void gl_texStats( glTexStats *stats );
+void gl_texPrint( void (*print)( const char *msg ) );
 
 
 #endif /* OPENGL_TEX_H */
@@ -61,6 +61,7 @@ static void outfit_launcherDesc( Outfit* o );
 static int outfit_compareNames( const void *name1, const void *name2 );
 /* parsing */
 static int outfit_loadDir( char *dir );
+static void outfit_checkGFX( Outfit *o );
 static int outfit_parseDamage( Damage *dmg, xmlNodePtr node );
 static int outfit_parse( Outfit* temp, const char* file );
 static void outfit_parseSBolt( Outfit* temp, const xmlNodePtr parent );
@@ -550,6 +551,16 @@ glTexture* outfit_gfx( const Outfit* o )
    else if (outfit_isAmmo(o)) return o->u.amm.gfx_space;
    return NULL;
 }
+/**
+ * @brief Gets the outfit's store graphic, loading it on first use.
+ *    @param o Outfit to get information from.
+ */
+glTexture* outfit_gfxStore( Outfit* o )
+{
+   if ((o->gfx_store == NULL) && (o->gfx_storePath != NULL))
+      o->gfx_store = gl_newImage( o->gfx_storePath, OPENGL_TEX_MIPMAPS );
+   return o->gfx_store;
+}
 /**
  * @brief Gets the outfit's sound effect.
  *    @param o Outfit to get information from.
@@ -2056,7 +2067,7 @@ if (o) WARN(_("Outfit '%s' missing/invalid '%s' element"), temp->name, s) /**< D
 static int outfit_parse( Outfit* temp, const char* file )
 {
    xmlNodePtr cur, node, parent;
-   char *prop;
+   char *prop, str[PATH_MAX];
    const char *cprop;
    int group;
    size_t bufsize;
@@ -2097,8 +2108,10 @@ static int outfit_parse( Outfit* temp, const char* file )
             xmlr_strd(cur,"typename",temp->typename);
             xmlr_int(cur,"priority",temp->priority);
             if (xml_isNode(cur,"gfx_store")) {
-               temp->gfx_store = xml_parseTexture( cur,
-                     OUTFIT_GFX_PATH"store/%s.png", 1, 1, OPENGL_TEX_MIPMAPS );
+               if (xml_get(cur) != NULL) {
+                  nsnprintf( str, PATH_MAX, OUTFIT_GFX_PATH"store/%s.png", xml_get(cur) );
+                  temp->gfx_storePath = strdup( str );
+               }
                continue;
             }
             else if (xml_isNode(cur,"slot")) {
@@ -2202,7 +2215,7 @@ if (o) WARN( _("Outfit '%s' missing/invalid '%s' element"), temp->name, s) /**<
    MELEMENT(temp->name==NULL,"name");
    MELEMENT(temp->slot.type==OUTFIT_SLOT_NULL,"slot");
    MELEMENT((temp->slot.type!=OUTFIT_SLOT_NA) && (temp->slot.size==OUTFIT_SLOT_SIZE_NA),"size");
-   MELEMENT(temp->gfx_store==NULL,"gfx_store");
+   MELEMENT(temp->gfx_storePath==NULL,"gfx_store");
    /*MELEMENT(temp->mass==0,"mass"); Not really needed */
    MELEMENT(temp->type==0,"type");
    /*MELEMENT(temp->price==0,"price");*/
@@ -2256,9 +2269,13 @@ int outfit_load (void)
    array_shrink(&outfit_stack);
    noutfits = array_size(outfit_stack);
 
+   /* Upload the graphics, they were read in the background while parsing. */
+   gl_texFlush();
+
    /* Second pass, sets up ammunition relationships. */
    for (i=0; i<noutfits; i++) {
       o = &outfit_stack[i];
+      outfit_checkGFX( o );
       if (outfit_isLauncher(&outfit_stack[i])) {
          o->u.lau.ammo = outfit_get( o->u.lau.ammo_name );
          if (outfit_isSeeker(o) && /* Smart seekers. */
@@ -2305,6 +2322,36 @@ int outfit_load (void)
 }
 
 
+/**
+ * @brief Drops the space graphics of an outfit that failed to decode.
+ *
+ * Missing images are already NULL and warned about when parsing.
+ *
+ *    @param o Outfit to check.
+ */
+static void outfit_checkGFX( Outfit *o )
+{
+   glTexture **gfx;
+
+   if (outfit_isBolt(o))
+      gfx = &o->u.blt.gfx_space;
+   else if (outfit_isBeam(o))
+      gfx = &o->u.bem.gfx;
+   else if (outfit_isAmmo(o))
+      gfx = &o->u.amm.gfx_space;
+   else
+      return;
+
+   if (*gfx != NULL) {
+      *gfx = gl_texCheck( *gfx );
+      if (*gfx == NULL)
+         WARN(_("Outfit '%s' missing/invalid '%s' element"), o->name, "gfx");
+   }
+   if (outfit_isBolt(o))
+      o->u.blt.gfx_end = gl_texCheck( o->u.blt.gfx_end );
+}
+
+
 /**
  * @brief qsort compare function for names.
  */
@@ -2489,6 +2536,7 @@ void outfit_free (void)
       free(o->name);
       if (o->gfx_store)
          gl_freeTexture(o->gfx_store);
+      free(o->gfx_storePath);
    }
 
    array_free(outfit_stack);
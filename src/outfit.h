@@ -339,7 +339,8 @@ typedef struct Outfit_ {
    char *desc_short; /**< Short outfit description. */
    int priority;     /**< Sort priority, highest first. */
 
-   glTexture* gfx_store; /**< Store graphic. */
+   char *gfx_storePath; /**< Path of the store graphic. */
+   glTexture* gfx_store; /**< Store graphic, loaded on first use by outfit_gfxStore(). */
 
    unsigned int properties; /**< Properties stored bitwise. */
 
@@ -409,6 +410,7 @@ const char *slotSize( const OutfitSlotSize o );
 const glColour *outfit_slotSizeColour( const OutfitSlot* os );
 OutfitSlotSize outfit_toSlotSize( const char *s );
 glTexture* outfit_gfx( const Outfit* o );
+glTexture* outfit_gfxStore( Outfit* o );
 int outfit_spfxArmour( const Outfit* o );
 int outfit_spfxShield( const Outfit* o );
 const Damage *outfit_damage( const Outfit* o );
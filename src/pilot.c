@@ -45,6 +45,7 @@
 #include "camera.h"
 #include "damagetype.h"
 #include "pause.h"
+#include "nmem.h"
 
 
 #define PILOT_CHUNK_MIN 128 /**< Minimum chunks to increment pilot_stack by */
@@ -2475,6 +2476,7 @@ void pilot_init( Pilot* pilot, Ship* ship, const char* name, int faction, const
    pilot->dockslot = dockslot;
 
    /* Basic information. */
+   ship_gfxLoad( ship );
    pilot->ship = ship;
    pilot->name = strdup( (name==NULL) ? ship->name : name );
 
@@ -2628,6 +2630,7 @@ unsigned int pilot_create( Ship* ship, const char* name, int faction, const char
       WARN(_("Unable to allocate memory"));
       return 0;
    }
+   nmem_alloc( MEM_PILOT, sizeof(Pilot) );
 
    /* See if memory needs to grow */
    if (pilot_nstack+1 > pilot_mstack) { /* needs to grow */
@@ -2636,6 +2639,7 @@ unsigned int pilot_create( Ship* ship, const char* name, int faction, const char
       else
          pilot_mstack += MIN( pilot_mstack, PILOT_CHUNK_MAX );
       pilot_stack = realloc( pilot_stack, pilot_mstack*sizeof(Pilot*) );
+      nmem_realloc( MEM_PILOT, pilot_nstack*sizeof(Pilot*), pilot_mstack*sizeof(Pilot*) );
    }
 
    /* Set the pilot in the stack -- must be there before initializing */
@@ -2668,6 +2672,7 @@ Pilot* pilot_createEmpty( Ship* ship, const char* name,
       WARN(_("Unable to allocate memory"));
       return 0;
    }
+   nmem_alloc( MEM_PILOT, sizeof(Pilot) );
    pilot_setFlagRaw( flags, PILOT_EMPTY );
    pilot_init( dyn, ship, name, faction, ai, 0., NULL, NULL, flags, 0, 0 );
    return dyn;
@@ -2684,6 +2689,7 @@ Pilot* pilot_copy( Pilot* src )
 {
    int i, p;
    Pilot *dest = malloc(sizeof(Pilot));
+   nmem_alloc( MEM_PILOT, sizeof(Pilot) );
 
    /* Copy data over, we'll have to reset all the pointers though. */
    *dest = *src;
@@ -2901,6 +2907,7 @@ void pilot_free( Pilot* p )
 #endif /* DEBUGGING */
 
    free(p);
+   nmem_free( MEM_PILOT, sizeof(Pilot) );
 }
 
 
@@ -2959,7 +2966,9 @@ void pilots_free (void)
    for (i=0; i < pilot_nstack; i++)
       pilot_free(pilot_stack[i]);
    free(pilot_stack);
+   nmem_free( MEM_PILOT, pilot_mstack*sizeof(Pilot*) );
    pilot_stack = NULL;
+   pilot_mstack = 0;
    player.p = NULL;
    pilot_nstack = 0;
 }
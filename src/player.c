@@ -60,6 +60,7 @@
 #include "input.h"
 #include "news.h"
 #include "nstring.h"
+#include "nstats.h"
 
 
 /*
@@ -131,6 +132,8 @@ static double player_timer = 0.; /**< For death and such. */
 static int* missions_done  = NULL; /**< Saves position of completed missions. */
 static int missions_mdone  = 0; /**< Memory size of completed missions. */
 static int missions_ndone  = 0; /**< Number of completed missions. */
+static uint32_t* missions_bdone = NULL; /**< Completed missions by ID, bitset. */
+static int missions_wdone  = 0; /**< Words in the completed missions bitset. */
 
 
 /*
@@ -139,6 +142,8 @@ static int missions_ndone  = 0; /**< Number of completed missions. */
 static int* events_done  = NULL; /**< Saves position of completed events. */
 static int events_mdone  = 0; /**< Memory size of completed events. */
 static int events_ndone  = 0; /**< Number of completed events. */
+static uint32_t* events_bdone = NULL; /**< Completed events by ID, bitset. */
+static int events_wdone  = 0; /**< Words in the completed events bitset. */
 
 
 /*
@@ -179,6 +184,9 @@ static void player_parseShipSlot( xmlNodePtr node, Pilot *ship, PilotOutfitSlot
 static int player_parseShip( xmlNodePtr parent, int is_player );
 static int player_parseEscorts( xmlNodePtr parent );
 static void player_addOutfitToPilot( Pilot* pilot, Outfit* outfit, PilotOutfitSlot *s );
+/* Done missions and events. */
+static void player_doneSet( uint32_t **bits, int *words, int id );
+static int player_doneGet( const uint32_t *bits, int words, int id );
 /* Misc. */
 static int player_filterSuitablePlanet( Planet *p );
 static void player_planetOutOfRangeMsg (void);
@@ -767,6 +775,9 @@ void player_cleanup (void)
    missions_done = NULL;
    missions_ndone = 0;
    missions_mdone = 0;
+   free(missions_bdone);
+   missions_bdone = NULL;
+   missions_wdone = 0;
 
    /* Clean up events. */
    if (events_done != NULL)
@@ -774,6 +785,9 @@ void player_cleanup (void)
    events_done = NULL;
    events_ndone = 0;
    events_mdone = 0;
+   free(events_bdone);
+   events_bdone = NULL;
+   events_wdone = 0;
 
    /* Clean up licenses. */
    if (player_nlicenses > 0) {
@@ -1776,6 +1790,9 @@ void player_brokeHyperspace (void)
    StarSystem *sys;
    JumpPoint *jp;
    int i;
+   Uint64 t0;
+
+   t0 = SDL_GetPerformanceCounter();
 
    /* First run jump hook. */
    hooks_run( "jumpout" );
@@ -1845,6 +1862,9 @@ void player_brokeHyperspace (void)
 
    /* Player sound. */
    player_soundPlay( snd_hypJump, 1 );
+
+   nstats_hyperspace( 1000. * (double)(SDL_GetPerformanceCounter() - t0) /
+         (double)SDL_GetPerformanceFrequency() );
 }
 
 
@@ -2641,6 +2661,44 @@ int player_rmOutfit( const Outfit *o, int quantity )
 }
 
 
+/**
+ * @brief Sets a bit in a done bitset, growing it as needed.
+ *
+ *    @param bits Bitset to modify.
+ *    @param words Number of words in the bitset.
+ *    @param id ID to set.
+ */
+static void player_doneSet( uint32_t **bits, int *words, int id )
+{
+   int w, n;
+
+   w = id / 32;
+   if (w >= *words) {
+      n     = MAX( w+1, 2 * (*words) );
+      *bits = realloc( *bits, sizeof(uint32_t) * n );
+      memset( &(*bits)[*words], 0, sizeof(uint32_t) * (n - *words) );
+      *words = n;
+   }
+   (*bits)[w] |= 1U << (id % 32);
+}
+
+
+/**
+ * @brief Checks a bit in a done bitset.
+ *
+ *    @param bits Bitset to check.
+ *    @param words Number of words in the bitset.
+ *    @param id ID to check.
+ *    @return 1 if set, 0 otherwise.
+ */
+static int player_doneGet( const uint32_t *bits, int words, int id )
+{
+   if ((id < 0) || (id / 32 >= words))
+      return 0;
+   return !!(bits[ id / 32 ] & (1U << (id % 32)));
+}
+
+
 /**
  * @brief Marks a mission as completed.
  *
@@ -2649,7 +2707,7 @@ int player_rmOutfit( const Outfit *o, int quantity )
 void player_missionFinished( int id )
 {
    /* Make sure not already marked. */
-   if (player_missionAlreadyDone(id))
+   if ((id < 0) || player_missionAlreadyDone(id))
       return;
 
    /* Mark as done. */
@@ -2659,6 +2717,7 @@ void player_missionFinished( int id )
       missions_done = realloc( missions_done, sizeof(int) * missions_mdone);
    }
    missions_done[ missions_ndone-1 ] = id;
+   player_doneSet( &missions_bdone, &missions_wdone, id );
 }
 
 
@@ -2670,11 +2729,7 @@ void player_missionFinished( int id )
  */
 int player_missionAlreadyDone( int id )
 {
-   int i;
-   for (i=0; i<missions_ndone; i++)
-      if (missions_done[i] == id)
-         return 1;
-   return 0;
+   return player_doneGet( missions_bdone, missions_wdone, id );
 }
 
 
@@ -2686,7 +2741,7 @@ int player_missionAlreadyDone( int id )
 void player_eventFinished( int id )
 {
    /* Make sure not already done. */
-   if (player_eventAlreadyDone(id))
+   if ((id < 0) || player_eventAlreadyDone(id))
       return;
 
    /* Add to done. */
@@ -2696,6 +2751,7 @@ void player_eventFinished( int id )
       events_done = realloc( events_done, sizeof(int) * events_mdone);
    }
    events_done[ events_ndone-1 ] = id;
+   player_doneSet( &events_bdone, &events_wdone, id );
 }
 
 
@@ -2707,11 +2763,7 @@ void player_eventFinished( int id )
  */
 int player_eventAlreadyDone( int id )
 {
-   int i;
-   for (i=0; i<events_ndone; i++)
-      if (events_done[i] == id)
-         return 1;
-   return 0;
+   return player_doneGet( events_bdone, events_wdone, id );
 }
 
 
@@ -28,6 +28,7 @@
 #include "shipstats.h"
 #include "slots.h"
 #include "nfile.h"
+#include "threadpool.h"
 
 
 #define XML_SHIP  "ship" /**< XML individual ship identifier. */
@@ -46,12 +47,36 @@
 #define STATS_DESC_MAX 256 /**< Maximum length for statistics description. */
 
 
+/**
+ * @brief Space sprite decoded ahead of time, waiting to be uploaded.
+ */
+typedef struct ShipDecode_ {
+   const char *path; /**< Image to decode. */
+   SDL_RWops *rw; /**< File, kept open to hash the collision map. */
+   npng_t *npng; /**< PNG being read. */
+   SDL_Surface *surface; /**< Decoded surface. */
+   png_uint_32 w; /**< Real width. */
+   png_uint_32 h; /**< Real height. */
+   int done; /**< Decoding is done. */
+} ShipDecode;
+
+
 static Ship* ship_stack = NULL; /**< Stack of ships available in the game. */
+static SDL_mutex *ship_decodeLock = NULL; /**< Protects ShipDecode.done. */
+static SDL_cond *ship_decodeCond = NULL; /**< Signalled when a decode finishes. */
 
 
 /*
  * Prototypes
  */
+static void ship_decode( ShipDecode *d );
+static int ship_decodeThread( void *data );
+static void ship_decodeWait( ShipDecode *d );
+static void ship_decodeFree( ShipDecode *d );
+static int ship_genTargetGFX( Ship *temp, SDL_Surface *surface, int sx, int sy );
+static int ship_loadSpaceImage( Ship *temp, ShipDecode *d );
+static void ship_setSpaceImage( Ship *temp, char *str, int sx, int sy );
+static void ship_setEngineImage( Ship *temp, char *str, int sx, int sy );
 static int ship_loadGFX( Ship *temp, char *buf, int sx, int sy, int engine );
 static int ship_parse( Ship *temp, xmlNodePtr parent );
 
@@ -441,62 +466,126 @@ static int ship_genTargetGFX( Ship *temp, SDL_Surface *surface, int sx, int sy )
 
 
 /**
- * @brief Loads the space graphics for a ship from an image.
+ * @brief Reads the space sprite, safe to run off the main thread.
  *
- *    @param temp Ship to load into.
- *    @param str Path of the image to use.
+ *    @param d Decode to read the image of.
  */
-static int ship_loadSpaceImage( Ship *temp, char *str, int sx, int sy )
+static void ship_decode( ShipDecode *d )
 {
-   png_uint_32 w, h;
-   SDL_RWops *rw;
-   npng_t *npng;
-   SDL_Surface *surface;
-   int ret;
+   d->rw = ndata_rwops( d->path );
+   if (d->rw == NULL)
+      return;
+   d->npng = npng_open( d->rw );
+   if (d->npng == NULL)
+      return;
+   npng_dim( d->npng, &d->w, &d->h );
+   d->surface = npng_readSurface( d->npng, gl_needPOT(), 1 );
+}
+
+
+/**
+ * @brief Threadpool job to read a prefetched space sprite.
+ */
+static int ship_decodeThread( void *data )
+{
+   ShipDecode *d = data;
+
+   ship_decode( d );
+
+   SDL_mutexP( ship_decodeLock );
+   d->done = 1;
+   SDL_CondBroadcast( ship_decodeCond );
+   SDL_mutexV( ship_decodeLock );
+   return 0;
+}
+
+
+/**
+ * @brief Waits for a prefetched space sprite to be read.
+ */
+static void ship_decodeWait( ShipDecode *d )
+{
+   SDL_mutexP( ship_decodeLock );
+   while (!d->done)
+      SDL_CondWait( ship_decodeCond, ship_decodeLock );
+   SDL_mutexV( ship_decodeLock );
+}
+
+
+/**
+ * @brief Frees a decode.
+ */
+static void ship_decodeFree( ShipDecode *d )
+{
+   if (d->npng != NULL)
+      npng_close( d->npng );
+   if (d->rw != NULL)
+      SDL_RWclose( d->rw );
+   if (d->surface != NULL)
+      SDL_FreeSurface( d->surface );
+   free( d );
+}
+
 
-   /* Load the space sprite. */
-   rw    = ndata_rwops( str );
-   npng  = npng_open( rw );
-   npng_dim( npng, &w, &h );
-   surface = npng_readSurface( npng, gl_needPOT(), 1 );
+/**
+ * @brief Uploads the space graphics for a ship.
+ *
+ *    @param temp Ship to load into.
+ *    @param d Decoded space sprite.
+ */
+static int ship_loadSpaceImage( Ship *temp, ShipDecode *d )
+{
+   if (d->surface == NULL) {
+      WARN(_("Unable to load graphic '%s' of ship '%s'."), d->path, temp->name );
+      return -1;
+   }
 
    /* Load the texture. */
-   temp->gfx_space = gl_loadImagePadTrans( str, surface, rw,
+   temp->gfx_space = gl_loadImagePadTrans( d->path, d->surface, d->rw,
          OPENGL_TEX_MAPTRANS | OPENGL_TEX_MIPMAPS,
-         w, h, sx, sy, 0 );
+         d->w, d->h, temp->gfx_sx, temp->gfx_sy, 0 );
 
    /* Create the target graphic. */
-   ret = ship_genTargetGFX( temp, surface, sx, sy );
-   if (ret != 0)
-      return ret;
+   return ship_genTargetGFX( temp, d->surface, temp->gfx_sx, temp->gfx_sy );
+}
 
-   /* Free stuff. */
-   npng_close( npng );
-   SDL_RWclose( rw );
-   SDL_FreeSurface( surface );
+
+/**
+ * @brief Sets the space graphics for a ship, they get loaded on first use.
+ *
+ *    @param temp Ship to set.
+ *    @param str Path of the image to use.
+ */
+static void ship_setSpaceImage( Ship *temp, char *str, int sx, int sy )
+{
+   free( temp->gfx_spacePath );
+   temp->gfx_spacePath = strdup( str );
+   temp->gfx_sx = sx;
+   temp->gfx_sy = sy;
 
    /* Calculate mount angle. */
    temp->mangle  = 2.*M_PI;
-   temp->mangle /= temp->gfx_space->sx * temp->gfx_space->sy;
-   return 0;
+   temp->mangle /= sx * sy;
 }
 
 
 /**
- * @brief Loads the space graphics for a ship from an image.
+ * @brief Sets the engine graphics for a ship, they get loaded on first use.
  *
- *    @param temp Ship to load into.
+ *    @param temp Ship to set.
  *    @param str Path of the image to use.
  */
-static int ship_loadEngineImage( Ship *temp, char *str, int sx, int sy )
+static void ship_setEngineImage( Ship *temp, char *str, int sx, int sy )
 {
-   temp->gfx_engine = gl_newSprite( str, sx, sy, OPENGL_TEX_MIPMAPS );
-   return (temp->gfx_engine != NULL);
+   free( temp->gfx_enginePath );
+   temp->gfx_enginePath = strdup( str );
+   temp->gfx_esx = sx;
+   temp->gfx_esy = sy;
 }
 
 
 /**
- * @brief Loads the graphics for a ship.
+ * @brief Sets the graphics for a ship.
  *
  *    @param temp Ship to load into.
  *    @param buf Name of the texture to work with.
@@ -505,10 +594,6 @@ static int ship_loadGFX( Ship *temp, char *buf, int sx, int sy, int engine )
 {
    char base[PATH_MAX], str[PATH_MAX];
    int i;
-   png_uint_32 w, h;
-   SDL_RWops *rw;
-   npng_t *npng;
-   SDL_Surface *surface;
 
    /* Get base path. */
    for (i=0; i<PATH_MAX; i++) {
@@ -524,14 +609,12 @@ static int ship_loadGFX( Ship *temp, char *buf, int sx, int sy, int engine )
    }
 
    nsnprintf( str, PATH_MAX, SHIP_GFX_PATH"%s/%s"SHIP_EXT, base, buf );
-   ship_loadSpaceImage( temp, str, sx, sy );
+   ship_setSpaceImage( temp, str, sx, sy );
 
-   /* Load the engine sprite .*/
+   /* Set the engine sprite .*/
    if (engine && conf.engineglow && conf.interpolate) {
       nsnprintf( str, PATH_MAX, SHIP_GFX_PATH"%s/%s"SHIP_ENGINE SHIP_EXT, base, buf );
-      ship_loadEngineImage( temp, str, sx, sy );
-      if (temp->gfx_engine == NULL)
-         WARN(_("Ship '%s' does not have an engine sprite (%s)."), temp->name, str );
+      ship_setEngineImage( temp, str, sx, sy );
    }
 
    /* Get the comm graphic for future loading. */
@@ -542,6 +625,85 @@ static int ship_loadGFX( Ship *temp, char *buf, int sx, int sy, int engine )
 }
 
 
+/**
+ * @brief Loads the graphics of a ship if they aren't loaded yet.
+ *
+ * Uses the prefetched sprites if there are any, otherwise they are read
+ * right away.
+ *
+ *    @param s Ship to load graphics of.
+ *    @return 0 on success.
+ */
+int ship_gfxLoad( Ship* s )
+{
+   ShipDecode *d;
+   int ret;
+
+   if (s->gfx_loaded)
+      return 0;
+
+   /* Start reading the sprites if they weren't prefetched. */
+   ship_gfxPrefetch( s );
+   s->gfx_loaded = 1;
+   if (s->gfx_decode == NULL)
+      return -1;
+
+   /* Space sprite. */
+   d = s->gfx_decode;
+   s->gfx_decode = NULL;
+   ship_decodeWait( d );
+   ret = ship_loadSpaceImage( s, d );
+   ship_decodeFree( d );
+
+   /* Engine sprite, renderers fall back to no glow when it's NULL. */
+   if (s->gfx_enginePath != NULL) {
+      s->gfx_engine = gl_texCheck( s->gfx_engine );
+      if (s->gfx_engine == NULL)
+         WARN(_("Ship '%s' does not have an engine sprite (%s)."), s->name, s->gfx_enginePath );
+   }
+
+   return ret;
+}
+
+
+/**
+ * @brief Starts reading the sprites of a ship in the background.
+ *
+ * The textures still get uploaded by ship_gfxLoad(), prefetching just takes
+ * the file reading and PNG decoding off the main thread.
+ *
+ *    @param s Ship to prefetch graphics of.
+ */
+void ship_gfxPrefetch( Ship* s )
+{
+   ShipDecode *d;
+
+   if (s->gfx_loaded || (s->gfx_decode != NULL) || (s->gfx_spacePath == NULL))
+      return;
+
+   d = calloc( 1, sizeof(ShipDecode) );
+   d->path = s->gfx_spacePath;
+   s->gfx_decode = d;
+   threadpool_newJob( ship_decodeThread, d );
+   if (s->gfx_enginePath != NULL)
+      s->gfx_engine = gl_texRequest( s->gfx_enginePath,
+            s->gfx_esx, s->gfx_esy, OPENGL_TEX_MIPMAPS );
+}
+
+
+/**
+ * @brief Gets the store graphic of a ship, loading the graphics if needed.
+ *
+ *    @param s Ship to get store graphic of.
+ *    @return The store graphic.
+ */
+glTexture* ship_gfxStore( Ship* s )
+{
+   ship_gfxLoad( s );
+   return s->gfx_store;
+}
+
+
 /**
  * @brief Parses a slot for a ship.
  *
@@ -738,7 +900,7 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
          else
             engine = 1;
 
-         /* Load the graphics. */
+         /* Set the graphics. */
          ship_loadGFX( temp, buf, sx, sy, engine );
 
          continue;
@@ -770,8 +932,8 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
          else
             sy = 8;
 
-         /* Load the graphics. */
-         ship_loadSpaceImage( temp, str, sx, sy );
+         /* Set the graphics. */
+         ship_setSpaceImage( temp, str, sx, sy );
 
          continue;
       }
@@ -802,8 +964,8 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
          else
             sy = 8;
 
-         /* Load the graphics. */
-         ship_loadEngineImage( temp, str, sx, sy );
+         /* Set the graphics. */
+         ship_setEngineImage( temp, str, sx, sy );
 
          continue;
       }
@@ -965,7 +1127,7 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
 #define MELEMENT(o,s)      if (o) WARN( _("Ship '%s' missing '%s' element"), temp->name, s)
    MELEMENT(temp->name==NULL,"name");
    MELEMENT(temp->base_type==NULL,"base_type");
-   MELEMENT((temp->gfx_space==NULL) || (temp->gfx_comm==NULL),"GFX");
+   MELEMENT((temp->gfx_spacePath==NULL) || (temp->gfx_comm==NULL),"GFX");
    MELEMENT(temp->gui==NULL,"GUI");
    MELEMENT(temp->class==SHIP_CLASS_NULL,"class");
    MELEMENT(temp->price==0,"price");
@@ -1012,6 +1174,10 @@ int ships_load (void)
    if (ship_stack == NULL) {
       ship_stack = array_create(Ship);
    }
+   if (ship_decodeLock == NULL) {
+      ship_decodeLock = SDL_CreateMutex();
+      ship_decodeCond = SDL_CreateCond();
+   }
 
    ship_files = ndata_list( SHIP_DATA_PATH, &nfiles );
    for (i=0; i<(int)nfiles; i++) {
@@ -1103,7 +1269,12 @@ void ships_free (void)
          ss_free( s->stats );
 
       /* Free graphics. */
-      gl_freeTexture(s->gfx_space);
+      if (s->gfx_decode != NULL) {
+         ship_decodeWait( s->gfx_decode );
+         ship_decodeFree( s->gfx_decode );
+      }
+      if (s->gfx_space != NULL)
+         gl_freeTexture(s->gfx_space);
       if (s->gfx_engine != NULL)
          gl_freeTexture(s->gfx_engine);
       if (s->gfx_target != NULL)
@@ -1111,8 +1282,15 @@ void ships_free (void)
       if (s->gfx_store != NULL)
          gl_freeTexture(s->gfx_store);
       free(s->gfx_comm);
+      free(s->gfx_spacePath);
+      free(s->gfx_enginePath);
    }
 
    array_free(ship_stack);
    ship_stack = NULL;
+
+   SDL_DestroyCond( ship_decodeCond );
+   SDL_DestroyMutex( ship_decodeLock );
+   ship_decodeCond = NULL;
+   ship_decodeLock = NULL;
 }
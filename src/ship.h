@@ -115,7 +115,15 @@ typedef struct Ship_ {
    double energy_regen; /**< Maximum energy regeneration in MJ/s. */
    double dmg_absorb; /**< Damage absorption in per one [0:1] with 1 being 100% absorption. */
 
-   /* graphics */
+   /* graphics, loaded on first use by ship_gfxLoad() */
+   char *gfx_spacePath; /**< Path of the space sprite sheet. */
+   int gfx_sx; /**< Space sprites on the x axis. */
+   int gfx_sy; /**< Space sprites on the y axis. */
+   char *gfx_enginePath; /**< Path of the engine glow sprite sheet, NULL if not used. */
+   int gfx_esx; /**< Engine glow sprites on the x axis. */
+   int gfx_esy; /**< Engine glow sprites on the y axis. */
+   int gfx_loaded; /**< Whether the graphics have been loaded. */
+   void *gfx_decode; /**< Pending prefetch, private to ship.c. */
    glTexture *gfx_space; /**< Space sprite sheet. */
    glTexture *gfx_engine; /**< Space engine glow sprite sheet. */
    glTexture *gfx_target; /**< Targeting window graphic. */
@@ -166,6 +174,14 @@ credits_t ship_buyPrice( const Ship* s );
 glTexture* ship_loadCommGFX( Ship* s );
 
 
+/*
+ * graphics
+ */
+int ship_gfxLoad( Ship* s );
+void ship_gfxPrefetch( Ship* s );
+glTexture* ship_gfxStore( Ship* s );
+
+
 /*
  * misc.
  */
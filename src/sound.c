@@ -612,6 +612,28 @@ void sound_stopAll (void)
 }
 
 
+/**
+ * @brief Gets the number of active voices.
+ *
+ *    @return Number of voices currently active.
+ */
+int sound_voices (void)
+{
+   alVoice *v;
+   int n;
+
+   if (sound_disabled)
+      return 0;
+
+   n = 0;
+   voiceLock();
+   for (v=voice_active; v!=NULL; v=v->next)
+      n++;
+   voiceUnlock();
+   return n;
+}
+
+
 /**
  * @brief Stops a voice from playing.
  *
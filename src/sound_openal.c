@@ -21,6 +21,7 @@
 #include "ndata.h"
 #include "log.h"
 #include "conf.h"
+#include "nmem.h"
 
 
 /*
@@ -718,6 +719,7 @@ int sound_al_load( alSound *snd, const char *filename )
    }
    else
       snd->length = (double)size / (double)(freq * (bits/8) * channels);
+   nmem_alloc( MEM_SOUND, size );
 
    /* Check for errors. */
    al_checkErr();
@@ -733,9 +735,13 @@ int sound_al_load( alSound *snd, const char *filename )
  */
 void sound_al_free( alSound *snd )
 {
+   ALint size;
+
    soundLock();
 
    /* free the stuff */
+   alGetBufferi( snd->u.al.buf, AL_SIZE, &size );
+   nmem_free( MEM_SOUND, size );
    alDeleteBuffers( 1, &snd->u.al.buf );
 
    soundUnlock();
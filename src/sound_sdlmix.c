@@ -28,6 +28,7 @@
 #include "music.h"
 #include "physics.h"
 #include "conf.h"
+#include "nmem.h"
 
 
 /*
@@ -445,6 +446,7 @@ int sound_mix_load( alSound *s, const char *filename )
 
    /* Set length. */
    s->length = (double)s->u.mix.buf->alen / (double)(freq*bytes*channels);
+   nmem_alloc( MEM_SOUND, s->u.mix.buf->alen );
 
    return 0;
 }
@@ -457,6 +459,8 @@ int sound_mix_load( alSound *s, const char *filename )
  */
 void sound_mix_free( alSound *snd )
 {
+   if (snd->u.mix.buf != NULL)
+      nmem_free( MEM_SOUND, snd->u.mix.buf->alen );
    Mix_FreeChunk(snd->u.mix.buf);
    snd->u.mix.buf = NULL;
 }
@@ -52,6 +52,8 @@
 #include "damagetype.h"
 #include "hook.h"
 #include "dev_uniedit.h"
+#include "md5.h"
+#include "space_cache.h"
 
 
 #define XML_PLANET_TAG        "asset" /**< Individual planet xml tag. */
@@ -107,6 +109,9 @@ static int asteroid_ntypes = 0; /**< Asteroid types stack size. */
  * Misc.
  */
 static int systems_loading = 1; /**< Systems are loading. */
+static char **systems_jumpTargets = NULL; /**< Unresolved jump targets while loading. */
+static int systems_njumpTargets = 0; /**< Number of unresolved jump targets. */
+static int systems_mjumpTargets = 0; /**< Memory allocated for unresolved jump targets. */
 StarSystem *cur_system = NULL; /**< Current star system. */
 glTexture *jumppoint_gfx = NULL; /**< Jump point graphics. */
 static glTexture *jumpbuoy_gfx = NULL; /**< Jump buoy graphics. */
@@ -137,7 +142,8 @@ static double interference_timer  = 0.; /**< Interference timer. */
  * Internal Prototypes.
  */
 /* planet load */
-static int planet_parse( Planet* planet, const xmlNodePtr parent );
+static int planet_parse( Planet* planet, xmlTextReaderPtr reader );
+static void planet_free( Planet *pnt );
 static int space_parseAssets( xmlNodePtr parent, StarSystem* sys );
 /* system load */
 static void system_init( StarSystem *sys );
@@ -146,10 +152,14 @@ static void debris_init( Debris *deb );
 static int systems_load (void);
 static int asteroidTypes_load (void);
 static StarSystem* system_parse( StarSystem *system, const xmlNodePtr parent );
+static void system_parseJumpPointData( const xmlNodePtr node, StarSystem *sys, JumpPoint *j );
 static int system_parseJumpPoint( const xmlNodePtr node, StarSystem *sys );
 static int system_parseAsteroidField( const xmlNodePtr node, StarSystem *sys );
 static int system_parseJumpPointDiff( const xmlNodePtr node, StarSystem *sys );
-static void system_parseJumps( const xmlNodePtr parent );
+static void system_parseJumps( const xmlNodePtr parent, StarSystem *sys );
+static int systems_cmpIndex( const void *p1, const void *p2 );
+static int systems_cmpName( const void *key, const void *p );
+static void systems_resolveJumps( int first );
 static void system_parseAsteroids( const xmlNodePtr parent, StarSystem *sys );
 /* misc */
 static int getPresenceIndex( StarSystem *sys, int faction );
@@ -1631,6 +1641,45 @@ Planet *planet_new (void)
 }
 
 
+/**
+ * @brief Frees the contents of a planet.
+ *
+ *    @param pnt Planet to free.
+ */
+static void planet_free( Planet *pnt )
+{
+   free(pnt->name);
+   free(pnt->class);
+   free(pnt->description);
+   free(pnt->bar_description);
+
+   /* graphics */
+   if (pnt->gfx_spaceName != NULL) {
+      if (pnt->gfx_space != NULL)
+         gl_freeTexture( pnt->gfx_space );
+      free(pnt->gfx_spaceName);
+      free(pnt->gfx_spacePath);
+   }
+   if (pnt->gfx_exterior != NULL) {
+      free(pnt->gfx_exterior);
+      free(pnt->gfx_exteriorPath);
+   }
+
+   /* Landing. */
+   free(pnt->land_func);
+   free(pnt->land_msg);
+   free(pnt->bribe_msg);
+   free(pnt->bribe_ack_msg);
+
+   /* tech */
+   if (pnt->tech != NULL)
+      tech_groupDestroy( pnt->tech );
+
+   /* commodities */
+   free(pnt->commodities);
+}
+
+
 /**
  * @brief Loads all the planets in the game.
  *
@@ -1640,14 +1689,14 @@ static int planets_load ( void )
 {
    size_t bufsize;
    char *buf, **planet_files, *file;
-   xmlNodePtr node;
-   xmlDocPtr doc;
+   xmlTextReaderPtr reader;
    Planet *p;
    size_t nfiles;
    size_t i, len;
 
    /* Load landing stuff. */
    landing_env = nlua_newEnv(0);
+   nlua_setEnvName( landing_env, "%s", LANDING_DATA_PATH );
    nlua_loadStandard(landing_env);
    buf         = ndata_read( LANDING_DATA_PATH, &bufsize );
    if (nlua_dobufenv(landing_env, buf, bufsize, LANDING_DATA_PATH) != 0) {
@@ -1672,31 +1721,38 @@ static int planets_load ( void )
       file = malloc( len );
       nsnprintf( file, len,"%s%s",PLANET_DATA_PATH,planet_files[i]);
       buf  = ndata_read( file, &bufsize );
-      doc  = xmlParseMemory( buf, bufsize );
-      if (doc == NULL) {
+      reader = xmls_open( buf, bufsize, file );
+      if (reader == NULL) {
          WARN(_("%s file is invalid xml!"),file);
          free(file);
          free(buf);
          continue;
       }
 
-      node = doc->xmlChildrenNode; /* first planet node */
-      if (node == NULL) {
-         WARN(_("Malformed %s file: does not contain elements"),file);
+      /* First planet node. */
+      if (!xmls_nextChild( reader, -1 )) {
+         if (!xmls_failed( reader ))
+            WARN(_("Malformed %s file: does not contain elements"),file);
          free(file);
-         xmlFreeDoc(doc);
+         xmls_close(reader);
          free(buf);
          continue;
       }
 
-      if (xml_isNode(node,XML_PLANET_TAG)) {
+      if (xmls_isNode(reader,XML_PLANET_TAG)) {
          p = planet_new();
-         planet_parse( p, node );
+         planet_parse( p, reader );
+
+         /* Skip the whole file if it turned out malformed, it's the last planet. */
+         if (xmls_failed( reader )) {
+            planet_free( p );
+            planet_nstack--;
+         }
       }
 
       /* Clean up. */
       free(file);
-      xmlFreeDoc(doc);
+      xmls_close(reader);
       free(buf);
    }
 
@@ -1841,8 +1897,13 @@ void space_gfxLoad( StarSystem *sys )
          continue;
 
       if (planet->gfx_space == NULL)
-         planet->gfx_space = gl_newImage( planet->gfx_spaceName, OPENGL_TEX_MIPMAPS );
+         planet->gfx_space = gl_texRequest( planet->gfx_spaceName, 0, 0, OPENGL_TEX_MIPMAPS );
    }
+
+   /* Decoded in parallel, uploaded as they come in. */
+   gl_texFlush();
+   for (i=0; i<sys->nplanets; i++)
+      sys->planets[i]->gfx_space = gl_texCheck( sys->planets[i]->gfx_space );
 }
 
 
@@ -1866,18 +1927,19 @@ void space_gfxUnload( StarSystem *sys )
 
 
 /**
- * @brief Parses a planet from an xml node.
+ * @brief Parses a planet from an xml stream.
  *
  *    @param planet Planet to fill up.
- *    @param parent Node that contains planet data.
+ *    @param reader Reader positioned on the planet element.
  *    @return 0 on success.
  */
-static int planet_parse( Planet *planet, const xmlNodePtr parent )
+static int planet_parse( Planet *planet, xmlTextReaderPtr reader )
 {
-   int mem;
-   char str[PATH_MAX], *tmp;
-   xmlNodePtr node, cur, ccur;
+   int mem, depth, cur, ccur;
+   char str[PATH_MAX];
+   const char *tmp;
    unsigned int flags;
+   xmlNodePtr node;
 
    /* Clear up memory for sane defaults. */
    flags          = 0;
@@ -1885,82 +1947,78 @@ static int planet_parse( Planet *planet, const xmlNodePtr parent )
    planet->hide   = 0.01;
 
    /* Get the name. */
-   xmlr_attr( parent, "name", planet->name );
+   planet->name = xmls_attr( reader, "name" );
 
-   node = parent->xmlChildrenNode;
-   do {
-
-      /* Only handle nodes. */
-      xml_onlyNodes(node);
+   depth = xmls_depth( reader );
+   while (xmls_nextChild( reader, depth )) {
 
-      if (xml_isNode(node,"virtual")) {
+      if (xmls_isNode(reader,"virtual")) {
          planet->real   = ASSET_VIRTUAL;
          continue;
       }
-      else if (xml_isNode(node,"GFX")) {
-         cur = node->children;
-         do {
-            if (xml_isNode(cur,"space")) { /* load space gfx */
-               nsnprintf( str, PATH_MAX, PLANET_GFX_SPACE_PATH"%s", xml_get(cur));
+      else if (xmls_isNode(reader,"GFX")) {
+         cur = xmls_depth( reader );
+         while (xmls_nextChild( reader, cur )) {
+            if (xmls_isNode(reader,"space")) { /* load space gfx */
+               planet->gfx_spacePath = xmls_getStrd(reader);
+               nsnprintf( str, PATH_MAX, PLANET_GFX_SPACE_PATH"%s", planet->gfx_spacePath);
                planet->gfx_spaceName = strdup(str);
-               planet->gfx_spacePath = xml_getStrd(cur);
                planet_setRadiusFromGFX(planet);
             }
-            else if (xml_isNode(cur,"exterior")) { /* load land gfx */
-               nsnprintf( str, PATH_MAX, PLANET_GFX_EXTERIOR_PATH"%s", xml_get(cur));
+            else if (xmls_isNode(reader,"exterior")) { /* load land gfx */
+               planet->gfx_exteriorPath = xmls_getStrd(reader);
+               nsnprintf( str, PATH_MAX, PLANET_GFX_EXTERIOR_PATH"%s", planet->gfx_exteriorPath);
                planet->gfx_exterior = strdup(str);
-               planet->gfx_exteriorPath = xml_getStrd(cur);
             }
-         } while (xml_nextNode(cur));
+         }
          continue;
       }
-      else if (xml_isNode(node,"pos")) {
-         cur          = node->children;
-         do {
-            if (xml_isNode(cur,"x")) {
+      else if (xmls_isNode(reader,"pos")) {
+         cur = xmls_depth( reader );
+         while (xmls_nextChild( reader, cur )) {
+            if (xmls_isNode(reader,"x")) {
                flags |= FLAG_XSET;
-               planet->pos.x = xml_getFloat(cur);
+               planet->pos.x = xmls_getFloat(reader);
             }
-            else if (xml_isNode(cur,"y")) {
+            else if (xmls_isNode(reader,"y")) {
                flags |= FLAG_YSET;
-               planet->pos.y = xml_getFloat(cur);
+               planet->pos.y = xmls_getFloat(reader);
             }
-         } while (xml_nextNode(cur));
+         }
          continue;
       }
-      else if (xml_isNode(node, "presence")) {
-         cur = node->children;
-         do {
-            xmlr_float(cur, "value", planet->presenceAmount);
-            xmlr_int(cur, "range", planet->presenceRange);
-            if (xml_isNode(cur,"faction")) {
+      else if (xmls_isNode(reader, "presence")) {
+         cur = xmls_depth( reader );
+         while (xmls_nextChild( reader, cur )) {
+            xmls_float(reader, "value", planet->presenceAmount);
+            xmls_int(reader, "range", planet->presenceRange);
+            if (xmls_isNode(reader,"faction")) {
                flags |= FLAG_FACTIONSET;
-               planet->faction = faction_get( xml_get(cur) );
+               planet->faction = faction_get( xmls_get(reader) );
                continue;
             }
-         } while (xml_nextNode(cur));
+         }
          continue;
       }
-      else if (xml_isNode(node,"general")) {
-         cur = node->children;
-         do {
+      else if (xmls_isNode(reader,"general")) {
+         cur = xmls_depth( reader );
+         while (xmls_nextChild( reader, cur )) {
             /* Direct reads. */
-            xmlr_strd(cur, "class", planet->class);
-            xmlr_strd(cur, "bar", planet->bar_description);
-            xmlr_strd(cur, "description", planet->description );
-            xmlr_ulong(cur, "population", planet->population );
-            xmlr_float(cur, "hide", planet->hide );
+            xmls_strd(reader, "class", planet->class);
+            xmls_strd(reader, "bar", planet->bar_description);
+            xmls_strd(reader, "description", planet->description );
+            xmls_ulong(reader, "population", planet->population );
+            xmls_float(reader, "hide", planet->hide );
 
-            if (xml_isNode(cur, "services")) {
+            if (xmls_isNode(reader, "services")) {
                flags |= FLAG_SERVICESSET;
-               ccur = cur->children;
+               ccur = xmls_depth( reader );
                planet->services = 0;
-               do {
-                  xml_onlyNodes(ccur);
+               while (xmls_nextChild( reader, ccur )) {
 
-                  if (xml_isNode(ccur, "land")) {
+                  if (xmls_isNode(reader, "land")) {
                      planet->services |= PLANET_SERVICE_LAND;
-                     tmp = xml_get(ccur);
+                     tmp = xmls_get(reader);
                      if (tmp != NULL) {
                         planet->land_func = strdup(tmp);
 #ifdef DEBUGGING
@@ -1974,31 +2032,31 @@ static int planet_parse( Planet *planet, const xmlNodePtr parent )
 #endif /* DEBUGGING */
                      }
                   }
-                  else if (xml_isNode(ccur, "refuel"))
+                  else if (xmls_isNode(reader, "refuel"))
                      planet->services |= PLANET_SERVICE_REFUEL | PLANET_SERVICE_INHABITED;
-                  else if (xml_isNode(ccur, "bar"))
+                  else if (xmls_isNode(reader, "bar"))
                      planet->services |= PLANET_SERVICE_BAR | PLANET_SERVICE_INHABITED;
-                  else if (xml_isNode(ccur, "missions"))
+                  else if (xmls_isNode(reader, "missions"))
                      planet->services |= PLANET_SERVICE_MISSIONS | PLANET_SERVICE_INHABITED;
-                  else if (xml_isNode(ccur, "commodity"))
+                  else if (xmls_isNode(reader, "commodity"))
                      planet->services |= PLANET_SERVICE_COMMODITY | PLANET_SERVICE_INHABITED;
-                  else if (xml_isNode(ccur, "outfits"))
+                  else if (xmls_isNode(reader, "outfits"))
                      planet->services |= PLANET_SERVICE_OUTFITS | PLANET_SERVICE_INHABITED;
-                  else if (xml_isNode(ccur, "shipyard"))
+                  else if (xmls_isNode(reader, "shipyard"))
                      planet->services |= PLANET_SERVICE_SHIPYARD | PLANET_SERVICE_INHABITED;
-                  else if (xml_isNode(ccur, "blackmarket"))
+                  else if (xmls_isNode(reader, "blackmarket"))
                      planet->services |= PLANET_SERVICE_BLACKMARKET;
                   else
-                     WARN(_("Planet '%s' has unknown services tag '%s'"), planet->name, ccur->name);
+                     WARN(_("Planet '%s' has unknown services tag '%s'"), planet->name, xmls_name(reader));
 
-               } while (xml_nextNode(ccur));
+               }
             }
 
-            else if (xml_isNode(cur, "commodities")) {
-               ccur = cur->children;
+            else if (xmls_isNode(reader, "commodities")) {
+               ccur = xmls_depth( reader );
                mem = 0;
-               do {
-                  if (xml_isNode(ccur,"commodity")) {
+               while (xmls_nextChild( reader, ccur )) {
+                  if (xmls_isNode(reader,"commodity")) {
                      planet->ncommodities++;
                      /* Memory must grow. */
                      if (planet->ncommodities > mem) {
@@ -2010,27 +2068,33 @@ static int planet_parse( Planet *planet, const xmlNodePtr parent )
                               mem * sizeof(Commodity*));
                      }
                      planet->commodities[planet->ncommodities-1] =
-                        commodity_get( xml_get(ccur) );
+                        commodity_get( xmls_get(reader) );
                   }
-               } while (xml_nextNode(ccur));
+               }
                /* Shrink to minimum size. */
                planet->commodities = realloc(planet->commodities,
                      planet->ncommodities * sizeof(Commodity*));
             }
 
-            else if (xml_isNode(cur, "blackmarket")) {
+            else if (xmls_isNode(reader, "blackmarket")) {
                planet_addService(planet, PLANET_SERVICE_BLACKMARKET);
             }
-         } while (xml_nextNode(cur));
+         }
          continue;
       }
-      else if (xml_isNode(node, "tech")) {
+      else if (xmls_isNode(reader, "tech")) {
+         /* Small enough to hand over as a tree. */
+         node = xmlTextReaderExpand( reader );
+         if (node == NULL) {
+            WARN(_("Planet '%s' has an invalid '%s' element."), planet->name, "tech");
+            continue;
+         }
          planet->tech = tech_groupCreateXML( node );
          continue;
       }
 
-      DEBUG(_("Unknown node '%s' in planet '%s'"),node->name,planet->name);
-   } while (xml_nextNode(node));
+      DEBUG(_("Unknown node '%s' in planet '%s'"),xmls_name(reader),planet->name);
+   }
 
 /*
  * verification
@@ -2735,56 +2799,19 @@ static int system_parseJumpPointDiff( const xmlNodePtr node, StarSystem *sys )
 
 
 /**
- * @brief Parses a single jump point for a system.
+ * @brief Parses the data of a jump point, everything but its target.
  *
  *    @param node Parent node containing jump point information.
  *    @param sys System to which the jump point belongs.
- *    @return 0 on success.
+ *    @param j Jump point to load data into.
  */
-static int system_parseJumpPoint( const xmlNodePtr node, StarSystem *sys )
+static void system_parseJumpPointData( const xmlNodePtr node, StarSystem *sys, JumpPoint *j )
 {
-   JumpPoint *j;
    char *buf;
    xmlNodePtr cur;
    double x, y;
-   StarSystem *target;
    int pos;
 
-   /* Get target. */
-   xmlr_attr( node, "target", buf );
-   if (buf == NULL) {
-      WARN(_("JumpPoint node for system '%s' has no target attribute."), sys->name);
-      return -1;
-   }
-   target = system_get(buf);
-   if (target == NULL) {
-      WARN(_("JumpPoint node for system '%s' has invalid target '%s'."), sys->name, buf );
-      free(buf);
-      return -1;
-   }
-
-#ifdef DEBUGGING
-   int i;
-   for (i=0; i<sys->njumps; i++) {
-      j = &sys->jumps[i];
-      if (j->targetid != target->id)
-         continue;
-
-      WARN(_("Star System '%s' has duplicate jump point to '%s'."),
-            sys->name, target->name );
-      break;
-   }
-#endif /* DEBUGGING */
-
-   /* Allocate more space. */
-   sys->jumps = realloc( sys->jumps, (sys->njumps+1)*sizeof(JumpPoint) );
-   j = &sys->jumps[ sys->njumps ];
-   memset( j, 0, sizeof(JumpPoint) );
-
-   /* Set some stuff. */
-   j->target = target;
-   free(buf);
-   j->targetid = j->target->id;
    j->radius = 200.;
 
    pos = 0;
@@ -2835,6 +2862,60 @@ static int system_parseJumpPoint( const xmlNodePtr node, StarSystem *sys )
 
    /* Square to allow for linear multiplication with squared distances. */
    j->hide = pow2(j->hide);
+}
+
+
+/**
+ * @brief Parses a single jump point for a system.
+ *
+ *    @param node Parent node containing jump point information.
+ *    @param sys System to which the jump point belongs.
+ *    @return 0 on success.
+ */
+static int system_parseJumpPoint( const xmlNodePtr node, StarSystem *sys )
+{
+   JumpPoint *j;
+   char *buf;
+   StarSystem *target;
+
+   /* Get target. */
+   xmlr_attr( node, "target", buf );
+   if (buf == NULL) {
+      WARN(_("JumpPoint node for system '%s' has no target attribute."), sys->name);
+      return -1;
+   }
+   target = system_get(buf);
+   if (target == NULL) {
+      WARN(_("JumpPoint node for system '%s' has invalid target '%s'."), sys->name, buf );
+      free(buf);
+      return -1;
+   }
+
+#ifdef DEBUGGING
+   int i;
+   for (i=0; i<sys->njumps; i++) {
+      j = &sys->jumps[i];
+      if (j->targetid != target->id)
+         continue;
+
+      WARN(_("Star System '%s' has duplicate jump point to '%s'."),
+            sys->name, target->name );
+      break;
+   }
+#endif /* DEBUGGING */
+
+   /* Allocate more space. */
+   sys->jumps = realloc( sys->jumps, (sys->njumps+1)*sizeof(JumpPoint) );
+   j = &sys->jumps[ sys->njumps ];
+   memset( j, 0, sizeof(JumpPoint) );
+
+   /* Set some stuff. */
+   j->target = target;
+   free(buf);
+   j->targetid = j->target->id;
+
+   /* Parse data. */
+   system_parseJumpPointData( node, sys, j );
 
    /* Added jump. */
    sys->njumps++;
@@ -2844,45 +2925,143 @@ static int system_parseJumpPoint( const xmlNodePtr node, StarSystem *sys )
 
 
 /**
- * @brief Loads the jumps into a system.
+ * @brief Loads the jumps into a system, leaving their targets unresolved.
+ *
+ * The target names are queued in systems_jumpTargets in the same order as the
+ * jumps and resolved by systems_resolveJumps() once all systems exist.
  *
  *    @param parent System parent node.
+ *    @param sys System.
  */
-static void system_parseJumps( const xmlNodePtr parent )
+static void system_parseJumps( const xmlNodePtr parent, StarSystem *sys )
 {
-   int i;
-   StarSystem *sys;
-   char* name;
+   JumpPoint *j;
+   char *buf;
    xmlNodePtr cur, node;
 
-   name = xml_nodeProp(parent,"name"); /* already mallocs */
-   sys = NULL;
-   for (i=0; i<systems_nstack; i++) {
-      if (strcmp( systems_stack[i].name, name)==0) {
-         sys = &systems_stack[i];
-         break;
-      }
-   }
-   if (sys == NULL) {
-      WARN(_("System '%s' was not found in the stack for some reason"),name);
-      return;
-   }
-   free(name); /* no more need for it */
-
    node  = parent->xmlChildrenNode;
 
    do { /* load all the data */
       if (xml_isNode(node,"jumps")) {
          cur = node->children;
          do {
-            if (xml_isNode(cur,"jump"))
-               system_parseJumpPoint( cur, sys );
+            if (!xml_isNode(cur,"jump"))
+               continue;
+
+            /* Get target. */
+            xmlr_attr( cur, "target", buf );
+            if (buf == NULL) {
+               WARN(_("JumpPoint node for system '%s' has no target attribute."), sys->name);
+               continue;
+            }
+
+            /* Allocate more space. */
+            sys->jumps = realloc( sys->jumps, (sys->njumps+1)*sizeof(JumpPoint) );
+            j = &sys->jumps[ sys->njumps ];
+            memset( j, 0, sizeof(JumpPoint) );
+            system_parseJumpPointData( cur, sys, j );
+            sys->njumps++;
+
+            /* Queue the target. */
+            if (systems_njumpTargets >= systems_mjumpTargets) {
+               systems_mjumpTargets = MAX( CHUNK_SIZE, 2*systems_mjumpTargets );
+               systems_jumpTargets  = realloc( systems_jumpTargets,
+                     sizeof(char*) * systems_mjumpTargets );
+            }
+            systems_jumpTargets[ systems_njumpTargets++ ] = buf;
          } while (xml_nextNode(cur));
       }
    } while (xml_nextNode(node));
 }
 
 
+/**
+ * @brief Compares two system indices by system name.
+ */
+static int systems_cmpIndex( const void *p1, const void *p2 )
+{
+   return strcmp( systems_stack[ *(const int*)p1 ].name,
+         systems_stack[ *(const int*)p2 ].name );
+}
+
+
+/**
+ * @brief Compares a system name to a system index.
+ */
+static int systems_cmpName( const void *key, const void *p )
+{
+   return strcmp( key, systems_stack[ *(const int*)p ].name );
+}
+
+
+/**
+ * @brief Resolves the targets queued by system_parseJumps().
+ *
+ * Jumps with invalid targets are dropped.
+ *
+ *    @param first First system that was loaded with queued targets.
+ */
+static void systems_resolveJumps( int first )
+{
+   int i, k, n, t, *order, *found;
+   char *name;
+   StarSystem *sys;
+   JumpPoint *j;
+#ifdef DEBUGGING
+   int l;
+#endif /* DEBUGGING */
+
+   /* Sort the systems by name for lookups. */
+   order = malloc( sizeof(int) * systems_nstack );
+   for (i=0; i<systems_nstack; i++)
+      order[i] = i;
+   qsort( order, systems_nstack, sizeof(int), systems_cmpIndex );
+
+   t = 0;
+   for (i=first; i<systems_nstack; i++) {
+      sys = &systems_stack[i];
+      n   = 0;
+      for (k=0; k<sys->njumps; k++) {
+         name  = systems_jumpTargets[ t++ ];
+         found = bsearch( name, order, systems_nstack, sizeof(int), systems_cmpName );
+         if (found == NULL) {
+            WARN(_("JumpPoint node for system '%s' has invalid target '%s'."), sys->name, name );
+            free(name);
+            continue;
+         }
+         free(name);
+
+         /* Compact over dropped jumps. */
+         j = &sys->jumps[n];
+         if (n != k)
+            *j = sys->jumps[k];
+         j->targetid = *found;
+         j->target   = &systems_stack[ *found ];
+
+#ifdef DEBUGGING
+         for (l=0; l<n; l++) {
+            if (sys->jumps[l].targetid != j->targetid)
+               continue;
+
+            WARN(_("Star System '%s' has duplicate jump point to '%s'."),
+                  sys->name, j->target->name );
+            break;
+         }
+#endif /* DEBUGGING */
+
+         n++;
+      }
+      sys->njumps = n;
+   }
+
+   free(order);
+   free(systems_jumpTargets);
+   systems_jumpTargets  = NULL;
+   systems_njumpTargets = 0;
+   systems_mjumpTargets = 0;
+}
+
+
 /**
  * @brief Parses a single asteroid field for a system.
  *
@@ -3341,22 +3520,26 @@ static int asteroidTypes_load (void)
 /**
  * @brief Loads the entire systems, needs to be called after planets_load.
  *
- * Does multiple passes to load:
+ * Uses the universe cache when the system files haven't changed, otherwise
+ * does multiple passes to load:
  *
- *  - First loads the star systems.
- *  - Next sets the jump routes.
+ *  - First loads the star systems and their jumps with the targets by name.
+ *  - Next resolves the jump targets.
  *
  *    @return 0 on success.
  */
 static int systems_load (void)
 {
-   size_t bufsize;
-   char *buf, **system_files, *file;
+   size_t *bufsize;
+   char **buf, **system_files, *file;
    xmlNodePtr node;
    xmlDocPtr doc;
    StarSystem *sys;
    size_t i, len;
    size_t nfiles;
+   int j, first;
+   md5_state_t md5;
+   md5_byte_t digest[16];
 
    /* Allocate if needed. */
    if (systems_stack == NULL) {
@@ -3364,82 +3547,83 @@ static int systems_load (void)
       systems_stack = malloc( sizeof(StarSystem) * systems_mstack );
       systems_nstack = 0;
    }
+   first = systems_nstack;
 
    system_files = ndata_list( SYSTEM_DATA_PATH, &nfiles );
+   buf      = calloc( nfiles, sizeof(char*) );
+   bufsize  = calloc( nfiles, sizeof(size_t) );
 
    /*
-    * First pass - loads all the star systems_stack.
+    * Read all the files and hash them along with the asteroid types the
+    * systems index, which is what the cache depends on.
     */
+   md5_init( &md5 );
+   for (j=0; j<asteroid_ntypes; j++)
+      md5_append( &md5, (md5_byte_t*)asteroid_types[j].ID, strlen(asteroid_types[j].ID)+1 );
    for (i=0; i<nfiles; i++) {
-
       len  = strlen(SYSTEM_DATA_PATH)+strlen(system_files[i])+2;
       file = malloc( len );
       nsnprintf( file, len, "%s%s", SYSTEM_DATA_PATH, system_files[i] );
-      /* Load the file. */
-      buf = ndata_read( file, &bufsize );
-      doc = xmlParseMemory( buf, bufsize );
-      if (doc == NULL) {
-         WARN(_("%s file is invalid xml!"),file);
-         free(buf);
-         continue;
-      }
-
-      node = doc->xmlChildrenNode; /* first planet node */
-      if (node == NULL) {
-         WARN(_("Malformed %s file: does not contain elements"),file);
-         xmlFreeDoc(doc);
-         free(buf);
-         continue;
-      }
-
-      sys = system_new();
-      system_parse( sys, node );
-      system_parseAsteroids(node, sys); /* load the asteroids anchors */
-
-      /* Clean up. */
-      xmlFreeDoc(doc);
-      free(buf);
+      buf[i] = ndata_read( file, &bufsize[i] );
       free( file );
+      md5_append( &md5, (md5_byte_t*)system_files[i], strlen(system_files[i])+1 );
+      if (buf[i] != NULL)
+         md5_append( &md5, (md5_byte_t*)buf[i], bufsize[i] );
    }
+   md5_finish( &md5, digest );
 
-   /*
-    * Second pass - loads all the jump routes.
-    */
-   for (i=0; i<nfiles; i++) {
+   if (space_cacheLoad( digest ) == 0)
+      DEBUG( _("Loaded star systems from the universe cache") );
+   else {
+      /*
+       * First pass - loads all the star systems_stack.
+       */
+      for (i=0; i<nfiles; i++) {
+         if (buf[i] == NULL)
+            continue;
 
-      len  = strlen(SYSTEM_DATA_PATH)+strlen(system_files[i])+2;
-      file = malloc( len );
-      nsnprintf( file, len, "%s%s", SYSTEM_DATA_PATH, system_files[i] );
-      /* Load the file. */
-      buf = ndata_read( file, &bufsize );
-      free( file );
-      doc = xmlParseMemory( buf, bufsize );
-      if (doc == NULL) {
-         free(buf);
-         continue;
-      }
+         doc = xmlParseMemory( buf[i], bufsize[i] );
+         if (doc == NULL) {
+            WARN(_("%s file is invalid xml!"),system_files[i]);
+            continue;
+         }
+
+         node = doc->xmlChildrenNode; /* first planet node */
+         if (node == NULL) {
+            WARN(_("Malformed %s file: does not contain elements"),system_files[i]);
+            xmlFreeDoc(doc);
+            continue;
+         }
 
-      node = doc->xmlChildrenNode; /* first planet node */
-      if (node == NULL) {
+         sys = system_new();
+         system_parse( sys, node );
+         system_parseAsteroids(node, sys); /* load the asteroids anchors */
+         system_parseJumps(node, sys); /* jump targets are resolved later */
+
+         /* Clean up. */
          xmlFreeDoc(doc);
-         free(buf);
-         continue;
       }
 
-      system_parseJumps(node); /* will automatically load the jumps into the system */
+      /*
+       * Second pass - resolves the jump routes in memory.
+       */
+      systems_resolveJumps( first );
 
-      /* Clean up. */
-      xmlFreeDoc(doc);
-      free(buf);
+      /* Skip the XML next time. */
+      space_cacheSave( digest, first );
    }
 
    DEBUG( ngettext( "Loaded %d Star System", "Loaded %d Star Systems", systems_nstack ), systems_nstack );
    DEBUG( ngettext( "       with %d Planet", "       with %d Planets", planet_nstack ), planet_nstack );
 
    /* Clean up. */
-   for (i=0; i<nfiles; i++)
+   for (i=0; i<nfiles; i++) {
       free( system_files[i] );
+      free( buf[i] );
+   }
    free( system_files );
+   free( buf );
+   free( bufsize );
 
    return 0;
 }
@@ -3651,7 +3835,6 @@ static void space_renderDebris( Debris *d, double x, double y )
 void space_exit (void)
 {
    int i, j;
-   Planet *pnt;
    AsteroidAnchor *ast;
    StarSystem *sys;
    AsteroidType *at;
@@ -3677,39 +3860,8 @@ void space_exit (void)
    spacename_nstack = 0;
 
    /* Free the planets. */
-   for (i=0; i < planet_nstack; i++) {
-      pnt = &planet_stack[i];
-
-      free(pnt->name);
-      free(pnt->class);
-      free(pnt->description);
-      free(pnt->bar_description);
-
-      /* graphics */
-      if (pnt->gfx_spaceName != NULL) {
-         if (pnt->gfx_space != NULL)
-            gl_freeTexture( pnt->gfx_space );
-         free(pnt->gfx_spaceName);
-         free(pnt->gfx_spacePath);
-      }
-      if (pnt->gfx_exterior != NULL) {
-         free(pnt->gfx_exterior);
-         free(pnt->gfx_exteriorPath);
-      }
-
-      /* Landing. */
-      free(pnt->land_func);
-      free(pnt->land_msg);
-      free(pnt->bribe_msg);
-      free(pnt->bribe_ack_msg);
-
-      /* tech */
-      if (pnt->tech != NULL)
-         tech_groupDestroy( pnt->tech );
-
-      /* commodities */
-      free(pnt->commodities);
-   }
+   for (i=0; i < planet_nstack; i++)
+      planet_free( &planet_stack[i] );
    free(planet_stack);
    planet_stack = NULL;
    planet_nstack = 0;
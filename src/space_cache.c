@@ -0,0 +1,598 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file space_cache.c
+ *
+ * @brief Binary cache of the parsed star systems.
+ *
+ * The star systems are written to the cache path once they have been parsed
+ * from XML, and read back on later starts as long as the digest of the data
+ * they were built from matches. Strings are stored as offsets into a string
+ * table and jump targets as system indices, both get fixed up when loading.
+ *
+ * The file is laid out as:
+ *
+ *  - SpaceCacheHeader.
+ *  - String table of strsize bytes.
+ *  - nsystems system records.
+ */
+
+
+#include "space_cache.h"
+
+#include "naev.h"
+
+#include <stdlib.h>
+#include "nstring.h"
+
+#include "log.h"
+#include "nfile.h"
+#include "space.h"
+
+
+#define SPACE_CACHE_NULL   UINT32_MAX /**< String offset of NULL. */
+#define SPACE_CACHE_CHUNK  4096 /**< Size to grow the write buffers by. */
+
+
+static const char space_cacheMagic[4] = { 'N', 'S', 'Y', 'S' }; /**< Identifies the file. */
+
+
+/**
+ * @brief Header of the cache file.
+ */
+typedef struct SpaceCacheHeader_ {
+   char magic[4]; /**< Must match space_cacheMagic. */
+   uint32_t version; /**< Must match SPACE_CACHE_VERSION. */
+   uint8_t digest[16]; /**< Digest of the data the cache was built from. */
+   uint32_t nsystems; /**< Number of systems. */
+   uint32_t strsize; /**< Size of the string table. */
+} SpaceCacheHeader;
+
+
+/**
+ * @brief Growing buffer the cache is written to.
+ */
+typedef struct SpaceCacheBuf_ {
+   char *data; /**< Data. */
+   size_t len; /**< Bytes used. */
+   size_t mem; /**< Bytes allocated. */
+} SpaceCacheBuf;
+
+
+/**
+ * @brief Cursor the cache is read with.
+ */
+typedef struct SpaceCacheReader_ {
+   const char *p; /**< Current position. */
+   const char *end; /**< End of the records. */
+   const char *str; /**< String table. */
+   uint32_t strsize; /**< Size of the string table. */
+   int err; /**< Set when the data is truncated or invalid. */
+} SpaceCacheReader;
+
+
+/*
+ * Prototypes.
+ */
+/* Writing. */
+static void cache_write( SpaceCacheBuf *b, const void *data, size_t size );
+static void cache_writeInt( SpaceCacheBuf *b, int i );
+static void cache_writeDouble( SpaceCacheBuf *b, double d );
+static void cache_writeString( SpaceCacheBuf *b, SpaceCacheBuf *s, const char *str );
+static void cache_writeVectors( SpaceCacheBuf *b, const Vector2d *v, int n );
+static void cache_writeSystem( SpaceCacheBuf *b, SpaceCacheBuf *s,
+      const StarSystem *sys, int first );
+/* Reading. */
+static void cache_read( SpaceCacheReader *r, void *data, size_t size );
+static int cache_readInt( SpaceCacheReader *r );
+static double cache_readDouble( SpaceCacheReader *r );
+static int cache_readCount( SpaceCacheReader *r, size_t size );
+static const char *cache_readString( SpaceCacheReader *r );
+static Vector2d *cache_readVectors( SpaceCacheReader *r, int *n );
+static void cache_readSystem( SpaceCacheReader *r, StarSystem *sys,
+      const char ***planets, int nsystems );
+static void cache_freeSystem( StarSystem *sys );
+
+
+/**
+ * @brief Appends data to a write buffer.
+ */
+static void cache_write( SpaceCacheBuf *b, const void *data, size_t size )
+{
+   if (size == 0)
+      return;
+   if (b->len + size > b->mem) {
+      b->mem  = MAX( b->mem + SPACE_CACHE_CHUNK, b->len + size );
+      b->data = realloc( b->data, b->mem );
+   }
+   memcpy( &b->data[ b->len ], data, size );
+   b->len += size;
+}
+
+
+/**
+ * @brief Appends an integer to a write buffer.
+ */
+static void cache_writeInt( SpaceCacheBuf *b, int i )
+{
+   int32_t v = i;
+   cache_write( b, &v, sizeof(v) );
+}
+
+
+/**
+ * @brief Appends a double to a write buffer.
+ */
+static void cache_writeDouble( SpaceCacheBuf *b, double d )
+{
+   cache_write( b, &d, sizeof(d) );
+}
+
+
+/**
+ * @brief Appends a string to the string table and its offset to a buffer.
+ *
+ *    @param b Buffer to write offset to.
+ *    @param s String table.
+ *    @param str String to write, may be NULL.
+ */
+static void cache_writeString( SpaceCacheBuf *b, SpaceCacheBuf *s, const char *str )
+{
+   uint32_t off;
+
+   if (str == NULL)
+      off = SPACE_CACHE_NULL;
+   else {
+      off = s->len;
+      cache_write( s, str, strlen(str)+1 );
+   }
+   cache_write( b, &off, sizeof(off) );
+}
+
+
+/**
+ * @brief Appends an array of vectors to a write buffer.
+ */
+static void cache_writeVectors( SpaceCacheBuf *b, const Vector2d *v, int n )
+{
+   int i;
+
+   cache_writeInt( b, n );
+   for (i=0; i<n; i++) {
+      cache_writeDouble( b, v[i].x );
+      cache_writeDouble( b, v[i].y );
+   }
+}
+
+
+/**
+ * @brief Writes the record of a star system.
+ *
+ *    @param b Buffer to write record to.
+ *    @param s String table.
+ *    @param sys System to write.
+ *    @param first Index of the first system written, jump targets are relative to it.
+ */
+static void cache_writeSystem( SpaceCacheBuf *b, SpaceCacheBuf *s,
+      const StarSystem *sys, int first )
+{
+   int i, j;
+   const JumpPoint *jp;
+   const AsteroidAnchor *a;
+   const AsteroidSubset *sub;
+
+   /* General. */
+   cache_writeString( b, s, sys->name );
+   cache_writeDouble( b, sys->pos.x );
+   cache_writeDouble( b, sys->pos.y );
+   cache_writeInt( b, sys->stars );
+   cache_writeDouble( b, sys->interference );
+   cache_writeDouble( b, sys->nebu_density );
+   cache_writeDouble( b, sys->nebu_volatility );
+   cache_writeDouble( b, sys->radius );
+   cache_writeString( b, s, sys->background );
+
+   /* Planets. */
+   cache_writeInt( b, sys->nplanets );
+   for (i=0; i<sys->nplanets; i++)
+      cache_writeString( b, s, sys->planets[i]->name );
+
+   /* Jumps. */
+   cache_writeInt( b, sys->njumps );
+   for (i=0; i<sys->njumps; i++) {
+      jp = &sys->jumps[i];
+      cache_writeInt( b, jp->targetid - first );
+      cache_writeDouble( b, jp->pos.x );
+      cache_writeDouble( b, jp->pos.y );
+      cache_writeDouble( b, jp->radius );
+      cache_writeDouble( b, jp->hide );
+      cache_writeInt( b, jp->flags );
+   }
+
+   /* Asteroids. */
+   cache_writeInt( b, sys->nasteroids );
+   for (i=0; i<sys->nasteroids; i++) {
+      a = &sys->asteroids[i];
+      cache_writeDouble( b, a->pos.x );
+      cache_writeDouble( b, a->pos.y );
+      cache_writeDouble( b, a->density );
+      cache_writeDouble( b, a->area );
+      cache_writeInt( b, a->nb );
+      cache_writeInt( b, a->ndebris );
+      cache_writeVectors( b, a->corners, a->ncorners );
+      cache_writeInt( b, a->nsubsets );
+      for (j=0; j<a->nsubsets; j++) {
+         sub = &a->subsets[j];
+         cache_writeDouble( b, sub->pos.x );
+         cache_writeDouble( b, sub->pos.y );
+         cache_writeDouble( b, sub->area );
+         cache_writeVectors( b, sub->corners, sub->ncorners );
+      }
+      cache_writeInt( b, a->ntype );
+      for (j=0; j<a->ntype; j++)
+         cache_writeInt( b, a->type[j] );
+   }
+}
+
+
+/**
+ * @brief Saves the star systems to the cache.
+ *
+ *    @param digest Digest of the data the systems were loaded from.
+ *    @param first Index of the first system to save.
+ *    @return 0 on success.
+ */
+int space_cacheSave( const uint8_t digest[16], int first )
+{
+   int i, nsys, ret;
+   StarSystem *systems;
+   SpaceCacheHeader h;
+   SpaceCacheBuf b, s, out;
+
+   memset( &b, 0, sizeof(b) );
+   memset( &s, 0, sizeof(s) );
+   memset( &out, 0, sizeof(out) );
+
+   /* Write the records. */
+   systems = system_getAll( &nsys );
+   for (i=first; i<nsys; i++)
+      cache_writeSystem( &b, &s, &systems[i], first );
+
+   /* Put the file together. */
+   memset( &h, 0, sizeof(h) );
+   memcpy( h.magic, space_cacheMagic, sizeof(h.magic) );
+   h.version   = SPACE_CACHE_VERSION;
+   memcpy( h.digest, digest, sizeof(h.digest) );
+   h.nsystems  = nsys - first;
+   h.strsize   = s.len;
+   cache_write( &out, &h, sizeof(h) );
+   cache_write( &out, s.data, s.len );
+   cache_write( &out, b.data, b.len );
+
+   nfile_dirMakeExist( "%s", nfile_cachePath() );
+   ret = nfile_writeFile( out.data, out.len, "%s"SPACE_CACHE_FILE, nfile_cachePath() );
+   if (ret)
+      WARN(_("Unable to write the universe cache."));
+
+   free( b.data );
+   free( s.data );
+   free( out.data );
+   return ret;
+}
+
+
+/**
+ * @brief Reads data from the cache.
+ */
+static void cache_read( SpaceCacheReader *r, void *data, size_t size )
+{
+   if (r->err || ((size_t)(r->end - r->p) < size)) {
+      r->err = 1;
+      memset( data, 0, size );
+      return;
+   }
+   memcpy( data, r->p, size );
+   r->p += size;
+}
+
+
+/**
+ * @brief Reads an integer from the cache.
+ */
+static int cache_readInt( SpaceCacheReader *r )
+{
+   int32_t v;
+   cache_read( r, &v, sizeof(v) );
+   return v;
+}
+
+
+/**
+ * @brief Reads a double from the cache.
+ */
+static double cache_readDouble( SpaceCacheReader *r )
+{
+   double d;
+   cache_read( r, &d, sizeof(d) );
+   return d;
+}
+
+
+/**
+ * @brief Reads the number of elements of an array, making sure they fit.
+ *
+ *    @param r Reader.
+ *    @param size Minimum size of an element.
+ *    @return Number of elements.
+ */
+static int cache_readCount( SpaceCacheReader *r, size_t size )
+{
+   int n = cache_readInt( r );
+   if ((n < 0) || ((size_t)n > (size_t)(r->end - r->p) / size)) {
+      r->err = 1;
+      return 0;
+   }
+   return n;
+}
+
+
+/**
+ * @brief Reads a string from the cache.
+ *
+ *    @return String in the string table, or NULL.
+ */
+static const char *cache_readString( SpaceCacheReader *r )
+{
+   uint32_t off;
+
+   cache_read( r, &off, sizeof(off) );
+   if (off == SPACE_CACHE_NULL)
+      return NULL;
+   if (off >= r->strsize) {
+      r->err = 1;
+      return NULL;
+   }
+   return &r->str[ off ];
+}
+
+
+/**
+ * @brief Reads an array of vectors from the cache.
+ *
+ *    @param r Reader.
+ *    @param[out] n Number of vectors read.
+ *    @return Newly allocated vectors.
+ */
+static Vector2d *cache_readVectors( SpaceCacheReader *r, int *n )
+{
+   int i;
+   Vector2d *v;
+
+   *n = cache_readCount( r, 2*sizeof(double) );
+   if (*n == 0)
+      return NULL;
+   v = malloc( sizeof(Vector2d) * (*n) );
+   for (i=0; i<*n; i++) {
+      v[i].x = cache_readDouble( r );
+      v[i].y = cache_readDouble( r );
+   }
+   return v;
+}
+
+
+/**
+ * @brief Reads the record of a star system.
+ *
+ * Planets are only read by name and jump targets are left as indices relative
+ * to the first system in the cache.
+ *
+ *    @param r Reader.
+ *    @param sys System to read into, must be zeroed.
+ *    @param[out] planets Names of the planets, sys->nplanets of them.
+ *    @param nsystems Number of systems in the cache.
+ */
+static void cache_readSystem( SpaceCacheReader *r, StarSystem *sys,
+      const char ***planets, int nsystems )
+{
+   int i, j;
+   const char *str;
+   JumpPoint *jp;
+   AsteroidAnchor *a;
+   AsteroidSubset *sub;
+
+   /* General. */
+   str = cache_readString( r );
+   if (str == NULL) {
+      r->err = 1;
+      return;
+   }
+   sys->name            = strdup( str );
+   sys->pos.x           = cache_readDouble( r );
+   sys->pos.y           = cache_readDouble( r );
+   sys->stars           = cache_readInt( r );
+   sys->interference    = cache_readDouble( r );
+   sys->nebu_density    = cache_readDouble( r );
+   sys->nebu_volatility = cache_readDouble( r );
+   sys->radius          = cache_readDouble( r );
+   str = cache_readString( r );
+   if (str != NULL)
+      sys->background   = strdup( str );
+
+   /* Planets. */
+   sys->nplanets = cache_readCount( r, sizeof(uint32_t) );
+   if (sys->nplanets > 0) {
+      *planets = malloc( sizeof(char*) * sys->nplanets );
+      for (i=0; i<sys->nplanets; i++) {
+         (*planets)[i] = cache_readString( r );
+         if ((*planets)[i] == NULL)
+            r->err = 1;
+      }
+   }
+
+   /* Jumps. */
+   sys->njumps = cache_readCount( r, sizeof(int32_t) );
+   if (sys->njumps > 0)
+      sys->jumps = calloc( sys->njumps, sizeof(JumpPoint) );
+   for (i=0; i<sys->njumps; i++) {
+      jp = &sys->jumps[i];
+      jp->targetid   = cache_readInt( r );
+      jp->pos.x      = cache_readDouble( r );
+      jp->pos.y      = cache_readDouble( r );
+      jp->radius     = cache_readDouble( r );
+      jp->hide       = cache_readDouble( r );
+      jp->flags      = cache_readInt( r );
+      if ((jp->targetid < 0) || (jp->targetid >= nsystems))
+         r->err = 1;
+   }
+
+   /* Asteroids. */
+   sys->nasteroids = cache_readCount( r, sizeof(double) );
+   if (sys->nasteroids > 0)
+      sys->asteroids = calloc( sys->nasteroids, sizeof(AsteroidAnchor) );
+   for (i=0; i<sys->nasteroids; i++) {
+      a = &sys->asteroids[i];
+      a->pos.x    = cache_readDouble( r );
+      a->pos.y    = cache_readDouble( r );
+      a->density  = cache_readDouble( r );
+      a->area     = cache_readDouble( r );
+      a->nb       = cache_readInt( r );
+      a->ndebris  = cache_readInt( r );
+      a->corners  = cache_readVectors( r, &a->ncorners );
+      a->nsubsets = cache_readCount( r, sizeof(double) );
+      if (a->nsubsets > 0)
+         a->subsets = calloc( a->nsubsets, sizeof(AsteroidSubset) );
+      for (j=0; j<a->nsubsets; j++) {
+         sub = &a->subsets[j];
+         sub->pos.x   = cache_readDouble( r );
+         sub->pos.y   = cache_readDouble( r );
+         sub->area    = cache_readDouble( r );
+         sub->corners = cache_readVectors( r, &sub->ncorners );
+      }
+      a->ntype = cache_readCount( r, sizeof(int32_t) );
+      if (a->ntype > 0)
+         a->type = malloc( sizeof(int) * a->ntype );
+      for (j=0; j<a->ntype; j++) {
+         a->type[j] = cache_readInt( r );
+         if (a->type[j] < 0)
+            r->err = 1;
+      }
+   }
+}
+
+
+/**
+ * @brief Frees a star system read from a cache that turned out to be invalid.
+ */
+static void cache_freeSystem( StarSystem *sys )
+{
+   int i, j;
+   AsteroidAnchor *a;
+
+   free( sys->name );
+   free( sys->background );
+   free( sys->jumps );
+   for (i=0; i<sys->nasteroids; i++) {
+      a = &sys->asteroids[i];
+      free( a->corners );
+      for (j=0; j<a->nsubsets; j++)
+         free( a->subsets[j].corners );
+      free( a->subsets );
+      free( a->type );
+   }
+   free( sys->asteroids );
+}
+
+
+/**
+ * @brief Loads the star systems from the cache.
+ *
+ * Nothing is added to the universe unless the whole cache is valid.
+ *
+ *    @param digest Digest of the data the systems would be loaded from.
+ *    @return 0 on success, the systems have to be loaded from XML otherwise.
+ */
+int space_cacheLoad( const uint8_t digest[16] )
+{
+   char *data;
+   size_t size;
+   int i, j, n, id, first, nplanets;
+   SpaceCacheHeader h;
+   SpaceCacheReader r;
+   StarSystem *tmp, *sys;
+   const char ***planets;
+
+   if (!nfile_fileExists( "%s"SPACE_CACHE_FILE, nfile_cachePath() ))
+      return -1;
+   data = nfile_readFile( &size, "%s"SPACE_CACHE_FILE, nfile_cachePath() );
+   if (data == NULL)
+      return -1;
+
+   /* Check the header. */
+   if (size < sizeof(h)) {
+      free( data );
+      return -1;
+   }
+   memcpy( &h, data, sizeof(h) );
+   if ((memcmp( h.magic, space_cacheMagic, sizeof(h.magic) ) != 0) ||
+         (h.version != SPACE_CACHE_VERSION) ||
+         (memcmp( h.digest, digest, sizeof(h.digest) ) != 0) ||
+         (h.strsize > size - sizeof(h)) ||
+         ((h.strsize > 0) && (data[ sizeof(h) + h.strsize - 1 ] != '\0')) ||
+         (h.nsystems > size)) {
+      free( data );
+      return -1;
+   }
+
+   /* Read everything before touching the universe. */
+   memset( &r, 0, sizeof(r) );
+   r.str     = &data[ sizeof(h) ];
+   r.strsize = h.strsize;
+   r.p       = &data[ sizeof(h) + h.strsize ];
+   r.end     = &data[ size ];
+   n         = h.nsystems;
+   tmp       = calloc( n, sizeof(StarSystem) );
+   planets   = calloc( n, sizeof(char**) );
+   for (i=0; (i<n) && !r.err; i++)
+      cache_readSystem( &r, &tmp[i], &planets[i], n );
+   if (r.err || (r.p != r.end)) {
+      for (i=0; i<n; i++) {
+         cache_freeSystem( &tmp[i] );
+         free( planets[i] );
+      }
+      free( tmp );
+      free( planets );
+      free( data );
+      return -1;
+   }
+
+   /* Add the systems. */
+   system_getAll( &first );
+   for (i=0; i<n; i++) {
+      sys            = system_new();
+      id             = sys->id;
+      nplanets       = tmp[i].nplanets;
+      *sys           = tmp[i];
+      sys->id        = id;
+      sys->faction   = -1;
+      sys->nplanets  = 0;
+      for (j=0; j<nplanets; j++)
+         system_addPlanet( sys, planets[i][j] );
+      free( planets[i] );
+   }
+
+   /* Fix up the jumps now that the stack won't move anymore. */
+   for (i=0; i<n; i++) {
+      sys = system_getIndex( first+i );
+      for (j=0; j<sys->njumps; j++) {
+         sys->jumps[j].targetid += first;
+         sys->jumps[j].target    = system_getIndex( sys->jumps[j].targetid );
+      }
+   }
+
+   free( tmp );
+   free( planets );
+   free( data );
+   return 0;
+}
@@ -0,0 +1,21 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef SPACE_CACHE_H
+#  define SPACE_CACHE_H
+
+
+#include <stdint.h>
+
+
+#define SPACE_CACHE_FILE      "universe.bin" /**< Name of the cache in the cache path. */
+#define SPACE_CACHE_VERSION   1 /**< Bump whenever the format changes. */
+
+
+int space_cacheLoad( const uint8_t digest[16] );
+int space_cacheSave( const uint8_t digest[16], int first );
+
+
+#endif /* SPACE_CACHE_H */
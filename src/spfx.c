@@ -28,6 +28,7 @@
 #include "nxml.h"
 #include "debris.h"
 #include "perlin.h"
+#include "nmem.h"
 
 
 #define SPFX_XML_ID     "spfxs" /**< XML Document tag. */
@@ -213,7 +214,7 @@ int spfx_get( char* name )
  */
 int spfx_load (void)
 {
-   int mem;
+   int i, mem;
    size_t bufsize;
    char *buf;
    xmlNodePtr node;
@@ -263,6 +264,16 @@ int spfx_load (void)
    xmlFreeDoc(doc);
    free(buf);
 
+   /* Upload the graphics. */
+   gl_texFlush();
+   for (i=0; i<spfx_neffects; i++) {
+      if (spfx_effects[i].gfx == NULL)
+         continue; /* Already warned about. */
+      spfx_effects[i].gfx = gl_texCheck( spfx_effects[i].gfx );
+      if (spfx_effects[i].gfx == NULL)
+         WARN( _("SPFX '%s' missing/invalid '%s' element"), spfx_effects[i].name, "gfx" );
+   }
+
 
    /*
     * Now initialize force feedback.
@@ -287,9 +298,11 @@ void spfx_free (void)
    /* get rid of all the particles and free the stacks */
    spfx_clear();
    if (spfx_stack_front) free(spfx_stack_front);
+   nmem_free( MEM_SPFX, spfx_mstack_front*sizeof(SPFX) );
    spfx_stack_front = NULL;
    spfx_mstack_front = 0;
    if (spfx_stack_back) free(spfx_stack_back);
+   nmem_free( MEM_SPFX, spfx_mstack_back*sizeof(SPFX) );
    spfx_stack_back = NULL;
    spfx_mstack_back = 0;
 
@@ -338,6 +351,7 @@ void spfx_add( int effect,
          else
             spfx_mstack_front += MIN( spfx_mstack_front, SPFX_CHUNK_MAX );
          spfx_stack_front = realloc( spfx_stack_front, spfx_mstack_front*sizeof(SPFX) );
+         nmem_realloc( MEM_SPFX, spfx_nstack_front*sizeof(SPFX), spfx_mstack_front*sizeof(SPFX) );
       }
       cur_spfx = &spfx_stack_front[spfx_nstack_front];
       spfx_nstack_front++;
@@ -349,6 +363,7 @@ void spfx_add( int effect,
          else
             spfx_mstack_back += MIN( spfx_mstack_back, SPFX_CHUNK_MAX );
          spfx_stack_back = realloc( spfx_stack_back, spfx_mstack_back*sizeof(SPFX) );
+         nmem_realloc( MEM_SPFX, spfx_nstack_back*sizeof(SPFX), spfx_mstack_back*sizeof(SPFX) );
       }
       cur_spfx = &spfx_stack_back[spfx_nstack_back];
       spfx_nstack_back++;
@@ -372,6 +387,18 @@ void spfx_add( int effect,
 }
 
 
+/**
+ * @brief Gets the number of running effects in a layer.
+ *
+ *    @param layer Layer to count effects of.
+ *    @return Number of effects in the layer.
+ */
+int spfx_count( const int layer )
+{
+   return (layer == SPFX_LAYER_FRONT) ? spfx_nstack_front : spfx_nstack_back;
+}
+
+
 /**
  * @brief Clears all the currently running effects.
  */
@@ -31,6 +31,7 @@
 #include "gui.h"
 #include "camera.h"
 #include "ai.h"
+#include "nmem.h"
 
 
 #define weapon_isSmart(w)     (w->think != NULL) /**< Checks if the weapon w is smart. */
@@ -1451,6 +1452,7 @@ static Weapon* weapon_create( const Outfit* outfit, double T,
 
    /* Create basic features */
    w           = calloc( 1, sizeof(Weapon) );
+   nmem_alloc( MEM_WEAPON, sizeof(Weapon) );
    w->dam_mod  = 1.; /* Default of 100% damage. */
    w->faction  = parent->faction; /* non-changeable */
    w->parent   = parent->id; /* non-changeable */
@@ -1581,6 +1583,7 @@ void weapon_add( const Outfit* outfit, const double T, const double dir,
             curLayer   = wfrontLayer = realloc(curLayer, (*mLayer)*sizeof(Weapon*));
             break;
       }
+      nmem_realloc( MEM_WEAPON, (*nLayer)*sizeof(Weapon*), (*mLayer)*sizeof(Weapon*) );
       curLayer[(*nLayer)++] = w;
 
       /* Grow the vertex stuff. */
@@ -1664,6 +1667,7 @@ unsigned int beam_start( const Outfit* outfit,
             curLayer = wfrontLayer = realloc(curLayer, (*mLayer)*sizeof(Weapon*));
             break;
       }
+      nmem_realloc( MEM_WEAPON, (*nLayer)*sizeof(Weapon*), (*mLayer)*sizeof(Weapon*) );
       curLayer[(*nLayer)++] = w;
 
       /* Grow the vertex stuff. */
@@ -1797,6 +1801,18 @@ static void weapon_free( Weapon* w )
 #endif /* DEBUGGING */
 
    free(w);
+   nmem_free( MEM_WEAPON, sizeof(Weapon) );
+}
+
+/**
+ * @brief Gets the number of weapons in a layer.
+ *
+ *    @param layer Layer to count weapons of.
+ *    @return Number of weapons in the layer.
+ */
+int weapon_count( WeaponLayer layer )
+{
+   return (layer == WEAPON_LAYER_BG) ? nwbackLayer : nwfrontLayer;
 }
 
 /**
@@ -1828,6 +1844,7 @@ void weapon_exit (void)
    /* Destroy front layer. */
    if (wbackLayer != NULL) {
       free(wbackLayer);
+      nmem_free( MEM_WEAPON, mwbacklayer*sizeof(Weapon*) );
       wbackLayer  = NULL;
       mwbacklayer = 0;
    }
@@ -1835,6 +1852,7 @@ void weapon_exit (void)
    /* Destroy back layer. */
    if (wfrontLayer != NULL) {
       free(wfrontLayer);
+      nmem_free( MEM_WEAPON, mwfrontLayer*sizeof(Weapon*) );
       wfrontLayer  = NULL;
       mwfrontLayer = 0;
    }
@@ -58,6 +58,7 @@ void weapons_render( const WeaponLayer layer, const double dt );
  * clean
  */
 void weapon_clear (void);
+int weapon_count( WeaponLayer layer );
 void weapon_exit (void);
 
 